@@ -4,5 +4,5 @@
 
 USER_OBJS :=
 
-LIBS := -lrt -lxml2 -lpthread
+LIBS := -lrt -lxml2 -lpthread -lm
 
@@ -8,6 +8,8 @@ C_SRCS += \
 ../src/hmcluster.c \
 ../src/hmconf.c \
 ../src/hmglobdb.c \
+../src/hmgossip.c \
+../src/hmhbeat.c \
 ../src/hmha.c \
 ../src/hmlocmgmt.c \
 ../src/hmmain.c \
@@ -24,6 +26,8 @@ OBJS += \
 ./src/hmcluster.o \
 ./src/hmconf.o \
 ./src/hmglobdb.o \
+./src/hmgossip.o \
+./src/hmhbeat.o \
 ./src/hmha.o \
 ./src/hmlocmgmt.o \
 ./src/hmmain.o \
@@ -40,6 +44,8 @@ C_DEPS += \
 ./src/hmcluster.d \
 ./src/hmconf.d \
 ./src/hmglobdb.d \
+./src/hmgossip.d \
+./src/hmhbeat.d \
 ./src/hmha.d \
 ./src/hmlocmgmt.d \
 ./src/hmmain.d \
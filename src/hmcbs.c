@@ -46,6 +46,7 @@ HM_CONFIG_CB * hm_alloc_config_cb()
   /* Initialize Addresses List for HM Instance                 */
   /***************************************************************************/
   HM_INIT_ROOT(config_cb->instance_info.addresses);
+  HM_INIT_ROOT(config_cb->instance_info.heartbeat_paths);
   /***************************************************************************/
   /* Initialize Node List                             */
   /***************************************************************************/
@@ -56,16 +57,43 @@ HM_CONFIG_CB * hm_alloc_config_cb()
   config_cb->instance_info.node.scope = HM_CONFIG_SCOPE_NODE;
   config_cb->instance_info.node.threshold = HM_CONFIG_DEFAULT_NODE_KICKOUT;
   config_cb->instance_info.node.timer_val = HM_CONFIG_DEFAULT_NODE_TICK_TIME;
+  config_cb->instance_info.node.phi_threshold = HM_CONFIG_DEFAULT_PHI_THRESHOLD;
+  config_cb->instance_info.node.liveness = HM_CONFIG_DEFAULT_LIVENESS;
 
   config_cb->instance_info.cluster.scope = HM_CONFIG_SCOPE_CLUSTER;
   config_cb->instance_info.cluster.threshold = HM_CONFIG_DEFAULT_PEER_KICKOUT;
   config_cb->instance_info.cluster.timer_val = HM_CONFIG_DEFAULT_PEER_TICK_TIME;
+  config_cb->instance_info.cluster.phi_threshold = HM_CONFIG_DEFAULT_PHI_THRESHOLD;
+  config_cb->instance_info.cluster.liveness = HM_CONFIG_DEFAULT_LIVENESS;
+  config_cb->instance_info.cluster.thread = HM_CONFIG_DEFAULT_HEARTBEAT_THREAD;
+  config_cb->instance_info.cluster.priority = HM_CONFIG_DEFAULT_HEARTBEAT_PRIORITY;
+  config_cb->instance_info.cluster.cpu = HM_CONFIG_DEFAULT_HEARTBEAT_CPU;
 
   /***************************************************************************/
   /* Initialize Transport Defauls                         */
   /***************************************************************************/
   config_cb->instance_info.mcast_group = HM_DEFAULT_MCAST_GROUP;
 
+  /***************************************************************************/
+  /* Subscriber Queue Defaults                         */
+  /***************************************************************************/
+  config_cb->instance_info.subs_queue.policy = HM_CONFIG_DEFAULT_SUBS_QUEUE_POLICY;
+  config_cb->instance_info.subs_queue.max_msgs = HM_CONFIG_DEFAULT_SUBS_QUEUE_MSGS;
+  config_cb->instance_info.subs_queue.max_bytes = HM_CONFIG_DEFAULT_SUBS_QUEUE_BYTES;
+  config_cb->instance_info.subs_queue.max_overflows =
+                                        HM_CONFIG_DEFAULT_SUBS_QUEUE_OVERFLOWS;
+
+  /***************************************************************************/
+  /* Peer Frame Default                              */
+  /***************************************************************************/
+  config_cb->instance_info.peer_frame_size = HM_CONFIG_DEFAULT_PEER_FRAME_SIZE;
+  config_cb->instance_info.replay_chunks = HM_CONFIG_DEFAULT_REPLAY_CHUNKS;
+  config_cb->instance_info.replay_rate = HM_CONFIG_DEFAULT_REPLAY_RATE;
+  config_cb->instance_info.membership = HM_CONFIG_DEFAULT_MEMBERSHIP;
+  config_cb->instance_info.gossip_fanout = HM_CONFIG_DEFAULT_GOSSIP_FANOUT;
+  config_cb->instance_info.aggregation_role = HM_CONFIG_DEFAULT_AGGREGATION_ROLE;
+  config_cb->instance_info.aggregator = 0;
+
 
 EXIT_LABEL:
   /***************************************************************************/
@@ -88,6 +116,7 @@ HM_TRANSPORT_CB * hm_alloc_transport_cb(uint32_t conn_type)
   /* Variable Declarations                           */
   /***************************************************************************/
   HM_TRANSPORT_CB *transport_cb = NULL;
+  uint32_t i;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -115,8 +144,14 @@ HM_TRANSPORT_CB * hm_alloc_transport_cb(uint32_t conn_type)
   transport_cb->in_buffer = NULL;
   transport_cb->out_buffer = NULL;
   transport_cb->hold = FALSE;
+  transport_cb->out_block = NULL;
+  transport_cb->out_offset = 0;
 
-  HM_INIT_ROOT(transport_cb->pending);
+  for(i = 0; i < HM_NUM_PRIORITIES; i++)
+  {
+    HM_INIT_ROOT(transport_cb->pending[i]);
+    transport_cb->credits[i] = hm_priority_weight[i];
+  }
 
 EXIT_LABEL:
   /***************************************************************************/
@@ -268,6 +303,7 @@ HM_LOCATION_CB * hm_alloc_location_cb()
   /* Variable Declarations                           */
   /***************************************************************************/
   HM_LOCATION_CB *loc_cb = NULL;
+  uint32_t lane;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -302,6 +338,10 @@ HM_LOCATION_CB * hm_alloc_location_cb()
     goto EXIT_LABEL;
   }
   loc_cb->keepalive_missed = 0;
+  hm_phi_init(&loc_cb->liveness);
+  memset(&loc_cb->link, 0, sizeof(loc_cb->link));
+  memset(&loc_cb->paths, 0, sizeof(loc_cb->paths));
+  loc_cb->capabilities = 0;
   loc_cb->keepalive_period = LOCAL.peer_keepalive_period;
   loc_cb->peer_listen_cb = NULL;
 
@@ -309,6 +349,31 @@ HM_LOCATION_CB * hm_alloc_location_cb()
   loc_cb->total_nodes = 0;
   loc_cb->active_processes = 0;
   loc_cb->replay_in_progress = FALSE;
+  memset(&loc_cb->replay, 0, sizeof(loc_cb->replay));
+  HM_INIT_LQE(loc_cb->replay.node, loc_cb);
+  loc_cb->incarnation = 0;
+  loc_cb->version = 0;
+  loc_cb->replay_since = 0;
+  loc_cb->digest = 0;
+  loc_cb->held_digest = 0;
+  loc_cb->tables_intact = FALSE;
+  loc_cb->interest_all = TRUE;
+  loc_cb->num_interests = 0;
+  loc_cb->aggregation_role = HM_AGGREGATION_ROLE_MESH;
+  loc_cb->aggregator = 0;
+  loc_cb->via = NULL;
+  loc_cb->frame_size = 0;
+  memset(loc_cb->lanes, 0, sizeof(loc_cb->lanes));
+  for (lane = 0; lane < HM_PEER_NUM_LANES; lane++)
+  {
+    HM_INIT_ROOT(loc_cb->lanes[lane].unacked);
+  }
+  loc_cb->ack_pending = FALSE;
+  loc_cb->member_status = HM_PEER_MEMBER_ALIVE;
+  loc_cb->member_incarnation = 0;
+  loc_cb->suspect_ticks = 0;
+  loc_cb->gossip_sends_left = 0;
+  loc_cb->gossip_full_sync = FALSE;
   /***************************************************************************/
   /* The following fields are necessary only for a local node. Maybe I would */
   /* remove them later.                             */
@@ -355,6 +420,11 @@ int32_t hm_free_location_cb(HM_LOCATION_CB *loc_cb)
   /* Free Nodes tree if not free.                         */
   /***************************************************************************/
 
+  /***************************************************************************/
+  /* A replay still under way to it has nowhere to go.             */
+  /***************************************************************************/
+  hm_cluster_replay_cancel(loc_cb);
+
   /***************************************************************************/
   /* Free memory                                 */
   /***************************************************************************/
@@ -421,6 +491,13 @@ HM_NODE_CB * hm_alloc_node_cb(uint32_t local)
   node_cb->keepalive_period = HM_CONFIG_DEFAULT_NODE_TICK_TIME;
   node_cb->timer_cb = NULL;
   node_cb->keepalive_missed = 0;
+  hm_phi_init(&node_cb->liveness);
+  node_cb->capabilities = 0;
+  node_cb->version = 0;
+  node_cb->hlc = 0;
+  node_cb->reported_status = HM_PEER_ENTITY_STATUS_INACTIVE;
+  node_cb->digest_leaf = 0;
+  node_cb->digest = 0;
   /***************************************************************************/
   /* Create a Timer                               */
   /***************************************************************************/
@@ -561,6 +638,10 @@ HM_PROCESS_CB * hm_alloc_process_cb()
   HM_AVL3_INIT_NODE(proc_cb->node, proc_cb);
   HM_INIT_ROOT(proc_cb->interfaces_list);
   proc_cb->running = FALSE;
+  proc_cb->version = 0;
+  proc_cb->hlc = 0;
+  proc_cb->reported_status = HM_PEER_ENTITY_STATUS_INACTIVE;
+  proc_cb->digest = 0;
 
   proc_cb->role = NODE_ROLE_PASSIVE;
   proc_cb->partner = NULL;
@@ -776,7 +857,8 @@ void hm_free_notify_cb(HM_NOTIFICATION_CB *notify_cb)
   /***************************************************************************/
   /* Variable Declarations                           */
   /***************************************************************************/
-
+  HM_GLOBAL_PENDING *pending = NULL;
+  uint32_t priority;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -791,6 +873,18 @@ void hm_free_notify_cb(HM_NOTIFICATION_CB *notify_cb)
     TRACE_DETAIL(("Removing from Notify list"));
     HM_REMOVE_FROM_LIST(notify_cb->node);
   }
+  /***************************************************************************/
+  /* No longer waiting on its row to be merged into.             */
+  /***************************************************************************/
+  if(notify_cb->node_cb.void_cb != NULL)
+  {
+    pending = hm_global_pending(notify_cb->node_cb.void_cb);
+    priority = hm_notify_priority(notify_cb->notification_type);
+    if((pending != NULL) && (pending->notify[priority] == notify_cb))
+    {
+      pending->notify[priority] = NULL;
+    }
+  }
   if(notify_cb->custom_data != NULL)
   {
     TRACE_DETAIL(("Blindly freeing custom data."));
@@ -803,3 +897,78 @@ void hm_free_notify_cb(HM_NOTIFICATION_CB *notify_cb)
   /***************************************************************************/
   TRACE_EXIT();
 }/* hm_free_notify_cb */
+
+
+/**
+ *  @brief Allocates a heartbeat path of type #HM_HEARTBEAT_PATH
+ *
+ *  @param *listen_cb Transport (#HM_TRANSPORT_CB) that joins the group
+ *  @param *send_cb Transport (#HM_TRANSPORT_CB) addressing the group
+ *  @return Pointer to the path, or NULL
+ */
+HM_HEARTBEAT_PATH * hm_alloc_heartbeat_path(HM_TRANSPORT_CB *listen_cb,
+                                            HM_TRANSPORT_CB *send_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_HEARTBEAT_PATH *path = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(listen_cb != NULL);
+  TRACE_ASSERT(send_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  path = (HM_HEARTBEAT_PATH *)malloc(sizeof(HM_HEARTBEAT_PATH));
+  if(path == NULL)
+  {
+    TRACE_ERROR(("Error allocating memory for heartbeat path"));
+    goto EXIT_LABEL;
+  }
+  memset(path, 0, sizeof(HM_HEARTBEAT_PATH));
+  HM_INIT_LQE(path->node, path);
+  path->listen_cb = listen_cb;
+  path->send_cb = send_cb;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return(path);
+}/* hm_alloc_heartbeat_path */
+
+
+/**
+ *  @brief Frees a heartbeat path and its transports
+ *
+ *  @param *path Heartbeat path (#HM_HEARTBEAT_PATH) to be freed
+ *  @return void
+ */
+void hm_free_heartbeat_path(HM_HEARTBEAT_PATH *path)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(path != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if(HM_IN_LIST(path->node))
+  {
+    HM_REMOVE_FROM_LIST(path->node);
+  }
+  hm_free_transport_cb(path->send_cb);
+  hm_free_transport_cb(path->listen_cb);
+  free(path);
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_free_heartbeat_path */
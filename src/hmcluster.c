@@ -16,9 +16,10 @@
  *
  *  @param *msg Message received on Transport Layer
  *  @param *sender Address of the sender (#SOCKADDR)
+ *  @param path_id Heartbeat path (#HM_HEARTBEAT_PATH) it was heard on
  *  @return void
  */
-void hm_cluster_check_location(HM_MSG *msg, SOCKADDR *sender)
+void hm_cluster_check_location(HM_MSG *msg, SOCKADDR *sender, uint32_t path_id)
 {
   /***************************************************************************/
   /* Variable Declarations                           */
@@ -34,6 +35,8 @@ void hm_cluster_check_location(HM_MSG *msg, SOCKADDR *sender)
 
   int32_t loc_id, port_id;
   int32_t temp_var;
+  uint32_t version, digest;
+  uint32_t role, aggregator;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -47,11 +50,73 @@ void hm_cluster_check_location(HM_MSG *msg, SOCKADDR *sender)
 
   memcpy(&send_addr.sock_addr, sender, sizeof(SOCKADDR));
   HM_GET_LONG(loc_id, keepalive_msg->hdr.hw_id);
+  if (loc_id != LOCAL.local_location_cb.index)
+  {
+    hm_hlc_merge(hm_hlc_get(keepalive_msg->hdr.timestamp));
+  }
+
+  /***************************************************************************/
+  /* In an aggregated cluster, we do not connect to every location we hear. */
+  /***************************************************************************/
+  HM_GET_LONG(role, keepalive_msg->aggregation_role);
+  HM_GET_LONG(aggregator, keepalive_msg->aggregator);
+  if (!hm_cluster_may_peer(loc_id, role, aggregator))
+  {
+    TRACE_DETAIL(("Location %d is not ours to peer with.", loc_id));
+    goto EXIT_LABEL;
+  }
+
   glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIND(LOCAL.locations_tree,
             &loc_id,
             locations_tree_by_db_id);
 
-  if (glob_cb == NULL)
+  if ((glob_cb != NULL) && (glob_cb->loc_cb->via != NULL))
+  {
+    TRACE_DETAIL(("Location %d is known through Location %d.", loc_id,
+                  glob_cb->loc_cb->via->index));
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* The same Tick comes in once on each heartbeat path. Note the path it   */
+  /* came by, but act on it only once. A heartbeat thread keeps the health */
+  /* of the paths itself.                                                  */
+  /***************************************************************************/
+  if ((glob_cb != NULL) && (!LOCAL.heartbeat.running))
+  {
+    hm_cluster_path_heard(&glob_cb->loc_cb->paths, loc_id, path_id);
+  }
+  if (hm_cluster_seen_tick(loc_id, hm_get_64(keepalive_msg->sent_ns)))
+  {
+    TRACE_DETAIL(("Tick of location %d already heard on another path.", loc_id));
+    goto EXIT_LABEL;
+  }
+
+  if ((glob_cb == NULL) &&
+      (LOCAL.local_location_cb.peer_listen_cb->type == HM_TRANSPORT_UDP))
+  {
+    /***************************************************************************/
+    /* There is no connection to make. Say INIT on our datagram socket, and   */
+    /* say it again on each tick of the peer until it answers.          */
+    /***************************************************************************/
+    HM_GET_LONG(port_id, keepalive_msg->listen_port);
+    send_addr.in_addr.sin_port = port_id;
+
+    loc_cb = hm_cluster_find_peer(loc_id);
+    if (loc_cb == NULL)
+    {
+      TRACE_INFO(("New Location Detected"));
+      loc_cb = hm_cluster_add_datagram_peer(loc_id, &send_addr.sock_addr);
+      if (loc_cb == NULL)
+      {
+        TRACE_ERROR(("Error creating datagram peer!"));
+        goto EXIT_LABEL;
+      }
+      hm_peer_fsm(HM_PEER_FSM_CONNECT, loc_cb);
+    }
+    hm_cluster_send_init(loc_cb->peer_listen_cb);
+  }
+  else if (glob_cb == NULL)
   {
     TRACE_INFO(("New Location Detected"));
     /***************************************************************************/
@@ -96,6 +161,22 @@ void hm_cluster_check_location(HM_MSG *msg, SOCKADDR *sender)
   else
   {
     TRACE_DETAIL(("Keepalive Message from known location."));
+    if (glob_cb->loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE)
+    {
+      hm_cluster_check_return(glob_cb->loc_cb, keepalive_msg);
+    }
+
+    if ((glob_cb->loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE) &&
+        (glob_cb->loc_cb->peer_listen_cb->type == HM_TRANSPORT_UDP))
+    {
+      /***************************************************************************/
+      /* We had given up on it, but it is ticking. Start over.           */
+      /***************************************************************************/
+      TRACE_INFO(("Location %d is back. Send INIT.", loc_id));
+      hm_cluster_send_init(glob_cb->loc_cb->peer_listen_cb);
+      goto EXIT_LABEL;
+    }
+
     if(glob_cb->status != HM_STATUS_RUNNING)
     {
       TRACE_WARN(("Receiving Tick from an Inactive Node. State inconsistent!"));
@@ -109,36 +190,43 @@ void hm_cluster_check_location(HM_MSG *msg, SOCKADDR *sender)
     {
       glob_cb->loc_cb->keepalive_missed--;
     }
+    hm_phi_heartbeat(&glob_cb->loc_cb->liveness,
+                     glob_cb->loc_cb->keepalive_period);
 
     /***************************************************************************/
-    /* Check if the number of processes and nodes cited in Keepalive are consi-*/
-    /* -stent with what we have. If not, re-initiate replay.           */
+    /* Look for the acknowledgement of our stream to this peer, if any.     */
     /***************************************************************************/
-    if (!glob_cb->loc_cb->replay_in_progress)
+    hm_cluster_read_keepalive_acks(keepalive_msg, msg->msg_len, glob_cb->loc_cb);
+
+    /***************************************************************************/
+    /* Check if the tables cited in Keepalive are consistent with what we have.*/
+    /* Counts and digest are only comparable once we have every change upto   */
+    /* the version it cites; till then, its updates are on their way.        */
+    /* Its digest covers all its processes: if we hold only those we subscribe*/
+    /* to, ours cannot match it, and the periodic digests tell us instead.   */
+    /***************************************************************************/
+    if ((glob_cb->loc_cb->fsm_state == HM_PEER_FSM_STATE_ACTIVE) &&
+        (!glob_cb->loc_cb->replay_in_progress))
     {
       TRACE_DETAIL(("Replay not in progress. Check consistency!"));
       HM_GET_LONG(temp_var, keepalive_msg->num_nodes);
       TRACE_DETAIL(("Active Nodes reported: %d", temp_var));
-
-      if (temp_var != glob_cb->loc_cb->active_nodes)
-      {
-        TRACE_WARN(("States inconsistent, initiate replay."));
-        hm_cluster_replay_info(glob_cb->loc_cb->peer_listen_cb);
-        glob_cb->loc_cb->replay_in_progress = TRUE;
-      }
-
-      temp_var = 0;
       HM_GET_LONG(temp_var, keepalive_msg->num_proc);
       TRACE_DETAIL(("Active Processes reported: %d", temp_var));
 
-      if (temp_var != glob_cb->loc_cb->active_processes)
+      HM_GET_LONG(version, keepalive_msg->version);
+      HM_GET_LONG(digest, keepalive_msg->digest);
+
+      if ((LOCAL.local_location_cb.interest_all) &&
+          (version == glob_cb->loc_cb->version) &&
+          (digest != glob_cb->loc_cb->digest))
       {
-        TRACE_WARN(("States inconsistent, initiate replay."));
-        hm_cluster_replay_info(glob_cb->loc_cb->peer_listen_cb);
-        glob_cb->loc_cb->replay_in_progress = TRUE;
+        TRACE_WARN(("Tables of Location %d differ at version %d. Compare digests.",
+                    loc_id, version));
+        hm_cluster_send_root_digest(glob_cb->loc_cb);
       }
     }
-    else
+    else if (glob_cb->loc_cb->replay_in_progress)
     {
       TRACE_INFO(("Peer is in replay mode. Stats must converge soon."));
     }
@@ -152,9 +240,313 @@ EXIT_LABEL:
 }/* hm_cluster_check_location */
 
 
+/**
+ *  @brief Finds a peer by its location index
+ *
+ *  Besides active locations, looks among datagram peers whose INIT exchange
+ *  is still in progress.
+ *
+ *  @param index Hardware location index of the peer
+ *  @return Location CB (#HM_LOCATION_CB) of the peer if known, NULL otherwise
+ */
+HM_LOCATION_CB *hm_cluster_find_peer(uint32_t index)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIND(LOCAL.locations_tree,
+            &index,
+            locations_tree_by_db_id);
+  if (glob_cb != NULL)
+  {
+    loc_cb = glob_cb->loc_cb;
+    goto EXIT_LABEL;
+  }
+
+  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.local_location_cb.peer_list);
+       block != NULL;
+       block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+  {
+    if (((HM_LOCATION_CB *)block->target)->index == index)
+    {
+      loc_cb = (HM_LOCATION_CB *)block->target;
+      break;
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (loc_cb);
+}/* hm_cluster_find_peer */
+
+
+/**
+ *  @brief Creates a peer reached over our datagram socket
+ *
+ *  Its transport only carries the address of the peer; all peers share the
+ *  one socket. Reliability comes from the sequenced stream to the location.
+ *  The peer stays on the pending list till the INIT exchange completes.
+ *
+ *  @param index Hardware location index of the peer
+ *  @param *addr Address (#SOCKADDR) of the datagram socket of the peer
+ *  @return Location CB (#HM_LOCATION_CB) of the peer, NULL on error
+ */
+HM_LOCATION_CB *hm_cluster_add_datagram_peer(uint32_t index, SOCKADDR *addr)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(addr != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  loc_cb = hm_alloc_location_cb();
+  if (loc_cb == NULL)
+  {
+    TRACE_ERROR(("Error allocating Location CB."));
+    goto EXIT_LABEL;
+  }
+  loc_cb->fsm_state = HM_PEER_FSM_STATE_NULL;
+  loc_cb->index = index;
+
+  loc_cb->peer_listen_cb = hm_alloc_transport_cb(HM_TRANSPORT_UDP);
+  block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
+  if ((loc_cb->peer_listen_cb == NULL) || (block == NULL))
+  {
+    TRACE_ERROR(("Error allocating datagram peer."));
+    if (loc_cb->peer_listen_cb != NULL)
+    {
+      hm_free_transport_cb(loc_cb->peer_listen_cb);
+      loc_cb->peer_listen_cb = NULL;
+    }
+    if (block != NULL)
+    {
+      free(block);
+    }
+    hm_free_location_cb(loc_cb);
+    loc_cb = NULL;
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Fix pointers. The socket keeps pointing to our own transport.        */
+  /***************************************************************************/
+  loc_cb->peer_listen_cb->location_cb = loc_cb;
+  loc_cb->peer_listen_cb->sock_cb = LOCAL.local_location_cb.peer_listen_cb->sock_cb;
+  memcpy(&loc_cb->peer_listen_cb->address.address, addr, sizeof(SOCKADDR));
+
+  HM_INIT_LQE(block->node, block);
+  block->target = loc_cb;
+  block->opaque = NULL;
+  HM_INSERT_BEFORE(LOCAL.local_location_cb.peer_list, block->node);
+
+  if (LOCAL.membership == HM_MEMBERSHIP_GOSSIP)
+  {
+    hm_gossip_add_member(loc_cb);
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (loc_cb);
+}/* hm_cluster_add_datagram_peer */
+
+
+/**
+ *  @brief Processes a datagram received on the socket shared by all peers
+ *
+ *  The message is handed to the location it claims to be from. An INIT from
+ *  an unknown location creates it. Anything else from a location that is not
+ *  active is dropped; it is never acknowledged, so it comes again.
+ *
+ *  @param *tprt_cb Our own peer transport (#HM_TRANSPORT_CB), holding the datagram
+ *  @param *sender Address (#SOCKADDR) the datagram came from
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_recv_datagram(HM_TRANSPORT_CB *tprt_cb, SOCKADDR *sender)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_PEER_MSG_HEADER *msg_header = NULL;
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_TRANSPORT_CB *peer_tprt_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+
+  uint32_t hw_id;
+  uint32_t msg_type;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  msg_header = (HM_PEER_MSG_HEADER *)tprt_cb->in_buffer;
+  HM_GET_LONG(hw_id, msg_header->hw_id);
+  HM_GET_LONG(msg_type, msg_header->msg_type);
+
+  if (hw_id == LOCAL.local_location_cb.index)
+  {
+    TRACE_WARN(("Datagram claims to be from us. Dropped."));
+    goto EXIT_LABEL;
+  }
+
+  if ((msg_type == HM_PEER_MSG_TYPE_PING) ||
+      (msg_type == HM_PEER_MSG_TYPE_PING_REQ) ||
+      (msg_type == HM_PEER_MSG_TYPE_PING_ACK))
+  {
+    /***************************************************************************/
+    /* Gossip is not tied to the state of the peer FSM.              */
+    /***************************************************************************/
+    if (LOCAL.membership == HM_MEMBERSHIP_GOSSIP)
+    {
+      ret_val = hm_gossip_receive(tprt_cb, sender);
+    }
+    else
+    {
+      TRACE_DETAIL(("Gossip from Location %d, but we do not gossip. Dropped.",
+                    hw_id));
+    }
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* An INIT is read before any peer is picked for it. A short one is noise  */
+  /* on the shared socket.                          */
+  /***************************************************************************/
+  if ((msg_type == HM_PEER_MSG_TYPE_INIT) &&
+      (tprt_cb->in_bytes < (int32_t)sizeof(HM_PEER_MSG_INIT)))
+  {
+    TRACE_WARN(("INIT of %d bytes from Location %d is too short. Dropped.",
+                tprt_cb->in_bytes, hw_id));
+    goto EXIT_LABEL;
+  }
+
+  loc_cb = hm_cluster_find_peer(hw_id);
+  if ((loc_cb != NULL) && (loc_cb->via != NULL))
+  {
+    TRACE_DETAIL(("Location %d is known through an aggregator. Dropped.", hw_id));
+    goto EXIT_LABEL;
+  }
+
+  if (loc_cb == NULL)
+  {
+    if ((msg_type != HM_PEER_MSG_TYPE_INIT) || (sender == NULL))
+    {
+      TRACE_DETAIL(("Message %d from unknown Location %d. Dropped.", msg_type,
+                    hw_id));
+      goto EXIT_LABEL;
+    }
+    if (!hm_cluster_init_may_peer((HM_PEER_MSG_INIT *)tprt_cb->in_buffer))
+    {
+      TRACE_DETAIL(("Location %d is not ours to peer with. Dropped.", hw_id));
+      goto EXIT_LABEL;
+    }
+    TRACE_INFO(("INIT from new Location %d", hw_id));
+    loc_cb = hm_cluster_add_datagram_peer(hw_id, sender);
+    if (loc_cb == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+  }
+  else if ((msg_type != HM_PEER_MSG_TYPE_INIT) &&
+           (loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE))
+  {
+    TRACE_DETAIL(("Location %d is not active. Message %d dropped.", hw_id,
+                  msg_type));
+    goto EXIT_LABEL;
+  }
+
+  if (msg_type == HM_PEER_MSG_TYPE_KEEPALIVE)
+  {
+    /***************************************************************************/
+    /* Without multicast, acks come to us alone.                 */
+    /***************************************************************************/
+    hm_tprt_heard_from(loc_cb->peer_listen_cb, FALSE);
+    hm_hlc_merge(hm_hlc_get(msg_header->timestamp));
+    hm_cluster_read_keepalive_acks((HM_PEER_MSG_KEEPALIVE *)tprt_cb->in_buffer,
+                                   tprt_cb->in_bytes, loc_cb);
+    goto EXIT_LABEL;
+  }
+
+  peer_tprt_cb = loc_cb->peer_listen_cb;
+  if ((msg_type == HM_PEER_MSG_TYPE_INIT) && (sender != NULL))
+  {
+    /***************************************************************************/
+    /* Answer where it says INIT from. It may have restarted elsewhere.     */
+    /***************************************************************************/
+    memcpy(&peer_tprt_cb->address.address, sender, sizeof(SOCKADDR));
+  }
+
+  peer_tprt_cb->in_buffer = tprt_cb->in_buffer;
+  peer_tprt_cb->in_bytes = tprt_cb->in_bytes;
+  ret_val = hm_receive_cluster_message(peer_tprt_cb);
+  peer_tprt_cb->in_buffer = NULL;
+
+  if ((msg_type == HM_PEER_MSG_TYPE_INIT) &&
+      (loc_cb->fsm_state == HM_PEER_FSM_STATE_ACTIVE))
+  {
+    /***************************************************************************/
+    /* INIT exchange is complete. It is in the locations tree now.       */
+    /***************************************************************************/
+    for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.local_location_cb.peer_list);
+         block != NULL;
+         block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+    {
+      if (block->target == loc_cb)
+      {
+        HM_REMOVE_FROM_LIST(block->node);
+        free(block);
+        break;
+      }
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_recv_datagram */
+
+
 /**
  *  @brief Sends out a Keepalive message on the multicast socket
  *
+ *  The Keepalive also acknowledges what has been received from each active
+ *  peer. Each tick, messages the peers have not acknowledged in time are sent
+ *  again. It goes out every period, however busy the streams to the peers:
+ *  it carries our table version and digest, it is heard on each heartbeat
+ *  path, and it is how new locations find us.
+ *
  *  @param None
  *  @return void
  */
@@ -165,11 +557,13 @@ void hm_cluster_send_tick()
   /***************************************************************************/
   HM_PEER_MSG_KEEPALIVE *tick_msg = NULL;
   HM_MSG *msg = NULL;
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_HEARTBEAT_PATH *path = NULL;
 
   SOCKADDR_IN *addr = NULL;
-  time_t current_time;
 
   uint32_t msg_type = HM_PEER_MSG_TYPE_KEEPALIVE;
+  uint32_t num_acks = 0, max_acks = 0;
 #ifdef I_WANT_TO_DEBUG
   uint32_t i = 0;
 #endif
@@ -180,6 +574,30 @@ void hm_cluster_send_tick()
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
+  LOCAL.peer_tick_count++;
+
+  /***************************************************************************/
+  /* Count the peers to acknowledge, upto what fits in a frame.        */
+  /***************************************************************************/
+  max_acks = (LOCAL.peer_frame_size - HM_PEER_KEEPALIVE_MSG_SIZE(0)) /
+                                                           sizeof(HM_PEER_ACK);
+  for (glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       glob_cb != NULL;
+       glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                 locations_tree_by_db_id))
+  {
+    if ((glob_cb->loc_cb->index == LOCAL.local_location_cb.index) ||
+        (glob_cb->loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE))
+    {
+      continue;
+    }
+
+    if (num_acks < max_acks)
+    {
+      num_acks++;
+    }
+  }
 
   /***************************************************************************/
   /* Get a bufffer for Keepalive messages.                   */
@@ -189,15 +607,17 @@ void hm_cluster_send_tick()
   /* hm_free_buffer which won't be possible there.               */
   /* The use of HM_MSG buffer type restricts us from doing that for now.     */
   /***************************************************************************/
-  msg = hm_get_buffer(sizeof(HM_PEER_MSG_KEEPALIVE));
+  msg = hm_get_buffer(HM_PEER_KEEPALIVE_MSG_SIZE(num_acks));
 
   if (msg == NULL)
   {
     TRACE_ERROR(("Error allcating buffer for Keepalive Message."));
     TRACE_ASSERT(FALSE);
+    goto EXIT_LABEL;
   }
 
   tick_msg = (HM_PEER_MSG_KEEPALIVE *)msg->msg;
+  memset(tick_msg, 0, HM_PEER_KEEPALIVE_MSG_SIZE(num_acks));
 
   HM_PUT_LONG(tick_msg->hdr.hw_id, LOCAL.local_location_cb.index);
 #ifdef I_WANT_TO_DEBUG
@@ -218,10 +638,10 @@ void hm_cluster_send_tick()
   }
 
 #endif
+  HM_PUT_LONG(tick_msg->hdr.msg_len, HM_PEER_KEEPALIVE_MSG_SIZE(num_acks));
 
-  current_time = hm_hton64(time(NULL));
-  TRACE_DETAIL(("Time value: 0x%x", (unsigned int)current_time));
-  memcpy(tick_msg->hdr.timestamp, &current_time, sizeof(current_time));
+  hm_hlc_put(tick_msg->hdr.timestamp, hm_hlc_now());
+  TRACE_DETAIL(("Clock: 0x%llx", (unsigned long long)LOCAL.hlc));
 #ifdef I_WANT_TO_DEBUG
 
   for (i = 0; i < sizeof(tick_msg->hdr.timestamp); i++)
@@ -265,80 +685,140 @@ void hm_cluster_send_tick()
 
 #endif
 
+  HM_PUT_LONG(tick_msg->incarnation, LOCAL.local_location_cb.incarnation);
+  HM_PUT_LONG(tick_msg->version, LOCAL.local_location_cb.version);
+  HM_PUT_LONG(tick_msg->digest, LOCAL.local_location_cb.digest);
+  TRACE_DETAIL(("Tables at version %d, digest 0x%x",
+                LOCAL.local_location_cb.version, LOCAL.local_location_cb.digest));
+  HM_PUT_LONG(tick_msg->aggregation_role, LOCAL.aggregation_role);
+  HM_PUT_LONG(tick_msg->aggregator, LOCAL.aggregator);
+  hm_put_64(tick_msg->sent_ns, hm_time_ns());
+  hm_put_64(tick_msg->wall_ns, hm_wall_time_ns());
+
   /***************************************************************************/
-  /* Message created. Now, add it to outgoing queue and try to send       */
+  /* Acknowledge the streams from peers too. Most go out sooner, on the    */
+  /* streams themselves.                            */
   /***************************************************************************/
-  if (hm_queue_on_transport(msg, LOCAL.mcast_addr, FALSE) != HM_OK)
+  HM_PUT_LONG(tick_msg->num_acks, num_acks);
+  num_acks = 0;
+  for (glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       glob_cb != NULL;
+       glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                 locations_tree_by_db_id))
   {
-    TRACE_ERROR(("Error occured while sending Tick"));
+    if ((glob_cb->loc_cb->index == LOCAL.local_location_cb.index) ||
+        (glob_cb->loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE))
+    {
+      continue;
+    }
+
+    if (num_acks < max_acks)
+    {
+      hm_cluster_put_ack(&tick_msg->acks[num_acks], glob_cb->loc_cb);
+      glob_cb->loc_cb->ack_pending = FALSE;
+      num_acks++;
+    }
   }
 
   /***************************************************************************/
-  /* Exit Level Checks                             */
+  /* Message created. Hand it to the heartbeat thread to send, or add it to  */
+  /* outgoing queue of each heartbeat path and try to send          */
   /***************************************************************************/
-  TRACE_EXIT();
-}/* hm_cluster_send_tick */
-
-
+  if (LOCAL.heartbeat.running)
+  {
+    hm_heartbeat_set_tick(msg);
+    hm_free_buffer(msg);
+    goto EXIT_LABEL;
+  }
+  for (path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+       path != NULL;
+       path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+  {
+    if (path->send_cb->sock_cb == NULL)
+    {
+      continue;
+    }
+    if (hm_queue_on_transport(msg, path->send_cb, HM_PRIORITY_HA) != HM_OK)
+    {
+      TRACE_ERROR(("Error occured while sending Tick on path %d", path->id));
+    }
+  }
+  hm_free_buffer(msg);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_cluster_send_tick */
+
+
 /**
- *  @brief Send an INIT request to the cluster location
+ *  @brief Acknowledges the stream from a peer in a Keepalive sent to it alone
  *
- *  @param *tprt_cb Transport Control Block of Peer to whom we would be sending
- *  this INIT message (#HM_TRANSPORT_CB)
+ *  Sent at the end of the pass of the main loop in which messages came from
+ *  the peer, so that its window opens without waiting for a multicast Tick.
  *
- *  @return HM_OK if successful, HM_ERR otherwise.
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return HM_OK if successful, HM_ERR otherwise
  */
-int32_t hm_cluster_send_init(HM_TRANSPORT_CB *tprt_cb)
+int32_t hm_cluster_send_ack(HM_LOCATION_CB *loc_cb)
 {
   /***************************************************************************/
   /* Variable Declarations                           */
   /***************************************************************************/
-  HM_PEER_MSG_INIT *init_msg = NULL;
+  int32_t ret_val = HM_OK;
+  HM_PEER_MSG_KEEPALIVE *tick_msg = NULL;
   HM_MSG *msg = NULL;
 
-  int32_t ret_val = HM_OK;
+  SOCKADDR_IN *addr = NULL;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
   TRACE_ENTRY();
 
-  TRACE_ASSERT(tprt_cb != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
-  msg = hm_get_buffer(sizeof(HM_PEER_MSG_INIT));
-
+  msg = hm_get_buffer(HM_PEER_KEEPALIVE_MSG_SIZE(1));
   if (msg == NULL)
   {
-    TRACE_ERROR(("Error allocating buffer for INIT message."));
+    TRACE_ERROR(("Error allocating buffer for Keepalive Message."));
     ret_val = HM_ERR;
     goto EXIT_LABEL;
   }
 
-  init_msg = (HM_PEER_MSG_INIT *)msg->msg;
+  tick_msg = (HM_PEER_MSG_KEEPALIVE *)msg->msg;
+  memset(tick_msg, 0, HM_PEER_KEEPALIVE_MSG_SIZE(1));
 
-  HM_PUT_LONG(init_msg->hdr.hw_id, LOCAL.local_location_cb.index);
-  HM_PUT_LONG(init_msg->hdr.msg_type, HM_PEER_MSG_TYPE_INIT);
-#ifdef I_WANT_TO_DEBUG
-  {
-    uint32_t test;
-    HM_GET_LONG(test, init_msg->hdr.msg_type);
-    TRACE_DETAIL(("Sending %d",
-                  *(uint32_t *)((void *) & (init_msg->hdr.msg_type))));
-    TRACE_DETAIL(("Sending %x", test));
-  }
-#endif
-  HM_PUT_LONG(init_msg->hdr.timestamp, 0);
+  HM_PUT_LONG(tick_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  HM_PUT_LONG(tick_msg->hdr.msg_type, HM_PEER_MSG_TYPE_KEEPALIVE);
+  HM_PUT_LONG(tick_msg->hdr.msg_len, HM_PEER_KEEPALIVE_MSG_SIZE(1));
+  hm_hlc_put(tick_msg->hdr.timestamp, hm_hlc_now());
 
-  HM_PUT_LONG(init_msg->request, TRUE);
-  HM_PUT_LONG(init_msg->response_ok, FALSE);
+  addr = (SOCKADDR_IN *) &
+         (LOCAL.local_location_cb.peer_listen_cb->address.address);
+  HM_PUT_LONG(tick_msg->listen_port, addr->sin_port);
+  HM_PUT_LONG(tick_msg->num_nodes, LOCAL.local_location_cb.active_nodes);
+  HM_PUT_LONG(tick_msg->num_proc, LOCAL.local_location_cb.active_processes);
+  HM_PUT_LONG(tick_msg->incarnation, LOCAL.local_location_cb.incarnation);
+  HM_PUT_LONG(tick_msg->version, LOCAL.local_location_cb.version);
+  HM_PUT_LONG(tick_msg->digest, LOCAL.local_location_cb.digest);
+  hm_put_64(tick_msg->sent_ns, hm_time_ns());
+  hm_put_64(tick_msg->wall_ns, hm_wall_time_ns());
+
+  HM_PUT_LONG(tick_msg->num_acks, 1);
+  hm_cluster_put_ack(&tick_msg->acks[0], loc_cb);
 
-  if (hm_queue_on_transport(msg, tprt_cb, TRUE) != HM_OK)
+  if (hm_queue_on_transport(msg, loc_cb->peer_listen_cb, HM_PRIORITY_HA) != HM_OK)
   {
-    TRACE_ERROR(("Error sending message to peer!"));
+    TRACE_ERROR(("Error occured while sending Ack"));
     ret_val = HM_ERR;
-    goto EXIT_LABEL;
   }
+  loc_cb->ack_pending = FALSE;
+  hm_free_buffer(msg);
 
 EXIT_LABEL:
   /***************************************************************************/
@@ -346,393 +826,377 @@ EXIT_LABEL:
   /***************************************************************************/
   TRACE_EXIT();
   return (ret_val);
-}/* hm_cluster_send_init */
+}/* hm_cluster_send_ack */
 
 
 /**
- *  @brief Replay complete local information to a peer.
+ *  @brief Reads the acknowledgement of our stream from a Keepalive of a peer
  *
- *  @param tprt_cb  Transport Control Block of Peer to whom we would be sending
- *  @return HM_OK if successful, HM_ERR otherwise
+ *  @param *keepalive_msg Keepalive (#HM_PEER_MSG_KEEPALIVE) received
+ *  @param msg_len Bytes received
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer that sent it
+ *  @return void
  */
-int32_t hm_cluster_replay_info(HM_TRANSPORT_CB *tprt_cb)
+void hm_cluster_read_keepalive_acks(HM_PEER_MSG_KEEPALIVE *keepalive_msg,
+                                    uint32_t msg_len, HM_LOCATION_CB *loc_cb)
 {
   /***************************************************************************/
   /* Variable Declarations                           */
   /***************************************************************************/
-  int32_t ret_val = HM_OK; /* I am very optimistic! */
-
-  HM_NODE_CB *node_cb = NULL;
-  HM_PROCESS_CB *proc_cb = NULL;
-
-  int32_t index_filled = 0, chunks_needed = 0, i;
-
-  HM_MSG *msg = NULL;
-  HM_PEER_MSG_REPLAY *replay_msg = NULL;
-
+  uint32_t num_acks, i, lane;
+  uint32_t hw_id, ack, sack;
+  HM_PEER_ACK *our_ack = NULL;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
   TRACE_ENTRY();
-  /***************************************************************************/
-  /* Main Routine                                 */
-  /***************************************************************************/
 
+  TRACE_ASSERT(keepalive_msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
   /***************************************************************************/
-  /* Chunks needed is minimum number of Blocks of HM_PEER_NUM_TLVS_PER_UPDATE*/
-  /* that can transmit all Node info.                       */
+  /* Main Routine                                 */
   /***************************************************************************/
-  chunks_needed =
-    ((LOCAL.local_location_cb.total_nodes) / HM_PEER_NUM_TLVS_PER_UPDATE);
-
-  if (((LOCAL.local_location_cb.total_nodes) % HM_PEER_NUM_TLVS_PER_UPDATE) !=
-      0)
+  if (msg_len < HM_PEER_KEEPALIVE_MSG_SIZE(0))
   {
-    chunks_needed +=
-      (
-        ((LOCAL.local_location_cb.total_nodes) % HM_PEER_NUM_TLVS_PER_UPDATE)
-        /
-        ((LOCAL.local_location_cb.total_nodes) % HM_PEER_NUM_TLVS_PER_UPDATE)
-      ); /* or simply 1 */
+    TRACE_WARN(("Keepalive of %d bytes is too short.", msg_len));
+    goto EXIT_LABEL;
   }
 
-  TRACE_DETAIL(("Chunks Needed = %d", chunks_needed));
-
-  if (chunks_needed == 0)
+  HM_GET_LONG(num_acks, keepalive_msg->num_acks);
+  if (num_acks > (msg_len - HM_PEER_KEEPALIVE_MSG_SIZE(0)) / sizeof(HM_PEER_ACK))
   {
-    /***************************************************************************/
-    /* Send end of replay message, since if there are no nodes, there can't be */
-    /* processes.                                 */
-    /***************************************************************************/
-    TRACE_DETAIL(("Send End of Replay. We have nothing to send."));
-
-    if (hm_cluster_send_end_of_replay(tprt_cb) != HM_OK)
+    TRACE_WARN(("Keepalive claims %d acks, more than it carries.", num_acks));
+    num_acks = (msg_len - HM_PEER_KEEPALIVE_MSG_SIZE(0)) / sizeof(HM_PEER_ACK);
+  }
+  for (i = 0; i < num_acks; i++)
+  {
+    HM_GET_LONG(hw_id, keepalive_msg->acks[i].hw_id);
+    if (hw_id == LOCAL.local_location_cb.index)
     {
-      TRACE_ERROR(("Error while sending End of Replay Message"));
-      ret_val = HM_ERR;
+      for (lane = 0; lane < HM_PEER_NUM_LANES; lane++)
+      {
+        HM_GET_LONG(ack, keepalive_msg->acks[i].lanes[lane].ack);
+        HM_GET_LONG(sack, keepalive_msg->acks[i].lanes[lane].sack);
+        hm_cluster_read_ack(loc_cb, lane, ack, sack);
+      }
+      our_ack = &keepalive_msg->acks[i];
+      break;
     }
-
-    /***************************************************************************/
-    /* Nothing more to do. Time to return                     */
-    /***************************************************************************/
-    goto EXIT_LABEL;
   }
+  hm_cluster_measure_link(keepalive_msg, our_ack, loc_cb);
 
+EXIT_LABEL:
   /***************************************************************************/
-  /* First, build a message for Nodes                       */
+  /* Exit Level Checks                             */
   /***************************************************************************/
-  index_filled = 0;
-  i = 0;
+  TRACE_EXIT();
+}/* hm_cluster_read_keepalive_acks */
 
-  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
-                 nodes_tree_by_node_id);
-       node_cb != NULL;
-       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
-                 nodes_tree_by_node_id))
+
+/**
+ *  @brief Fills an Ack to a peer with what has arrived on each lane from it
+ *
+ *  @param *ack Ack (#HM_PEER_ACK) being filled for the peer
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return void
+ */
+void hm_cluster_put_ack(HM_PEER_ACK *ack, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t lane;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ASSERT(ack != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_PUT_LONG(ack->hw_id, loc_cb->index);
+  for (lane = 0; lane < HM_PEER_NUM_LANES; lane++)
   {
-    TRACE_DETAIL(("Filling out Node %d information.", node_cb->index));
+    HM_PUT_LONG(ack->lanes[lane].ack, loc_cb->lanes[lane].recv_seq);
+    HM_PUT_LONG(ack->lanes[lane].sack, loc_cb->lanes[lane].recv_sack);
+  }
+  hm_cluster_put_echo(ack, loc_cb);
+}/* hm_cluster_put_ack */
 
-    if (index_filled == 0)
-    {
-      /***************************************************************************/
-      /* Allocate a message buffer if we know that currently, no indices have    */
-      /* been used. This implies a new message must be constructed.         */
-      /***************************************************************************/
-#ifdef I_WANT_TO_DEBUG
-      i++; /* keep score of number of allocs so far */
-      TRACE_ASSERT(i <= chunks_needed);
-#endif
-      /***************************************************************************/
-      /* Allocate a buffer for update                         */
-      /***************************************************************************/
-      msg = hm_get_buffer(sizeof(HM_PEER_MSG_REPLAY));
 
-      if (msg == NULL)
-      {
-        TRACE_ERROR(("Error allocating memory for Replay Message."));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
+/**
+ *  @brief Echoes the send stamp of a peer's last Keepalive in an Ack to it
+ *
+ *  @param *ack Ack (#HM_PEER_ACK) being filled for the peer
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return void
+ */
+void hm_cluster_put_echo(HM_PEER_ACK *ack, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ASSERT(ack != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (loc_cb->link.echo_sent_ns == 0)
+  {
+    return;
+  }
+  hm_put_64(ack->echo_ns, loc_cb->link.echo_sent_ns);
+  hm_put_64(ack->held_ns, hm_time_ns() - loc_cb->link.echo_rcvd_ns);
+}/* hm_cluster_put_echo */
 
-      replay_msg = (HM_PEER_MSG_REPLAY *)msg->msg;
 
-      if (replay_msg == NULL)
-      {
-        TRACE_ERROR(("Error allocating memory for Replay Message."));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
+/**
+ *  @brief Updates the round trip and clock offset to a peer from its Keepalive
+ *
+ *  Remembers the send stamp of the Keepalive to echo back to the peer. If the
+ *  peer echoed one of ours, the time since we sent it, less the time the peer
+ *  held it, is a round trip; it is smoothed as TCP smooths its RTT. The wall
+ *  clock the peer stamped, half a round trip later, is compared with ours.
+ *
+ *  @param *keepalive_msg Keepalive (#HM_PEER_MSG_KEEPALIVE) received
+ *  @param *ack Ack (#HM_PEER_ACK) in it for us, NULL if none
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer that sent it
+ *  @return void
+ */
+void hm_cluster_measure_link(HM_PEER_MSG_KEEPALIVE *keepalive_msg,
+                             HM_PEER_ACK *ack, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LINK_STATS *link = NULL;
+  uint64_t now, echo, held, sample, diff, wall, limit;
+  int64_t offset;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-      memset(replay_msg, 0, sizeof(HM_PEER_MSG_REPLAY));
-      HM_PUT_LONG(replay_msg->hdr.hw_id, LOCAL.local_location_cb.index);
-      HM_PUT_LONG(replay_msg->hdr.msg_type, HM_PEER_MSG_TYPE_REPLAY);
-      HM_PUT_LONG(replay_msg->hdr.timestamp, 0);
+  TRACE_ASSERT(keepalive_msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  link = &loc_cb->link;
+  now = hm_time_ns();
+  link->echo_sent_ns = hm_get_64(keepalive_msg->sent_ns);
+  link->echo_rcvd_ns = now;
 
-      /* Not the last message */
-      HM_PUT_LONG(replay_msg->last, 0);
-    }
+  if (ack == NULL)
+  {
+    goto EXIT_LABEL;
+  }
+  echo = hm_get_64(ack->echo_ns);
+  held = hm_get_64(ack->held_ns);
+  if ((echo == 0) || (echo > now) || (held > now - echo))
+  {
+    /*************************************************************************/
+    /* Nothing of ours received yet, or the peer restarted in between.     */
+    /*************************************************************************/
+    goto EXIT_LABEL;
+  }
+  sample = now - echo - held;
 
-    /***************************************************************************/
-    /* It is necessary to communicate information of all the nodes that we know*/
-    /* about, running or not.                           */
-    /* This is because, later, if the node fails to start (during INIT), we    */
-    /* send out an update of FAILED Node, and the remote HM would not find an  */
-    /* entry for that node, causing trouble.                    */
-    /***************************************************************************/
-    HM_PUT_LONG(replay_msg->tlv[index_filled].group,
-                (uint32_t)node_cb->group);
-    HM_PUT_LONG(replay_msg->tlv[index_filled].node_id,
-                (uint32_t)node_cb->index);
-    HM_PUT_LONG(replay_msg->tlv[index_filled].update_type,
-                HM_PEER_REPLAY_UPDATE_TYPE_NODE);
+  if (link->num_samples == 0)
+  {
+    link->rtt_ns = sample;
+    link->jitter_ns = sample / 2;
+    link->min_rtt_ns = sample;
+  }
+  else
+  {
+    diff = (sample > link->rtt_ns) ? (sample - link->rtt_ns) :
+                                     (link->rtt_ns - sample);
+    link->jitter_ns = link->jitter_ns - (link->jitter_ns / 4) + (diff / 4);
+    link->rtt_ns = link->rtt_ns - (link->rtt_ns / 8) + (sample / 8);
+    if (sample < link->min_rtt_ns)
+    {
+      link->min_rtt_ns = sample;
+    }
+  }
 
-    if (node_cb->current_role != NODE_ROLE_NONE)
+  /***************************************************************************/
+  /* The peer stamped its wall clock half a round trip before now.       */
+  /***************************************************************************/
+  wall = hm_get_64(keepalive_msg->wall_ns);
+  if (wall != 0)
+  {
+    offset = (int64_t)(wall + (link->rtt_ns / 2) - hm_wall_time_ns());
+    if (link->num_samples == 0)
     {
-      TRACE_DETAIL(("Node role: %s",
-          node_cb->current_role== NODE_ROLE_ACTIVE? "ACTIVE": "PASSIVE"));
-      HM_PUT_LONG(replay_msg->tlv[index_filled].role,
-                  (uint32_t)node_cb->current_role);
+      link->clock_offset_ns = offset;
     }
     else
     {
-      TRACE_DETAIL(("Node role resolution not completed. Use desired role"));
-      HM_PUT_LONG(replay_msg->tlv[index_filled].role,
-                  (uint32_t)node_cb->role);
-      TRACE_DETAIL(("Node role: %s",
-          node_cb->role== NODE_ROLE_ACTIVE? "ACTIVE": "PASSIVE"));
+      link->clock_offset_ns += (offset - link->clock_offset_ns) / 8;
     }
+  }
+  link->num_samples++;
+  TRACE_DETAIL(("Location %d: RTT %llu ns (sample %llu, jitter %llu, min %llu), "
+                "clock offset %lld ns", loc_cb->index,
+                (unsigned long long)link->rtt_ns, (unsigned long long)sample,
+                (unsigned long long)link->jitter_ns,
+                (unsigned long long)link->min_rtt_ns,
+                (long long)link->clock_offset_ns));
 
-    HM_PUT_LONG(replay_msg->tlv[index_filled].running, (node_cb->fsm_state));
-
-    index_filled++;
-
-    /***************************************************************************/
-    /* If we've filled enough TLVs at this point, send the message and prepare */
-    /* a new buffer for filling up.                         */
-    /***************************************************************************/
-    if (index_filled == HM_PEER_NUM_TLVS_PER_UPDATE)
+  /***************************************************************************/
+  /* A link whose round trip, with margin, eats half the Keepalive period   */
+  /* makes missed Keepalives likely. Say so once, and once when it recovers.*/
+  /***************************************************************************/
+  limit = (uint64_t)loc_cb->keepalive_period * 1000000 / 2;
+  if ((link->rtt_ns + (4 * link->jitter_ns)) > limit)
+  {
+    if (!link->degraded)
     {
-      HM_PUT_LONG(replay_msg->num_tlvs, index_filled);
+      TRACE_WARN(("Link to location %d is slow: RTT %llu ns, jitter %llu ns "
+                  "for a Keepalive period of %d ms", loc_cb->index,
+                  (unsigned long long)link->rtt_ns,
+                  (unsigned long long)link->jitter_ns,
+                  loc_cb->keepalive_period));
+      link->degraded = TRUE;
+    }
+  }
+  else if (link->degraded)
+  {
+    TRACE_INFO(("Link to location %d has recovered: RTT %llu ns, jitter %llu ns",
+                loc_cb->index, (unsigned long long)link->rtt_ns,
+                (unsigned long long)link->jitter_ns));
+    link->degraded = FALSE;
+  }
 
-      /***************************************************************************/
-      /* Made message, now queue on transport and send if possible         */
-      /***************************************************************************/
-      if (hm_queue_on_transport(msg, tprt_cb, FALSE) != HM_OK)
-      {
-        TRACE_ERROR(("Error sending message to peer!"));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_cluster_measure_link */
 
-      hm_free_buffer(msg);
-      index_filled = 0;
-    }
-  }//Node loop
 
-  TRACE_ASSERT(i == chunks_needed);
+/**
+ *  @brief Tells if a Tick has already been heard on another heartbeat path
+ *
+ *  Remembers it otherwise.
+ *
+ *  @param loc_id Index of the location that sent it
+ *  @param sent_ns Send stamp it carries
+ *  @return TRUE if it was heard before, FALSE otherwise
+ */
+uint32_t hm_cluster_seen_tick(uint32_t loc_id, uint64_t sent_ns)
+{
   /***************************************************************************/
-  /* At this point, either all node information has been sent, or there still*/
-  /* remains the last incomplete TLV block message.               */
-  /* Now, we will fill it with Process information.               */
+  /* Variable Declarations                           */
   /***************************************************************************/
-  /* Now, build a message for Processes                     */
+  uint32_t seen = FALSE;
+  uint32_t i;
   /***************************************************************************/
-  chunks_needed =
-    ((LOCAL.local_location_cb.active_processes) / HM_PEER_NUM_TLVS_PER_UPDATE);
-
-  if (((LOCAL.local_location_cb.active_processes) % HM_PEER_NUM_TLVS_PER_UPDATE)
-      != 0)
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if ((LOCAL.num_heartbeat_paths < 2) || (sent_ns == 0))
   {
-    chunks_needed += 1;
+    goto EXIT_LABEL;
   }
-
-  if (chunks_needed == 0)
+  for (i = 0; i < HM_RECENT_TICKS; i++)
   {
-    /***************************************************************************/
-    /* If no more chunks are needed, verify that we've sent our previous msg   */
-    /***************************************************************************/
-    if (index_filled != 0)
+    if ((LOCAL.recent_ticks[i].loc_id == loc_id) &&
+        (LOCAL.recent_ticks[i].sent_ns == sent_ns))
     {
-      TRACE_INFO(("No more message need be sent. Send the pending buffer and EOR!"));
-      HM_PUT_LONG(replay_msg->num_tlvs, index_filled);
-
-      if (hm_queue_on_transport(msg, tprt_cb, FALSE) != HM_OK)
-      {
-        TRACE_ERROR(("Error sending message to peer!"));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
+      seen = TRUE;
+      goto EXIT_LABEL;
     }
+  }
+  LOCAL.recent_ticks[LOCAL.next_recent_tick].loc_id = loc_id;
+  LOCAL.recent_ticks[LOCAL.next_recent_tick].sent_ns = sent_ns;
+  LOCAL.next_recent_tick = (LOCAL.next_recent_tick + 1) % HM_RECENT_TICKS;
 
-    /***************************************************************************/
-    /* Send end of replay message.                         */
-    /***************************************************************************/
-    TRACE_DETAIL(("Send End of Replay. We have nothing more to send."));
-
-    if (hm_cluster_send_end_of_replay(tprt_cb) != HM_OK)
-    {
-      TRACE_ERROR(("Error while sending End of Replay Message"));
-      ret_val = HM_ERR;
-    }
+EXIT_LABEL:
+  return (seen);
+}/* hm_cluster_seen_tick */
 
-    /***************************************************************************/
-    /* Nothing more to do. Time to return                     */
-    /***************************************************************************/
-    goto EXIT_LABEL;
-  }
 
+/**
+ *  @brief Notes that a peer was heard on a heartbeat path
+ *
+ *  @param *paths Health (#HM_PATH_HEALTH) of the paths to the peer
+ *  @param loc_id Index of the peer
+ *  @param path_id Heartbeat path (#HM_HEARTBEAT_PATH) it was heard on
+ *  @return void
+ */
+void hm_cluster_path_heard(HM_PATH_HEALTH *paths, uint32_t loc_id,
+                           uint32_t path_id)
+{
   /***************************************************************************/
-  /* Now, loop through all the nodes collecting their running processes and  */
-  /* making an update.                             */
+  /* Sanity Checks                               */
   /***************************************************************************/
-  i = 0;
-
-  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
-                 nodes_tree_by_node_id);
-       node_cb != NULL;
-       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
-                 nodes_tree_by_node_id))
+  TRACE_ASSERT(paths != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (path_id >= HM_MAX_HEARTBEAT_PATHS)
   {
-    TRACE_DETAIL(("Filling out Node %d information.", node_cb->index));
-
-    /***************************************************************************/
-    /* Fill at max five process updates                       */
-    /***************************************************************************/
-    for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
-                   node_process_tree_by_proc_type_and_pid);
-         proc_cb != NULL;
-         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
-                   node_process_tree_by_proc_type_and_pid))
-    {
-      TRACE_DETAIL(("Filling out Process %d information.", proc_cb->type));
-
-      if (index_filled == 0)
-      {
-        /***************************************************************************/
-        /* Allocate a message buffer if we know that currently, no indices have    */
-        /* been used. This implies a new message must be constructed.         */
-        /***************************************************************************/
-#ifdef I_WANT_TO_DEBUG
-        i++; /* keep score of number of allocs so far */
-        TRACE_ASSERT(i <= chunks_needed);
-#endif
-        /***************************************************************************/
-        /* Allocate a buffer for update                         */
-        /***************************************************************************/
-        msg = hm_get_buffer(sizeof(HM_PEER_MSG_REPLAY));
-
-        if (msg == NULL)
-        {
-          TRACE_ERROR(("Error allocating memory for Replay Message."));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
-
-        replay_msg = (HM_PEER_MSG_REPLAY *)msg->msg;
-
-        if (replay_msg == NULL)
-        {
-          TRACE_ERROR(("Error allocating memory for Replay Message."));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
-
-        memset(replay_msg, 0, sizeof(HM_PEER_MSG_REPLAY));
-        HM_PUT_LONG(replay_msg->hdr.hw_id, LOCAL.local_location_cb.index);
-        HM_PUT_LONG(replay_msg->hdr.msg_type, HM_PEER_MSG_TYPE_REPLAY);
-        HM_PUT_LONG(replay_msg->hdr.timestamp, 0);
-
-        /* Not the last message */
-        HM_PUT_LONG(replay_msg->last, 0);
-      }
-
-      if (proc_cb->running != FALSE)
-      {
-        HM_PUT_LONG(replay_msg->tlv[index_filled].group,
-                    (uint32_t)proc_cb->type);
-        HM_PUT_LONG(replay_msg->tlv[index_filled].node_id,
-                    (uint32_t)node_cb->index);
-        HM_PUT_LONG(replay_msg->tlv[index_filled].update_type,
-                    HM_PEER_REPLAY_UPDATE_TYPE_PROC);
-        HM_PUT_LONG(replay_msg->tlv[index_filled].pid,
-                    (uint32_t)proc_cb->pid);
-
-        index_filled++;
-      }
-      else
-      {
-        /***************************************************************************/
-        /* Process is not running. Exclude it from update.               */
-        /***************************************************************************/
-        TRACE_DETAIL(("Exclude from update. Not running!"));
-        continue;
-      }
-
-      /***************************************************************************/
-      /* If we've filled enough TLVs at this point, send the message and prepare */
-      /* a new buffer for filling up.                         */
-      /***************************************************************************/
-
-      if (index_filled == HM_PEER_NUM_TLVS_PER_UPDATE)
-      {
-        HM_PUT_LONG(replay_msg->num_tlvs, index_filled);
-
-        /***************************************************************************/
-        /* Made message, now queue on transport and send if possible         */
-        /***************************************************************************/
-        if (hm_queue_on_transport(msg, tprt_cb, FALSE) != HM_OK)
-        {
-          TRACE_ERROR(("Error sending message to peer!"));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
+    return;
+  }
+  paths->missed[path_id] = 0;
+  if (paths->down & (1 << path_id))
+  {
+    paths->down &= ~(1 << path_id);
+    TRACE_INFO(("Heartbeat path %d to location %d is up again.", path_id,
+                loc_id));
+  }
+}/* hm_cluster_path_heard */
 
-        hm_free_buffer(msg);
-        index_filled = 0;
-      }
-    }//processes loop
 
-    /***************************************************************************/
-    /* If we've broken out before all TLVs were filled, then the process list  */
-    /* is exhausted for this node and we still have space for more.        */
-    /* So, move on to next node.                         */
-    /***************************************************************************/
-    if (index_filled != 0)
-    {
-      TRACE_DETAIL(("Move to next Node tree."));
-      continue;
-    }
-  }//Node loop
+/**
+ *  @brief Counts a Keepalive period in which a peer may have been missed
+ *
+ *  Each heartbeat path on which the peer has been silent for longer than the
+ *  kickout value is reported down. The peer itself is judged by its Ticks
+ *  over all paths together, so it is lost only when all of them are.
+ *
+ *  @param *paths Health (#HM_PATH_HEALTH) of the paths to the peer
+ *  @param loc_id Index of the peer
+ *  @return void
+ */
+void hm_cluster_path_missed(HM_PATH_HEALTH *paths, uint32_t loc_id)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t i, num_up = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
+  TRACE_ASSERT(paths != NULL);
   /***************************************************************************/
-  /* If we've reached here and indexes filled is less than max., that mean   */
-  /* we've exhausted all processes in all nodes and this is the penultimate  */
-  /* message to be sent.                             */
+  /* Main Routine                                 */
   /***************************************************************************/
-  if (index_filled != 0)
+  if (LOCAL.num_heartbeat_paths < 2)
   {
-    HM_PUT_LONG(replay_msg->num_tlvs, index_filled);
-
-    /***************************************************************************/
-    /* Made message, now queue on transport and send if possible         */
-    /***************************************************************************/
-    if (hm_queue_on_transport(msg, tprt_cb, FALSE) != HM_OK)
+    goto EXIT_LABEL;
+  }
+  for (i = 0; i < LOCAL.num_heartbeat_paths; i++)
+  {
+    if (!(paths->down & (1 << i)))
     {
-      TRACE_ERROR(("Error sending message to peer!"));
-      ret_val = HM_ERR;
-      goto EXIT_LABEL;
+      if (++paths->missed[i] <= LOCAL.peer_kickout_value)
+      {
+        num_up++;
+        continue;
+      }
+      paths->down |= (1 << i);
+      TRACE_WARN(("Heartbeat path %d to location %d is down.", i, loc_id));
     }
-
-    hm_free_buffer(msg);
   }
-
-  TRACE_DETAIL(("Send End of Replay. We have nothing more to send."));
-
-  if (hm_cluster_send_end_of_replay(tprt_cb) != HM_OK)
+  if (num_up < LOCAL.num_heartbeat_paths)
   {
-    TRACE_ERROR(("Error while sending End of Replay Message"));
-    ret_val = HM_ERR;
-    goto EXIT_LABEL;
+    TRACE_DETAIL(("Location %d: %d of %d heartbeat paths up.", loc_id,
+                  num_up, LOCAL.num_heartbeat_paths));
   }
 
 EXIT_LABEL:
@@ -740,23 +1204,24 @@ EXIT_LABEL:
   /* Exit Level Checks                             */
   /***************************************************************************/
   TRACE_EXIT();
-  return (ret_val);
-}/* hm_cluster_replay_info */
+}/* hm_cluster_path_missed */
 
 
 /**
- *  @brief Sends the end of replay message
+ *  @brief Send an INIT request to the cluster location
  *
  *  @param *tprt_cb Transport Control Block of Peer to whom we would be sending
- *  @return HM_OK if successful, HM_ERR otherwise
+ *  this INIT message (#HM_TRANSPORT_CB)
+ *
+ *  @return HM_OK if successful, HM_ERR otherwise.
  */
-int32_t hm_cluster_send_end_of_replay(HM_TRANSPORT_CB *tprt_cb)
+int32_t hm_cluster_send_init(HM_TRANSPORT_CB *tprt_cb)
 {
   /***************************************************************************/
   /* Variable Declarations                           */
   /***************************************************************************/
+  HM_PEER_MSG_INIT *init_msg = NULL;
   HM_MSG *msg = NULL;
-  HM_PEER_MSG_REPLAY *replay_msg = NULL;
 
   int32_t ret_val = HM_OK;
   /***************************************************************************/
@@ -768,1133 +1233,5913 @@ int32_t hm_cluster_send_end_of_replay(HM_TRANSPORT_CB *tprt_cb)
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
-  msg = hm_get_buffer(sizeof(HM_PEER_MSG_REPLAY));
+  msg = hm_get_buffer(sizeof(HM_PEER_MSG_INIT));
 
   if (msg == NULL)
   {
-    TRACE_ERROR(("Error allocating memory for Replay Message."));
+    TRACE_ERROR(("Error allocating buffer for INIT message."));
     ret_val = HM_ERR;
     goto EXIT_LABEL;
   }
 
-  replay_msg = (HM_PEER_MSG_REPLAY *)msg->msg;
+  init_msg = (HM_PEER_MSG_INIT *)msg->msg;
 
-  if (replay_msg == NULL)
+  HM_PUT_LONG(init_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  HM_PUT_LONG(init_msg->hdr.msg_type, HM_PEER_MSG_TYPE_INIT);
+#ifdef I_WANT_TO_DEBUG
   {
-    TRACE_ERROR(("Error allocating memory for Replay Message."));
-    ret_val = HM_ERR;
-    goto EXIT_LABEL;
+    uint32_t test;
+    HM_GET_LONG(test, init_msg->hdr.msg_type);
+    TRACE_DETAIL(("Sending %d",
+                  *(uint32_t *)((void *) & (init_msg->hdr.msg_type))));
+    TRACE_DETAIL(("Sending %x", test));
   }
+#endif
+  HM_PUT_LONG(init_msg->hdr.timestamp, 0);
 
-  memset(replay_msg, 0, sizeof(HM_PEER_MSG_REPLAY));
-  HM_PUT_LONG(replay_msg->hdr.hw_id, LOCAL.local_location_cb.index);
-  HM_PUT_LONG(replay_msg->hdr.msg_type, HM_PEER_MSG_TYPE_REPLAY);
-  HM_PUT_LONG(replay_msg->hdr.timestamp, 0);
-
-  /* Not the last message */
-  HM_PUT_LONG(replay_msg->last, 1);
+  HM_PUT_LONG(init_msg->request, TRUE);
+  HM_PUT_LONG(init_msg->response_ok, FALSE);
+  hm_cluster_fill_init(init_msg, tprt_cb->location_cb);
 
-  if (hm_queue_on_transport(msg, tprt_cb, FALSE) != HM_OK)
+  if (hm_queue_on_transport(msg, tprt_cb, HM_PRIORITY_CONTROL) != HM_OK)
   {
     TRACE_ERROR(("Error sending message to peer!"));
     ret_val = HM_ERR;
-    goto EXIT_LABEL;
   }
 
-  hm_free_buffer(msg);
-
 EXIT_LABEL:
   /***************************************************************************/
   /* Exit Level Checks                             */
   /***************************************************************************/
+  if (msg != NULL)
+  {
+    hm_free_buffer(msg);
+  }
   TRACE_EXIT();
   return (ret_val);
-}/* hm_cluster_send_end_of_replay */
-
+}/* hm_cluster_send_init */
 
 /**
- *  @brief Receives and processes a cluster message
+ *  @brief Fills in the version information in an INIT request/response
  *
- *  @param *sock_cb Socket Control Block on which a Cluster message was received (#HM_SOCKET_CB)
- *  @return HM_OK if successful, HM_ERR otherwise
+ *  Tells the peer which run of ours this is, and which version of its tables
+ *  we already have, so that it replays only what we missed.
+ *
+ *  @param *init_msg INIT message (#HM_PEER_MSG_INIT) to be filled in
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer it is sent to
+ *  @return @c void
  */
-int32_t hm_receive_cluster_message(HM_SOCKET_CB *sock_cb)
+void hm_cluster_fill_init(HM_PEER_MSG_INIT *init_msg, HM_LOCATION_CB *loc_cb)
 {
   /***************************************************************************/
-  /* Variable Declarations                           */
+  /* Sanity Checks                               */
   /***************************************************************************/
-  int32_t ret_val = HM_OK;
+  TRACE_ENTRY();
 
-  HM_PEER_MSG_HEADER *msg_header = NULL;
-  int32_t msg_type;
-  int32_t hw_id;
+  TRACE_ASSERT(init_msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  /***************************************************************************/
+  /* A response is built over the request; it must carry our index, since   */
+  /* datagram peers are told apart by it.                    */
+  /***************************************************************************/
+  HM_PUT_LONG(init_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  hm_hlc_put(init_msg->hdr.timestamp, hm_hlc_now());
+  HM_PUT_LONG(init_msg->version, HM_PEER_PROTOCOL_VERSION);
+  HM_PUT_LONG(init_msg->incarnation, LOCAL.local_location_cb.incarnation);
+  HM_PUT_LONG(init_msg->peer_incarnation, loc_cb->incarnation);
+  HM_PUT_LONG(init_msg->seen_version, loc_cb->version);
+  TRACE_DETAIL(("Seen version %d of Location %d", loc_cb->version,
+                loc_cb->index));
+  HM_PUT_LONG(init_msg->frame_size, LOCAL.peer_frame_size);
+  HM_PUT_LONG(init_msg->capabilities, HM_PEER_CAP_IDLE_KEEPALIVE);
+  HM_PUT_LONG(init_msg->aggregation_role, LOCAL.aggregation_role);
+  HM_PUT_LONG(init_msg->aggregator, LOCAL.aggregator);
+  HM_PUT_LONG(init_msg->hdr.msg_len, sizeof(HM_PEER_MSG_INIT));
 
-  HM_PEER_MSG_INIT *init_msg = NULL;
-  HM_PEER_MSG_REPLAY *replay_msg = NULL;
-  HM_PEER_MSG_NODE_UPDATE *node_update = NULL;
-  HM_PEER_MSG_PROCESS_UPDATE *proc_update = NULL;
-  //HM_PEER_MSG_UNION *msg = NULL; /* Use this instead of many pointers */
+  /***************************************************************************/
+  /* Our stream to the peer starts over after an INIT             */
+  /***************************************************************************/
+  hm_cluster_reset_stream(loc_cb);
 
-  HM_LOCATION_CB *loc_cb = NULL;
-  HM_NODE_CB *node_cb = NULL;
-  HM_PROCESS_CB *proc_cb = NULL;
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_fill_init */
 
-  HM_MSG *msg = NULL;
 
-  int32_t node_id;
-  int32_t proc_key[2];
-  int32_t status;
+/**
+ *  @brief Reads the version information in an incoming INIT request/response
+ *
+ *  If the peer has restarted, what we know of its versions is stale: forget
+ *  them so that its replay is applied in full. If it has seen a version of our
+ *  tables from this run, remember it so that only newer changes are replayed.
+ *
+ *  @param *init_msg INIT message (#HM_PEER_MSG_INIT) received
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer it came from
+ *  @return @c void
+ */
+void hm_cluster_read_init(HM_PEER_MSG_INIT *init_msg, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t incarnation, peer_incarnation, seen_version;
+  uint32_t lane;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
   TRACE_ENTRY();
 
-  TRACE_ASSERT(sock_cb != NULL);
+  TRACE_ASSERT(init_msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
-  msg_header = (HM_PEER_MSG_HEADER *)sock_cb->tprt_cb->in_buffer;
-
-  loc_cb = sock_cb->tprt_cb->location_cb;
-
-  HM_GET_LONG(hw_id, msg_header->hw_id);
-  HM_GET_LONG(msg_type, msg_header->msg_type);
-  TRACE_DETAIL(("Received message of type %d from Location %d", msg_type,
-                hw_id));
+  HM_GET_LONG(incarnation, init_msg->incarnation);
+  HM_GET_LONG(peer_incarnation, init_msg->peer_incarnation);
+  HM_GET_LONG(seen_version, init_msg->seen_version);
+  HM_GET_LONG(loc_cb->frame_size, init_msg->frame_size);
+  TRACE_DETAIL(("Location %d accepts frames of %d bytes", loc_cb->index,
+                loc_cb->frame_size));
+  HM_GET_LONG(loc_cb->capabilities, init_msg->capabilities);
+  HM_GET_LONG(loc_cb->aggregation_role, init_msg->aggregation_role);
+  HM_GET_LONG(loc_cb->aggregator, init_msg->aggregator);
 
   /***************************************************************************/
-  /* Since the message can be received over TCP or UDP, the incoming buffer  */
-  /* is kept as large as possible while keeping the PDU size on the UDP     */
-  /* socket limited.                               */
-  /* Thus, here, we won't need to allocate more buffers. We already have a   */
-  /* complete message.                             */
+  /* And so does the peer's stream to us                     */
   /***************************************************************************/
-  switch (msg_type)
+  for (lane = 0; lane < HM_PEER_NUM_LANES; lane++)
   {
-    case HM_PEER_MSG_TYPE_INIT:
-      TRACE_DETAIL(("Received INIT message."));
-      init_msg = (HM_PEER_MSG_INIT *)sock_cb->tprt_cb->in_buffer;
-      HM_GET_LONG(hw_id, init_msg->hdr.hw_id);
-      HM_GET_LONG(node_id, init_msg->request);
+    loc_cb->lanes[lane].recv_seq = 0;
+    loc_cb->lanes[lane].recv_sack = 0;
+  }
 
-      if (node_id == TRUE)
-      {
-        TRACE_DETAIL(("Received INIT request."));
-        HM_PUT_LONG(init_msg->response_ok, TRUE);
-        HM_PUT_LONG(init_msg->request, TRUE);
-        msg = hm_get_buffer(sizeof(HM_PEER_MSG_INIT));
+  if (incarnation != loc_cb->incarnation)
+  {
+    TRACE_INFO(("Location %d is in a new run. Forget its versions.",
+                loc_cb->index));
+    loc_cb->incarnation = incarnation;
+    hm_cluster_forget_versions(loc_cb);
 
-        if (msg == NULL)
-        {
-          TRACE_ERROR(("Error allocating buffer for INIT response."));
-          TRACE_ASSERT(msg != NULL);
-        }
+    /***************************************************************************/
+    /* Nor do we know what it subscribes to, till it tells us.         */
+    /***************************************************************************/
+    loc_cb->interest_all = TRUE;
+    loc_cb->num_interests = 0;
+  }
 
-        memcpy(msg->msg, init_msg, sizeof(HM_PEER_MSG_INIT));
+  if (peer_incarnation == LOCAL.local_location_cb.incarnation)
+  {
+    TRACE_DETAIL(("Location %d has seen version %d", loc_cb->index,
+                  seen_version));
+    loc_cb->replay_since = seen_version;
+  }
+  else
+  {
+    TRACE_DETAIL(("Location %d has not seen this run. Replay everything.",
+                  loc_cb->index));
+    loc_cb->replay_since = 0;
+  }
 
-        /***************************************************************************/
-        /* Queue on port                               */
-        /***************************************************************************/
-        if (hm_queue_on_transport(msg, sock_cb->tprt_cb, TRUE) != HM_OK)
-        {
-          TRACE_ERROR(("Error while sending INIT response."));
-          TRACE_ASSERT(FALSE);
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_read_init */
 
-        hm_free_buffer(msg);
-      }
-      else
-      {
-        TRACE_DETAIL(("Received INIT Response."));
-        HM_GET_LONG(node_id, init_msg->response_ok);
 
-        if (node_id != TRUE)
-        {
-          TRACE_ERROR(("Response is not OK"));
+/**
+ *  @brief Forgets the versions of a peer's tables we hold
+ *
+ *  The next replay from the peer is then asked for, and applied, in full.
+ *  The clocks of its entities go too: a new run of the peer may start on a
+ *  wall clock behind the one it stamped them with.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return @c void
+ */
+void hm_cluster_forget_versions(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  loc_cb->version = 0;
+
+  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(loc_cb->node_tree,
+                 nodes_tree_by_node_id);
+       node_cb != NULL;
+       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                 nodes_tree_by_node_id))
+  {
+    node_cb->version = 0;
+    node_cb->hlc = 0;
+
+    for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                   node_process_tree_by_proc_type_and_pid);
+         proc_cb != NULL;
+         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                   node_process_tree_by_proc_type_and_pid))
+    {
+      proc_cb->version = 0;
+      proc_cb->hlc = 0;
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_forget_versions */
+
+
+/**
+ *  @brief Checks the Tick of a peer we had lost against the tables we held
+ *
+ *  If it is in the same run, at the version we last had, and its digest is
+ *  what ours was when we lost it, our tables of it are still good: they are
+ *  restored as soon as it is active again, without waiting on its replay.
+ *  If only the digest differs, our copy went wrong somewhere, and we ask for
+ *  everything.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param *keepalive_msg Keepalive (#HM_PEER_MSG_KEEPALIVE) it sent
+ *  @return @c void
+ */
+void hm_cluster_check_return(HM_LOCATION_CB *loc_cb,
+                             HM_PEER_MSG_KEEPALIVE *keepalive_msg)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t incarnation, version, digest;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(keepalive_msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_GET_LONG(incarnation, keepalive_msg->incarnation);
+  HM_GET_LONG(version, keepalive_msg->version);
+  HM_GET_LONG(digest, keepalive_msg->digest);
+
+  loc_cb->tables_intact = FALSE;
+  if ((incarnation != loc_cb->incarnation) || (loc_cb->version == 0))
+  {
+    TRACE_DETAIL(("Nothing held of this run of Location %d", loc_cb->index));
+    goto EXIT_LABEL;
+  }
+
+  if (!LOCAL.local_location_cb.interest_all)
+  {
+    TRACE_DETAIL(("We hold only some processes of Location %d. Its digest "
+                  "cannot vouch for them.", loc_cb->index));
+    goto EXIT_LABEL;
+  }
+
+  if (version != loc_cb->version)
+  {
+    TRACE_DETAIL(("Location %d moved from version %d to %d while away.",
+                  loc_cb->index, loc_cb->version, version));
+    goto EXIT_LABEL;
+  }
+
+  if (digest != loc_cb->held_digest)
+  {
+    TRACE_WARN(("Location %d digest 0x%x, ours was 0x%x at the same version.",
+                loc_cb->index, digest, loc_cb->held_digest));
+    hm_cluster_forget_versions(loc_cb);
+    goto EXIT_LABEL;
+  }
+
+  TRACE_DETAIL(("Location %d is back with tables as we held them.",
+                loc_cb->index));
+  loc_cb->tables_intact = TRUE;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_check_return */
+
+
+/**
+ *  @brief Largest message that can be sent to a peer
+ *
+ *  It is the smaller of our configured frame size and what the peer told us
+ *  it accepts. Without a peer, it is the smallest over all peers that told us,
+ *  so that a message meant for all of them fits each.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer, NULL for all peers
+ *  @return Frame size in bytes
+ */
+uint32_t hm_cluster_frame_size(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  uint32_t frame_size = LOCAL.peer_frame_size;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (loc_cb != NULL)
+  {
+    if ((loc_cb->frame_size != 0) && (loc_cb->frame_size < frame_size))
+    {
+      frame_size = loc_cb->frame_size;
+    }
+    goto EXIT_LABEL;
+  }
+
+  for (glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       glob_cb != NULL;
+       glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                 locations_tree_by_db_id))
+  {
+    if ((glob_cb->loc_cb->frame_size != 0) &&
+        (glob_cb->loc_cb->frame_size < frame_size))
+    {
+      frame_size = glob_cb->loc_cb->frame_size;
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (frame_size);
+}/* hm_cluster_frame_size */
+
+
+/**
+ *  @brief Sends a message on the sequenced stream to a peer
+ *
+ *  Over TCP, the message is handed to the transport as it is: the kernel
+ *  already orders, delivers and paces the stream.
+ *  Otherwise, the message is numbered and kept until the peer acknowledges it,
+ *  so that it can be sent again if lost. It is handed to the transport right away if the
+ *  window of its lane has room, else it waits for acknowledgements to open it.
+ *  Control and HA messages go on the control lane, everything else on the
+ *  bulk lane, so that they never wait behind a replay.
+ *  The message itself is never written to, for it may be held for other peers
+ *  or be part of the replay snapshot. The sequence number, lane and clock of
+ *  this peer go in a header of its own, sent in front of the shared body.
+ *
+ *  @param *msg Peer message (#HM_MSG) to send. The caller keeps its reference.
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param priority Priority class to queue it in on the transport
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_send_sequenced(HM_MSG *msg, HM_LOCATION_CB *loc_cb,
+                                  uint32_t priority)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_MSG *seq_msg = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  HM_PEER_WINDOW_ENTRY *entry = NULL;
+  HM_PEER_LANE *lane = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(msg->body == NULL);
+  TRACE_ASSERT(msg->msg_len >= sizeof(HM_PEER_MSG_HEADER));
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (loc_cb->peer_listen_cb == NULL)
+  {
+    TRACE_WARN(("Location %d is known through an aggregator only. Not sent.",
+                loc_cb->index));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  seq_msg = hm_get_buffer(sizeof(HM_PEER_MSG_HEADER));
+  if (seq_msg == NULL)
+  {
+    TRACE_ERROR(("Error allocating header for peer message."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  memcpy(seq_msg->msg, msg->msg, sizeof(HM_PEER_MSG_HEADER));
+  seq_msg->body = msg;
+  msg->ref_count++;
+
+  if (hm_cluster_stream_reliable(loc_cb))
+  {
+    HM_PUT_LONG(((HM_PEER_MSG_HEADER *)seq_msg->msg)->seq, 0);
+    if (hm_hlc_get(((HM_PEER_MSG_HEADER *)seq_msg->msg)->timestamp) == 0)
+    {
+      hm_hlc_put(((HM_PEER_MSG_HEADER *)seq_msg->msg)->timestamp, hm_hlc_now());
+    }
+    ret_val = hm_queue_on_transport(seq_msg, loc_cb->peer_listen_cb, priority);
+    hm_free_buffer(seq_msg);
+    goto EXIT_LABEL;
+  }
+
+  block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK) +
+                                  sizeof(HM_PEER_WINDOW_ENTRY));
+  if (block == NULL)
+  {
+    TRACE_ERROR(("Error allocating window entry."));
+    hm_free_buffer(seq_msg);
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  HM_INIT_LQE(block->node, block);
+  block->target = seq_msg;
+  block->opaque = (void *)((char *)block + sizeof(HM_LIST_BLOCK));
+
+  entry = (HM_PEER_WINDOW_ENTRY *)block->opaque;
+  entry->lane = (priority <= HM_PRIORITY_HA) ? HM_PEER_LANE_CONTROL :
+                                               HM_PEER_LANE_BULK;
+  lane = &loc_cb->lanes[entry->lane];
+  entry->seq = ++lane->send_seq;
+  entry->priority = priority;
+  entry->in_flight = FALSE;
+  entry->sent_ms = 0;
+  entry->queued_ns = hm_time_ns();
+  HM_PUT_LONG(((HM_PEER_MSG_HEADER *)seq_msg->msg)->seq, entry->seq);
+  HM_PUT_LONG(((HM_PEER_MSG_HEADER *)seq_msg->msg)->lane, entry->lane);
+
+  /***************************************************************************/
+  /* An update comes stamped with the clock of its change already.       */
+  /***************************************************************************/
+  if (hm_hlc_get(((HM_PEER_MSG_HEADER *)seq_msg->msg)->timestamp) == 0)
+  {
+    hm_hlc_put(((HM_PEER_MSG_HEADER *)seq_msg->msg)->timestamp, hm_hlc_now());
+  }
+
+  HM_INSERT_BEFORE(lane->unacked, block->node);
+  lane->num_unacked++;
+
+  if (lane->num_in_flight < HM_PEER_WINDOW_SIZE)
+  {
+    ret_val = hm_cluster_transmit(block, loc_cb);
+  }
+  else
+  {
+    TRACE_DETAIL(("Window of lane %d to Location %d is full. Hold message %d.",
+                  entry->lane, loc_cb->index, entry->seq));
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_send_sequenced */
+
+
+/**
+ *  @brief Hands a message on the stream to the peer's transport
+ *
+ *  The first time, the time it waited on its lane is accounted for.
+ *
+ *  @param *block Window entry (#HM_LIST_BLOCK) of the message
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_transmit(HM_LIST_BLOCK *block, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_PEER_WINDOW_ENTRY *entry = NULL;
+  HM_PEER_LANE *lane = NULL;
+  uint64_t waited;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(block != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  entry = (HM_PEER_WINDOW_ENTRY *)block->opaque;
+  lane = &loc_cb->lanes[entry->lane];
+
+  if (!entry->in_flight)
+  {
+    entry->in_flight = TRUE;
+    lane->num_in_flight++;
+
+    waited = hm_time_ns() - entry->queued_ns;
+    lane->num_queued++;
+    lane->total_queue_ns += waited;
+    if (waited > lane->max_queue_ns)
+    {
+      lane->max_queue_ns = waited;
+    }
+  }
+  entry->sent_ms = hm_time_ms();
+
+  if (hm_queue_on_transport((HM_MSG *)block->target, loc_cb->peer_listen_cb,
+                            entry->priority) != HM_OK)
+  {
+    TRACE_ERROR(("Error sending message %d on lane %d to Location %d",
+                 entry->seq, entry->lane, loc_cb->index));
+    ret_val = HM_ERR;
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_transmit */
+
+
+/**
+ *  @brief Processes an acknowledgement of one lane from a peer
+ *
+ *  Messages it has received are released. A message it has not received, but
+ *  a later one of which it has, is lost: only such messages are sent again.
+ *  Held messages then go out as far as the window allows.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param lane_id Lane acknowledged (HM_PEER_LANE_*)
+ *  @param ack Peer has all messages upto this
+ *  @param sack Bitmap of messages after ack + 1 that the peer has
+ *  @return @c void
+ */
+void hm_cluster_read_ack(HM_LOCATION_CB *loc_cb, uint32_t lane_id,
+                         uint32_t ack, uint32_t sack)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *block = NULL, *next_block = NULL;
+  HM_PEER_WINDOW_ENTRY *entry = NULL;
+  HM_PEER_LANE *lane = NULL;
+  uint32_t highest = ack;
+  uint32_t bit;
+  uint64_t now = hm_time_ms();
+  uint64_t rtt_ms = loc_cb->link.rtt_ns / 1000000;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(lane_id < HM_PEER_NUM_LANES);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  lane = &loc_cb->lanes[lane_id];
+  if (ack > lane->send_seq)
+  {
+    TRACE_WARN(("Location %d acknowledges %d on lane %d, only %d were sent. Ignore.",
+                loc_cb->index, ack, lane_id, lane->send_seq));
+    goto EXIT_LABEL;
+  }
+
+  for (bit = 0; bit < HM_PEER_SACK_BITS; bit++)
+  {
+    if (sack & (1U << bit))
+    {
+      highest = ack + 2 + bit;
+    }
+  }
+
+  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(lane->unacked);
+       block != NULL;
+       block = next_block)
+  {
+    next_block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node);
+    entry = (HM_PEER_WINDOW_ENTRY *)block->opaque;
+
+    if ((entry->seq <= ack) ||
+        ((entry->seq >= ack + 2) && (entry->seq < ack + 2 + HM_PEER_SACK_BITS) &&
+         (sack & (1U << (entry->seq - ack - 2)))))
+    {
+      /***************************************************************************/
+      /* Received by peer. Release it. The peer is getting through again.    */
+      /***************************************************************************/
+      if (entry->in_flight)
+      {
+        lane->num_in_flight--;
+      }
+      lane->backoff = 0;
+      HM_REMOVE_FROM_LIST(block->node);
+      lane->num_unacked--;
+      hm_free_buffer((HM_MSG *)block->target);
+      free(block);
+      continue;
+    }
+
+    if (entry->in_flight && (entry->seq < highest) &&
+        ((now - entry->sent_ms) >= rtt_ms) &&
+        (((HM_MSG *)block->target)->ref_count == 1))
+    {
+      /***************************************************************************/
+      /* A later message has made it, this one has not. It is no longer with    */
+      /* the transport either, and was sent a round trip ago, so it is lost.   */
+      /* Send it again.                             */
+      /***************************************************************************/
+      TRACE_INFO(("Message %d on lane %d to Location %d lost. Send again.",
+                  entry->seq, lane_id, loc_cb->index));
+      lane->retransmits++;
+      hm_cluster_transmit(block, loc_cb);
+    }
+  }
+
+  hm_cluster_open_window(loc_cb, lane_id);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_read_ack */
+
+
+/**
+ *  @brief Sends held messages on a lane to a peer as far as its window allows
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param lane_id Lane (HM_PEER_LANE_*)
+ *  @return @c void
+ */
+void hm_cluster_open_window(HM_LOCATION_CB *loc_cb, uint32_t lane_id)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *block = NULL;
+  HM_PEER_LANE *lane = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(lane_id < HM_PEER_NUM_LANES);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  lane = &loc_cb->lanes[lane_id];
+  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(lane->unacked);
+       (block != NULL) && (lane->num_in_flight < HM_PEER_WINDOW_SIZE);
+       block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+  {
+    if (!((HM_PEER_WINDOW_ENTRY *)block->opaque)->in_flight)
+    {
+      hm_cluster_transmit(block, loc_cb);
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_open_window */
+
+
+/**
+ *  @brief Sends again the messages a peer has not acknowledged in time
+ *
+ *  Called on every pass of the main loop, for each lane. A message still with
+ *  the transport is not late, it is only waiting behind others.
+ *
+ *  Each time messages on a lane time out, its timeout doubles, upto
+ *  #HM_PEER_RTO_MAX_MSEC, so that a peer which is slow or gone is not flooded.
+ *  It is back to normal once an ack makes progress on the lane.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return @c void
+ */
+void hm_cluster_check_retransmit(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *block = NULL;
+  HM_PEER_WINDOW_ENTRY *entry = NULL;
+  uint32_t lane;
+  uint32_t timed_out;
+  uint64_t now = hm_time_ms();
+  uint64_t rto_ms, lane_rto_ms;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  rto_ms = hm_cluster_rto_ms(loc_cb);
+  for (lane = 0; lane < HM_PEER_NUM_LANES; lane++)
+  {
+    timed_out = FALSE;
+    lane_rto_ms = MIN(rto_ms << loc_cb->lanes[lane].backoff,
+                      MAX(rto_ms, HM_PEER_RTO_MAX_MSEC));
+    for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(loc_cb->lanes[lane].unacked);
+         block != NULL;
+         block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+    {
+      entry = (HM_PEER_WINDOW_ENTRY *)block->opaque;
+      if (!entry->in_flight)
+      {
+        /***************************************************************************/
+        /* Rest are held. They have never been sent.               */
+        /***************************************************************************/
+        break;
+      }
+
+      if (((now - entry->sent_ms) >= lane_rto_ms) &&
+          (((HM_MSG *)block->target)->ref_count == 1))
+      {
+        TRACE_INFO(("Message %d on lane %d to Location %d not acknowledged. "
+                    "Send again.", entry->seq, lane, loc_cb->index));
+        loc_cb->lanes[lane].retransmits++;
+        hm_cluster_transmit(block, loc_cb);
+        timed_out = TRUE;
+      }
+    }
+
+    /***************************************************************************/
+    /* Wait twice as long before the next try, unless already at the maximum. */
+    /***************************************************************************/
+    if (timed_out && (lane_rto_ms < HM_PEER_RTO_MAX_MSEC))
+    {
+      loc_cb->lanes[lane].backoff++;
+      TRACE_DETAIL(("Retransmission timeout on lane %d to Location %d backs "
+                    "off to %llu ms", lane, loc_cb->index,
+                    (unsigned long long)MIN(lane_rto_ms * 2,
+                                            HM_PEER_RTO_MAX_MSEC)));
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_check_retransmit */
+
+
+/**
+ *  @brief Acknowledges peer streams and resends what they have not acknowledged
+ *
+ *  Called once every pass of the main loop. All that arrived from a peer in
+ *  the pass is acknowledged together.
+ *
+ *  @param None
+ *  @return @c void
+ */
+void hm_cluster_service_streams()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_LOCATION_CB *loc_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       glob_cb != NULL;
+       glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                 locations_tree_by_db_id))
+  {
+    loc_cb = glob_cb->loc_cb;
+    if ((loc_cb->index == LOCAL.local_location_cb.index) ||
+        (loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE) ||
+        (loc_cb->peer_listen_cb == NULL))
+    {
+      continue;
+    }
+
+    if (loc_cb->ack_pending)
+    {
+      hm_cluster_send_ack(loc_cb);
+    }
+    hm_cluster_check_retransmit(loc_cb);
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_service_streams */
+
+
+/**
+ *  @brief Tells if the stream to a peer runs over TCP
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return TRUE if the transport orders and delivers the stream itself
+ */
+uint32_t hm_cluster_stream_reliable(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint16_t type;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(loc_cb->peer_listen_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  type = loc_cb->peer_listen_cb->type;
+  return ((type != HM_TRANSPORT_UDP) && (type != HM_TRANSPORT_UDP_IPv6));
+}/* hm_cluster_stream_reliable */
+
+
+/**
+ *  @brief Time after which a message not acknowledged by a peer is sent again
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return Retransmission timeout in ms
+ */
+uint64_t hm_cluster_rto_ms(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint64_t rto_ms = HM_PEER_RTO_INITIAL_MSEC;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (loc_cb->link.num_samples != 0)
+  {
+    rto_ms = (loc_cb->link.rtt_ns + (4 * loc_cb->link.jitter_ns)) / 1000000;
+    if (rto_ms < HM_PEER_RTO_MIN_MSEC)
+    {
+      rto_ms = HM_PEER_RTO_MIN_MSEC;
+    }
+  }
+  return (rto_ms);
+}/* hm_cluster_rto_ms */
+
+
+/**
+ *  @brief Checks the sequence number of a message received from a peer
+ *
+ *  Updates are versioned, so a message that arrives out of order is still
+ *  applied; only one that has already arrived is refused.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param lane_id Lane of the stream it came on (HM_PEER_LANE_*)
+ *  @param seq Sequence number of the message. 0 if it is not on the stream.
+ *  @return TRUE if the message must be processed, FALSE if it is a duplicate
+ */
+uint32_t hm_cluster_accept_seq(HM_LOCATION_CB *loc_cb, uint32_t lane_id,
+                               uint32_t seq)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t accept = TRUE;
+  uint32_t bit;
+  HM_PEER_LANE *lane = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (seq == 0)
+  {
+    goto EXIT_LABEL;
+  }
+  if (lane_id >= HM_PEER_NUM_LANES)
+  {
+    TRACE_WARN(("Message %d from Location %d on unknown lane %d", seq,
+                loc_cb->index, lane_id));
+    accept = FALSE;
+    goto EXIT_LABEL;
+  }
+  lane = &loc_cb->lanes[lane_id];
+
+  /***************************************************************************/
+  /* A duplicate is acknowledged again too: the last ack may have been lost. */
+  /***************************************************************************/
+  loc_cb->ack_pending = TRUE;
+
+  if (seq <= lane->recv_seq)
+  {
+    accept = FALSE;
+  }
+  else if (seq == lane->recv_seq + 1)
+  {
+    /***************************************************************************/
+    /* Next in order. Move past it and past whatever had arrived after it.   */
+    /***************************************************************************/
+    lane->recv_seq++;
+    while (lane->recv_sack & 1)
+    {
+      lane->recv_sack >>= 1;
+      lane->recv_seq++;
+    }
+    lane->recv_sack >>= 1;
+  }
+  else if ((bit = seq - lane->recv_seq - 2) < HM_PEER_SACK_BITS)
+  {
+    if (lane->recv_sack & (1U << bit))
+    {
+      accept = FALSE;
+    }
+    lane->recv_sack |= (1U << bit);
+  }
+  else
+  {
+    /***************************************************************************/
+    /* Too far ahead to be recorded. It will come again and be applied again.  */
+    /***************************************************************************/
+    TRACE_DETAIL(("Message %d from Location %d too far ahead of %d on lane %d",
+                  seq, loc_cb->index, lane->recv_seq, lane_id));
+  }
+
+  if (!accept)
+  {
+    TRACE_DETAIL(("Message %d from Location %d already received on lane %d",
+                  seq, loc_cb->index, lane_id));
+    lane->duplicates++;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (accept);
+}/* hm_cluster_accept_seq */
+
+
+/**
+ *  @brief Ends the stream to a peer
+ *
+ *  Messages it has not acknowledged are released. What they carried reaches
+ *  the peer through the replay that follows the next INIT. A replay under way
+ *  is given up.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return @c void
+ */
+void hm_cluster_reset_stream(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *block = NULL;
+  HM_PEER_LANE *lane = NULL;
+  uint32_t lane_id;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  hm_cluster_replay_cancel(loc_cb);
+
+  for (lane_id = 0; lane_id < HM_PEER_NUM_LANES; lane_id++)
+  {
+    lane = &loc_cb->lanes[lane_id];
+    TRACE_DETAIL(("Lane %d to Location %d: %d sent, %d unacknowledged, "
+                  "%d retransmitted, %d duplicates received, queued %llu ns "
+                  "on average, %llu ns at most", lane_id, loc_cb->index,
+                  lane->send_seq, lane->num_unacked, lane->retransmits,
+                  lane->duplicates,
+                  (unsigned long long)((lane->num_queued != 0) ?
+                              (lane->total_queue_ns / lane->num_queued) : 0),
+                  (unsigned long long)lane->max_queue_ns));
+
+    while ((block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(lane->unacked)) != NULL)
+    {
+      HM_REMOVE_FROM_LIST(block->node);
+      hm_free_buffer((HM_MSG *)block->target);
+      free(block);
+    }
+    lane->num_unacked = 0;
+    lane->num_in_flight = 0;
+    lane->send_seq = 0;
+    lane->backoff = 0;
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_reset_stream */
+
+
+/**
+ *  @brief Starts replaying local information to a peer.
+ *
+ *  If the peer told us in INIT which version of our tables it already has,
+ *  only the nodes and processes that changed after it are sent. Processes
+ *  that stopped in the meantime go too, marked as not running, so that the
+ *  peer can retire them. Otherwise, everything we know of is sent.
+ *
+ *  The replay is not sent at once: the first few messages go now, the rest
+ *  from the main loop through hm_cluster_replay_continue(). A replay already
+ *  under way to the peer is given up for this one.
+ *
+ *  @param tprt_cb  Transport Control Block of Peer to whom we would be sending
+ *  @param since Version of our tables the peer already has. 0 for full replay.
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_replay_info(HM_TRANSPORT_CB *tprt_cb, uint32_t since)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK; /* I am very optimistic! */
+
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_REPLAY_CURSOR *cursor = NULL;
+  HM_REPLAY_SNAPSHOT *snapshot = NULL;
+
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+  TRACE_ASSERT(tprt_cb->location_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  loc_cb = tprt_cb->location_cb;
+  cursor = &loc_cb->replay;
+
+  if (since > LOCAL.local_location_cb.version)
+  {
+    /***************************************************************************/
+    /* Peer claims to have seen changes we have not made yet. Do not trust it. */
+    /***************************************************************************/
+    TRACE_WARN(("Peer has seen version %d, we are at %d. Replay everything.",
+                since, LOCAL.local_location_cb.version));
+    since = 0;
+  }
+
+  if (cursor->stage != HM_REPLAY_STAGE_IDLE)
+  {
+    TRACE_INFO(("Replay to Location %d restarted after %d messages.",
+                loc_cb->index, cursor->num_msgs));
+    hm_cluster_replay_cancel(loc_cb);
+  }
+
+  TRACE_DETAIL(("Replay changes after version %d. Current version: %d", since,
+                LOCAL.local_location_cb.version));
+
+  cursor->since = since;
+  cursor->from = since;
+  cursor->upto = LOCAL.local_location_cb.version;
+  cursor->stage = HM_REPLAY_STAGE_NODES;
+  cursor->resume = FALSE;
+  cursor->msg = NULL;
+  cursor->started_ns = hm_time_ns();
+  cursor->refilled_ns = cursor->started_ns;
+  cursor->tokens = (int64_t)hm_cluster_frame_size(loc_cb) * LOCAL.replay_chunks;
+  cursor->num_msgs = 0;
+  cursor->num_bytes = 0;
+  cursor->num_passes = 1;
+
+  /***************************************************************************/
+  /* A full replay to a peer that wants everything is the same for all such */
+  /* peers. Send the shared snapshot, then only what changed after it.     */
+  /***************************************************************************/
+  if ((since == 0) && (loc_cb->interest_all) &&
+      ((snapshot = hm_cluster_replay_snapshot(
+                                hm_cluster_frame_size(loc_cb))) != NULL) &&
+      (HM_NEXT_IN_LIST(snapshot->msgs) != NULL))
+  {
+    cursor->stage = HM_REPLAY_STAGE_SNAPSHOT;
+    cursor->snap_block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(snapshot->msgs);
+    cursor->snap_generation = snapshot->generation;
+    cursor->upto = snapshot->version;
+  }
+
+  HM_INSERT_BEFORE(LOCAL.replays, cursor->node);
+
+  ret_val = hm_cluster_replay_step(loc_cb);
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_replay_info */
+
+
+/**
+ *  @brief Moves every replay under way a few messages further
+ *
+ *  Called from the main loop on each turn while LOCAL.replays is not empty.
+ *
+ *  @param None
+ *  @return @c void
+ */
+void hm_cluster_replay_continue()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LOCATION_CB *next_loc_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (loc_cb = (HM_LOCATION_CB *)HM_NEXT_IN_LIST(LOCAL.replays);
+       loc_cb != NULL;
+       loc_cb = next_loc_cb)
+  {
+    /***************************************************************************/
+    /* A step that finishes the replay takes it off the list.         */
+    /***************************************************************************/
+    next_loc_cb = (HM_LOCATION_CB *)HM_NEXT_IN_LIST(loc_cb->replay.node);
+
+    if (hm_cluster_replay_step(loc_cb) != HM_OK)
+    {
+      TRACE_ERROR(("Error replaying to Location %d. Giving up.", loc_cb->index));
+      hm_cluster_replay_cancel(loc_cb);
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_replay_continue */
+
+
+/**
+ *  @brief Sends the next few messages of the replay to a peer
+ *
+ *  At most LOCAL.replay_chunks messages go, and fewer if the bulk lane window
+ *  to the peer is full, its socket is backed up, or the rate cap is reached.
+ *  When a pass ends and our tables have moved on since it began, another
+ *  starts from there, up to HM_REPLAY_MAX_PASSES in all. Otherwise End of
+ *  Replay is sent and the replay is done. Under constant churn the last pass
+ *  does not wait for the tables to settle: changes made during it are sent
+ *  to the peer as live updates, which it takes by version.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_replay_step(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  int32_t sent;
+  uint32_t num_chunks;
+  uint64_t now;
+  uint64_t elapsed;
+
+  HM_REPLAY_CURSOR *cursor = NULL;
+  HM_TRANSPORT_CB *tprt_cb = NULL;
+  int64_t max_tokens;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  cursor = &loc_cb->replay;
+  tprt_cb = loc_cb->peer_listen_cb;
+
+  if ((cursor->stage == HM_REPLAY_STAGE_IDLE) || (tprt_cb == NULL))
+  {
+    TRACE_WARN(("No replay to step for Location %d", loc_cb->index));
+    hm_cluster_replay_cancel(loc_cb);
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Refill the rate cap for the time gone by. A burst of a full step is all */
+  /* that may build up.                            */
+  /***************************************************************************/
+  if (LOCAL.replay_rate != 0)
+  {
+    now = hm_time_ns();
+    max_tokens = (int64_t)hm_cluster_frame_size(loc_cb) * LOCAL.replay_chunks;
+    elapsed = now - cursor->refilled_ns;
+    if (elapsed > 1000000000)
+    {
+      elapsed = 1000000000;
+    }
+    cursor->tokens += (int64_t)(elapsed * LOCAL.replay_rate / 1000000000);
+    if (cursor->tokens > max_tokens)
+    {
+      cursor->tokens = max_tokens;
+    }
+    cursor->refilled_ns = now;
+  }
+
+  for (num_chunks = 0; num_chunks < LOCAL.replay_chunks; num_chunks++)
+  {
+    /***************************************************************************/
+    /* Let the peer and its socket catch up before adding more.        */
+    /***************************************************************************/
+    if ((loc_cb->lanes[HM_PEER_LANE_BULK].num_unacked >= HM_PEER_WINDOW_SIZE) ||
+        (tprt_cb->stats.num_pending >= LOCAL.replay_chunks))
+    {
+      TRACE_DETAIL(("Replay to Location %d waits on the peer.", loc_cb->index));
+      break;
+    }
+    if ((LOCAL.replay_rate != 0) && (cursor->tokens <= 0))
+    {
+      TRACE_DETAIL(("Replay to Location %d is at its rate.", loc_cb->index));
+      break;
+    }
+
+    if ((sent = hm_cluster_replay_chunk(loc_cb)) < 0)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+
+    if (sent > 0)
+    {
+      cursor->tokens -= sent;
+      cursor->num_msgs++;
+      cursor->num_bytes += sent;
+      continue;
+    }
+
+    /***************************************************************************/
+    /* Pass over. Send again whatever changed while it was under way.     */
+    /***************************************************************************/
+    if ((LOCAL.local_location_cb.version > cursor->upto) &&
+        (cursor->num_passes < HM_REPLAY_MAX_PASSES))
+    {
+      TRACE_DETAIL(("Tables moved from %d to %d during replay pass. Go again.",
+                    cursor->upto, LOCAL.local_location_cb.version));
+      cursor->from = cursor->upto;
+      cursor->upto = LOCAL.local_location_cb.version;
+      cursor->stage = HM_REPLAY_STAGE_NODES;
+      cursor->resume = FALSE;
+      cursor->num_passes++;
+      continue;
+    }
+
+    if (LOCAL.local_location_cb.version > cursor->upto)
+    {
+      TRACE_DETAIL(("Replay made %d passes. Versions %d to %d went live.",
+                    cursor->num_passes, cursor->upto,
+                    LOCAL.local_location_cb.version));
+    }
+    TRACE_DETAIL(("Send End of Replay. We have nothing more to send."));
+
+    if (hm_cluster_send_end_of_replay(tprt_cb, cursor->since) != HM_OK)
+    {
+      TRACE_ERROR(("Error while sending End of Replay Message"));
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+
+    TRACE_INFO(("Replayed to Location %d in %d messages, %d bytes, %d passes,"
+                " %llu ms.", loc_cb->index, cursor->num_msgs, cursor->num_bytes,
+                cursor->num_passes,
+           (unsigned long long)((hm_time_ns() - cursor->started_ns) / 1000000)));
+    hm_cluster_replay_cancel(loc_cb);
+    break;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_replay_step */
+
+
+/**
+ *  @brief Sends the next message of the replay to a peer
+ *
+ *  It is the next message of the snapshot, or one filled with as many of the
+ *  Nodes, then Processes, that follow where the pass stands as fit.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return Bytes sent, 0 when the pass is over, -1 on error
+ */
+int32_t hm_cluster_replay_chunk(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = 0;
+
+  HM_REPLAY_CURSOR *cursor = NULL;
+  HM_TRANSPORT_CB *tprt_cb = NULL;
+  HM_REPLAY_SNAPSHOT *snapshot = &LOCAL.replay_snapshot;
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
+  HM_MSG *msg = NULL;
+  uint32_t max_tlvs;
+  uint32_t num_tlvs = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  cursor = &loc_cb->replay;
+  tprt_cb = loc_cb->peer_listen_cb;
+
+  if (cursor->stage == HM_REPLAY_STAGE_SNAPSHOT)
+  {
+    if ((!snapshot->valid) || (snapshot->generation != cursor->snap_generation))
+    {
+      /***************************************************************************/
+      /* Snapshot was dropped under us. What the peer already got of it is  */
+      /* sent again, but that does no harm.                   */
+      /***************************************************************************/
+      TRACE_INFO(("Snapshot dropped during replay to Location %d. "
+                  "Replay everything.", loc_cb->index));
+      cursor->from = 0;
+      cursor->upto = LOCAL.local_location_cb.version;
+      cursor->stage = HM_REPLAY_STAGE_NODES;
+      cursor->resume = FALSE;
+    }
+    else
+    {
+      msg = (HM_MSG *)cursor->snap_block->target;
+      if (hm_cluster_send_sequenced(msg, loc_cb, HM_PRIORITY_NODE) != HM_OK)
+      {
+        TRACE_ERROR(("Error sending message to peer!"));
+        ret_val = -1;
+        goto EXIT_LABEL;
+      }
+      ret_val = msg->msg_len;
+
+      cursor->snap_block =
+                  (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(cursor->snap_block->node);
+      if (cursor->snap_block == NULL)
+      {
+        TRACE_DETAIL(("Sent snapshot at version %d in %d messages.",
+                      cursor->upto, snapshot->num_msgs));
+        cursor->from = cursor->upto;
+        cursor->upto = LOCAL.local_location_cb.version;
+        cursor->stage = HM_REPLAY_STAGE_NODES;
+        cursor->resume = FALSE;
+      }
+      goto EXIT_LABEL;
+    }
+  }
+
+  max_tlvs = (hm_cluster_frame_size(loc_cb) - HM_PEER_REPLAY_MSG_SIZE(0)) /
+                                                  sizeof(HM_PEER_REPLAY_TLV);
+
+  while (num_tlvs < max_tlvs)
+  {
+    if (cursor->stage == HM_REPLAY_STAGE_NODES)
+    {
+      /***************************************************************************/
+      /* First, Nodes. Process updates before nodes will fail at the peer if the */
+      /* nodes do not exist there.                         */
+      /***************************************************************************/
+      if (cursor->resume)
+      {
+        node_cb = (HM_NODE_CB *)HM_AVL3_FIND_NEXT(
+                                    LOCAL.local_location_cb.node_tree,
+                                    &cursor->node_key, nodes_tree_by_node_id);
+      }
+      else
+      {
+        node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
+                                              nodes_tree_by_node_id);
+      }
+
+      while ((node_cb != NULL) && (cursor->from != 0) &&
+             (node_cb->version <= cursor->from))
+      {
+        TRACE_DETAIL(("Node %d unchanged since version %d", node_cb->index,
+                      cursor->from));
+        node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                                             nodes_tree_by_node_id);
+      }
+
+      if (node_cb == NULL)
+      {
+        cursor->stage = HM_REPLAY_STAGE_PROCESSES;
+        cursor->resume = FALSE;
+        continue;
+      }
+      cursor->node_key = node_cb->index;
+      cursor->resume = TRUE;
+
+      TRACE_DETAIL(("Filling out Node %d information.", node_cb->index));
+
+      if ((tlv = hm_cluster_replay_next_tlv(tprt_cb, &cursor->msg,
+                                            cursor->from)) == NULL)
+      {
+        ret_val = -1;
+        goto EXIT_LABEL;
+      }
+
+      /***************************************************************************/
+      /* It is necessary to communicate information of all the nodes that we know*/
+      /* about, running or not.                           */
+      /* This is because, later, if the node fails to start (during INIT), we    */
+      /* send out an update of FAILED Node, and the remote HM would not find an  */
+      /* entry for that node, causing trouble.                    */
+      /***************************************************************************/
+      hm_cluster_fill_node_tlv(tlv, node_cb);
+    }
+    else if (cursor->stage == HM_REPLAY_STAGE_PROCESSES)
+    {
+      if ((proc_cb = hm_cluster_replay_next_process(loc_cb)) == NULL)
+      {
+        break;
+      }
+
+      TRACE_DETAIL(("Filling out Process %d information.", proc_cb->type));
+
+      if ((tlv = hm_cluster_replay_next_tlv(tprt_cb, &cursor->msg,
+                                            cursor->from)) == NULL)
+      {
+        ret_val = -1;
+        goto EXIT_LABEL;
+      }
+
+      hm_cluster_fill_process_tlv(tlv, proc_cb);
+    }
+    else
+    {
+      break;
+    }
+    num_tlvs++;
+  }
+
+  /***************************************************************************/
+  /* Send what was filled. Nothing filled means the pass is over.       */
+  /***************************************************************************/
+  if (cursor->msg != NULL)
+  {
+    hm_cluster_replay_seal(&cursor->msg);
+    ret_val = cursor->msg->msg_len;
+    if (hm_cluster_replay_flush(tprt_cb, &cursor->msg) != HM_OK)
+    {
+      ret_val = -1;
+      goto EXIT_LABEL;
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_replay_chunk */
+
+
+/**
+ *  @brief Finds the next Process the replay pass should send, and moves to it
+ *
+ *  A full replay carries running processes only. A partial one carries every
+ *  process that changed, so that the ones which stopped are retired.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return Process CB (#HM_PROCESS_CB), NULL if there are no more
+ */
+HM_PROCESS_CB * hm_cluster_replay_next_process(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_REPLAY_CURSOR *cursor = NULL;
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  cursor = &loc_cb->replay;
+
+  if (!cursor->resume)
+  {
+    node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
+                                          nodes_tree_by_node_id);
+    proc_cb = NULL;
+    if (node_cb != NULL)
+    {
+      proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                                      node_process_tree_by_proc_type_and_pid);
+    }
+  }
+  else
+  {
+    /***************************************************************************/
+    /* The node we stopped in may be gone. Then its successor is begun.    */
+    /***************************************************************************/
+    node_cb = (HM_NODE_CB *)HM_AVL3_FIND_OR_FIND_NEXT(
+                                    LOCAL.local_location_cb.node_tree,
+                                    &cursor->node_key, nodes_tree_by_node_id);
+    proc_cb = NULL;
+    if ((node_cb != NULL) && (node_cb->index == cursor->node_key))
+    {
+      proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIND_NEXT(node_cb->process_tree,
+                                      cursor->proc_key,
+                                      node_process_tree_by_proc_type_and_pid);
+    }
+    else if (node_cb != NULL)
+    {
+      proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                                      node_process_tree_by_proc_type_and_pid);
+    }
+  }
+
+  while (node_cb != NULL)
+  {
+    for (; proc_cb != NULL;
+         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                                      node_process_tree_by_proc_type_and_pid))
+    {
+      if (((cursor->from == 0) && (proc_cb->running == FALSE)) ||
+          ((cursor->from != 0) && (proc_cb->version <= cursor->from)))
+      {
+        TRACE_DETAIL(("Exclude Process %d from update.", proc_cb->pid));
+        continue;
+      }
+
+      if (!hm_cluster_peer_wants(loc_cb, proc_cb->type))
+      {
+        TRACE_DETAIL(("Peer has no subscribers for Process %d.", proc_cb->pid));
+        continue;
+      }
+
+      cursor->resume = TRUE;
+      cursor->node_key = node_cb->index;
+      cursor->proc_key[0] = proc_cb->type;
+      cursor->proc_key[1] = proc_cb->pid;
+      goto EXIT_LABEL;
+    }
+
+    node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                                         nodes_tree_by_node_id);
+    if (node_cb != NULL)
+    {
+      proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                                      node_process_tree_by_proc_type_and_pid);
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (proc_cb);
+}/* hm_cluster_replay_next_process */
+
+
+/**
+ *  @brief Gives up the replay under way to a peer, if any
+ *
+ *  What it already sent stays on the stream.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return @c void
+ */
+void hm_cluster_replay_cancel(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_REPLAY_CURSOR *cursor = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  cursor = &loc_cb->replay;
+
+  if (cursor->msg != NULL)
+  {
+    hm_free_buffer(cursor->msg);
+    cursor->msg = NULL;
+  }
+  if (HM_IN_LIST(cursor->node))
+  {
+    HM_REMOVE_FROM_LIST(cursor->node);
+  }
+  cursor->snap_block = NULL;
+  cursor->stage = HM_REPLAY_STAGE_IDLE;
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_replay_cancel */
+
+
+/**
+ *  @brief Returns the full replay snapshot of our tables, building it if needed
+ *
+ *  The snapshot is kept till our tables move on by more than
+ *  #HM_REPLAY_SNAPSHOT_MAX_LAG versions, or a peer needs another frame size.
+ *  Nodes go first, then running processes, as in a full replay.
+ *
+ *  @param frame_size Largest message the peer accepts
+ *  @return Snapshot (#HM_REPLAY_SNAPSHOT), NULL on error
+ */
+HM_REPLAY_SNAPSHOT * hm_cluster_replay_snapshot(uint32_t frame_size)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_REPLAY_SNAPSHOT *snapshot = &LOCAL.replay_snapshot;
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  HM_MSG *msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
+  uint32_t max_tlvs;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if ((snapshot->valid) && (snapshot->frame_size == frame_size) &&
+      (LOCAL.local_location_cb.version - snapshot->version <=
+                                                HM_REPLAY_SNAPSHOT_MAX_LAG))
+  {
+    TRACE_DETAIL(("Reuse snapshot at version %d", snapshot->version));
+    goto EXIT_LABEL;
+  }
+
+  hm_cluster_drop_snapshot();
+  snapshot->version = LOCAL.local_location_cb.version;
+  snapshot->frame_size = frame_size;
+  max_tlvs = (frame_size - HM_PEER_REPLAY_MSG_SIZE(0)) /
+             sizeof(HM_PEER_REPLAY_TLV);
+  TRACE_DETAIL(("Take snapshot of tables at version %d", snapshot->version));
+
+  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
+                 nodes_tree_by_node_id);
+       node_cb != NULL;
+       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                 nodes_tree_by_node_id))
+  {
+    if ((tlv = hm_cluster_snapshot_next_tlv(&msg, max_tlvs)) == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    hm_cluster_fill_node_tlv(tlv, node_cb);
+  }
+
+  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
+                 nodes_tree_by_node_id);
+       node_cb != NULL;
+       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                 nodes_tree_by_node_id))
+  {
+    for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                   node_process_tree_by_proc_type_and_pid);
+         proc_cb != NULL;
+         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                   node_process_tree_by_proc_type_and_pid))
+    {
+      if (proc_cb->running == FALSE)
+      {
+        continue;
+      }
+
+      if ((tlv = hm_cluster_snapshot_next_tlv(&msg, max_tlvs)) == NULL)
+      {
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+      hm_cluster_fill_process_tlv(tlv, proc_cb);
+    }
+  }
+
+  if ((msg != NULL) && (hm_cluster_snapshot_append(&msg) != HM_OK))
+  {
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  snapshot->valid = TRUE;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (ret_val != HM_OK)
+  {
+    TRACE_ERROR(("Error taking snapshot of tables."));
+    if (msg != NULL)
+    {
+      hm_free_buffer(msg);
+    }
+    hm_cluster_drop_snapshot();
+    snapshot = NULL;
+  }
+  TRACE_EXIT();
+  return (snapshot);
+}/* hm_cluster_replay_snapshot */
+
+
+/**
+ *  @brief Returns the next free TLV in the snapshot being taken
+ *
+ *  A full message is added to the snapshot, and a new one is started.
+ *
+ *  @param **msg Replay message (#HM_MSG) being built. NULL if there is none.
+ *  @param max_tlvs Number of TLVs a message has room for
+ *  @return Pointer to TLV (#HM_PEER_REPLAY_TLV) to fill, NULL on error
+ */
+HM_PEER_REPLAY_TLV * hm_cluster_snapshot_next_tlv(HM_MSG **msg,
+                                                  uint32_t max_tlvs)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PEER_MSG_REPLAY *replay_msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
+  uint32_t num_tlvs = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (*msg != NULL)
+  {
+    replay_msg = (HM_PEER_MSG_REPLAY *)(*msg)->msg;
+    HM_GET_LONG(num_tlvs, replay_msg->num_tlvs);
+
+    if ((num_tlvs == max_tlvs) && (hm_cluster_snapshot_append(msg) != HM_OK))
+    {
+      goto EXIT_LABEL;
+    }
+  }
+
+  if ((*msg == NULL) && ((*msg = hm_cluster_replay_new(max_tlvs, 0)) == NULL))
+  {
+    goto EXIT_LABEL;
+  }
+
+  replay_msg = (HM_PEER_MSG_REPLAY *)(*msg)->msg;
+  HM_GET_LONG(num_tlvs, replay_msg->num_tlvs);
+  tlv = &replay_msg->tlv[num_tlvs];
+  HM_PUT_LONG(replay_msg->num_tlvs, num_tlvs + 1);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (tlv);
+}/* hm_cluster_snapshot_next_tlv */
+
+
+/**
+ *  @brief Adds a filled Replay message to the end of the snapshot
+ *
+ *  @param **msg Replay message (#HM_MSG). The snapshot owns it, and it is
+ *  reset to NULL, even on error.
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_snapshot_append(HM_MSG **msg)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_LIST_BLOCK *block = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(*msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  hm_cluster_replay_seal(msg);
+
+  block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
+  if (block == NULL)
+  {
+    TRACE_ERROR(("Error allocating resources for snapshot."));
+    hm_free_buffer(*msg);
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  HM_INIT_LQE(block->node, block);
+  block->target = *msg;
+  block->opaque = NULL;
+  HM_INSERT_BEFORE(LOCAL.replay_snapshot.msgs, block->node);
+  LOCAL.replay_snapshot.num_msgs++;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  *msg = NULL;
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_snapshot_append */
+
+
+/**
+ *  @brief Releases the full replay snapshot of our tables
+ *
+ *  Peers which were sent its messages and have not acknowledged them yet
+ *  keep their references.
+ *
+ *  @param None
+ *  @return @c void
+ */
+void hm_cluster_drop_snapshot()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *block = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.replay_snapshot.msgs);
+       block != NULL;
+       block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.replay_snapshot.msgs))
+  {
+    HM_REMOVE_FROM_LIST(block->node);
+    hm_free_buffer((HM_MSG *)block->target);
+    free(block);
+  }
+  LOCAL.replay_snapshot.num_msgs = 0;
+  LOCAL.replay_snapshot.valid = FALSE;
+  LOCAL.replay_snapshot.generation++;
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_drop_snapshot */
+
+
+/**
+ *  @brief Fills a Replay TLV with the current state of one of our nodes
+ *
+ *  @param *tlv TLV (#HM_PEER_REPLAY_TLV) to fill
+ *  @param *node_cb Node CB (#HM_NODE_CB) of the local node
+ *  @return @c void
+ */
+void hm_cluster_fill_node_tlv(HM_PEER_REPLAY_TLV *tlv, HM_NODE_CB *node_cb)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tlv != NULL);
+  TRACE_ASSERT(node_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_PUT_LONG(tlv->group, (uint32_t)node_cb->group);
+  HM_PUT_LONG(tlv->node_id, (uint32_t)node_cb->index);
+  HM_PUT_LONG(tlv->update_type, HM_PEER_REPLAY_UPDATE_TYPE_NODE);
+  HM_PUT_LONG(tlv->version, node_cb->version);
+  hm_hlc_put(tlv->hlc, node_cb->hlc);
+
+  if (node_cb->current_role != NODE_ROLE_NONE)
+  {
+    TRACE_DETAIL(("Node role: %s",
+        node_cb->current_role== NODE_ROLE_ACTIVE? "ACTIVE": "PASSIVE"));
+    HM_PUT_LONG(tlv->role, (uint32_t)node_cb->current_role);
+  }
+  else
+  {
+    TRACE_DETAIL(("Node role resolution not completed. Use desired role"));
+    HM_PUT_LONG(tlv->role, (uint32_t)node_cb->role);
+    TRACE_DETAIL(("Node role: %s",
+        node_cb->role== NODE_ROLE_ACTIVE? "ACTIVE": "PASSIVE"));
+  }
+
+  HM_PUT_LONG(tlv->running, (node_cb->fsm_state));
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_fill_node_tlv */
+
+
+/**
+ *  @brief Fills a Replay TLV with the current state of one of our processes
+ *
+ *  @param *tlv TLV (#HM_PEER_REPLAY_TLV) to fill
+ *  @param *proc_cb Process CB (#HM_PROCESS_CB) of the local process
+ *  @return @c void
+ */
+void hm_cluster_fill_process_tlv(HM_PEER_REPLAY_TLV *tlv, HM_PROCESS_CB *proc_cb)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tlv != NULL);
+  TRACE_ASSERT(proc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_PUT_LONG(tlv->group, (uint32_t)proc_cb->type);
+  HM_PUT_LONG(tlv->node_id, (uint32_t)proc_cb->parent_node_cb->index);
+  HM_PUT_LONG(tlv->update_type, HM_PEER_REPLAY_UPDATE_TYPE_PROC);
+  HM_PUT_LONG(tlv->pid, (uint32_t)proc_cb->pid);
+  HM_PUT_LONG(tlv->running, proc_cb->running);
+  HM_PUT_LONG(tlv->version, proc_cb->version);
+  hm_hlc_put(tlv->hlc, proc_cb->hlc);
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_fill_process_tlv */
+
+
+/**
+ *  @brief Returns the next free TLV in the Replay message being built
+ *
+ *  If there is no message being built, or it is full, the full one is sent
+ *  and a new one is started. A message holds as many TLVs as fit in the frame
+ *  size agreed with the peer.
+ *
+ *  @param *tprt_cb Transport Control Block of Peer to whom we would be sending
+ *  @param **msg Replay message (#HM_MSG) being built. NULL if there is none.
+ *  @param since Version after which changes are being replayed
+ *  @return Pointer to TLV (#HM_PEER_REPLAY_TLV) to fill, NULL on error
+ */
+HM_PEER_REPLAY_TLV * hm_cluster_replay_next_tlv(HM_TRANSPORT_CB *tprt_cb,
+                        HM_MSG **msg, uint32_t since)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PEER_MSG_REPLAY *replay_msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
+  uint32_t num_tlvs = 0;
+  uint32_t max_tlvs = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(tprt_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  max_tlvs = (hm_cluster_frame_size(tprt_cb->location_cb) -
+              HM_PEER_REPLAY_MSG_SIZE(0)) / sizeof(HM_PEER_REPLAY_TLV);
+
+  if (*msg != NULL)
+  {
+    replay_msg = (HM_PEER_MSG_REPLAY *)(*msg)->msg;
+    HM_GET_LONG(num_tlvs, replay_msg->num_tlvs);
+
+    if (num_tlvs == max_tlvs)
+    {
+      /***************************************************************************/
+      /* Made message, now queue on transport and send if possible         */
+      /***************************************************************************/
+      if (hm_cluster_replay_flush(tprt_cb, msg) != HM_OK)
+      {
+        goto EXIT_LABEL;
+      }
+    }
+  }
+
+  if ((*msg == NULL) && ((*msg = hm_cluster_replay_new(max_tlvs, since)) == NULL))
+  {
+    goto EXIT_LABEL;
+  }
+
+  replay_msg = (HM_PEER_MSG_REPLAY *)(*msg)->msg;
+  HM_GET_LONG(num_tlvs, replay_msg->num_tlvs);
+  tlv = &replay_msg->tlv[num_tlvs];
+  HM_PUT_LONG(replay_msg->num_tlvs, num_tlvs + 1);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (tlv);
+}/* hm_cluster_replay_next_tlv */
+
+
+/**
+ *  @brief Starts a Replay message of our tables
+ *
+ *  @param max_tlvs Number of TLVs the message has room for
+ *  @param since Version after which changes are being replayed
+ *  @return Replay message (#HM_MSG) with no TLVs yet, NULL on error
+ */
+HM_MSG * hm_cluster_replay_new(uint32_t max_tlvs, uint32_t since)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_MSG *msg = NULL;
+  HM_PEER_MSG_REPLAY *replay_msg = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  msg = hm_get_buffer(HM_PEER_REPLAY_MSG_SIZE(max_tlvs));
+
+  if (msg == NULL)
+  {
+    TRACE_ERROR(("Error allocating memory for Replay Message."));
+    goto EXIT_LABEL;
+  }
+
+  replay_msg = (HM_PEER_MSG_REPLAY *)msg->msg;
+  memset(replay_msg, 0, HM_PEER_REPLAY_MSG_SIZE(max_tlvs));
+  HM_PUT_LONG(replay_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  HM_PUT_LONG(replay_msg->hdr.msg_type, HM_PEER_MSG_TYPE_REPLAY);
+  HM_PUT_LONG(replay_msg->hdr.timestamp, 0);
+
+  /* Not the last message */
+  HM_PUT_LONG(replay_msg->last, 0);
+  HM_PUT_LONG(replay_msg->since, since);
+  HM_PUT_LONG(replay_msg->version, LOCAL.local_location_cb.version);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (msg);
+}/* hm_cluster_replay_new */
+
+
+/**
+ *  @brief Cuts a Replay message down to the TLVs actually filled in
+ *
+ *  @param **msg Replay message (#HM_MSG). Replaced if it is reallocated.
+ *  @return @c void
+ */
+void hm_cluster_replay_seal(HM_MSG **msg)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PEER_MSG_REPLAY *replay_msg = NULL;
+  HM_MSG *shrunk = NULL;
+  uint32_t num_tlvs = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(*msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  replay_msg = (HM_PEER_MSG_REPLAY *)(*msg)->msg;
+  HM_GET_LONG(num_tlvs, replay_msg->num_tlvs);
+  HM_PUT_LONG(replay_msg->hdr.msg_len, HM_PEER_REPLAY_MSG_SIZE(num_tlvs));
+
+  if (HM_PEER_REPLAY_MSG_SIZE(num_tlvs) < (*msg)->msg_len)
+  {
+    shrunk = hm_shrink_buffer(*msg, HM_PEER_REPLAY_MSG_SIZE(num_tlvs));
+    if (shrunk != NULL)
+    {
+      *msg = shrunk;
+    }
+    else
+    {
+      /***************************************************************************/
+      /* Send only the filled part out of the bigger buffer            */
+      /***************************************************************************/
+      (*msg)->msg_len = HM_PEER_REPLAY_MSG_SIZE(num_tlvs);
+    }
+  }
+  TRACE_DETAIL(("%d TLVs in %d bytes", num_tlvs, (*msg)->msg_len));
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_replay_seal */
+
+
+/**
+ *  @brief Sends the Replay message being built, if any
+ *
+ *  The message is cut down to the TLVs actually filled in before it is sent.
+ *
+ *  @param *tprt_cb Transport Control Block of Peer to whom we would be sending
+ *  @param **msg Replay message (#HM_MSG) being built. Reset to NULL once sent.
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_replay_flush(HM_TRANSPORT_CB *tprt_cb, HM_MSG **msg)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (*msg == NULL)
+  {
+    TRACE_DETAIL(("Nothing pending."));
+    goto EXIT_LABEL;
+  }
+
+  hm_cluster_replay_seal(msg);
+
+  if (hm_cluster_send_sequenced(*msg, tprt_cb->location_cb, HM_PRIORITY_NODE)
+                                                                    != HM_OK)
+  {
+    TRACE_ERROR(("Error sending message to peer!"));
+    ret_val = HM_ERR;
+  }
+
+  hm_free_buffer(*msg);
+  *msg = NULL;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_replay_flush */
+
+
+/**
+ *  @brief Sends the end of replay message
+ *
+ *  It carries the version of our tables the replay brought the peer up to.
+ *
+ *  @param *tprt_cb Transport Control Block of Peer to whom we would be sending
+ *  @param since Version after which changes were replayed. 0 for full replay.
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_send_end_of_replay(HM_TRANSPORT_CB *tprt_cb, uint32_t since)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_MSG *msg = NULL;
+  HM_PEER_MSG_REPLAY *replay_msg = NULL;
+
+  int32_t ret_val = HM_OK;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  msg = hm_get_buffer(HM_PEER_REPLAY_MSG_SIZE(0));
+
+  if (msg == NULL)
+  {
+    TRACE_ERROR(("Error allocating memory for Replay Message."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  replay_msg = (HM_PEER_MSG_REPLAY *)msg->msg;
+
+  if (replay_msg == NULL)
+  {
+    TRACE_ERROR(("Error allocating memory for Replay Message."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  memset(replay_msg, 0, HM_PEER_REPLAY_MSG_SIZE(0));
+  HM_PUT_LONG(replay_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  HM_PUT_LONG(replay_msg->hdr.msg_type, HM_PEER_MSG_TYPE_REPLAY);
+  HM_PUT_LONG(replay_msg->hdr.timestamp, 0);
+  HM_PUT_LONG(replay_msg->hdr.msg_len, HM_PEER_REPLAY_MSG_SIZE(0));
+
+  /* The last message */
+  HM_PUT_LONG(replay_msg->last, 1);
+  HM_PUT_LONG(replay_msg->since, since);
+  HM_PUT_LONG(replay_msg->version, LOCAL.local_location_cb.version);
+
+  if (hm_cluster_send_sequenced(msg, tprt_cb->location_cb, HM_PRIORITY_NODE)
+                                                                    != HM_OK)
+  {
+    TRACE_ERROR(("Error sending message to peer!"));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  hm_free_buffer(msg);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_send_end_of_replay */
+
+
+/**
+ *  @brief Receives and processes a cluster message
+ *
+ *  @param *tprt_cb Transport Control Block of the peer the message is from (#HM_TRANSPORT_CB)
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_receive_cluster_message(HM_TRANSPORT_CB *tprt_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+
+  HM_PEER_MSG_HEADER *msg_header = NULL;
+  int32_t msg_type;
+  int32_t hw_id;
+
+  HM_PEER_MSG_INIT *init_msg = NULL;
+  HM_PEER_MSG_REPLAY *replay_msg = NULL;
+  HM_PEER_MSG_NODE_UPDATE *node_update = NULL;
+  HM_PEER_MSG_PROCESS_UPDATE *proc_update = NULL;
+  //HM_PEER_MSG_UNION *msg = NULL; /* Use this instead of many pointers */
+
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+
+  HM_MSG *msg = NULL;
+
+  int32_t node_id;
+  int32_t proc_key[2];
+  int32_t status;
+  uint32_t version;
+  uint64_t hlc;
+  uint32_t num_entries;
+  uint32_t seq, lane;
+  uint32_t request;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  msg_header = (HM_PEER_MSG_HEADER *)tprt_cb->in_buffer;
+
+  loc_cb = tprt_cb->location_cb;
+
+  HM_GET_LONG(hw_id, msg_header->hw_id);
+  HM_GET_LONG(msg_type, msg_header->msg_type);
+  TRACE_DETAIL(("Received message of type %d from Location %d", msg_type,
+                hw_id));
+  hlc = hm_hlc_get(msg_header->timestamp);
+  hm_hlc_merge(hlc);
+
+  /***************************************************************************/
+  /* Even a message we have had already shows the peer is alive.       */
+  /***************************************************************************/
+  hm_tprt_heard_from(tprt_cb, FALSE);
+
+  /***************************************************************************/
+  /* A message sent again that had arrived already is not processed twice.   */
+  /***************************************************************************/
+  HM_GET_LONG(seq, msg_header->seq);
+  HM_GET_LONG(lane, msg_header->lane);
+  if (!hm_cluster_accept_seq(loc_cb, lane, seq))
+  {
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Since the message can be received over TCP or UDP, the incoming buffer  */
+  /* is kept as large as possible while keeping the PDU size on the UDP     */
+  /* socket limited.                               */
+  /* Thus, here, we won't need to allocate more buffers. We already have a   */
+  /* complete message.                             */
+  /***************************************************************************/
+  switch (msg_type)
+  {
+    case HM_PEER_MSG_TYPE_INIT:
+      TRACE_DETAIL(("Received INIT message."));
+      if (tprt_cb->in_bytes < (int32_t)sizeof(HM_PEER_MSG_INIT))
+      {
+        TRACE_ERROR(("INIT of %d bytes is too short", tprt_cb->in_bytes));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+      init_msg = (HM_PEER_MSG_INIT *)tprt_cb->in_buffer;
+      HM_GET_LONG(hw_id, init_msg->hdr.hw_id);
+      HM_GET_LONG(request, init_msg->request);
+
+      if (!hm_cluster_init_may_peer(init_msg))
+      {
+        TRACE_WARN(("Location %d may not peer with us. INIT ignored.", hw_id));
+        goto EXIT_LABEL;
+      }
+
+      hm_cluster_read_init(init_msg, loc_cb);
+
+      if (request == TRUE)
+      {
+        TRACE_DETAIL(("Received INIT request."));
+        HM_PUT_LONG(init_msg->response_ok, TRUE);
+        HM_PUT_LONG(init_msg->request, FALSE);
+        msg = hm_get_buffer(sizeof(HM_PEER_MSG_INIT));
+
+        if (msg == NULL)
+        {
+          TRACE_ERROR(("Error allocating buffer for INIT response."));
+          TRACE_ASSERT(msg != NULL);
+        }
+
+        memcpy(msg->msg, init_msg, sizeof(HM_PEER_MSG_INIT));
+        hm_cluster_fill_init((HM_PEER_MSG_INIT *)msg->msg, loc_cb);
+
+        /***************************************************************************/
+        /* Queue on port                               */
+        /***************************************************************************/
+        if (hm_queue_on_transport(msg, tprt_cb, HM_PRIORITY_CONTROL) != HM_OK)
+        {
+          TRACE_ERROR(("Error while sending INIT response."));
+          TRACE_ASSERT(FALSE);
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        hm_free_buffer(msg);
+      }
+      else
+      {
+        TRACE_DETAIL(("Received INIT Response."));
+        HM_GET_LONG(node_id, init_msg->response_ok);
+
+        if (node_id != TRUE)
+        {
+          TRACE_ERROR(("Response is not OK"));
           TRACE_ASSERT(FALSE);
         }
       }
 
-      hm_peer_fsm(HM_PEER_FSM_INIT_RCVD, sock_cb->tprt_cb->location_cb);
-      break;
+      if (loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE)
+      {
+        hm_peer_fsm(HM_PEER_FSM_INIT_RCVD, loc_cb);
+      }
+      else if (request == TRUE)
+      {
+        /***************************************************************************/
+        /* The peer has started over while we thought it active: our response  */
+        /* was lost, or it restarted. Our stream to it began again with the   */
+        /* response, so replay again from what it says it has.          */
+        /***************************************************************************/
+        TRACE_INFO(("Location %d started over. Replay again.", loc_cb->index));
+        hm_cluster_send_interest(loc_cb);
+        loc_cb->replay_in_progress = TRUE;
+        if (hm_cluster_replay_info(tprt_cb, loc_cb->replay_since) != HM_OK)
+        {
+          TRACE_ERROR(("Error sending replay messages to peer."));
+        }
+        hm_cluster_relay_tables(loc_cb);
+      }
+      break;
+
+    case HM_PEER_MSG_TYPE_REPLAY:
+      TRACE_DETAIL(("Received Replay Message Sequence"));
+      /***************************************************************************/
+      /* Location cannot be inactive while doing replay               */
+      /***************************************************************************/
+      TRACE_ASSERT(tprt_cb->location_cb->fsm_state
+                   == HM_PEER_FSM_STATE_ACTIVE);
+      replay_msg = (HM_PEER_MSG_REPLAY *)tprt_cb->in_buffer;
+      HM_GET_LONG(num_entries, replay_msg->num_tlvs);
+
+      if ((tprt_cb->in_bytes < (int32_t)HM_PEER_REPLAY_MSG_SIZE(0)) ||
+          (num_entries > (tprt_cb->in_bytes - HM_PEER_REPLAY_MSG_SIZE(0)) /
+                                                   sizeof(HM_PEER_REPLAY_TLV)))
+      {
+        TRACE_ERROR(("Replay of %d bytes cannot carry %d TLVs",
+                     tprt_cb->in_bytes, num_entries));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      if ((ret_val = hm_cluster_process_replay(replay_msg, loc_cb)) != HM_OK)
+      {
+        TRACE_ERROR(("Error occurred while processing Replay Message."));
+        goto EXIT_LABEL;
+      }
+
+      break;
+
+
+    case HM_PEER_MSG_TYPE_NODE_UPDATE:
+      TRACE_DETAIL(("Received Node Update"));
+      /***************************************************************************/
+      /* Location cannot be inactive while getting a node update              */
+      /***************************************************************************/
+      TRACE_ASSERT(tprt_cb->location_cb->fsm_state
+                   == HM_PEER_FSM_STATE_ACTIVE);
+      node_update = (HM_PEER_MSG_NODE_UPDATE *)tprt_cb->in_buffer;
+
+      /***************************************************************************/
+      /* Find the node_cb in HM                           */
+      /***************************************************************************/
+      HM_GET_LONG(node_id, node_update->node_id);
+      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
+                                           &node_id,
+                                           nodes_tree_by_node_id);
+
+      if (node_cb == NULL)
+      {
+        TRACE_ERROR(("Node %d does not exist in DB and its update was received.",
+                     node_id));
+        TRACE_ASSERT(FALSE);
+        /* This is temporary. The code is unhittable, but currently on upgrade path */
+        node_cb = hm_alloc_node_cb(FALSE);
+
+        if (node_cb == NULL)
+        {
+          TRACE_ERROR(("Error allocating memory for Remote Node"));
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        HM_GET_LONG(node_cb->index, node_update->node_id);
+        HM_GET_LONG(node_cb->group, node_update->node_group);
+        HM_GET_LONG(node_cb->role, node_update->node_role);
+        HM_GET_LONG(status, node_update->status);
+        HM_GET_LONG(version, node_update->version);
+        hm_cluster_accept_version(loc_cb, &node_cb->version, version,
+                                  &node_cb->hlc, hlc);
+        node_cb->reported_status = status;
+
+        if (status == HM_PEER_ENTITY_STATUS_ACTIVE)
+        {
+          TRACE_DETAIL(("Node %d has become active.", node_id));
+          node_cb->fsm_state = HM_NODE_FSM_STATE_ACTIVE;
+        }
+        else
+        {
+          node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
+        }
+
+        /***************************************************************************/
+        /* Add node to system                             */
+        /***************************************************************************/
+        if (hm_node_add(node_cb, loc_cb) != HM_OK)
+        {
+          TRACE_ERROR(("Error adding node to system."));
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        /***************************************************************************/
+        /* We've parsed the whole thing. No need to go any further with this msg.  */
+        /***************************************************************************/
+        break;
+      }
+
+      HM_GET_LONG(status, node_update->status);
+      HM_GET_LONG(version, node_update->version);
+
+      if (!hm_cluster_accept_version(loc_cb, &node_cb->version, version,
+                                     &node_cb->hlc, hlc))
+      {
+        TRACE_DETAIL(("Update of Node %d is older than what we have.", node_id));
+        break;
+      }
+
+      node_cb->reported_status = status;
+      hm_cluster_apply_node_status(node_cb, status);
+      break;
+
+    case HM_PEER_MSG_TYPE_PROCESS_UPDATE:
+      TRACE_DETAIL(("Received Process Update Message"));
+      /***************************************************************************/
+      /* Location cannot be inactive while getting a process update         */
+      /***************************************************************************/
+      TRACE_ASSERT(tprt_cb->location_cb->fsm_state
+                   == HM_PEER_FSM_STATE_ACTIVE);
+      proc_update = (HM_PEER_MSG_PROCESS_UPDATE *)tprt_cb->in_buffer;
+      /***************************************************************************/
+      /* Find the node_cb in HM                           */
+      /***************************************************************************/
+      HM_GET_LONG(node_id, proc_update->node_id);
+      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
+                                           &node_id,
+                                           nodes_tree_by_node_id);
+
+      if (node_cb == NULL)
+      {
+        TRACE_ERROR(("Node %d does not exist in DB and its update was received.",
+                     node_id));
+        ret_val = HM_ERR;
+        break;
+      }
+
+      HM_GET_LONG(proc_key[0], proc_update->proc_type);
+      HM_GET_LONG(proc_key[1], proc_update->proc_id);
+
+      /***************************************************************************/
+      /* Find the Process in the Nodes tree                     */
+      /***************************************************************************/
+      proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIND(node_cb->process_tree,
+                                              &proc_key,
+                                              node_process_tree_by_proc_type_and_pid);
+
+      if (proc_cb == NULL)
+      {
+        TRACE_WARN(("Process CB not found!"));
+        proc_cb = hm_alloc_process_cb();
+
+        if (proc_cb == NULL)
+        {
+          TRACE_ERROR(("Error allocating memory for Process CBs"));
+          /***************************************************************************/
+          /* Maybe, try again later?                           */
+          /***************************************************************************/
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        /***************************************************************************/
+        /* Find a node_cb                               */
+        /***************************************************************************/
+
+        proc_cb->parent_node_cb = node_cb;
+        proc_cb->pid =  proc_key[1];
+        proc_cb->type = proc_key[0];
+
+        HM_GET_LONG(status, proc_update->status);
+        HM_GET_LONG(version, proc_update->version);
+        hm_cluster_accept_version(loc_cb, &proc_cb->version, version,
+                                  &proc_cb->hlc, hlc);
+        proc_cb->reported_status = status;
+
+        if (status == HM_PEER_ENTITY_STATUS_ACTIVE)
+        {
+          TRACE_DETAIL(("Proces is active"));
+          proc_cb->running = TRUE;
+          //TODO: Let remote nodes also be managed by the same FSM
+          //hm_node_fsm(HM_NODE_FSM_TERM, node_cb);
+        }
+        else
+        {
+          TRACE_DETAIL(("Process is not running."));
+          proc_cb->running = FALSE;
+        }
+
+        if (hm_process_add(proc_cb, proc_cb->parent_node_cb) != HM_OK)
+        {
+          TRACE_ERROR(("Error occurred while adding process info to HM."));
+          hm_free_process_cb(proc_cb);
+          proc_cb = NULL;
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        TRACE_DETAIL(("Added Process!"));
+        break;
+      }
+
+      /***************************************************************************/
+      /* Found Process CB                                 */
+      /***************************************************************************/
+      HM_GET_LONG(status, proc_update->status);
+      HM_GET_LONG(version, proc_update->version);
+
+      if (!hm_cluster_accept_version(loc_cb, &proc_cb->version, version,
+                                     &proc_cb->hlc, hlc))
+      {
+        TRACE_DETAIL(("Update of Process %d is older than what we have.",
+                      proc_key[1]));
+        break;
+      }
+
+      proc_cb->reported_status = status;
+      hm_cluster_apply_process_status(proc_cb, status);
+      break;
+
+    case HM_PEER_MSG_TYPE_HA_UPDATE:
+      TRACE_DETAIL(("Received HA Update Message"));
+      msg = (HM_MSG *)tprt_cb->in_buffer;
+
+      if (hm_cluster_recv_ha_update((HM_PEER_MSG_HA_UPDATE *)msg, loc_cb) != HM_OK)
+      {
+        TRACE_ERROR(("Error processing HA Update!"));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      break;
+
+    case HM_PEER_MSG_TYPE_BINDING:
+      TRACE_DETAIL(("Received Subscription binding message"));
+      msg = (HM_MSG *)tprt_cb->in_buffer;
+      HM_GET_LONG(num_entries, ((HM_PEER_MSG_BINDING *)msg)->num_bindings);
+
+      if ((tprt_cb->in_bytes < (int32_t)HM_PEER_BINDING_MSG_SIZE(0)) ||
+          (num_entries > (tprt_cb->in_bytes - HM_PEER_BINDING_MSG_SIZE(0)) /
+                                                   sizeof(HM_PEER_BINDING_CB)))
+      {
+        TRACE_ERROR(("Binding message of %d bytes cannot carry %d bindings",
+                     tprt_cb->in_bytes, num_entries));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      if (hm_cluster_recv_binding((HM_PEER_MSG_BINDING *)msg, loc_cb) != TRUE)
+      {
+        TRACE_ERROR(("Error processing Subscription bidning!"));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      break;
+
+    case HM_PEER_MSG_TYPE_DIGEST:
+      TRACE_DETAIL(("Received Digest message"));
+      msg = (HM_MSG *)tprt_cb->in_buffer;
+      HM_GET_LONG(num_entries, ((HM_PEER_MSG_DIGEST *)msg)->num_entries);
+
+      if ((tprt_cb->in_bytes < (int32_t)HM_PEER_DIGEST_MSG_SIZE(0)) ||
+          (num_entries > (tprt_cb->in_bytes - HM_PEER_DIGEST_MSG_SIZE(0)) /
+                                                 sizeof(HM_PEER_DIGEST_ENTRY)))
+      {
+        TRACE_ERROR(("Digest message of %d bytes cannot carry %d entries",
+                     tprt_cb->in_bytes, num_entries));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      if ((ret_val = hm_cluster_recv_digest((HM_PEER_MSG_DIGEST *)msg, loc_cb))
+                                                                    != HM_OK)
+      {
+        TRACE_ERROR(("Error processing Digest message."));
+        goto EXIT_LABEL;
+      }
+
+      break;
+
+    case HM_PEER_MSG_TYPE_INTEREST:
+      TRACE_DETAIL(("Received Interest message"));
+      msg = (HM_MSG *)tprt_cb->in_buffer;
+      HM_GET_LONG(num_entries, ((HM_PEER_MSG_INTEREST *)msg)->num_types);
+
+      if ((num_entries > HM_PEER_MAX_INTERESTS) ||
+          (tprt_cb->in_bytes < (int32_t)HM_PEER_INTEREST_MSG_SIZE(num_entries)))
+      {
+        TRACE_ERROR(("Interest message of %d bytes cannot carry %d types",
+                     tprt_cb->in_bytes, num_entries));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      hm_cluster_recv_interest((HM_PEER_MSG_INTEREST *)msg, loc_cb);
+      break;
+
+    case HM_PEER_MSG_TYPE_RELAY:
+      TRACE_DETAIL(("Received Relay message"));
+      msg = (HM_MSG *)tprt_cb->in_buffer;
+      HM_GET_LONG(num_entries, ((HM_PEER_MSG_RELAY *)msg)->replay.num_tlvs);
+
+      if ((tprt_cb->in_bytes < (int32_t)HM_PEER_RELAY_MSG_SIZE(0)) ||
+          (num_entries > (tprt_cb->in_bytes - HM_PEER_RELAY_MSG_SIZE(0)) /
+                                                   sizeof(HM_PEER_REPLAY_TLV)))
+      {
+        TRACE_ERROR(("Relay of %d bytes cannot carry %d TLVs",
+                     tprt_cb->in_bytes, num_entries));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      if ((ret_val = hm_cluster_recv_relay((HM_PEER_MSG_RELAY *)msg, loc_cb))
+                                                                    != HM_OK)
+      {
+        TRACE_ERROR(("Error processing Relay message."));
+        goto EXIT_LABEL;
+      }
+
+      break;
+
+    default:
+      TRACE_WARN(("Unknown Message type."));
+      TRACE_ASSERT(FALSE);
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_receive_cluster_message */
+
+
+/**
+ *  @brief Processes an incoming Replay Message
+ *
+ *  Entries we already know of are updated in place; a partial replay may also
+ *  carry processes that are no longer running. At the end of a partial
+ *  replay, entries it did not touch are restored to their last known status.
+ *
+ *  @param *msg an #HM_PEER_MSG_REPLAY type message received on Transport
+ *  @param *loc_cb Location Control Block (#HM_LOCATION_CB) of the Location from
+ *  where message was received.
+ *
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_process_replay(HM_PEER_MSG_REPLAY *msg,
+                                  HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  int32_t end = FALSE;
+
+  int32_t tlv_type, num_tlvs = 0;
+
+  /***************************************************************************/
+  /* Use of i is necessary. We MUST traverse update in order only. Process   */
+  /* updates before nodes will fail if nodes do not exist.           */
+  /***************************************************************************/
+  int32_t node_id, i;
+  int32_t proc_key[2];
+  uint32_t since, version, status, running;
+  uint64_t hlc;
+
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_GET_LONG(end, msg->last);
+
+  if (end)
+  {
+    TRACE_DETAIL(("End of replay message received."));
+    HM_GET_LONG(since, msg->since);
+    HM_GET_LONG(version, msg->version);
+
+    if (since != 0)
+    {
+      TRACE_DETAIL(("Replay had changes after version %d only.", since));
+      hm_cluster_restore_location(loc_cb, since);
+    }
+
+    /***************************************************************************/
+    /* We now have everything of the peer up to the version it replayed.     */
+    /***************************************************************************/
+    if (version > loc_cb->version)
+    {
+      loc_cb->version = version;
+    }
+    TRACE_DETAIL(("Location %d is at version %d", loc_cb->index,
+                  loc_cb->version));
+    loc_cb->replay_in_progress = FALSE;
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* We expect more messages. Parse the current one               */
+  /***************************************************************************/
+  HM_GET_LONG(num_tlvs, msg->num_tlvs);
+  TRACE_DETAIL(("%d TLVs present.", num_tlvs));
+
+  for (i = 0; i < num_tlvs; i++)
+  {
+    HM_GET_LONG(tlv_type, msg->tlv[i].update_type);
+    HM_GET_LONG(version, msg->tlv[i].version);
+    hlc = hm_hlc_get(msg->tlv[i].hlc);
+
+    switch (tlv_type)
+    {
+      case HM_PEER_REPLAY_UPDATE_TYPE_NODE:
+        TRACE_DETAIL(("Node Update"));
+        HM_GET_LONG(node_id, msg->tlv[i].node_id);
+        HM_GET_LONG(running, msg->tlv[i].running);
+        status = (running == HM_NODE_FSM_STATE_ACTIVE) ?
+            HM_PEER_ENTITY_STATUS_ACTIVE : HM_PEER_ENTITY_STATUS_INACTIVE;
+
+        node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
+                                             &node_id,
+                                             nodes_tree_by_node_id);
+
+        if (node_cb != NULL)
+        {
+          TRACE_DETAIL(("Node %d is known. Update it.", node_id));
+
+          if (!hm_cluster_accept_version(loc_cb, &node_cb->version, version,
+                                         &node_cb->hlc, hlc))
+          {
+            TRACE_DETAIL(("Replay of Node %d is older than what we have.", node_id));
+            break;
+          }
+
+          HM_GET_LONG(node_cb->current_role, msg->tlv[i].role);
+          node_cb->reported_status = status;
+          running = (node_cb->fsm_state == HM_NODE_FSM_STATE_ACTIVE) ?
+              HM_PEER_ENTITY_STATUS_ACTIVE : HM_PEER_ENTITY_STATUS_INACTIVE;
+
+          if (running != status)
+          {
+            hm_cluster_apply_node_status(node_cb, status);
+          }
+
+          break;
+        }
+
+        node_cb = hm_alloc_node_cb(FALSE);
+
+        if (node_cb == NULL)
+        {
+          TRACE_ERROR(("Error allocating memory for Remote Node"));
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        node_cb->index = node_id;
+        TRACE_DETAIL(("Node ID: %d", node_cb->index));
+        HM_GET_LONG(node_cb->group, msg->tlv[i].group);
+        TRACE_DETAIL(("Node group: %d", node_cb->group));
+        HM_GET_LONG(node_cb->current_role, msg->tlv[i].role);
+        TRACE_DETAIL(("Node Role: %s",
+                  (node_cb->current_role==NODE_ROLE_ACTIVE)?"ACTIVE": "PASSIVE"));
+        node_cb->fsm_state = running;
+        hm_cluster_accept_version(loc_cb, &node_cb->version, version,
+                                  &node_cb->hlc, hlc);
+        node_cb->reported_status = status;
+
+        if (node_cb->fsm_state != HM_NODE_FSM_STATE_ACTIVE)
+        {
+          TRACE_DETAIL(("Remote node not yet active. Do not trigger subscriptions yet!"));
+          node_cb->fsm_state =
+            HM_NODE_FSM_STATE_WAITING;/* It may or may not succeed. */
+        }
+
+        /***************************************************************************/
+        /* Add node to system                             */
+        /***************************************************************************/
+        if (hm_node_add(node_cb, loc_cb) != HM_OK)
+        {
+          TRACE_ERROR(("Error adding node to system."));
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        /***************************************************************************/
+        /* Resolve active-backup if we have suitable candidates                    */
+        /***************************************************************************/
+        hm_ha_resolve_active_backup(node_cb);
+        break;
+
+      case HM_PEER_REPLAY_UPDATE_TYPE_PROC:
+        TRACE_DETAIL(("Process Update"));
+        HM_GET_LONG(node_id, msg->tlv[i].node_id);
+        /***************************************************************************/
+        /* Find the node first                             */
+        /***************************************************************************/
+        node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
+                                             &node_id,
+                                             nodes_tree_by_node_id);
+
+        if (node_cb == NULL)
+        {
+          TRACE_ERROR(("Could not find node in Location CB. Out of Order Replays?"));
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        HM_GET_LONG(proc_key[0], msg->tlv[i].group);
+        HM_GET_LONG(proc_key[1], msg->tlv[i].pid);
+        HM_GET_LONG(running, msg->tlv[i].running);
+        status = (running == TRUE) ?
+            HM_PEER_ENTITY_STATUS_ACTIVE : HM_PEER_ENTITY_STATUS_INACTIVE;
+
+        proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIND(node_cb->process_tree,
+                                                &proc_key,
+                                                node_process_tree_by_proc_type_and_pid);
+
+        if (proc_cb != NULL)
+        {
+          TRACE_DETAIL(("Process %d is known. Update it.", proc_key[1]));
+
+          if (!hm_cluster_accept_version(loc_cb, &proc_cb->version, version,
+                                         &proc_cb->hlc, hlc))
+          {
+            TRACE_DETAIL(("Replay of Process %d is older than what we have.",
+                          proc_key[1]));
+            break;
+          }
+
+          proc_cb->reported_status = status;
+
+          if (proc_cb->running != running)
+          {
+            hm_cluster_apply_process_status(proc_cb, status);
+          }
+
+          break;
+        }
+
+        if (running != TRUE)
+        {
+          TRACE_DETAIL(("Process %d stopped before we knew of it.", proc_key[1]));
+          break;
+        }
+
+        TRACE_DETAIL(("Found Node. Update Process Entries"));
+        proc_cb = hm_alloc_process_cb();
+
+        if (proc_cb == NULL)
+        {
+          TRACE_ERROR(("Error allocating memory for Process CBs"));
+          /***************************************************************************/
+          /* Maybe, try again later?                           */
+          /***************************************************************************/
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        /***************************************************************************/
+        /* Find a node_cb                               */
+        /***************************************************************************/
+
+        proc_cb->parent_node_cb = node_cb;
+        proc_cb->type = proc_key[0];
+        proc_cb->pid = proc_key[1];
+        proc_cb->running = TRUE;
+        hm_cluster_accept_version(loc_cb, &proc_cb->version, version,
+                                  &proc_cb->hlc, hlc);
+        proc_cb->reported_status = status;
+
+        if (hm_process_add(proc_cb, proc_cb->parent_node_cb) != HM_OK)
+        {
+          TRACE_ERROR(("Error occurred while adding process info to HM."));
+          hm_free_process_cb(proc_cb);
+          proc_cb = NULL;
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+
+        TRACE_DETAIL(("Added Process!"));
+        break;
+
+      default:
+        TRACE_DETAIL(("Unknown type %d", tlv_type));
+        TRACE_ASSERT(FALSE);
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_process_replay */
+
+/**
+ *  @brief Checks the version of an incoming change to a peer's entity and records it
+ *
+ *  A change older than what we hold by either its version or its clock is
+ *  discarded, whether it came in a replay or live.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer which sent the change
+ *  @param *entity_version Version of the entity as we know it. Updated if accepted.
+ *  @param version Version carried by the change. 0 if the peer did not stamp it.
+ *  @param *entity_hlc Hybrid logical clock of the entity's last change we applied.
+ *  Updated if accepted.
+ *  @param hlc Hybrid logical clock of the change. 0 if the peer did not stamp it.
+ *  @return TRUE if the change must be applied, FALSE if it is older than what we have
+ */
+uint32_t hm_cluster_accept_version(HM_LOCATION_CB *loc_cb,
+                                   uint32_t *entity_version, uint32_t version,
+                                   uint64_t *entity_hlc, uint64_t hlc)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t accept = TRUE;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(entity_version != NULL);
+  TRACE_ASSERT(entity_hlc != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if ((hlc != 0) && (hlc <= *entity_hlc))
+  {
+    TRACE_DETAIL(("Change at clock 0x%llx is not newer than 0x%llx.",
+                  (unsigned long long)hlc, (unsigned long long)*entity_hlc));
+    accept = FALSE;
+    goto EXIT_LABEL;
+  }
+
+  if ((version != 0) && (version <= *entity_version))
+  {
+    TRACE_DETAIL(("Version %d is not newer than %d.", version, *entity_version));
+    accept = FALSE;
+    goto EXIT_LABEL;
+  }
+
+  if (hlc != 0)
+  {
+    *entity_hlc = hlc;
+  }
+
+  if (version == 0)
+  {
+    TRACE_DETAIL(("Unversioned change. Apply."));
+    goto EXIT_LABEL;
+  }
+
+  *entity_version = version;
+
+  /***************************************************************************/
+  /* Peer stamps and sends its changes in order, so this is also the highest */
+  /* version of its tables we have. A replay is not in order: it counts only */
+  /* once it has ended.                             */
+  /***************************************************************************/
+  if ((version > loc_cb->version) && (!loc_cb->replay_in_progress))
+  {
+    loc_cb->version = version;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (accept);
+}/* hm_cluster_accept_version */
+
+
+/**
+ *  @brief Applies the status reported by a peer to one of its nodes
+ *
+ *  @param *node_cb Node CB (#HM_NODE_CB) of the remote node
+ *  @param status #HM_PEER_ENTITY_STATUS_ACTIVE or #HM_PEER_ENTITY_STATUS_INACTIVE
+ *  @return @c void
+ */
+void hm_cluster_apply_node_status(HM_NODE_CB *node_cb, uint32_t status)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(node_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  TRACE_DETAIL(("Current state of node: %d", node_cb->fsm_state));
+
+  if ((status == HM_PEER_ENTITY_STATUS_ACTIVE) &&
+      (node_cb->fsm_state != HM_NODE_FSM_STATE_ACTIVE))
+  {
+    TRACE_DETAIL(("Node %d has become active.", node_cb->index));
+    node_cb->fsm_state = HM_NODE_FSM_STATE_ACTIVE;
+    TRACE_ASSERT(node_cb->parent_location_cb->active_nodes >= 0);
+    node_cb->parent_location_cb->active_nodes++;
+    //TODO: Let remote nodes also be managed by the same FSM
+    //hm_node_fsm(HM_NODE_FSM_TERM, node_cb);
+  }
+  else if ((status == HM_PEER_ENTITY_STATUS_ACTIVE) &&
+           (node_cb->fsm_state == HM_NODE_FSM_STATE_ACTIVE))
+  {
+    TRACE_DETAIL(("Node %d has become active. But we know it already",
+                  node_cb->index));
+  }
+  else if ((status == HM_PEER_ENTITY_STATUS_INACTIVE) &&
+           (node_cb->fsm_state == HM_NODE_FSM_STATE_WAITING))
+  {
+    TRACE_DETAIL(("Node %d has failed to start.", node_cb->index));
+    node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
+  }
+  else if ((status == HM_PEER_ENTITY_STATUS_INACTIVE) &&
+           (node_cb->fsm_state != HM_NODE_FSM_STATE_FAILED))
+  {
+    TRACE_DETAIL(("Node %d has failed.", node_cb->index));
+    node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
+    node_cb->parent_location_cb->active_nodes--;
+  }
+  else if ((status == HM_PEER_ENTITY_STATUS_INACTIVE) &&
+           (node_cb->fsm_state == HM_NODE_FSM_STATE_FAILED))
+  {
+    TRACE_DETAIL(("Node %d has failed. But we know it already", node_cb->index));
+  }
+  else
+  {
+    TRACE_DETAIL(("Something happened to Node %d, but fail anyway.",
+                  node_cb->index));
+    node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
+    node_cb->parent_location_cb->active_nodes--;
+  }
+
+  hm_global_node_update(node_cb, HM_UPDATE_RUN_STATUS);
+  if(node_cb->fsm_state == HM_NODE_FSM_STATE_FAILING)
+  {
+    /* FIXME: Added later to avoid multiple receive of same notification. */
+    node_cb->fsm_state = HM_NODE_FSM_STATE_FAILED;
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_apply_node_status */
+
+
+/**
+ *  @brief Applies the status reported by a peer to one of its processes
+ *
+ *  @param *proc_cb Process CB (#HM_PROCESS_CB) of the remote process
+ *  @param status #HM_PEER_ENTITY_STATUS_ACTIVE or #HM_PEER_ENTITY_STATUS_INACTIVE
+ *  @return @c void
+ */
+void hm_cluster_apply_process_status(HM_PROCESS_CB *proc_cb, uint32_t status)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(proc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (status == HM_PEER_ENTITY_STATUS_ACTIVE)
+  {
+    TRACE_DETAIL(("Process %d has become active.", proc_cb->pid));
+    proc_cb->running = TRUE;
+    //TODO: Let remote nodes also be managed by the same FSM
+    //hm_node_fsm(HM_NODE_FSM_TERM, node_cb);
+  }
+  else
+  {
+    TRACE_DETAIL(("Process %d is not running.", proc_cb->pid));
+    proc_cb->running = FALSE;
+  }
+
+  hm_process_update(proc_cb);
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_apply_process_status */
+
+
+/**
+ *  @brief Restores the entries of a peer that a partial replay did not touch
+ *
+ *  When a peer goes down, all its nodes and processes are marked down here.
+ *  A partial replay on its return only carries what changed in between; the
+ *  rest is brought back to the status the peer last reported for it.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param since Version after which the peer replayed its changes
+ *  @return @c void
+ */
+void hm_cluster_restore_location(HM_LOCATION_CB *loc_cb, uint32_t since)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  uint32_t active;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(loc_cb->node_tree,
+                 nodes_tree_by_node_id);
+       node_cb != NULL;
+       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                 nodes_tree_by_node_id))
+  {
+    if (node_cb->version <= since)
+    {
+      active = (node_cb->fsm_state == HM_NODE_FSM_STATE_ACTIVE) ?
+            HM_PEER_ENTITY_STATUS_ACTIVE : HM_PEER_ENTITY_STATUS_INACTIVE;
+
+      if (active != node_cb->reported_status)
+      {
+        TRACE_DETAIL(("Restore Node %d", node_cb->index));
+        hm_cluster_apply_node_status(node_cb, node_cb->reported_status);
+      }
+    }
+
+    for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                   node_process_tree_by_proc_type_and_pid);
+         proc_cb != NULL;
+         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                   node_process_tree_by_proc_type_and_pid))
+    {
+      if (proc_cb->version > since)
+      {
+        continue;
+      }
+
+      active = (proc_cb->running == TRUE) ?
+            HM_PEER_ENTITY_STATUS_ACTIVE : HM_PEER_ENTITY_STATUS_INACTIVE;
+
+      if (active != proc_cb->reported_status)
+      {
+        TRACE_DETAIL(("Restore Process %d", proc_cb->pid));
+        hm_cluster_apply_process_status(proc_cb, proc_cb->reported_status);
+      }
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_restore_location */
+
+
+/**
+ *  @brief Sends out an update on the status of this entry in DB
+ *
+ *  @param *cb Control block for which Update needs to be sent.
+ *  It is of type @c void to allow some polymorphism in the type of Control Blocks
+ *
+ *  @return HM_OK if successful, HM_ERR otherwise.
+ */
+int32_t hm_cluster_send_update(void *cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_SUBSCRIBER glob_cb;
+
+  HM_GLOBAL_LOCATION_CB *loc_cb;
+
+  HM_PEER_MSG_NODE_UPDATE *node_update = NULL;
+  HM_PEER_MSG_PROCESS_UPDATE *proc_update = NULL;
+
+  HM_MSG *msg = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  glob_cb.void_cb = cb;
+
+  /***************************************************************************/
+  /* Only an aggregator has updates of other locations to send. It passes  */
+  /* them on as it holds them.                         */
+  /***************************************************************************/
+  if (hm_global_is_remote(cb))
+  {
+    ret_val = hm_cluster_relay_update(cb);
+    goto EXIT_LABEL;
+  }
+
+  /* Value at address saved at memory location(
+   *    treating the pointer as that of a uint32_t(
+   *      treating the pointer cb as a byte, advance it by sizeof uint32_t
+   *      )
+   *    )
+   */
+  switch (*(uint32_t *)((char *)cb + sizeof(uint32_t)))
+  {
+    case HM_TABLE_TYPE_NODES:
+      TRACE_DETAIL(("Nodes Table Update"));
+      msg = hm_get_buffer(sizeof(HM_PEER_MSG_NODE_UPDATE));
+
+      if (msg == NULL)
+      {
+        TRACE_ERROR(("Error allocating buffer for Node Update"));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      node_update = (HM_PEER_MSG_NODE_UPDATE *)msg->msg;
+      memset(node_update, 0, sizeof(HM_PEER_MSG_NODE_UPDATE));
+      HM_PUT_LONG(node_update->hdr.hw_id, LOCAL.local_location_cb.index);
+      HM_PUT_LONG(node_update->hdr.msg_type, HM_PEER_MSG_TYPE_NODE_UPDATE);
+      HM_PUT_LONG(node_update->hdr.timestamp, 0);
+      HM_PUT_LONG(node_update->hdr.msg_len, sizeof(HM_PEER_MSG_NODE_UPDATE));
+
+      HM_PUT_LONG(node_update->node_group, glob_cb.node_cb->group_index);
+      HM_PUT_LONG(node_update->node_id, glob_cb.node_cb->index);
+      HM_PUT_LONG(node_update->node_role, glob_cb.node_cb->role);
+
+      /***************************************************************************/
+      /* Stamp the change as it goes out, so that peers see versions in order.  */
+      /***************************************************************************/
+      glob_cb.node_cb->node_cb->version = ++LOCAL.local_location_cb.version;
+      HM_PUT_LONG(node_update->version, glob_cb.node_cb->node_cb->version);
+      glob_cb.node_cb->node_cb->hlc = hm_hlc_now();
+      hm_hlc_put(node_update->hdr.timestamp, glob_cb.node_cb->node_cb->hlc);
+
+      if (glob_cb.node_cb->status == HM_NODE_FSM_STATE_ACTIVE)
+      {
+        HM_PUT_LONG(node_update->status, HM_PEER_ENTITY_STATUS_ACTIVE);
+      }
+      else
+      {
+        HM_PUT_LONG(node_update->status, HM_PEER_ENTITY_STATUS_INACTIVE);
+      }
+
+      break;
+
+    case HM_TABLE_TYPE_PROCESS:
+      TRACE_DETAIL(("Processes Table"));
+      msg = hm_get_buffer(sizeof(HM_PEER_MSG_PROCESS_UPDATE));
+
+      if (msg == NULL)
+      {
+        TRACE_ERROR(("Error allocating buffer for Process Update"));
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+
+      proc_update = (HM_PEER_MSG_PROCESS_UPDATE *)msg->msg;
+      memset(proc_update, 0, sizeof(HM_PEER_MSG_PROCESS_UPDATE));
+      HM_PUT_LONG(proc_update->hdr.hw_id, LOCAL.local_location_cb.index);
+      HM_PUT_LONG(proc_update->hdr.msg_type, HM_PEER_MSG_TYPE_PROCESS_UPDATE);
+      HM_PUT_LONG(proc_update->hdr.timestamp, 0);
+      HM_PUT_LONG(proc_update->hdr.msg_len, sizeof(HM_PEER_MSG_PROCESS_UPDATE));
+
+      HM_PUT_LONG(proc_update->proc_type, glob_cb.process_cb->type);
+      HM_PUT_LONG(proc_update->proc_id, glob_cb.process_cb->pid);
+      HM_PUT_LONG(proc_update->node_id, glob_cb.process_cb->node_index);
+
+      glob_cb.process_cb->proc_cb->version = ++LOCAL.local_location_cb.version;
+      HM_PUT_LONG(proc_update->version, glob_cb.process_cb->proc_cb->version);
+      glob_cb.process_cb->proc_cb->hlc = hm_hlc_now();
+      hm_hlc_put(proc_update->hdr.timestamp, glob_cb.process_cb->proc_cb->hlc);
+
+      if (glob_cb.process_cb->status == TRUE)
+      {
+        HM_PUT_LONG(proc_update->status, HM_PEER_ENTITY_STATUS_ACTIVE);
+      }
+      else
+      {
+        HM_PUT_LONG(proc_update->status, HM_PEER_ENTITY_STATUS_INACTIVE);
+      }
+
+      break;
+
+    case HM_TABLE_TYPE_LOCATION:
+      TRACE_DETAIL(("Location Table"));
+
+      break;
+
+    case HM_TABLE_TYPE_NODES_LOCAL:
+      TRACE_ERROR(("Local Node Structure. Find its Global Entry."));
+      TRACE_ASSERT(FALSE);
+      break;
+
+    case HM_TABLE_TYPE_LOCATION_LOCAL:
+      TRACE_ERROR(("Local Location Structure. Find its Global Entry."));
+      TRACE_ASSERT(FALSE);
+      break;
+
+    case HM_TABLE_TYPE_PROCESS_LOCAL:
+      TRACE_ERROR(("Local Process Structure. Find its Global Entry."));
+      TRACE_ASSERT(FALSE);
+      break;
+
+    default:
+      TRACE_WARN(("Unknown type of subscriber"));
+      TRACE_ASSERT((FALSE));
+  }
+
+  if (msg != NULL)
+  {
+    TRACE_DETAIL(("Try to send message to cluster."));
+
+    /***************************************************************************/
+    /* Later, it might be sending update only on the multicast port, but right */
+    /* now, we must loop through all Location CBs and send to each if its      */
+    /* connection in active.                           */
+    /***************************************************************************/
+    for (loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                  locations_tree_by_db_id);
+         loc_cb != NULL;
+         loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(loc_cb->node,
+                  locations_tree_by_db_id))
+    {
+      if (loc_cb->loc_cb->index == LOCAL.local_location_cb.index)
+      {
+        /***************************************************************************/
+        /* Don't send to itself!                           */
+        /***************************************************************************/
+        continue;
+      }
+
+      if (loc_cb->loc_cb->peer_listen_cb == NULL ||
+          loc_cb->loc_cb->peer_listen_cb->sock_cb == NULL ||
+          loc_cb->loc_cb->peer_listen_cb->sock_cb->sock_fd == -1)
+      {
+        /***************************************************************************/
+        /* Peer is not connected.                           */
+        /***************************************************************************/
+        TRACE_DETAIL(("Skipping %d", loc_cb->index));
+        continue;
+      }
+
+      if ((loc_cb->loc_cb->replay.stage != HM_REPLAY_STAGE_IDLE) &&
+          (loc_cb->loc_cb->replay.num_passes < HM_REPLAY_MAX_PASSES))
+      {
+        /***************************************************************************/
+        /* A replay is under way to the peer. The change is stamped newer than */
+        /* its pass, so the pass after it carries the change. The last pass    */
+        /* has none after it, so changes during it are sent right away.     */
+        /***************************************************************************/
+        TRACE_DETAIL(("Location %d is being replayed to. Update deferred.",
+                      loc_cb->loc_cb->index));
+        continue;
+      }
+
+      if ((proc_update != NULL) &&
+          (!hm_cluster_peer_wants(loc_cb->loc_cb, glob_cb.process_cb->type)))
+      {
+        /***************************************************************************/
+        /* Peer has no subscribers for this process. Nodes go to all peers, since */
+        /* HA roles and the processes on them depend on them.          */
+        /***************************************************************************/
+        TRACE_DETAIL(("Location %d has no interest in Process type %d",
+                      loc_cb->loc_cb->index, glob_cb.process_cb->type));
+        continue;
+      }
+
+      ret_val = hm_cluster_send_sequenced(msg, loc_cb->loc_cb, HM_PRIORITY_NODE);
+    }
+
+    /***************************************************************************/
+    /* We've sent/queued message on all transports. Release buffer on our side */
+    /***************************************************************************/
+    hm_free_buffer(msg);
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_send_update */
+
+/**
+ *  hm_cluster_exchange_binding
+ *  @brief Sends out subscription bindings on the cluster
+ *
+ *  Each message carries as many bindings as fit in the smallest frame size
+ *  agreed with the peers, since the same message goes to all of them.
+ *
+ *  @param *src_cb A global table entry pointer for the local entity which subscribed.
+ *  @param num_bindings Number of bindings to be propagated
+ *  @param *reg_msg Register Message from which to extract requests
+ *
+ *  @return Nothing
+ */
+void hm_cluster_exchange_binding(void *cb, uint32_t num_bindings,
+                                 void *reg_msg)
+{
+  /***************************************************************************/
+  /* Local Variables                                                         */
+  /***************************************************************************/
+  HM_PEER_MSG_BINDING *bind_msg = NULL;
+  HM_PEER_BINDING_CB *binding_cb = NULL;
+  HM_REGISTER_TLV_CB *tlv = NULL;
+  uint32_t i = 0;
+  int32_t subscriber_type, reqd;
+  HM_SUBSCRIBER subscriber;
+
+  uint32_t packed = 0, total_packed = 0;
+  uint32_t max_bindings = 0, to_pack = 0;
+
+  HM_MSG *msg = NULL;
+  HM_GLOBAL_LOCATION_CB *loc_cb;
+  /***************************************************************************/
+  /* Sanity Checks                                                           */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(cb != NULL);
+  TRACE_ASSERT(reg_msg != NULL);
+  TRACE_ASSERT(num_bindings > 0);
+
+  /***************************************************************************/
+  /* Main Routine                                                            */
+  /***************************************************************************/
+  max_bindings = (hm_cluster_frame_size(NULL) - HM_PEER_BINDING_MSG_SIZE(0)) /
+                                                    sizeof(HM_PEER_BINDING_CB);
+
+  reqd = (num_bindings + max_bindings - 1) / max_bindings;
+
+  TRACE_DETAIL(("Require %d messages of upto %d bindings", reqd, max_bindings));
+  /* Determine subscriber type to set subscriber ID */
+  subscriber_type = *(int32_t *)((char *)cb + (uint32_t)(sizeof(int32_t)));
+  subscriber.void_cb = cb;
+
+  /***************************************************************************/
+  /* Each peer binds its own entities to the subscriber and notifies them of */
+  /* its changes, so it must know the subscriber, even if it has no         */
+  /* subscribers for processes of its type.                    */
+  /***************************************************************************/
+  if (subscriber_type == HM_TABLE_TYPE_PROCESS_LOCAL)
+  {
+    for (loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                  locations_tree_by_db_id);
+         loc_cb != NULL;
+         loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(loc_cb->node,
+                  locations_tree_by_db_id))
+    {
+      if ((loc_cb->loc_cb->index == LOCAL.local_location_cb.index) ||
+          (loc_cb->loc_cb->peer_listen_cb == NULL) ||
+          (loc_cb->loc_cb->peer_listen_cb->sock_cb == NULL) ||
+          (loc_cb->loc_cb->peer_listen_cb->sock_cb->sock_fd == -1) ||
+          (hm_cluster_peer_wants(loc_cb->loc_cb,
+                                 subscriber.proper_process_cb->type)))
+      {
+        continue;
+      }
+
+      TRACE_DETAIL(("Location %d does not know Process %d yet", loc_cb->index,
+                    subscriber.proper_process_cb->pid));
+      hm_cluster_send_process(loc_cb->loc_cb, subscriber.proper_process_cb);
+    }
+  }
+
+  while (reqd > 0)
+  {
+    bind_msg = NULL;
+    to_pack = num_bindings - total_packed;
+    if (to_pack > max_bindings)
+    {
+      to_pack = max_bindings;
+    }
+    msg = hm_get_buffer(HM_PEER_BINDING_MSG_SIZE(to_pack));
+
+    if (msg == NULL)
+    {
+      TRACE_ASSERT(msg != NULL);
+      TRACE_ERROR(("Error allocating binding message buffer."));
+      goto EXIT_LABEL;
+    }
+
+    bind_msg = (HM_PEER_MSG_BINDING *)msg->msg;
+
+    memset(bind_msg, 0, HM_PEER_BINDING_MSG_SIZE(to_pack));
+    HM_PUT_LONG(bind_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+    HM_PUT_LONG(bind_msg->hdr.msg_type, HM_PEER_MSG_TYPE_BINDING);
+    HM_PUT_LONG(bind_msg->hdr.timestamp, 0);
+
+    packed = 0;
+
+    switch (subscriber_type)
+    {
+      case HM_TABLE_TYPE_NODES_LOCAL:
+        TRACE_DETAIL(("Local Node Structure."));
+        HM_PUT_LONG(bind_msg->subscriber_nid, subscriber.proper_node_cb->index);
+        HM_PUT_LONG(bind_msg->subscriber_type, HM_PEER_REPLAY_UPDATE_TYPE_NODE);
+        break;
+
+      case HM_TABLE_TYPE_PROCESS_LOCAL:
+        TRACE_DETAIL(("Local Process Structure."));
+        HM_PUT_LONG(bind_msg->subscriber_nid,
+                    subscriber.proper_process_cb->parent_node_cb->index);
+        HM_PUT_LONG(bind_msg->subscriber_pid, subscriber.proper_process_cb->pid);
+        HM_PUT_LONG(bind_msg->subscriber_type, HM_PEER_REPLAY_UPDATE_TYPE_PROC);
+        break;
+
+      default:
+        TRACE_WARN(("Unknown type of subscriber %d", subscriber_type));
+        TRACE_ASSERT((FALSE));
+    }
+
+    binding_cb = bind_msg->bindings;
+
+    while (i < ((HM_REGISTER_MSG *)reg_msg)->num_register
+           && packed < to_pack)
+    {
+      tlv = (HM_REGISTER_TLV_CB *)((HM_REGISTER_MSG *)reg_msg)->data + i;
+
+      if (tlv->cross_bind)
+      {
+        HM_PUT_LONG(binding_cb->subscription_id, tlv->id);
+
+        switch (((HM_REGISTER_MSG *)reg_msg)->type)
+        {
+          case HM_REG_SUBS_TYPE_GROUP:
+            TRACE_DETAIL(("Registering for Node Group"));
+            HM_PUT_LONG(binding_cb->subscription_type, HM_REG_SUBS_TYPE_GROUP);
+            break;
+
+          case HM_REG_SUBS_TYPE_PROC:
+            TRACE_DETAIL(("Registering for Process Types"));
+            HM_PUT_LONG(binding_cb->subscription_type, HM_REG_SUBS_TYPE_PROC);
+            break;
+
+          default:
+            TRACE_ERROR(("Registering for unsupported type: %d",
+                         ((HM_REGISTER_MSG *)reg_msg)->type));
+            TRACE_ASSERT(0 != 0);
+            break;
+        }
+
+        packed++;
+        total_packed++;
+        binding_cb = binding_cb + 1;
+      }
+
+      i++;
+    }
+
+
+    TRACE_DETAIL(("Try to send message to cluster."));
+    HM_PUT_LONG(bind_msg->num_bindings, packed);
+    msg->msg_len = HM_PEER_BINDING_MSG_SIZE(packed);
+    HM_PUT_LONG(bind_msg->hdr.msg_len, msg->msg_len);
+
+    /***************************************************************************/
+    /* Later, it might be sending update only on the multicast port, but right */
+    /* now, we must loop through all Location CBs and send to each if its      */
+    /* connection in active.                           */
+    /***************************************************************************/
+    for (loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                  locations_tree_by_db_id);
+         loc_cb != NULL;
+         loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(loc_cb->node,
+                  locations_tree_by_db_id))
+    {
+      if (loc_cb->loc_cb->index == LOCAL.local_location_cb.index)
+      {
+        /***************************************************************************/
+        /* Don't send to itself!                           */
+        /***************************************************************************/
+        continue;
+      }
+
+      if (loc_cb->loc_cb->peer_listen_cb == NULL ||
+          loc_cb->loc_cb->peer_listen_cb->sock_cb == NULL ||
+          loc_cb->loc_cb->peer_listen_cb->sock_cb->sock_fd == -1)
+      {
+        /***************************************************************************/
+        /* Peer is not connected.                           */
+        /***************************************************************************/
+        TRACE_DETAIL(("Skipping %d", loc_cb->index));
+        continue;
+      }
+
+      hm_cluster_send_sequenced(msg, loc_cb->loc_cb, HM_PRIORITY_NODE);
+    }
+
+    /***************************************************************************/
+    /* We've sent/queued message on all transports. Release buffer on our side */
+    /***************************************************************************/
+    hm_free_buffer(msg);
+    reqd--;
+  }//end while
+
+  if (total_packed != num_bindings)
+  {
+    TRACE_ERROR(("Unequal bindings and packing values."));
+    TRACE_ASSERT(packed == num_bindings);
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                                                       */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+} /* hm_cluster_exchange_binding */
+
+
+/**
+ *  hm_cluster_recv_binding
+ *  @brief Receive a subscription binding from the cluster
+ *
+ *  @param *msg Subscription binding message.
+ *  @return True if successful, else FALSE
+ *
+ *  A subscription binding can never arrive before the create message for the
+ *  entity that generated it was received. Consequently, it is guaranteed that
+ *  the initiator has a cb present here.
+ *
+ *  Proceed from here as if it were a regular subscribe request received from
+ *  a regular local node.
+ */
+uint32_t hm_cluster_recv_binding(HM_PEER_MSG_BINDING *msg,
+                                 HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Local Variables                                                         */
+  /***************************************************************************/
+  uint32_t ret_val = TRUE;
+  uint32_t subscriber_nid, subscriber_type, i, subscriber_pid;
+  uint32_t reg_type, value, num_bindings;
+  HM_SUBSCRIBER subscriber = {0};
+
+  HM_PEER_BINDING_CB *binding_cb = NULL;
+  HM_NODE_CB *node_cb  = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+
+  /***************************************************************************/
+  /* Sanity Checks                                                           */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                                            */
+  /***************************************************************************/
+  HM_GET_LONG(subscriber_nid, msg->subscriber_nid);
+  HM_GET_LONG(subscriber_type, msg->subscriber_type);
+  HM_GET_LONG(num_bindings, msg->num_bindings);
+  HM_GET_LONG(subscriber_pid, msg->subscriber_pid);
+  /* First find the corresponding subscriber. */
+
+  switch (subscriber_type)
+  {
+    case HM_PEER_REPLAY_UPDATE_TYPE_NODE:
+      TRACE_DETAIL(("Node subscriber"));
+      /* There will always be a node */
+      subscriber.node_cb = (HM_GLOBAL_NODE_CB *)HM_AVL3_FIND(LOCAL.nodes_tree,
+                           &subscriber_nid,
+                           nodes_tree_by_db_id);
+
+      if (subscriber.node_cb == NULL)
+      {
+        TRACE_ERROR(("Binding received from a Node that we don't know about!"));
+        TRACE_ASSERT(FALSE);
+      }
+
+      subscriber.proper_node_cb = subscriber.node_cb->node_cb;
+#ifdef I_WANT_TO_DEBUG
+      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
+                                           &subscriber_nid,
+                                           nodes_tree_by_node_id);
+
+      if (node_cb == NULL)
+      {
+        TRACE_ERROR(("Node with index %d not found in location %d", subscriber_nid,
+                     loc_cb->index));
+        TRACE_ASSERT(FALSE);
+      }
+
+      TRACE_ASSERT(node_cb == subscriber.proper_node_cb);
+#endif
+      /********************************************************************//**
+       * Explicitly set void cb so that others do not spend time wasting how
+       * void_cb gets automatically initialized while initalizing proper_node_cb
+       * or proper_process_cb
+       ***********************************************************************/
+      subscriber.void_cb = subscriber.proper_node_cb;
+
+      break;
+
+    case HM_PEER_REPLAY_UPDATE_TYPE_PROC:
+      TRACE_DETAIL(("Process subscriber"));
+      /* Need Proc Type and PID to get the Process CB. Scan Location's Tree */
+      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
+                                           &subscriber_nid,
+                                           nodes_tree_by_node_id);
+
+      if (node_cb == NULL)
+      {
+        TRACE_ERROR(("Node with index %d not found in location %d", subscriber_nid,
+                     loc_cb->index));
+
+        TRACE_ASSERT(FALSE);
+      }
+
+      proc_cb = HM_AVL3_FIRST(node_cb->process_tree,
+                              node_process_tree_by_proc_type_and_pid);
+
+      while (proc_cb != NULL && proc_cb->pid != subscriber_pid)
+      {
+        proc_cb = HM_AVL3_NEXT(proc_cb->node,
+                               node_process_tree_by_proc_type_and_pid);
+      }
+
+      if (proc_cb != NULL)
+      {
+        TRACE_DETAIL(("Found Process CB"));
+        subscriber.proper_process_cb = proc_cb;
+      }
+      else
+      {
+        TRACE_ERROR(("Binding received from a Process that we don't know about!"));
+        TRACE_ASSERT(FALSE);
+      }
+
+      /********************************************************************//**
+       * Explicitly set void cb so that others do not spend time wasting how
+       * void_cb gets automatically initialized while initalizing proper_node_cb
+       * or proper_process_cb
+       ***********************************************************************/
+
+      subscriber.void_cb = subscriber.proper_process_cb;
+      break;
+
+    default:
+      TRACE_ERROR(("Unsupported type: %d", subscriber_type));
+      TRACE_ASSERT(0 != 0);
+      break;
+  }
+
+  for (i = 0; i < num_bindings; i++)
+  {
+    binding_cb = &msg->bindings[i];
+    HM_GET_LONG(reg_type, binding_cb->subscription_type);
+    HM_GET_LONG(value, binding_cb->subscription_id);
+    TRACE_DETAIL(("Registration Type: %d", reg_type));
+    TRACE_DETAIL(("Subscription ID: %d", value));
+
+    /***************************************************************************/
+    /* The peer notifies its subscriber of our entities itself, when our      */
+    /* updates reach it. We bind our entities to the subscriber, and notify   */
+    /* them of its changes when its updates reach us.              */
+    /***************************************************************************/
+    if (hm_subscribe(reg_type, value, subscriber.void_cb, TRUE, NULL) != HM_OK)
+    {
+      TRACE_ERROR(("Error creating subscriptions."));
+      ret_val = FALSE;
+      break;
+    }
+  }
+
+  /***************************************************************************/
+  /* Our entities now hear of this process: we need its updates.       */
+  /***************************************************************************/
+  if (subscriber_type == HM_PEER_REPLAY_UPDATE_TYPE_PROC)
+  {
+    hm_cluster_update_interest();
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                                                       */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+} /* hm_cluster_recv_binding */
+
+
+/**
+ *  @brief Compares digests of the tables with every peer, once in a while
+ *
+ *  We send each active peer our digest of its tables. If it does not match
+ *  its own, the peer sends the digests of its nodes so that only those we
+ *  disagree on are sent again. Called on every Keepalive tick.
+ *
+ *  @param None
+ *  @return @c void
+ */
+void hm_cluster_check_digests()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_LOCATION_CB *loc_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (LOCAL.digest_ticks_left > 1)
+  {
+    LOCAL.digest_ticks_left--;
+    goto EXIT_LABEL;
+  }
+  LOCAL.digest_ticks_left = HM_DIGEST_INTERVAL_TICKS;
+
+  for (glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       glob_cb != NULL;
+       glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                 locations_tree_by_db_id))
+  {
+    loc_cb = glob_cb->loc_cb;
+    if ((loc_cb->index == LOCAL.local_location_cb.index) ||
+        (loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE) ||
+        (loc_cb->peer_listen_cb == NULL))
+    {
+      continue;
+    }
+
+    /***************************************************************************/
+    /* Our tables of the peer are not settled till its replay is over.     */
+    /***************************************************************************/
+    if (loc_cb->replay_in_progress)
+    {
+      TRACE_DETAIL(("Replay from Location %d in progress.", loc_cb->index));
+      continue;
+    }
+
+    if (hm_cluster_send_root_digest(loc_cb) != HM_OK)
+    {
+      break;
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_check_digests */
+
+
+/**
+ *  @brief Sends a peer our digest of its tables
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_send_root_digest(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_MSG *msg = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  TRACE_DETAIL(("Digest of Location %d: 0x%x", loc_cb->index, loc_cb->digest));
+  msg = hm_cluster_digest_new(loc_cb, HM_PEER_DIGEST_ROOT, loc_cb->digest, 0);
+  if (msg == NULL)
+  {
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  ret_val = hm_cluster_digest_flush(loc_cb, &msg, HM_PEER_DIGEST_LAST_NODE);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_send_root_digest */
+
+
+/**
+ *  @brief Starts a Digest message to a peer
+ *
+ *  The buffer is as large as the frame size agreed with the peer; it is cut
+ *  down to the entries filled in when sent.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param kind One of HM_PEER_DIGEST_*
+ *  @param digest Digest of the location the message is about
+ *  @param first First Node ID the entries will cover
+ *  @return Message (#HM_MSG), NULL on error
+ */
+HM_MSG * hm_cluster_digest_new(HM_LOCATION_CB *loc_cb, uint32_t kind,
+                               uint32_t digest, uint32_t first)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_MSG *msg = NULL;
+  HM_PEER_MSG_DIGEST *digest_msg = NULL;
+  uint32_t size = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  size = hm_cluster_frame_size(loc_cb);
+  msg = hm_get_buffer(size);
+  if (msg == NULL)
+  {
+    TRACE_ERROR(("Error allocating memory for Digest Message."));
+    goto EXIT_LABEL;
+  }
+
+  digest_msg = (HM_PEER_MSG_DIGEST *)msg->msg;
+  memset(digest_msg, 0, size);
+  HM_PUT_LONG(digest_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  HM_PUT_LONG(digest_msg->hdr.msg_type, HM_PEER_MSG_TYPE_DIGEST);
+  HM_PUT_LONG(digest_msg->hdr.timestamp, 0);
+
+  HM_PUT_LONG(digest_msg->kind, kind);
+  HM_PUT_LONG(digest_msg->digest, digest);
+  HM_PUT_LONG(digest_msg->first, first);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (msg);
+}/* hm_cluster_digest_new */
+
+
+/**
+ *  @brief Returns the next free entry in the Digest message being built
+ *
+ *  If the message is full, it is sent, covering nodes upto its last entry,
+ *  and a new one is started from the node after.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param **msg Digest message (#HM_MSG) being built. NULL if there is none.
+ *  @param kind One of HM_PEER_DIGEST_*, if a message must be started
+ *  @param digest Digest of the location, if a message must be started
+ *  @return Entry (#HM_PEER_DIGEST_ENTRY) to fill, NULL on error
+ */
+HM_PEER_DIGEST_ENTRY * hm_cluster_digest_next_entry(HM_LOCATION_CB *loc_cb,
+                          HM_MSG **msg, uint32_t kind, uint32_t digest)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PEER_MSG_DIGEST *digest_msg = NULL;
+  HM_PEER_DIGEST_ENTRY *entry = NULL;
+  uint32_t num_entries = 0;
+  uint32_t max_entries = 0;
+  uint32_t first = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  max_entries = (hm_cluster_frame_size(loc_cb) - HM_PEER_DIGEST_MSG_SIZE(0)) /
+                                                  sizeof(HM_PEER_DIGEST_ENTRY);
+  if (*msg != NULL)
+  {
+    digest_msg = (HM_PEER_MSG_DIGEST *)(*msg)->msg;
+    HM_GET_LONG(num_entries, digest_msg->num_entries);
+
+    if (num_entries == max_entries)
+    {
+      HM_GET_LONG(first, digest_msg->entries[num_entries - 1].node_id);
+      if (hm_cluster_digest_flush(loc_cb, msg, first) != HM_OK)
+      {
+        goto EXIT_LABEL;
+      }
+      first++;
+    }
+  }
+
+  if (*msg == NULL)
+  {
+    *msg = hm_cluster_digest_new(loc_cb, kind, digest, first);
+    if (*msg == NULL)
+    {
+      goto EXIT_LABEL;
+    }
+  }
+
+  digest_msg = (HM_PEER_MSG_DIGEST *)(*msg)->msg;
+  HM_GET_LONG(num_entries, digest_msg->num_entries);
+  entry = &digest_msg->entries[num_entries];
+  HM_PUT_LONG(digest_msg->num_entries, num_entries + 1);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (entry);
+}/* hm_cluster_digest_next_entry */
+
+
+/**
+ *  @brief Sends the Digest message being built, if any
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param **msg Digest message (#HM_MSG) being built. Reset to NULL once sent.
+ *  @param last Last Node ID the entries cover
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_digest_flush(HM_LOCATION_CB *loc_cb, HM_MSG **msg,
+                                uint32_t last)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PEER_MSG_DIGEST *digest_msg = NULL;
+  HM_MSG *shrunk = NULL;
+  uint32_t num_entries = 0;
+
+  int32_t ret_val = HM_OK;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (*msg == NULL)
+  {
+    TRACE_DETAIL(("Nothing pending."));
+    goto EXIT_LABEL;
+  }
+
+  digest_msg = (HM_PEER_MSG_DIGEST *)(*msg)->msg;
+  HM_PUT_LONG(digest_msg->last, last);
+  HM_GET_LONG(num_entries, digest_msg->num_entries);
+  HM_PUT_LONG(digest_msg->hdr.msg_len, HM_PEER_DIGEST_MSG_SIZE(num_entries));
+
+  if (HM_PEER_DIGEST_MSG_SIZE(num_entries) < (*msg)->msg_len)
+  {
+    shrunk = hm_shrink_buffer(*msg, HM_PEER_DIGEST_MSG_SIZE(num_entries));
+    if (shrunk != NULL)
+    {
+      *msg = shrunk;
+    }
+    else
+    {
+      (*msg)->msg_len = HM_PEER_DIGEST_MSG_SIZE(num_entries);
+    }
+  }
+  TRACE_DETAIL(("Sending %d digests in %d bytes", num_entries, (*msg)->msg_len));
+
+  if (hm_cluster_send_sequenced(*msg, loc_cb, HM_PRIORITY_INFO) != HM_OK)
+  {
+    TRACE_ERROR(("Error sending message to peer!"));
+    ret_val = HM_ERR;
+  }
+
+  hm_free_buffer(*msg);
+  *msg = NULL;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_digest_flush */
+
+
+/**
+ *  @brief Processes an incoming Digest message
+ *
+ *  @param *msg Digest message (#HM_PEER_MSG_DIGEST) received
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer which sent it
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_recv_digest(HM_PEER_MSG_DIGEST *msg, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  uint32_t kind, digest, ours;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_GET_LONG(kind, msg->kind);
+  HM_GET_LONG(digest, msg->digest);
+
+  switch (kind)
+  {
+    case HM_PEER_DIGEST_ROOT:
+      ours = hm_cluster_location_digest_for(loc_cb);
+      if (digest == ours)
+      {
+        TRACE_DETAIL(("Location %d agrees with our tables.", loc_cb->index));
+        break;
+      }
+      TRACE_INFO(("Location %d has digest 0x%x of our tables, ours is 0x%x",
+                  loc_cb->index, digest, ours));
+      ret_val = hm_cluster_send_node_digests(loc_cb);
+      break;
+
+    case HM_PEER_DIGEST_NODES:
+      ret_val = hm_cluster_compare_node_digests(msg, loc_cb);
+      break;
+
+    case HM_PEER_DIGEST_REPAIR:
+      ret_val = hm_cluster_repair_nodes(msg, loc_cb);
+      break;
+
+    case HM_PEER_DIGEST_REPAIRED:
+      hm_cluster_retire_unrepaired(msg, loc_cb);
+      break;
+
+    default:
+      TRACE_WARN(("Unknown kind of Digest: %d", kind));
+      TRACE_ASSERT(FALSE);
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_recv_digest */
+
+
+/**
+ *  @brief Sends the digests of our nodes to a peer that disagrees with us
+ *
+ *  Nodes with nothing active on them are left out; the peer must not have
+ *  anything active on them either. Only the processes the peer subscribes to
+ *  count, since it holds no others.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_send_node_digests(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_NODE_CB *node_cb = NULL;
+  HM_MSG *msg = NULL;
+  HM_PEER_DIGEST_ENTRY *entry = NULL;
+  uint32_t loc_digest, node_digest;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  loc_digest = hm_cluster_location_digest_for(loc_cb);
+  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
+                 nodes_tree_by_node_id);
+       node_cb != NULL;
+       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                 nodes_tree_by_node_id))
+  {
+    node_digest = hm_cluster_node_digest_for(node_cb, loc_cb);
+    if (node_digest == 0)
+    {
+      continue;
+    }
+
+    entry = hm_cluster_digest_next_entry(loc_cb, &msg, HM_PEER_DIGEST_NODES,
+                                         loc_digest);
+    if (entry == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    HM_PUT_LONG(entry->node_id, node_cb->index);
+    HM_PUT_LONG(entry->digest, node_digest);
+  }
+
+  /***************************************************************************/
+  /* The last message covers the rest of the range, even if it is empty.   */
+  /***************************************************************************/
+  if (msg == NULL)
+  {
+    msg = hm_cluster_digest_new(loc_cb, HM_PEER_DIGEST_NODES, loc_digest, 0);
+    if (msg == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+  }
+  ret_val = hm_cluster_digest_flush(loc_cb, &msg, HM_PEER_DIGEST_LAST_NODE);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (msg != NULL)
+  {
+    hm_free_buffer(msg);
+  }
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_send_node_digests */
+
+
+/**
+ *  @brief Compares the digests of a peer's nodes with ours and asks for repair
+ *
+ *  Nodes the digests disagree on, or that only one side has anything active
+ *  on, are asked for again. Their versions are forgotten, so that what the
+ *  peer sends is applied; whatever the peer does not send is retired once it
+ *  says it is done.
+ *
+ *  @param *msg Digest message (#HM_PEER_MSG_DIGEST) of kind Nodes
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer which sent it
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_compare_node_digests(HM_PEER_MSG_DIGEST *msg,
+                                        HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_NODE_CB *node_cb = NULL;
+  HM_NODE_CB *repair_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  HM_MSG *repair_msg = NULL;
+  HM_PEER_DIGEST_ENTRY *entry = NULL;
+
+  uint32_t digest, first, last, num_entries;
+  uint32_t node_id = 0, node_digest = 0;
+  uint32_t repair = FALSE;
+  uint32_t i = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_GET_LONG(digest, msg->digest);
+  HM_GET_LONG(first, msg->first);
+  HM_GET_LONG(last, msg->last);
+  HM_GET_LONG(num_entries, msg->num_entries);
+
+  if (loc_cb->replay_in_progress)
+  {
+    TRACE_DETAIL(("Replay from Location %d in progress.", loc_cb->index));
+    goto EXIT_LABEL;
+  }
+
+  if (digest == loc_cb->digest)
+  {
+    TRACE_DETAIL(("Updates in the meantime have brought us in agreement."));
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Walk our nodes of the peer and its entries side by side, both being in */
+  /* order of Node ID.                             */
+  /***************************************************************************/
+  node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(loc_cb->node_tree, nodes_tree_by_node_id);
+  while ((node_cb != NULL) && (node_cb->index < first))
+  {
+    node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                                         nodes_tree_by_node_id);
+  }
+
+  while ((i < num_entries) || ((node_cb != NULL) && (node_cb->index <= last)))
+  {
+    repair = FALSE;
+    repair_cb = NULL;
+    if (i < num_entries)
+    {
+      HM_GET_LONG(node_id, msg->entries[i].node_id);
+      HM_GET_LONG(node_digest, msg->entries[i].digest);
+    }
+
+    if ((node_cb == NULL) || (node_cb->index > last) ||
+        ((i < num_entries) && (node_id < node_cb->index)))
+    {
+      /***************************************************************************/
+      /* Peer has something active on a node we do not know of.         */
+      /***************************************************************************/
+      TRACE_DETAIL(("Node %d is not known.", node_id));
+      repair = TRUE;
+      i++;
+    }
+    else
+    {
+      if ((i < num_entries) && (node_id == node_cb->index))
+      {
+        repair = (node_digest != node_cb->digest);
+        i++;
+      }
+      else
+      {
+        /***************************************************************************/
+        /* Peer has nothing active on this node.                   */
+        /***************************************************************************/
+        node_id = node_cb->index;
+        node_digest = 0;
+        repair = (node_cb->digest != 0);
+      }
+
+      if (repair)
+      {
+        TRACE_DETAIL(("Node %d digest 0x%x, ours 0x%x", node_id, node_digest,
+                      node_cb->digest));
+        repair_cb = node_cb;
+      }
+      node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                                           nodes_tree_by_node_id);
+    }
+
+    if (!repair)
+    {
+      continue;
+    }
+
+    entry = hm_cluster_digest_next_entry(loc_cb, &repair_msg,
+                                         HM_PEER_DIGEST_REPAIR, loc_cb->digest);
+    if (entry == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    HM_PUT_LONG(entry->node_id, node_id);
+    HM_PUT_LONG(entry->digest, (repair_cb != NULL) ? repair_cb->digest : 0);
+
+    if (repair_cb == NULL)
+    {
+      continue;
+    }
+
+    repair_cb->version = 0;
+    repair_cb->hlc = 0;
+    for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(repair_cb->process_tree,
+                   node_process_tree_by_proc_type_and_pid);
+         proc_cb != NULL;
+         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                   node_process_tree_by_proc_type_and_pid))
+    {
+      proc_cb->version = 0;
+      proc_cb->hlc = 0;
+    }
+  }
+
+  if (repair_msg != NULL)
+  {
+    TRACE_INFO(("Ask Location %d to repair nodes %d to %d", loc_cb->index,
+                first, last));
+    ret_val = hm_cluster_digest_flush(loc_cb, &repair_msg, last);
+  }
 
-    case HM_PEER_MSG_TYPE_REPLAY:
-      TRACE_DETAIL(("Received Replay Message Sequence"));
-      /***************************************************************************/
-      /* Location cannot be inactive while doing replay               */
-      /***************************************************************************/
-      TRACE_ASSERT(sock_cb->tprt_cb->location_cb->fsm_state
-                   == HM_PEER_FSM_STATE_ACTIVE);
-      replay_msg = (HM_PEER_MSG_REPLAY *)sock_cb->tprt_cb->in_buffer;
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (repair_msg != NULL)
+  {
+    hm_free_buffer(repair_msg);
+  }
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_compare_node_digests */
 
-      if ((ret_val = hm_cluster_process_replay(replay_msg, loc_cb)) != HM_OK)
+
+/**
+ *  @brief Sends a peer our nodes it asked for again, with all their processes
+ *
+ *  Of the processes, only those the peer subscribes to are sent; it retires
+ *  any others it holds. They go out as Replay TLVs, followed by a Repaired message naming the
+ *  same nodes so that the peer can retire whatever was not sent.
+ *
+ *  @param *msg Digest message (#HM_PEER_MSG_DIGEST) of kind Repair
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer which sent it
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_repair_nodes(HM_PEER_MSG_DIGEST *msg, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  HM_MSG *replay_msg = NULL;
+  HM_MSG *repaired_msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
+  HM_PEER_DIGEST_ENTRY *entry = NULL;
+
+  uint32_t num_entries, node_id, i;
+  uint32_t loc_digest;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (loc_cb->peer_listen_cb == NULL)
+  {
+    TRACE_WARN(("No transport to Location %d", loc_cb->index));
+    goto EXIT_LABEL;
+  }
+
+  HM_GET_LONG(num_entries, msg->num_entries);
+  for (i = 0; i < num_entries; i++)
+  {
+    HM_GET_LONG(node_id, msg->entries[i].node_id);
+    node_cb = (HM_NODE_CB *)HM_AVL3_FIND(LOCAL.local_location_cb.node_tree,
+                                         &node_id, nodes_tree_by_node_id);
+    if (node_cb == NULL)
+    {
+      TRACE_DETAIL(("Node %d is not ours.", node_id));
+      continue;
+    }
+
+    TRACE_DETAIL(("Repair Node %d", node_id));
+    if ((tlv = hm_cluster_replay_next_tlv(loc_cb->peer_listen_cb, &replay_msg,
+                                LOCAL.local_location_cb.version)) == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    hm_cluster_fill_node_tlv(tlv, node_cb);
+
+    for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                   node_process_tree_by_proc_type_and_pid);
+         proc_cb != NULL;
+         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                   node_process_tree_by_proc_type_and_pid))
+    {
+      if (!hm_cluster_peer_wants(loc_cb, proc_cb->type))
       {
-        TRACE_ERROR(("Error occurred while processing Replay Message."));
+        continue;
+      }
+
+      if ((tlv = hm_cluster_replay_next_tlv(loc_cb->peer_listen_cb, &replay_msg,
+                                  LOCAL.local_location_cb.version)) == NULL)
+      {
+        ret_val = HM_ERR;
         goto EXIT_LABEL;
       }
+      hm_cluster_fill_process_tlv(tlv, proc_cb);
+    }
+  }
 
-      break;
+  if (hm_cluster_replay_flush(loc_cb->peer_listen_cb, &replay_msg) != HM_OK)
+  {
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
 
+  /***************************************************************************/
+  /* The stream is in order, so the peer has all of the above by the time   */
+  /* this arrives.                                 */
+  /***************************************************************************/
+  loc_digest = hm_cluster_location_digest_for(loc_cb);
+  for (i = 0; i < num_entries; i++)
+  {
+    HM_GET_LONG(node_id, msg->entries[i].node_id);
+    node_cb = (HM_NODE_CB *)HM_AVL3_FIND(LOCAL.local_location_cb.node_tree,
+                                         &node_id, nodes_tree_by_node_id);
 
-    case HM_PEER_MSG_TYPE_NODE_UPDATE:
-      TRACE_DETAIL(("Received Node Update"));
-      /***************************************************************************/
-      /* Location cannot be inactive while getting a node update              */
-      /***************************************************************************/
-      TRACE_ASSERT(sock_cb->tprt_cb->location_cb->fsm_state
-                   == HM_PEER_FSM_STATE_ACTIVE);
-      node_update = (HM_PEER_MSG_NODE_UPDATE *)sock_cb->tprt_cb->in_buffer;
+    entry = hm_cluster_digest_next_entry(loc_cb, &repaired_msg,
+                      HM_PEER_DIGEST_REPAIRED, loc_digest);
+    if (entry == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    HM_PUT_LONG(entry->node_id, node_id);
+    HM_PUT_LONG(entry->digest, (node_cb != NULL) ?
+                hm_cluster_node_digest_for(node_cb, loc_cb) : 0);
+  }
 
-      /***************************************************************************/
-      /* Find the node_cb in HM                           */
-      /***************************************************************************/
-      HM_GET_LONG(node_id, node_update->node_id);
-      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
-                                           &node_id,
-                                           nodes_tree_by_node_id);
+  ret_val = hm_cluster_digest_flush(loc_cb, &repaired_msg,
+                                    HM_PEER_DIGEST_LAST_NODE);
 
-      if (node_cb == NULL)
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (replay_msg != NULL)
+  {
+    hm_free_buffer(replay_msg);
+  }
+  if (repaired_msg != NULL)
+  {
+    hm_free_buffer(repaired_msg);
+  }
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_repair_nodes */
+
+
+/**
+ *  @brief Retires what a peer did not send again of the nodes it repaired
+ *
+ *  Those entries had their versions forgotten when repair was asked for, and
+ *  still do; the peer has nothing active there.
+ *
+ *  @param *msg Digest message (#HM_PEER_MSG_DIGEST) of kind Repaired
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer which sent it
+ *  @return @c void
+ */
+void hm_cluster_retire_unrepaired(HM_PEER_MSG_DIGEST *msg,
+                                  HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_NODE_CB *node_cb = NULL;
+  HM_PROCESS_CB *proc_cb = NULL;
+  uint32_t num_entries, node_id, digest, i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_GET_LONG(num_entries, msg->num_entries);
+  for (i = 0; i < num_entries; i++)
+  {
+    HM_GET_LONG(node_id, msg->entries[i].node_id);
+    node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree, &node_id,
+                                         nodes_tree_by_node_id);
+    if (node_cb == NULL)
+    {
+      continue;
+    }
+
+    for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                   node_process_tree_by_proc_type_and_pid);
+         proc_cb != NULL;
+         proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                   node_process_tree_by_proc_type_and_pid))
+    {
+      if ((proc_cb->version == 0) && (proc_cb->running == TRUE))
       {
-        TRACE_ERROR(("Node %d does not exist in DB and its update was received.",
-                     node_id));
-        TRACE_ASSERT(FALSE);
-        /* This is temporary. The code is unhittable, but currently on upgrade path */
-        node_cb = hm_alloc_node_cb(FALSE);
+        TRACE_INFO(("Process %d on Node %d is not running at its owner.",
+                    proc_cb->pid, node_id));
+        proc_cb->reported_status = HM_PEER_ENTITY_STATUS_INACTIVE;
+        hm_cluster_apply_process_status(proc_cb,
+                                        HM_PEER_ENTITY_STATUS_INACTIVE);
+      }
+    }
 
-        if (node_cb == NULL)
-        {
-          TRACE_ERROR(("Error allocating memory for Remote Node"));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
+    if ((node_cb->version == 0) &&
+        (node_cb->fsm_state == HM_NODE_FSM_STATE_ACTIVE))
+    {
+      TRACE_INFO(("Node %d is not active at its owner.", node_id));
+      node_cb->reported_status = HM_PEER_ENTITY_STATUS_INACTIVE;
+      hm_cluster_apply_node_status(node_cb, HM_PEER_ENTITY_STATUS_INACTIVE);
+    }
+  }
 
-        HM_GET_LONG(node_cb->index, node_update->node_id);
-        HM_GET_LONG(node_cb->group, node_update->node_group);
-        HM_GET_LONG(node_cb->role, node_update->node_role);
-        HM_GET_LONG(status, node_update->status);
+  HM_GET_LONG(digest, msg->digest);
+  TRACE_DETAIL(("Location %d digest: 0x%x, ours of it: 0x%x", loc_cb->index,
+                digest, loc_cb->digest));
 
-        if (status == HM_PEER_ENTITY_STATUS_ACTIVE)
-        {
-          TRACE_DETAIL(("Node %d has become active.", node_id));
-          node_cb->fsm_state = HM_NODE_FSM_STATE_ACTIVE;
-        }
-        else
-        {
-          node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
-        }
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_retire_unrepaired */
+
+
+/**
+ *  @brief Tells if a peer wants updates of a type of process
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param proc_type Type of the process
+ *  @return TRUE if the peer has subscribers for it, FALSE otherwise
+ */
+uint32_t hm_cluster_peer_wants(HM_LOCATION_CB *loc_cb, uint32_t proc_type)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t wants;
+  uint32_t i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  wants = loc_cb->interest_all;
+  for (i = 0; (!wants) && (i < loc_cb->num_interests); i++)
+  {
+    wants = (loc_cb->interests[i] == proc_type);
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (wants);
+}/* hm_cluster_peer_wants */
+
+
+/**
+ *  @brief Digest of one of our nodes as a peer holds it
+ *
+ *  The peer holds only the processes it subscribes to, so only their digests
+ *  are added to that of the node itself.
+ *
+ *  @param *node_cb Node CB (#HM_NODE_CB) of the local node
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return Digest of the node
+ */
+uint32_t hm_cluster_node_digest_for(HM_NODE_CB *node_cb, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PROCESS_CB *proc_cb = NULL;
+  uint32_t digest;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(node_cb != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (loc_cb->interest_all)
+  {
+    digest = node_cb->digest;
+    goto EXIT_LABEL;
+  }
+
+  digest = node_cb->digest_leaf;
+  for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                 node_process_tree_by_proc_type_and_pid);
+       proc_cb != NULL;
+       proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                 node_process_tree_by_proc_type_and_pid))
+  {
+    if (hm_cluster_peer_wants(loc_cb, proc_cb->type))
+    {
+      digest += proc_cb->digest;
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (digest);
+}/* hm_cluster_node_digest_for */
+
+
+/**
+ *  @brief Digest of our tables as a peer holds them
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return Digest of the local location
+ */
+uint32_t hm_cluster_location_digest_for(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_NODE_CB *node_cb = NULL;
+  uint32_t digest = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (loc_cb->interest_all)
+  {
+    digest = LOCAL.local_location_cb.digest;
+    goto EXIT_LABEL;
+  }
 
-        /***************************************************************************/
-        /* Add node to system                             */
-        /***************************************************************************/
-        if (hm_node_add(node_cb, loc_cb) != HM_OK)
-        {
-          TRACE_ERROR(("Error adding node to system."));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
+  for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(LOCAL.local_location_cb.node_tree,
+                 nodes_tree_by_node_id);
+       node_cb != NULL;
+       node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                 nodes_tree_by_node_id))
+  {
+    digest += hm_cluster_node_digest_for(node_cb, loc_cb);
+  }
 
-        /***************************************************************************/
-        /* We've parsed the whole thing. No need to go any further with this msg.  */
-        /***************************************************************************/
-        break;
-      }
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (digest);
+}/* hm_cluster_location_digest_for */
 
-      HM_GET_LONG(status, node_update->status);
-      TRACE_DETAIL(("Current state of node: %d", node_cb->fsm_state));
 
-      if ((status == HM_PEER_ENTITY_STATUS_ACTIVE) &&
-          (node_cb->fsm_state != HM_NODE_FSM_STATE_ACTIVE))
-      {
-        TRACE_DETAIL(("Node %d has become active.", node_id));
-        node_cb->fsm_state = HM_NODE_FSM_STATE_ACTIVE;
-        TRACE_ASSERT(node_cb->parent_location_cb->active_nodes >= 0);
-        node_cb->parent_location_cb->active_nodes++;
-        //TODO: Let remote nodes also be managed by the same FSM
-        //hm_node_fsm(HM_NODE_FSM_TERM, node_cb);
-      }
-      else if ((status == HM_PEER_ENTITY_STATUS_ACTIVE) &&
-               (node_cb->fsm_state == HM_NODE_FSM_STATE_ACTIVE))
-      {
-        TRACE_DETAIL(("Node %d has become active. But we know it already", node_id));
-      }
-      else if ((status == HM_PEER_ENTITY_STATUS_INACTIVE) &&
-               (node_cb->fsm_state == HM_NODE_FSM_STATE_WAITING))
-      {
-        TRACE_DETAIL(("Node %d has failed to start.", node_id));
-        node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
-      }
-      else if ((status == HM_PEER_ENTITY_STATUS_INACTIVE) &&
-               (node_cb->fsm_state != HM_NODE_FSM_STATE_FAILED))
-      {
-        TRACE_DETAIL(("Node %d has failed.", node_id));
-        node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
-        node_cb->parent_location_cb->active_nodes--;
-      }
-      else if ((status == HM_PEER_ENTITY_STATUS_INACTIVE) &&
-               (node_cb->fsm_state == HM_NODE_FSM_STATE_FAILED))
-      {
-        TRACE_DETAIL(("Node %d has failed. But we know it already", node_id));
-      }
-      else
-      {
-        TRACE_DETAIL(("Something happened to Node %d, but fail anyway.", node_id));
-        node_cb->fsm_state = HM_NODE_FSM_STATE_FAILING;
-        node_cb->parent_location_cb->active_nodes--;
-      }
+/**
+ *  @brief Works out the process types we have subscribers for
+ *
+ *  Subscriptions to processes are always by type, and kept among the
+ *  wildcard subscribers. Only those of our own nodes and processes count:
+ *  remote subscribers are notified by their own HM. So do the types of the
+ *  processes of peers that our entities are bound to. If the set has grown,
+ *  peers are told, and asked to compare digests so that they send the
+ *  processes we did not have till now.
+ *
+ *  @param None
+ *  @return @c void
+ */
+void hm_cluster_update_interest()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_SUBSCRIBER_WILDCARD *greedy = NULL;
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_LOCATION_CB *local = &LOCAL.local_location_cb;
 
-      hm_global_node_update(node_cb, HM_UPDATE_RUN_STATUS);
-      if(node_cb->fsm_state == HM_NODE_FSM_STATE_FAILING)
+  uint32_t all = FALSE, num_interests = 0, value;
+  uint32_t interests[HM_PEER_MAX_INTERESTS];
+  uint32_t i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (greedy = (HM_SUBSCRIBER_WILDCARD *)HM_NEXT_IN_LIST(LOCAL.table_root_subscribers);
+       (greedy != NULL) && (!all);
+       greedy = (HM_SUBSCRIBER_WILDCARD *)HM_NEXT_IN_LIST(greedy->node))
+  {
+    /***************************************************************************/
+    /* Subscribers from configuration may not be in the global tables yet;   */
+    /* they are ours. A process of a peer bound to our entities is not       */
+    /* subscribed to anything here, but they hear of it: we want its type.   */
+    /***************************************************************************/
+    value = greedy->value;
+    if (hm_global_is_remote(greedy->subscriber.void_cb))
+    {
+      if ((!greedy->cross_bind) ||
+          (*(int32_t *)((char *)greedy->subscriber.void_cb + sizeof(int32_t))
+                                                    != HM_TABLE_TYPE_PROCESS))
       {
-        /* FIXME: Added later to avoid multiple receive of same notification. */
-        node_cb->fsm_state = HM_NODE_FSM_STATE_FAILED;
+        continue;
       }
-      break;
+      value = greedy->subscriber.process_cb->type;
+      TRACE_DETAIL(("Bound to Process %d of type %d",
+                    greedy->subscriber.process_cb->pid, value));
+    }
+    else if (greedy->subs_type != HM_CONFIG_ATTR_SUBS_TYPE_PROC)
+    {
+      continue;
+    }
 
-    case HM_PEER_MSG_TYPE_PROCESS_UPDATE:
-      TRACE_DETAIL(("Received Process Update Message"));
-      /***************************************************************************/
-      /* Location cannot be inactive while getting a process update         */
-      /***************************************************************************/
-      TRACE_ASSERT(sock_cb->tprt_cb->location_cb->fsm_state
-                   == HM_PEER_FSM_STATE_ACTIVE);
-      proc_update = (HM_PEER_MSG_PROCESS_UPDATE *)sock_cb->tprt_cb->in_buffer;
-      /***************************************************************************/
-      /* Find the node_cb in HM                           */
-      /***************************************************************************/
-      HM_GET_LONG(node_id, proc_update->node_id);
-      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
-                                           &node_id,
-                                           nodes_tree_by_node_id);
+    if (value == 0)
+    {
+      all = TRUE;
+      break;
+    }
 
-      if (node_cb == NULL)
+    for (i = 0; i < num_interests; i++)
+    {
+      if (interests[i] == value)
       {
-        TRACE_ERROR(("Node %d does not exist in DB and its update was received.",
-                     node_id));
-        ret_val = HM_ERR;
         break;
       }
+    }
+    if (i < num_interests)
+    {
+      continue;
+    }
 
-      HM_GET_LONG(proc_key[0], proc_update->proc_type);
-      HM_GET_LONG(proc_key[1], proc_update->proc_id);
-
-      /***************************************************************************/
-      /* Find the Process in the Nodes tree                     */
-      /***************************************************************************/
-      proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIND(node_cb->process_tree,
-                                              &proc_key,
-                                              node_process_tree_by_proc_type_and_pid);
-
-      if (proc_cb == NULL)
-      {
-        TRACE_WARN(("Process CB not found!"));
-        proc_cb = hm_alloc_process_cb();
-
-        if (proc_cb == NULL)
-        {
-          TRACE_ERROR(("Error allocating memory for Process CBs"));
-          /***************************************************************************/
-          /* Maybe, try again later?                           */
-          /***************************************************************************/
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
-
-        /***************************************************************************/
-        /* Find a node_cb                               */
-        /***************************************************************************/
+    if (num_interests == HM_PEER_MAX_INTERESTS)
+    {
+      TRACE_INFO(("Subscribed to more than %d process types. Ask for all.",
+                  HM_PEER_MAX_INTERESTS));
+      all = TRUE;
+      break;
+    }
+    interests[num_interests++] = value;
+  }
 
-        proc_cb->parent_node_cb = node_cb;
-        proc_cb->pid =  proc_key[1];
-        proc_cb->type = proc_key[0];
+  if ((all == local->interest_all) && (num_interests == local->num_interests) &&
+      (memcmp(interests, local->interests, num_interests * sizeof(uint32_t)) == 0))
+  {
+    TRACE_DETAIL(("Interest unchanged."));
+    goto EXIT_LABEL;
+  }
 
-        HM_GET_LONG(status, proc_update->status);
+  local->interest_all = all;
+  local->num_interests = num_interests;
+  memcpy(local->interests, interests, num_interests * sizeof(uint32_t));
+  TRACE_INFO(("Subscribed to %s%d process types", all ? "all " : "",
+              num_interests));
+
+  for (glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       glob_cb != NULL;
+       glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                 locations_tree_by_db_id))
+  {
+    if ((glob_cb->loc_cb->index == local->index) ||
+        (glob_cb->loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE) ||
+        (glob_cb->loc_cb->peer_listen_cb == NULL))
+    {
+      continue;
+    }
 
-        if (status == HM_PEER_ENTITY_STATUS_ACTIVE)
-        {
-          TRACE_DETAIL(("Proces is active"));
-          proc_cb->running = TRUE;
-          //TODO: Let remote nodes also be managed by the same FSM
-          //hm_node_fsm(HM_NODE_FSM_TERM, node_cb);
-        }
-        else
-        {
-          TRACE_DETAIL(("Process is not running."));
-          proc_cb->running = FALSE;
-        }
+    if (hm_cluster_send_interest(glob_cb->loc_cb) != HM_OK)
+    {
+      continue;
+    }
 
-        if (hm_process_add(proc_cb, proc_cb->parent_node_cb) != HM_OK)
-        {
-          TRACE_ERROR(("Error occurred while adding process info to HM."));
-          hm_free_process_cb(proc_cb);
-          proc_cb = NULL;
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
+    if (!glob_cb->loc_cb->replay_in_progress)
+    {
+      hm_cluster_send_root_digest(glob_cb->loc_cb);
+    }
+  }
 
-        TRACE_DETAIL(("Added Process!"));
-        break;
-      }
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_cluster_update_interest */
 
-      /***************************************************************************/
-      /* Found Process CB                                 */
-      /***************************************************************************/
-      HM_GET_LONG(status, proc_update->status);
 
-      if (status == HM_PEER_ENTITY_STATUS_ACTIVE)
-      {
-        TRACE_DETAIL(("Process %d has become active.", proc_key[1]));
-        proc_cb->running = TRUE;
-        //TODO: Let remote nodes also be managed by the same FSM
-        //hm_node_fsm(HM_NODE_FSM_TERM, node_cb);
-      }
-      else
-      {
-        TRACE_DETAIL(("Process %d is not running.", proc_key[1]));
-        proc_cb->running = FALSE;
-      }
+/**
+ *  @brief Tells a peer the process types we have subscribers for
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_send_interest(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_MSG *msg = NULL;
+  HM_PEER_MSG_INTEREST *interest_msg = NULL;
+  uint32_t num_interests = LOCAL.local_location_cb.num_interests;
+  uint32_t i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-      hm_process_update(proc_cb);
-      break;
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  msg = hm_get_buffer(HM_PEER_INTEREST_MSG_SIZE(num_interests));
+  if (msg == NULL)
+  {
+    TRACE_ERROR(("Error allocating buffer for Interest message."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
 
-    case HM_PEER_MSG_TYPE_HA_UPDATE:
-      TRACE_DETAIL(("Received HA Update Message"));
-      msg = (HM_MSG *)sock_cb->tprt_cb->in_buffer;
+  interest_msg = (HM_PEER_MSG_INTEREST *)msg->msg;
+  memset(interest_msg, 0, HM_PEER_INTEREST_MSG_SIZE(num_interests));
+  HM_PUT_LONG(interest_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  HM_PUT_LONG(interest_msg->hdr.msg_type, HM_PEER_MSG_TYPE_INTEREST);
+  HM_PUT_LONG(interest_msg->hdr.timestamp, 0);
+  HM_PUT_LONG(interest_msg->hdr.msg_len, HM_PEER_INTEREST_MSG_SIZE(num_interests));
 
-      if (hm_cluster_recv_ha_update((HM_PEER_MSG_HA_UPDATE *)msg, loc_cb) != HM_OK)
-      {
-        TRACE_ERROR(("Error processing HA Update!"));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
+  HM_PUT_LONG(interest_msg->all, LOCAL.local_location_cb.interest_all);
+  HM_PUT_LONG(interest_msg->num_types, num_interests);
+  for (i = 0; i < num_interests; i++)
+  {
+    HM_PUT_LONG(interest_msg->proc_types[i],
+                LOCAL.local_location_cb.interests[i]);
+  }
 
-      break;
+  if (hm_cluster_send_sequenced(msg, loc_cb, HM_PRIORITY_CONTROL) != HM_OK)
+  {
+    TRACE_ERROR(("Error sending message to peer!"));
+    ret_val = HM_ERR;
+  }
 
-    case HM_PEER_MSG_TYPE_BINDING:
-      TRACE_DETAIL(("Received Subscription binding message"));
-      msg = (HM_MSG *)sock_cb->tprt_cb->in_buffer;
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (msg != NULL)
+  {
+    hm_free_buffer(msg);
+  }
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_send_interest */
 
-      if (hm_cluster_recv_binding((HM_PEER_MSG_BINDING *)msg, loc_cb) != TRUE)
-      {
-        TRACE_ERROR(("Error processing Subscription bidning!"));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
 
-      break;
+/**
+ *  @brief Records the process types a peer has subscribers for
+ *
+ *  From now on, only updates of those are sent to it.
+ *
+ *  @param *msg Interest message (#HM_PEER_MSG_INTEREST) received
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer which sent it
+ *  @return @c void
+ */
+void hm_cluster_recv_interest(HM_PEER_MSG_INTEREST *msg, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-    default:
-      TRACE_WARN(("Unknown Message type."));
-      TRACE_ASSERT(FALSE);
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_GET_LONG(loc_cb->interest_all, msg->all);
+  HM_GET_LONG(loc_cb->num_interests, msg->num_types);
+  for (i = 0; i < loc_cb->num_interests; i++)
+  {
+    HM_GET_LONG(loc_cb->interests[i], msg->proc_types[i]);
   }
 
-EXIT_LABEL:
+  TRACE_INFO(("Location %d subscribes to %s%d process types", loc_cb->index,
+              loc_cb->interest_all ? "all " : "", loc_cb->num_interests));
+
   /***************************************************************************/
   /* Exit Level Checks                             */
   /***************************************************************************/
   TRACE_EXIT();
-  return (ret_val);
-}/* hm_receive_cluster_message */
+  return;
+}/* hm_cluster_recv_interest */
 
 
 /**
- *  @brief Processes an incoming Replay Message
+ *  @brief Sends a peer the current state of one of our processes
  *
- *  @param *msg an #HM_PEER_MSG_REPLAY type message received on Transport
- *  @param *loc_cb Location Control Block (#HM_LOCATION_CB) of the Location from
- *  where message was received.
+ *  For a peer that has no subscribers for processes of its type, and so has
+ *  not been told of it, but must now know it. It goes out as a Replay TLV.
  *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @param *proc_cb Process CB (#HM_PROCESS_CB) of the local process
  *  @return HM_OK if successful, HM_ERR otherwise
  */
-int32_t hm_cluster_process_replay(HM_PEER_MSG_REPLAY *msg,
-                                  HM_LOCATION_CB *loc_cb)
+int32_t hm_cluster_send_process(HM_LOCATION_CB *loc_cb, HM_PROCESS_CB *proc_cb)
 {
   /***************************************************************************/
   /* Variable Declarations                           */
   /***************************************************************************/
   int32_t ret_val = HM_OK;
-  int32_t end = FALSE;
-
-  int32_t tlv_type, num_tlvs = 0;
-
-  /***************************************************************************/
-  /* Use of i is necessary. We MUST traverse update in order only. Process   */
-  /* updates before nodes will fail if nodes do not exist.           */
-  /***************************************************************************/
-  int32_t node_id, i;
-
-  HM_NODE_CB *node_cb = NULL;
-  HM_PROCESS_CB *proc_cb = NULL;
+  HM_MSG *msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
   TRACE_ENTRY();
 
-  TRACE_ASSERT(msg != NULL);
   TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(proc_cb != NULL);
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
-  HM_GET_LONG(end, msg->last);
-
-  if (end)
+  if ((tlv = hm_cluster_replay_next_tlv(loc_cb->peer_listen_cb, &msg,
+                                LOCAL.local_location_cb.version)) == NULL)
   {
-    TRACE_DETAIL(("End of replay message received."));
-    loc_cb->replay_in_progress = FALSE;
+    ret_val = HM_ERR;
     goto EXIT_LABEL;
   }
+  hm_cluster_fill_process_tlv(tlv, proc_cb);
+
+  ret_val = hm_cluster_replay_flush(loc_cb->peer_listen_cb, &msg);
 
+EXIT_LABEL:
   /***************************************************************************/
-  /* We expect more messages. Parse the current one               */
+  /* Exit Level Checks                             */
   /***************************************************************************/
-  HM_GET_LONG(num_tlvs, msg->num_tlvs);
-  TRACE_DETAIL(("%d TLVs present.", num_tlvs));
-
-  for (i = 0; i < num_tlvs; i++)
+  if (msg != NULL)
   {
-    HM_GET_LONG(tlv_type, msg->tlv[i].update_type);
-
-    switch (tlv_type)
-    {
-      case HM_PEER_REPLAY_UPDATE_TYPE_NODE:
-        TRACE_DETAIL(("Node Update"));
-        node_cb = hm_alloc_node_cb(FALSE);
-
-        if (node_cb == NULL)
-        {
-          TRACE_ERROR(("Error allocating memory for Remote Node"));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
-
-        HM_GET_LONG(node_cb->index, msg->tlv[i].node_id);
-        TRACE_DETAIL(("Node ID: %d", node_cb->index));
-        HM_GET_LONG(node_cb->group, msg->tlv[i].group);
-        TRACE_DETAIL(("Node group: %d", node_cb->group));
-        HM_GET_LONG(node_cb->current_role, msg->tlv[i].role);
-        TRACE_DETAIL(("Node Role: %s",
-                  (node_cb->current_role==NODE_ROLE_ACTIVE)?"ACTIVE": "PASSIVE"));
-        HM_GET_LONG(node_cb->fsm_state, msg->tlv[i].running);
-
-        if (node_cb->fsm_state != HM_NODE_FSM_STATE_ACTIVE)
-        {
-          TRACE_DETAIL(("Remote node not yet active. Do not trigger subscriptions yet!"));
-          node_cb->fsm_state =
-            HM_NODE_FSM_STATE_WAITING;/* It may or may not succeed. */
-        }
-
-        /***************************************************************************/
-        /* Add node to system                             */
-        /***************************************************************************/
-        if (hm_node_add(node_cb, loc_cb) != HM_OK)
-        {
-          TRACE_ERROR(("Error adding node to system."));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
-
-        /***************************************************************************/
-        /* Resolve active-backup if we have suitable candidates                    */
-        /***************************************************************************/
-        hm_ha_resolve_active_backup(node_cb);
-        break;
-
-      case HM_PEER_REPLAY_UPDATE_TYPE_PROC:
-        TRACE_DETAIL(("Process Update"));
-        HM_GET_LONG(node_id, msg->tlv[i].node_id);
-        /***************************************************************************/
-        /* Find the node first                             */
-        /***************************************************************************/
-        node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
-                                             &node_id,
-                                             nodes_tree_by_node_id);
-
-        if (node_cb == NULL)
-        {
-          TRACE_ERROR(("Could not find node in Location CB. Out of Order Replays?"));
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
-
-        TRACE_DETAIL(("Found Node. Update Process Entries"));
-        proc_cb = hm_alloc_process_cb();
-
-        if (proc_cb == NULL)
-        {
-          TRACE_ERROR(("Error allocating memory for Process CBs"));
-          /***************************************************************************/
-          /* Maybe, try again later?                           */
-          /***************************************************************************/
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
-
-        /***************************************************************************/
-        /* Find a node_cb                               */
-        /***************************************************************************/
-
-        proc_cb->parent_node_cb = node_cb;
-        HM_GET_LONG(proc_cb->pid, msg->tlv[i].pid);
-        HM_GET_LONG(proc_cb->type, msg->tlv[i].group);
-        proc_cb->running = TRUE;
-
-        if (hm_process_add(proc_cb, proc_cb->parent_node_cb) != HM_OK)
-        {
-          TRACE_ERROR(("Error occurred while adding process info to HM."));
-          hm_free_process_cb(proc_cb);
-          proc_cb = NULL;
-          ret_val = HM_ERR;
-          goto EXIT_LABEL;
-        }
+    hm_free_buffer(msg);
+  }
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_send_process */
 
-        TRACE_DETAIL(("Added Process!"));
-        break;
 
-      default:
-        TRACE_DETAIL(("Unknown type %d", tlv_type));
-        TRACE_ASSERT(FALSE);
-    }
+/**
+ *  @brief Tells if we may peer with a location, given its aggregation role
+ *
+ *  A leaf peers with its aggregator alone, and an aggregator peers with its
+ *  own leaves besides the other aggregators. Everyone else peers with all.
+ *
+ *  @param index Hardware location index of the location
+ *  @param role Aggregation role the location has announced
+ *  @param aggregator Aggregator the location has announced, if it is a leaf
+ *  @return TRUE if we may peer with it, FALSE otherwise
+ */
+uint32_t hm_cluster_may_peer(uint32_t index, uint32_t role, uint32_t aggregator)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t may_peer = TRUE;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (LOCAL.aggregation_role == HM_AGGREGATION_ROLE_LEAF)
+  {
+    may_peer = (index == LOCAL.aggregator);
+  }
+  else if (role == HM_AGGREGATION_ROLE_LEAF)
+  {
+    may_peer = (aggregator == LOCAL.local_location_cb.index);
   }
 
-EXIT_LABEL:
   /***************************************************************************/
   /* Exit Level Checks                             */
   /***************************************************************************/
   TRACE_EXIT();
-  return (ret_val);
-}/* hm_cluster_process_replay */
+  return (may_peer);
+}/* hm_cluster_may_peer */
 
 
 /**
- *  @brief Sends out an update on the status of this entry in DB
+ *  @brief Tells if we may peer with the location which sent an INIT
  *
- *  @param *cb Control block for which Update needs to be sent.
- *  It is of type @c void to allow some polymorphism in the type of Control Blocks
+ *  Its protocol version is checked first: nothing else in the message can be
+ *  read unless it speaks ours.
  *
- *  @return HM_OK if successful, HM_ERR otherwise.
+ *  @param *init_msg INIT message (#HM_PEER_MSG_INIT) received
+ *  @return TRUE if we may peer with it, FALSE otherwise
  */
-int32_t hm_cluster_send_update(void *cb)
+uint32_t hm_cluster_init_may_peer(HM_PEER_MSG_INIT *init_msg)
 {
   /***************************************************************************/
   /* Variable Declarations                           */
   /***************************************************************************/
-  int32_t ret_val = HM_OK;
-  HM_SUBSCRIBER glob_cb;
-
-  HM_GLOBAL_LOCATION_CB *loc_cb;
-
-  HM_PEER_MSG_NODE_UPDATE *node_update = NULL;
-  HM_PEER_MSG_PROCESS_UPDATE *proc_update = NULL;
-
-  HM_MSG *msg = NULL;
+  uint32_t index, role, aggregator, version;
+  uint32_t may_peer = FALSE;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
   TRACE_ENTRY();
 
-  TRACE_ASSERT(cb != NULL);
+  TRACE_ASSERT(init_msg != NULL);
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
-  glob_cb.void_cb = cb;
-
-  /* Value at address saved at memory location(
-   *    treating the pointer as that of a uint32_t(
-   *      treating the pointer cb as a byte, advance it by sizeof uint32_t
-   *      )
-   *    )
-   */
-  switch (*(uint32_t *)((char *)cb + sizeof(uint32_t)))
+  HM_GET_LONG(index, init_msg->hdr.hw_id);
+  HM_GET_LONG(version, init_msg->version);
+  if (version != HM_PEER_PROTOCOL_VERSION)
   {
-    case HM_TABLE_TYPE_NODES:
-      TRACE_DETAIL(("Nodes Table Update"));
-      msg = hm_get_buffer(sizeof(HM_PEER_MSG_NODE_UPDATE));
-
-      if (msg == NULL)
-      {
-        TRACE_ERROR(("Error allocating buffer for Node Update"));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
-
-      node_update = (HM_PEER_MSG_NODE_UPDATE *)msg->msg;
-      memset(node_update, 0, sizeof(HM_PEER_MSG_NODE_UPDATE));
-      HM_PUT_LONG(node_update->hdr.hw_id, LOCAL.local_location_cb.index);
-      HM_PUT_LONG(node_update->hdr.msg_type, HM_PEER_MSG_TYPE_NODE_UPDATE);
-      HM_PUT_LONG(node_update->hdr.timestamp, 0);
-
-      HM_PUT_LONG(node_update->node_group, glob_cb.node_cb->group_index);
-      HM_PUT_LONG(node_update->node_id, glob_cb.node_cb->index);
-      HM_PUT_LONG(node_update->node_role, glob_cb.node_cb->role);
-
-      if (glob_cb.node_cb->status == HM_NODE_FSM_STATE_ACTIVE)
-      {
-        HM_PUT_LONG(node_update->status, HM_PEER_ENTITY_STATUS_ACTIVE);
-      }
-      else
-      {
-        HM_PUT_LONG(node_update->status, HM_PEER_ENTITY_STATUS_INACTIVE);
-      }
+    TRACE_WARN(("Location %d speaks peer protocol version %d, we speak %d.",
+                index, version, HM_PEER_PROTOCOL_VERSION));
+    goto EXIT_LABEL;
+  }
 
-      break;
+  HM_GET_LONG(role, init_msg->aggregation_role);
+  HM_GET_LONG(aggregator, init_msg->aggregator);
+  may_peer = hm_cluster_may_peer(index, role, aggregator);
 
-    case HM_TABLE_TYPE_PROCESS:
-      TRACE_DETAIL(("Processes Table"));
-      msg = hm_get_buffer(sizeof(HM_PEER_MSG_PROCESS_UPDATE));
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (may_peer);
+}/* hm_cluster_init_may_peer */
 
-      if (msg == NULL)
-      {
-        TRACE_ERROR(("Error allocating buffer for Process Update"));
-        ret_val = HM_ERR;
-        goto EXIT_LABEL;
-      }
 
-      proc_update = (HM_PEER_MSG_PROCESS_UPDATE *)msg->msg;
-      memset(proc_update, 0, sizeof(HM_PEER_MSG_PROCESS_UPDATE));
-      HM_PUT_LONG(proc_update->hdr.hw_id, LOCAL.local_location_cb.index);
-      HM_PUT_LONG(proc_update->hdr.msg_type, HM_PEER_MSG_TYPE_PROCESS_UPDATE);
-      HM_PUT_LONG(proc_update->hdr.timestamp, 0);
+/**
+ *  @brief Tells if a peer is a leaf which has us for its aggregator
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return TRUE if it is one of our leaves, FALSE otherwise
+ */
+uint32_t hm_cluster_is_our_leaf(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-      HM_PUT_LONG(proc_update->proc_type, glob_cb.process_cb->type);
-      HM_PUT_LONG(proc_update->proc_id, glob_cb.process_cb->pid);
-      HM_PUT_LONG(proc_update->node_id, glob_cb.process_cb->node_index);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return ((loc_cb->aggregation_role == HM_AGGREGATION_ROLE_LEAF) &&
+          (loc_cb->aggregator == LOCAL.local_location_cb.index));
+}/* hm_cluster_is_our_leaf */
 
-      if (glob_cb.process_cb->status == TRUE)
-      {
-        HM_PUT_LONG(proc_update->status, HM_PEER_ENTITY_STATUS_ACTIVE);
-      }
-      else
-      {
-        HM_PUT_LONG(proc_update->status, HM_PEER_ENTITY_STATUS_INACTIVE);
-      }
 
-      break;
+/**
+ *  @brief Tells if we pass on to a peer what we learnt from another
+ *
+ *  An aggregator passes what its leaves tell it to everyone, and what the
+ *  other aggregators tell it to its leaves. Nothing goes back to where it
+ *  came from.
+ *
+ *  @param *from Location CB (#HM_LOCATION_CB) of the peer we learnt it from
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer to pass it to
+ *  @return TRUE if it must be passed on, FALSE otherwise
+ */
+uint32_t hm_cluster_relays_to(HM_LOCATION_CB *from, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t relay = FALSE;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-    case HM_TABLE_TYPE_LOCATION:
-      TRACE_DETAIL(("Location Table"));
+  TRACE_ASSERT(from != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if ((LOCAL.aggregation_role != HM_AGGREGATION_ROLE_AGGREGATOR) ||
+      (loc_cb == from))
+  {
+    goto EXIT_LABEL;
+  }
 
-      break;
+  if (hm_cluster_is_our_leaf(from))
+  {
+    relay = TRUE;
+    goto EXIT_LABEL;
+  }
 
-    case HM_TABLE_TYPE_NODES_LOCAL:
-      TRACE_ERROR(("Local Node Structure. Find its Global Entry."));
-      TRACE_ASSERT(FALSE);
-      break;
+  relay = hm_cluster_is_our_leaf(loc_cb);
 
-    case HM_TABLE_TYPE_LOCATION_LOCAL:
-      TRACE_ERROR(("Local Location Structure. Find its Global Entry."));
-      TRACE_ASSERT(FALSE);
-      break;
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (relay);
+}/* hm_cluster_relays_to */
 
-    case HM_TABLE_TYPE_PROCESS_LOCAL:
-      TRACE_ERROR(("Local Process Structure. Find its Global Entry."));
-      TRACE_ASSERT(FALSE);
-      break;
 
-    default:
-      TRACE_WARN(("Unknown type of subscriber"));
-      TRACE_ASSERT((FALSE));
-  }
+/**
+ *  @brief Returns the next free TLV in the Relay message being built
+ *
+ *  Works like hm_cluster_replay_next_tlv(), but the TLVs are those of another
+ *  location, which the message names.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer it goes to
+ *  @param *origin Location CB (#HM_LOCATION_CB) whose entities are relayed
+ *  @param **msg Relay message (#HM_MSG) being built. NULL if there is none.
+ *  @return Pointer to TLV (#HM_PEER_REPLAY_TLV) to fill, NULL on error
+ */
+HM_PEER_REPLAY_TLV * hm_cluster_relay_next_tlv(HM_LOCATION_CB *loc_cb,
+                        HM_LOCATION_CB *origin, HM_MSG **msg)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PEER_MSG_RELAY *relay_msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
+  uint32_t num_tlvs = 0;
+  uint32_t max_tlvs = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-  if (msg != NULL)
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  TRACE_ASSERT(origin != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  max_tlvs = (hm_cluster_frame_size(loc_cb) - HM_PEER_RELAY_MSG_SIZE(0)) /
+             sizeof(HM_PEER_REPLAY_TLV);
+
+  if (*msg != NULL)
   {
-    TRACE_DETAIL(("Try to send message to cluster."));
+    relay_msg = (HM_PEER_MSG_RELAY *)(*msg)->msg;
+    HM_GET_LONG(num_tlvs, relay_msg->replay.num_tlvs);
 
-    /***************************************************************************/
-    /* Later, it might be sending update only on the multicast port, but right */
-    /* now, we must loop through all Location CBs and send to each if its      */
-    /* connection in active.                           */
-    /***************************************************************************/
-    for (loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
-                  locations_tree_by_db_id);
-         loc_cb != NULL;
-         loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(loc_cb->node,
-                  locations_tree_by_db_id))
+    if ((num_tlvs == max_tlvs) &&
+        (hm_cluster_relay_flush(loc_cb, msg) != HM_OK))
     {
-      if (loc_cb->loc_cb->index == LOCAL.local_location_cb.index)
-      {
-        /***************************************************************************/
-        /* Don't send to itself!                           */
-        /***************************************************************************/
-        continue;
-      }
+      goto EXIT_LABEL;
+    }
+  }
 
-      if (loc_cb->loc_cb->peer_listen_cb->sock_cb == NULL ||
-          loc_cb->loc_cb->peer_listen_cb->sock_cb->sock_fd == -1)
-      {
-        /***************************************************************************/
-        /* Peer is not connected.                           */
-        /***************************************************************************/
-        TRACE_DETAIL(("Skipping %d", loc_cb->index));
-      }
+  if (*msg == NULL)
+  {
+    *msg = hm_get_buffer(HM_PEER_RELAY_MSG_SIZE(max_tlvs));
 
-      ret_val = hm_queue_on_transport(msg, loc_cb->loc_cb->peer_listen_cb, FALSE);
+    if (*msg == NULL)
+    {
+      TRACE_ERROR(("Error allocating memory for Relay Message."));
+      goto EXIT_LABEL;
     }
 
+    relay_msg = (HM_PEER_MSG_RELAY *)(*msg)->msg;
+    memset(relay_msg, 0, HM_PEER_RELAY_MSG_SIZE(max_tlvs));
+    HM_PUT_LONG(relay_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+    HM_PUT_LONG(relay_msg->hdr.msg_type, HM_PEER_MSG_TYPE_RELAY);
+    HM_PUT_LONG(relay_msg->hdr.timestamp, 0);
+    HM_PUT_LONG(relay_msg->origin, origin->index);
+
     /***************************************************************************/
-    /* We've sent/queued message on all transports. Release buffer on our side */
+    /* The inner Replay is never the last one: a relay does not end a replay. */
     /***************************************************************************/
-    hm_free_buffer(msg);
+    HM_PUT_LONG(relay_msg->replay.hdr.hw_id, origin->index);
+    HM_PUT_LONG(relay_msg->replay.hdr.msg_type, HM_PEER_MSG_TYPE_REPLAY);
+    HM_PUT_LONG(relay_msg->replay.last, 0);
   }
 
+  relay_msg = (HM_PEER_MSG_RELAY *)(*msg)->msg;
+  HM_GET_LONG(num_tlvs, relay_msg->replay.num_tlvs);
+  tlv = &relay_msg->replay.tlv[num_tlvs];
+  HM_PUT_LONG(relay_msg->replay.num_tlvs, num_tlvs + 1);
+
 EXIT_LABEL:
   /***************************************************************************/
   /* Exit Level Checks                             */
   /***************************************************************************/
   TRACE_EXIT();
-  return (ret_val);
-}/* hm_cluster_send_update */
+  return (tlv);
+}/* hm_cluster_relay_next_tlv */
+
 
 /**
- *  hm_cluster_exchange_binding
- *  @brief Sends out subscription bindings on the cluster
- *
- *  @param *src_cb A global table entry pointer for the local entity which subscribed.
- *  @param num_bindings Number of bindings to be propagated
- *  @param *reg_msg Register Message from which to extract requests
+ *  @brief Sends the Relay message being built, if any
  *
- *  @return Nothing
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer it goes to
+ *  @param **msg Relay message (#HM_MSG) being built. Reset to NULL once sent.
+ *  @return HM_OK if successful, HM_ERR otherwise
  */
-void hm_cluster_exchange_binding(void *cb, uint32_t num_bindings,
-                                 void *reg_msg)
+int32_t hm_cluster_relay_flush(HM_LOCATION_CB *loc_cb, HM_MSG **msg)
 {
   /***************************************************************************/
-  /* Local Variables                                                         */
+  /* Variable Declarations                           */
   /***************************************************************************/
-  HM_PEER_MSG_BINDING *bind_msg = NULL;
-  HM_PEER_BINDING_CB *binding_cb = NULL;
-  HM_REGISTER_TLV_CB *tlv = NULL;
-  uint32_t i = 0;
-  int32_t subscriber_type, reqd;
-  HM_SUBSCRIBER subscriber;
-
-  uint32_t packed = 0, total_packed = 0;
+  HM_PEER_MSG_RELAY *relay_msg = NULL;
+  HM_MSG *shrunk = NULL;
+  uint32_t num_tlvs = 0;
 
-  HM_MSG *msg = NULL;
-  HM_GLOBAL_LOCATION_CB *loc_cb;
+  int32_t ret_val = HM_OK;
   /***************************************************************************/
-  /* Sanity Checks                                                           */
+  /* Sanity Checks                               */
   /***************************************************************************/
   TRACE_ENTRY();
 
-  TRACE_ASSERT(cb != NULL);
-  TRACE_ASSERT(reg_msg != NULL);
-  TRACE_ASSERT(num_bindings > 0);
-
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
   /***************************************************************************/
-  /* Main Routine                                                            */
+  /* Main Routine                                 */
   /***************************************************************************/
-  reqd = (num_bindings / HM_PEER_NUM_TLVS_PER_UPDATE);
-
-  if ((num_bindings % HM_PEER_NUM_TLVS_PER_UPDATE) != 0)
+  if (*msg == NULL)
   {
-    reqd +=
-      (
-        (num_bindings % HM_PEER_NUM_TLVS_PER_UPDATE)
-        /
-        (num_bindings % HM_PEER_NUM_TLVS_PER_UPDATE)
-      ); /* or simply 1 */
+    TRACE_DETAIL(("Nothing pending."));
+    goto EXIT_LABEL;
   }
 
-  TRACE_DETAIL(("Require %d messages", reqd));
-  /* Determine subscriber type to set subscriber ID */
-  subscriber_type = *(int32_t *)((char *)cb + (uint32_t)(sizeof(int32_t)));
-  subscriber.void_cb = cb;
-  tlv = (HM_REGISTER_TLV_CB *)((HM_REGISTER_MSG *)reg_msg)->data;
+  relay_msg = (HM_PEER_MSG_RELAY *)(*msg)->msg;
+  HM_GET_LONG(num_tlvs, relay_msg->replay.num_tlvs);
+  HM_PUT_LONG(relay_msg->hdr.msg_len, HM_PEER_RELAY_MSG_SIZE(num_tlvs));
+  HM_PUT_LONG(relay_msg->replay.hdr.msg_len, HM_PEER_REPLAY_MSG_SIZE(num_tlvs));
 
-  while (reqd > 0)
+  if (HM_PEER_RELAY_MSG_SIZE(num_tlvs) < (*msg)->msg_len)
   {
-    bind_msg = NULL;
-    msg = hm_get_buffer(sizeof(HM_PEER_MSG_BINDING));
-
-    if (msg == NULL)
+    shrunk = hm_shrink_buffer(*msg, HM_PEER_RELAY_MSG_SIZE(num_tlvs));
+    if (shrunk != NULL)
     {
-      TRACE_ASSERT(msg != NULL);
-      TRACE_ERROR(("Error allocating binding message buffer."));
-      goto EXIT_LABEL;
+      *msg = shrunk;
     }
-
-    bind_msg = (HM_PEER_MSG_BINDING *)msg->msg;
-
-    memset(bind_msg, 0, sizeof(HM_PEER_MSG_BINDING));
-    HM_PUT_LONG(bind_msg->hdr.hw_id, LOCAL.local_location_cb.index);
-    HM_PUT_LONG(bind_msg->hdr.msg_type, HM_PEER_MSG_TYPE_BINDING);
-    HM_PUT_LONG(bind_msg->hdr.timestamp, 0);
-
-    packed = 0;
-
-    switch (subscriber_type)
+    else
     {
-      case HM_TABLE_TYPE_NODES_LOCAL:
-        TRACE_DETAIL(("Local Node Structure."));
-        HM_PUT_LONG(bind_msg->subscriber_nid, subscriber.proper_node_cb->index);
-        HM_PUT_LONG(bind_msg->subscriber_type, HM_PEER_REPLAY_UPDATE_TYPE_NODE);
-        break;
-
-      case HM_TABLE_TYPE_PROCESS_LOCAL:
-        TRACE_DETAIL(("Local Process Structure."));
-        HM_PUT_LONG(bind_msg->subscriber_nid,
-                    subscriber.proper_process_cb->parent_node_cb->index);
-        HM_PUT_LONG(bind_msg->subscriber_pid, subscriber.proper_process_cb->pid);
-        HM_PUT_LONG(bind_msg->subscriber_type, HM_PEER_REPLAY_UPDATE_TYPE_PROC);
-        break;
-
-      default:
-        TRACE_WARN(("Unknown type of subscriber %d", subscriber_type));
-        TRACE_ASSERT((FALSE));
+      (*msg)->msg_len = HM_PEER_RELAY_MSG_SIZE(num_tlvs);
     }
+  }
 
-    binding_cb = bind_msg->bindings;
-
-    while (i < ((HM_REGISTER_MSG *)reg_msg)->num_register
-           && packed < HM_PEER_NUM_TLVS_PER_UPDATE)
-    {
-      tlv = tlv + i;
-
-      if (tlv->cross_bind && packed < HM_PEER_NUM_TLVS_PER_UPDATE)
-      {
-        HM_PUT_LONG(binding_cb->subscription_id, tlv->id);
+  TRACE_DETAIL(("Relay %d entries to Location %d", num_tlvs, loc_cb->index));
+  if (hm_cluster_send_sequenced(*msg, loc_cb, HM_PRIORITY_NODE) != HM_OK)
+  {
+    TRACE_ERROR(("Error sending Relay message to peer!"));
+    ret_val = HM_ERR;
+  }
 
-        switch (((HM_REGISTER_MSG *)reg_msg)->type)
-        {
-          case HM_REG_SUBS_TYPE_GROUP:
-            TRACE_DETAIL(("Registering for Node Group"));
-            HM_PUT_LONG(binding_cb->subscription_type, HM_REG_SUBS_TYPE_GROUP);
-            break;
+  hm_free_buffer(*msg);
+  *msg = NULL;
 
-          case HM_REG_SUBS_TYPE_PROC:
-            TRACE_DETAIL(("Registering for Process Types"));
-            HM_PUT_LONG(binding_cb->subscription_type, HM_REG_SUBS_TYPE_PROC);
-            break;
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_relay_flush */
 
-          default:
-            TRACE_ERROR(("Registering for unsupported type: %d",
-                         ((HM_REGISTER_MSG *)reg_msg)->type));
-            TRACE_ASSERT(0 != 0);
-            break;
-        }
 
-        packed++;
-        total_packed++;
-        binding_cb = binding_cb + 1;
-      }
+/**
+ *  @brief Passes on a change to a node or process of another location
+ *
+ *  Only aggregators do this. The change goes to the peers we relay to from
+ *  where we learnt of it, as long as they have subscribers for it.
+ *
+ *  @param *cb Global Node or Process CB which was updated
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_relay_update(void *cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_SUBSCRIBER glob_cb;
+  HM_GLOBAL_LOCATION_CB *peer_cb = NULL;
+  HM_LOCATION_CB *origin = NULL;
+  HM_LOCATION_CB *from = NULL;
+  HM_MSG *msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
+  uint32_t table_type;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-      i++;
-    }
+  TRACE_ASSERT(cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  glob_cb.void_cb = cb;
+  table_type = *(uint32_t *)((char *)cb + sizeof(uint32_t));
+  if ((table_type != HM_TABLE_TYPE_NODES) &&
+      (table_type != HM_TABLE_TYPE_PROCESS))
+  {
+    TRACE_DETAIL(("Only Nodes and Processes are relayed."));
+    goto EXIT_LABEL;
+  }
 
+  origin = hm_global_owner(cb);
+  if (origin == NULL)
+  {
+    TRACE_WARN(("Owner of the update is not known."));
+    goto EXIT_LABEL;
+  }
+  from = (origin->via != NULL) ? origin->via : origin;
 
-    TRACE_DETAIL(("Try to send message to cluster."));
-    HM_PUT_LONG(bind_msg->num_bindings, packed);
+  for (peer_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       peer_cb != NULL;
+       peer_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(peer_cb->node,
+                 locations_tree_by_db_id))
+  {
+    if ((peer_cb->loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE) ||
+        (peer_cb->loc_cb->peer_listen_cb == NULL) ||
+        (!hm_cluster_relays_to(from, peer_cb->loc_cb)))
+    {
+      continue;
+    }
 
-    /***************************************************************************/
-    /* Later, it might be sending update only on the multicast port, but right */
-    /* now, we must loop through all Location CBs and send to each if its      */
-    /* connection in active.                           */
-    /***************************************************************************/
-    for (loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
-                  locations_tree_by_db_id);
-         loc_cb != NULL;
-         loc_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(loc_cb->node,
-                  locations_tree_by_db_id))
+    if ((table_type == HM_TABLE_TYPE_PROCESS) &&
+        (!hm_cluster_peer_wants(peer_cb->loc_cb, glob_cb.process_cb->type)))
     {
-      if (loc_cb->loc_cb->index == LOCAL.local_location_cb.index)
-      {
-        /***************************************************************************/
-        /* Don't send to itself!                           */
-        /***************************************************************************/
-        continue;
-      }
+      continue;
+    }
 
-      if (loc_cb->loc_cb->peer_listen_cb->sock_cb == NULL ||
-          loc_cb->loc_cb->peer_listen_cb->sock_cb->sock_fd == -1)
-      {
-        /***************************************************************************/
-        /* Peer is not connected.                           */
-        /***************************************************************************/
-        TRACE_DETAIL(("Skipping %d", loc_cb->index));
-      }
+    if ((tlv = hm_cluster_relay_next_tlv(peer_cb->loc_cb, origin, &msg)) == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
 
-      hm_queue_on_transport(msg, loc_cb->loc_cb->peer_listen_cb, FALSE);
+    if (table_type == HM_TABLE_TYPE_NODES)
+    {
+      hm_cluster_fill_node_tlv(tlv, glob_cb.node_cb->node_cb);
+    }
+    else
+    {
+      hm_cluster_fill_process_tlv(tlv, glob_cb.process_cb->proc_cb);
     }
 
     /***************************************************************************/
-    /* We've sent/queued message on all transports. Release buffer on our side */
+    /* The change may be ours: a leaf we lost has its nodes marked down here.*/
+    /* So it carries no version nor clock, and is applied as it comes.     */
     /***************************************************************************/
-    hm_free_buffer(msg);
-    reqd--;
-  }//end while
+    HM_PUT_LONG(tlv->version, 0);
+    hm_hlc_put(tlv->hlc, 0);
 
-  if (total_packed != num_bindings)
-  {
-    TRACE_ERROR(("Unequal bindings and packing values."));
-    TRACE_ASSERT(packed == num_bindings);
+    if (hm_cluster_relay_flush(peer_cb->loc_cb, &msg) != HM_OK)
+    {
+      ret_val = HM_ERR;
+    }
   }
 
 EXIT_LABEL:
   /***************************************************************************/
-  /* Exit Level Checks                                                       */
+  /* Exit Level Checks                             */
   /***************************************************************************/
+  if (msg != NULL)
+  {
+    hm_free_buffer(msg);
+  }
   TRACE_EXIT();
-  return;
-} /* hm_cluster_exchange_binding */
+  return (ret_val);
+}/* hm_cluster_relay_update */
 
 
 /**
- *  hm_cluster_recv_binding
- *  @brief Receive a subscription binding from the cluster
- *
- *  @param *msg Subscription binding message.
- *  @return True if successful, else FALSE
+ *  @brief Sends a peer everything we relay to it from the other locations
  *
- *  A subscription binding can never arrive before the create message for the
- *  entity that generated it was received. Consequently, it is guaranteed that
- *  the initiator has a cb present here.
+ *  Called when the peer becomes active, after our own replay to it. Nodes of
+ *  each location go first, then its running processes the peer wants.
  *
- *  Proceed from here as if it were a regular subscribe request received from
- *  a regular local node.
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the peer
+ *  @return HM_OK if successful, HM_ERR otherwise
  */
-uint32_t hm_cluster_recv_binding(HM_PEER_MSG_BINDING *msg,
-                                 HM_LOCATION_CB *loc_cb)
+int32_t hm_cluster_relay_tables(HM_LOCATION_CB *loc_cb)
 {
   /***************************************************************************/
-  /* Local Variables                                                         */
+  /* Variable Declarations                           */
   /***************************************************************************/
-  uint32_t ret_val = TRUE;
-  uint32_t subscriber_nid, subscriber_type, i, subscriber_pid;
-  uint32_t reg_type, value, num_bindings;
-  HM_SUBSCRIBER subscriber = {0};
-
-  HM_PEER_BINDING_CB *binding_cb = NULL;
-  HM_NODE_CB *node_cb  = NULL;
+  int32_t ret_val = HM_OK;
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_LOCATION_CB *origin = NULL;
+  HM_LOCATION_CB *from = NULL;
+  HM_NODE_CB *node_cb = NULL;
   HM_PROCESS_CB *proc_cb = NULL;
-
+  HM_MSG *msg = NULL;
+  HM_PEER_REPLAY_TLV *tlv = NULL;
   /***************************************************************************/
-  /* Sanity Checks                                                           */
+  /* Sanity Checks                               */
   /***************************************************************************/
   TRACE_ENTRY();
-  TRACE_ASSERT(msg != NULL);
-  TRACE_ASSERT(loc_cb != NULL);
 
+  TRACE_ASSERT(loc_cb != NULL);
   /***************************************************************************/
-  /* Main Routine                                                            */
+  /* Main Routine                                 */
   /***************************************************************************/
-  HM_GET_LONG(subscriber_nid, msg->subscriber_nid);
-  HM_GET_LONG(subscriber_type, msg->subscriber_type);
-  HM_GET_LONG(num_bindings, msg->num_bindings);
-  HM_GET_LONG(subscriber_pid, msg->subscriber_pid);
-  /* First find the corresponding subscriber. */
+  if (LOCAL.aggregation_role != HM_AGGREGATION_ROLE_AGGREGATOR)
+  {
+    goto EXIT_LABEL;
+  }
 
-  switch (subscriber_type)
+  for (glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                 locations_tree_by_db_id);
+       glob_cb != NULL;
+       glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                 locations_tree_by_db_id))
   {
-    case HM_PEER_REPLAY_UPDATE_TYPE_NODE:
-      TRACE_DETAIL(("Node subscriber"));
-      /* There will always be a node */
-      subscriber.node_cb = (HM_GLOBAL_NODE_CB *)HM_AVL3_FIND(LOCAL.nodes_tree,
-                           &subscriber_nid,
-                           nodes_tree_by_db_id);
+    origin = glob_cb->loc_cb;
+    if ((origin->index == LOCAL.local_location_cb.index) ||
+        (origin == loc_cb) ||
+        ((origin->fsm_state != HM_PEER_FSM_STATE_ACTIVE) &&
+         (origin->fsm_state != HM_PEER_FSM_STATE_DELEGATED)))
+    {
+      continue;
+    }
 
-      if (subscriber.node_cb == NULL)
-      {
-        TRACE_ERROR(("Binding received from a Node that we don't know about!"));
-        TRACE_ASSERT(FALSE);
-      }
+    from = (origin->via != NULL) ? origin->via : origin;
+    if (!hm_cluster_relays_to(from, loc_cb))
+    {
+      continue;
+    }
 
-      subscriber.proper_node_cb = subscriber.node_cb->node_cb;
-#ifdef I_WANT_TO_DEBUG
-      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
-                                           &subscriber_nid,
-                                           nodes_tree_by_node_id);
+    TRACE_DETAIL(("Relay tables of Location %d to Location %d", origin->index,
+                  loc_cb->index));
 
-      if (node_cb == NULL)
+    for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(origin->node_tree,
+                   nodes_tree_by_node_id);
+         node_cb != NULL;
+         node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                   nodes_tree_by_node_id))
+    {
+      if ((tlv = hm_cluster_relay_next_tlv(loc_cb, origin, &msg)) == NULL)
       {
-        TRACE_ERROR(("Node with index %d not found in location %d", subscriber_nid,
-                     loc_cb->index));
-        TRACE_ASSERT(FALSE);
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
       }
+      hm_cluster_fill_node_tlv(tlv, node_cb);
+      HM_PUT_LONG(tlv->version, 0);
+      hm_hlc_put(tlv->hlc, 0);
+    }
 
-      TRACE_ASSERT(node_cb == subscriber.proper_node_cb);
-#endif
-      /********************************************************************//**
-       * Explicitly set void cb so that others do not spend time wasting how
-       * void_cb gets automatically initialized while initalizing proper_node_cb
-       * or proper_process_cb
-       ***********************************************************************/
-      subscriber.void_cb = subscriber.proper_node_cb;
-
-      break;
-
-    case HM_PEER_REPLAY_UPDATE_TYPE_PROC:
-      TRACE_DETAIL(("Process subscriber"));
-      /* Need Proc Type and PID to get the Process CB. Scan Location's Tree */
-      node_cb = (HM_NODE_CB *)HM_AVL3_FIND(loc_cb->node_tree,
-                                           &subscriber_nid,
-                                           nodes_tree_by_node_id);
-
-      if (node_cb == NULL)
+    for (node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(origin->node_tree,
+                   nodes_tree_by_node_id);
+         node_cb != NULL;
+         node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node,
+                   nodes_tree_by_node_id))
+    {
+      for (proc_cb = (HM_PROCESS_CB *)HM_AVL3_FIRST(node_cb->process_tree,
+                     node_process_tree_by_proc_type_and_pid);
+           proc_cb != NULL;
+           proc_cb = (HM_PROCESS_CB *)HM_AVL3_NEXT(proc_cb->node,
+                     node_process_tree_by_proc_type_and_pid))
       {
-        TRACE_ERROR(("Node with index %d not found in location %d", subscriber_nid,
-                     loc_cb->index));
+        if ((proc_cb->running == FALSE) ||
+            (!hm_cluster_peer_wants(loc_cb, proc_cb->type)))
+        {
+          continue;
+        }
 
-        TRACE_ASSERT(FALSE);
+        if ((tlv = hm_cluster_relay_next_tlv(loc_cb, origin, &msg)) == NULL)
+        {
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+        hm_cluster_fill_process_tlv(tlv, proc_cb);
+        HM_PUT_LONG(tlv->version, 0);
+        hm_hlc_put(tlv->hlc, 0);
       }
+    }
 
-      proc_cb = HM_AVL3_FIRST(node_cb->process_tree,
-                              node_process_tree_by_proc_type_and_pid);
-
-      while (proc_cb != NULL && proc_cb->pid != subscriber_pid)
-      {
-        proc_cb = HM_AVL3_NEXT(proc_cb->node,
-                               node_process_tree_by_proc_type_and_pid);
-      }
+    /***************************************************************************/
+    /* A Relay message carries entities of one location only.         */
+    /***************************************************************************/
+    if (hm_cluster_relay_flush(loc_cb, &msg) != HM_OK)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+  }
 
-      if (proc_cb != NULL)
-      {
-        TRACE_DETAIL(("Found Process CB"));
-        subscriber.proper_process_cb = proc_cb;
-      }
-      else
-      {
-        TRACE_ERROR(("Binding received from a Process that we don't know about!"));
-        TRACE_ASSERT(FALSE);
-      }
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (msg != NULL)
+  {
+    hm_free_buffer(msg);
+  }
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_cluster_relay_tables */
 
-      /********************************************************************//**
-       * Explicitly set void cb so that others do not spend time wasting how
-       * void_cb gets automatically initialized while initalizing proper_node_cb
-       * or proper_process_cb
-       ***********************************************************************/
 
-      subscriber.void_cb = subscriber.proper_process_cb;
-      break;
+/**
+ *  @brief Processes a Relay message from an aggregator
+ *
+ *  A location we do not peer with is added the first time we hear of it, in
+ *  delegated state: whatever it is, the aggregator tells us.
+ *
+ *  @param *msg Relay message (#HM_PEER_MSG_RELAY) received
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the aggregator
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_cluster_recv_relay(HM_PEER_MSG_RELAY *msg, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_LOCATION_CB *origin = NULL;
+  uint32_t index;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
 
-    default:
-      TRACE_ERROR(("Unsupported type: %d", subscriber_type));
-      TRACE_ASSERT(0 != 0);
-      break;
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_GET_LONG(index, msg->origin);
+  if (index == LOCAL.local_location_cb.index)
+  {
+    TRACE_DETAIL(("Relay of our own tables. Ignore."));
+    goto EXIT_LABEL;
   }
 
-  binding_cb = msg->bindings;
+  glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIND(LOCAL.locations_tree,
+            &index,
+            locations_tree_by_db_id);
+  if (glob_cb == NULL)
+  {
+    TRACE_INFO(("Location %d is known through Location %d", index,
+                loc_cb->index));
+    origin = hm_alloc_location_cb();
+    if (origin == NULL)
+    {
+      TRACE_ERROR(("Error allocating Location CB."));
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    origin->index = index;
+    origin->fsm_state = HM_PEER_FSM_STATE_DELEGATED;
+    origin->via = loc_cb;
 
-  for (i = 0; i < num_bindings; i++)
+    if ((hm_location_add(origin) != HM_OK) ||
+        (hm_location_update(origin) != HM_OK))
+    {
+      TRACE_ERROR(("Error adding Location %d", index));
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+  }
+  else
   {
-    binding_cb = binding_cb + i;
-    HM_GET_LONG(reg_type, binding_cb->subscription_type);
-    TRACE_DETAIL(("Registration Type: %d", reg_type));
-    TRACE_DETAIL(("Subscription ID: %d", value));
-    HM_GET_LONG(value, binding_cb->subscription_id);
+    origin = glob_cb->loc_cb;
+    if (origin->via == NULL)
+    {
+      TRACE_DETAIL(("We hear from Location %d directly. Ignore.", index));
+      goto EXIT_LABEL;
+    }
 
-    /* We've received it over a cluster. Don't need cross-bind. It already is.*/
-    if (hm_subscribe(reg_type, value, subscriber.void_cb, FALSE) != HM_OK)
+    origin->via = loc_cb;
+    if (origin->fsm_state != HM_PEER_FSM_STATE_DELEGATED)
     {
-      TRACE_ERROR(("Error creating subscriptions."));
-      ret_val = FALSE;
-      break;
+      TRACE_INFO(("Location %d is back through Location %d", index,
+                  loc_cb->index));
+      origin->fsm_state = HM_PEER_FSM_STATE_DELEGATED;
+      hm_location_update(origin);
     }
   }
 
+  ret_val = hm_cluster_process_replay(&msg->replay, origin);
+
+EXIT_LABEL:
   /***************************************************************************/
-  /* Exit Level Checks                                                       */
+  /* Exit Level Checks                             */
   /***************************************************************************/
   TRACE_EXIT();
   return (ret_val);
-} /* hm_cluster_recv_binding */
+}/* hm_cluster_recv_relay */
@@ -104,6 +104,26 @@ static int32_t hm_get_node_type(xmlNode *node)
   }
   /* Order of occurance is important while using strstr */
   /* ip occurs in subscr'ip'tions. So, first check for longest word first */
+  else if(strstr((const char *)node->name, "subscriber_queue") != NULL)
+  {
+    ret_val = HM_CONFIG_SUBS_QUEUE;
+  }
+  else if(strstr((const char *)node->name, "peer_frame") != NULL)
+  {
+    ret_val = HM_CONFIG_PEER_FRAME;
+  }
+  else if(strstr((const char *)node->name, "peer_replay") != NULL)
+  {
+    ret_val = HM_CONFIG_PEER_REPLAY;
+  }
+  else if(strstr((const char *)node->name, "membership") != NULL)
+  {
+    ret_val = HM_CONFIG_MEMBERSHIP;
+  }
+  else if(strstr((const char *)node->name, "aggregation") != NULL)
+  {
+    ret_val = HM_CONFIG_AGGREGATION;
+  }
   else if(strstr((const char *)node->name, "subscriptions") != NULL)
   {
     ret_val = HM_CONFIG_SUBSCRIPTION_TREE;
@@ -390,6 +410,7 @@ static int32_t hm_recurse_tree(xmlNode *begin_node, HM_STACK *stack, HM_CONFIG_C
 
       case HM_CONFIG_HEARTBEAT:
         TRACE_INFO(("Scope of Heartbeat: %s", xmlGetProp(current_node, (const xmlChar *)"scope")));
+        config_node->opaque = NULL;
         if((ret_val = hm_get_attr_type(xmlGetProp(current_node, (const xmlChar *)"scope")))== HM_ERR)
         {
           TRACE_WARN(("Error finding attribute type value. Ignoring!"));
@@ -417,6 +438,67 @@ static int32_t hm_recurse_tree(xmlNode *begin_node, HM_STACK *stack, HM_CONFIG_C
             TRACE_ERROR(("Unknown type %d", ret_val));
           }
         }
+        /***************************************************************************/
+        /* Suspicion at which it is declared down, instead of the threshold count */
+        /***************************************************************************/
+        if((config_node->opaque != NULL) &&
+           (xmlHasProp(current_node, (const xmlChar *)"phi") != NULL))
+        {
+          hb_config = (HM_HEARTBEAT_CONFIG *)config_node->opaque;
+          hb_config->phi_threshold =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"phi"));
+          TRACE_INFO(("Phi threshold: %d", hb_config->phi_threshold));
+        }
+        /***************************************************************************/
+        /* Nodes may be left to the kernel to watch, over their connections    */
+        /***************************************************************************/
+        if((config_node->opaque != NULL) &&
+           (xmlHasProp(current_node, (const xmlChar *)"liveness") != NULL))
+        {
+          hb_config = (HM_HEARTBEAT_CONFIG *)config_node->opaque;
+          switch (hm_get_attr_type(xmlGetProp(current_node,
+                                              (const xmlChar *)"liveness")))
+          {
+          case HM_CONFIG_ATTR_LIVENESS_APPLICATION:
+            hb_config->liveness = HM_LIVENESS_APPLICATION;
+            break;
+
+          case HM_CONFIG_ATTR_LIVENESS_KERNEL:
+            TRACE_INFO(("Liveness is detected by kernel"));
+            hb_config->liveness = HM_LIVENESS_KERNEL;
+            break;
+
+          default:
+            TRACE_WARN(("Unknown liveness mode. Ignoring!"));
+          }
+        }
+        /***************************************************************************/
+        /* Ticks may be kept off the main loop, on a thread of their own       */
+        /***************************************************************************/
+        if((config_node->opaque != NULL) &&
+           (xmlHasProp(current_node, (const xmlChar *)"thread") != NULL))
+        {
+          hb_config = (HM_HEARTBEAT_CONFIG *)config_node->opaque;
+          hb_config->thread = (xmlStrcmp(xmlGetProp(current_node,
+                          (const xmlChar *)"thread"), (const xmlChar *)"yes") == 0);
+          TRACE_INFO(("Heartbeat thread: %s", hb_config->thread ? "yes" : "no"));
+        }
+        if((config_node->opaque != NULL) &&
+           (xmlHasProp(current_node, (const xmlChar *)"priority") != NULL))
+        {
+          hb_config = (HM_HEARTBEAT_CONFIG *)config_node->opaque;
+          hb_config->priority =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"priority"));
+          TRACE_INFO(("Heartbeat thread priority: %d", hb_config->priority));
+        }
+        if((config_node->opaque != NULL) &&
+           (xmlHasProp(current_node, (const xmlChar *)"cpu") != NULL))
+        {
+          hb_config = (HM_HEARTBEAT_CONFIG *)config_node->opaque;
+          hb_config->cpu =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"cpu"));
+          TRACE_INFO(("Heartbeat thread CPU: %d", hb_config->cpu));
+        }
         HM_STACK_PUSH(stack, config_node);
         break;
 
@@ -752,17 +834,35 @@ static int32_t hm_recurse_tree(xmlNode *begin_node, HM_STACK *stack, HM_CONFIG_C
                 address_cb->comm_scope == HM_CONFIG_ATTR_SCOPE_CLUSTER)
           {
             TRACE_DETAIL(("IPv4 UDP Address for Multicast on cluster"));
-            hm_config->instance_info.mcast = address_cb;
             address_cb->address.type = HM_TRANSPORT_MCAST;
+            /***************************************************************************/
+            /* Each further multicast address is another path for heartbeats.      */
+            /***************************************************************************/
+            if (hm_config->instance_info.mcast == NULL)
+            {
+              hm_config->instance_info.mcast = address_cb;
+            }
+            else
+            {
+              TRACE_DETAIL(("Additional heartbeat path."));
+              HM_INIT_LQE(address_cb->node, address_cb);
+              HM_INSERT_BEFORE(hm_config->instance_info.heartbeat_paths,
+                               address_cb->node);
+            }
           }
           else if(  ip_version==HM_CONFIG_ATTR_IP_VERSION_4 &&
-                ip_type==HM_CONFIG_ATTR_IP_TYPE_TCP &&
+                (ip_type==HM_CONFIG_ATTR_IP_TYPE_TCP ||
+                 ip_type==HM_CONFIG_ATTR_IP_TYPE_UDP) &&
                 ip_scope==HM_CONFIG_ATTR_ADDR_TYPE_CLUSTER)
 
           {
             TRACE_DETAIL(("Remote Node information."));
             HM_INIT_LQE(address_cb->node, address_cb);
-            address_cb->address.type = HM_TRANSPORT_TCP_OUT;
+            /***************************************************************************/
+            /* A remote UDP address is a seed for gossip membership.          */
+            /***************************************************************************/
+            address_cb->address.type = (ip_type==HM_CONFIG_ATTR_IP_TYPE_UDP) ?
+                            HM_TRANSPORT_UDP : HM_TRANSPORT_TCP_OUT;
             address_cb->scope = HM_CONFIG_ATTR_ADDR_TYPE_CLUSTER;
             /***************************************************************************/
             /* Insert into List                               */
@@ -1043,6 +1143,168 @@ static int32_t hm_recurse_tree(xmlNode *begin_node, HM_STACK *stack, HM_CONFIG_C
         config_node->opaque = &hm_config->instance_info.ha_role;
         break;
 
+      case HM_CONFIG_SUBS_QUEUE:
+        TRACE_DETAIL(("Subscriber Queue Specifications."));
+        /***************************************************************************/
+        /* All values are carried in attributes. There is no value node to expect */
+        /***************************************************************************/
+        if((ret_val = hm_get_attr_type(xmlGetProp(current_node, (const xmlChar *)"policy")))== HM_ERR)
+        {
+          TRACE_WARN(("Error finding attribute type value. Ignoring!"));
+        }
+        else
+        {
+          switch (ret_val)
+          {
+          case HM_CONFIG_ATTR_QUEUE_DROP_OLDEST:
+            TRACE_INFO(("Subscriber queues drop oldest notifications on overflow"));
+            hm_config->instance_info.subs_queue.policy = HM_SUBS_QUEUE_POLICY_DROP_OLDEST;
+            break;
+          case HM_CONFIG_ATTR_QUEUE_COLLAPSE:
+            TRACE_INFO(("Subscriber queues collapse notifications per entity"));
+            hm_config->instance_info.subs_queue.policy = HM_SUBS_QUEUE_POLICY_COLLAPSE;
+            break;
+          case HM_CONFIG_ATTR_QUEUE_DISCONNECT:
+            TRACE_INFO(("Subscriber queues disconnect persistent slow consumers"));
+            hm_config->instance_info.subs_queue.policy = HM_SUBS_QUEUE_POLICY_DISCONNECT;
+            break;
+          default:
+            TRACE_ERROR(("Unknown type %d", ret_val));
+          }
+        }
+        if(xmlHasProp(current_node, (const xmlChar *)"messages") != NULL)
+        {
+          hm_config->instance_info.subs_queue.max_msgs =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"messages"));
+        }
+        if(xmlHasProp(current_node, (const xmlChar *)"bytes") != NULL)
+        {
+          hm_config->instance_info.subs_queue.max_bytes =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"bytes"));
+        }
+        if(xmlHasProp(current_node, (const xmlChar *)"overflows") != NULL)
+        {
+          hm_config->instance_info.subs_queue.max_overflows =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"overflows"));
+        }
+        TRACE_INFO(("Subscriber Queue: %d messages, %d bytes, disconnect after %d overflows",
+            hm_config->instance_info.subs_queue.max_msgs,
+            hm_config->instance_info.subs_queue.max_bytes,
+            hm_config->instance_info.subs_queue.max_overflows));
+        free(config_node);
+        config_node = NULL;
+        ret_val = HM_OK;
+        break;
+
+      case HM_CONFIG_PEER_FRAME:
+        TRACE_DETAIL(("Peer Frame Specifications."));
+        if(xmlHasProp(current_node, (const xmlChar *)"bytes") != NULL)
+        {
+          hm_config->instance_info.peer_frame_size =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"bytes"));
+        }
+        TRACE_INFO(("Peer Frame Size: %d bytes",
+            hm_config->instance_info.peer_frame_size));
+        free(config_node);
+        config_node = NULL;
+        ret_val = HM_OK;
+        break;
+
+      case HM_CONFIG_PEER_REPLAY:
+        TRACE_DETAIL(("Peer Replay Specifications."));
+        if(xmlHasProp(current_node, (const xmlChar *)"chunks") != NULL)
+        {
+          hm_config->instance_info.replay_chunks =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"chunks"));
+        }
+        if(xmlHasProp(current_node, (const xmlChar *)"rate") != NULL)
+        {
+          hm_config->instance_info.replay_rate =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"rate"));
+        }
+        TRACE_INFO(("Peer Replay: %d messages per turn, %d bytes per second",
+            hm_config->instance_info.replay_chunks,
+            hm_config->instance_info.replay_rate));
+        free(config_node);
+        config_node = NULL;
+        ret_val = HM_OK;
+        break;
+
+      case HM_CONFIG_MEMBERSHIP:
+        TRACE_DETAIL(("Membership Specifications."));
+        if((ret_val = hm_get_attr_type(xmlGetProp(current_node, (const xmlChar *)"mode")))== HM_ERR)
+        {
+          TRACE_WARN(("Error finding attribute type value. Ignoring!"));
+        }
+        else
+        {
+          switch (ret_val)
+          {
+          case HM_CONFIG_ATTR_MEMBERSHIP_MCAST:
+            TRACE_INFO(("Locations tick on the multicast group"));
+            hm_config->instance_info.membership = HM_MEMBERSHIP_MULTICAST;
+            break;
+          case HM_CONFIG_ATTR_MEMBERSHIP_GOSSIP:
+            TRACE_INFO(("Locations gossip membership"));
+            hm_config->instance_info.membership = HM_MEMBERSHIP_GOSSIP;
+            break;
+          default:
+            TRACE_ERROR(("Unknown type %d", ret_val));
+          }
+        }
+        if(xmlHasProp(current_node, (const xmlChar *)"fanout") != NULL)
+        {
+          hm_config->instance_info.gossip_fanout =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"fanout"));
+        }
+        TRACE_INFO(("Membership: %d, Fanout: %d",
+            hm_config->instance_info.membership,
+            hm_config->instance_info.gossip_fanout));
+        free(config_node);
+        config_node = NULL;
+        ret_val = HM_OK;
+        break;
+
+      case HM_CONFIG_AGGREGATION:
+        TRACE_DETAIL(("Aggregation Specifications."));
+        if((ret_val = hm_get_attr_type(xmlGetProp(current_node, (const xmlChar *)"role")))== HM_ERR)
+        {
+          TRACE_WARN(("Error finding attribute type value. Ignoring!"));
+        }
+        else
+        {
+          switch (ret_val)
+          {
+          case HM_CONFIG_ATTR_AGGREGATION_MESH:
+            TRACE_INFO(("Peer with every location"));
+            hm_config->instance_info.aggregation_role = HM_AGGREGATION_ROLE_MESH;
+            break;
+          case HM_CONFIG_ATTR_AGGREGATION_AGGREGATOR:
+            TRACE_INFO(("Aggregate the locations that name us"));
+            hm_config->instance_info.aggregation_role =
+                                              HM_AGGREGATION_ROLE_AGGREGATOR;
+            break;
+          case HM_CONFIG_ATTR_AGGREGATION_LEAF:
+            TRACE_INFO(("Peer with our aggregator only"));
+            hm_config->instance_info.aggregation_role = HM_AGGREGATION_ROLE_LEAF;
+            break;
+          default:
+            TRACE_ERROR(("Unknown type %d", ret_val));
+          }
+        }
+        if(xmlHasProp(current_node, (const xmlChar *)"aggregator") != NULL)
+        {
+          hm_config->instance_info.aggregator =
+             atoi((const char *)xmlGetProp(current_node, (const xmlChar *)"aggregator"));
+        }
+        TRACE_INFO(("Aggregation role: %d, Aggregator: %d",
+            hm_config->instance_info.aggregation_role,
+            hm_config->instance_info.aggregator));
+        free(config_node);
+        config_node = NULL;
+        ret_val = HM_OK;
+        break;
+
       default:
         /***************************************************************************/
         /* UNHITTABLE                                 */
@@ -1284,6 +1546,11 @@ static int32_t hm_recurse_tree(xmlNode *begin_node, HM_STACK *stack, HM_CONFIG_C
               goto EXIT_LABEL;
             }
             TRACE_INFO(("Multicast Group: %s", current_node->content));
+            address_cb = (HM_CONFIG_ADDRESS_CB *)parent_node->opaque;
+            if (address_cb != NULL)
+            {
+              address_cb->address.mcast_group = atoi((const char *)current_node->content);
+            }
           }
           else if(parent_node->type == HM_CONFIG_NODE_INSTANCE)
           {
@@ -1420,7 +1687,8 @@ EXIT_LABEL:
  *    config      : Root of config
  *    hm_instance_info: Config for HM Binary
  *    index      : Index value
- *    heartbeat    : Heartbeat Configuration
+ *    heartbeat    : Heartbeat Configuration. Optional phi threshold, and
+ *                   liveness of nodes by application keepalives or kernel
  *    period      : Timer Value
  *    threshold    : Maximum number of timeouts
  *    address      : Inet Address structure
@@ -1431,6 +1699,11 @@ EXIT_LABEL:
  *    node      : Single Node in cluster
  *    name      : String Name
  *    role      : Active/Passive
+ *    subscriber_queue: Bounds and overflow policy of subscriber queues
+ *    peer_frame: Largest message sent to a peer HM
+ *    peer_replay: Replay messages sent per turn of the main loop, and rate cap
+ *    membership: Multicast ticks or gossip, and gossip fanout
+ *    aggregation: Role as mesh, aggregator or leaf, and the aggregator of a leaf
  *    Group
  *
  *  @param *config_cb #HM_CONFIG_CB type of configuration Control Block
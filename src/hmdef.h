@@ -116,6 +116,12 @@
 #define HM_PEER_FSM_STATE_FAILED                  ((uint16_t) 3)
 
 #define HM_PEER_FSM_NUM_STATES                    ((uint32_t) 4)
+
+/***************************************************************************/
+/* A location known only through an aggregator. It has no connection of   */
+/* its own, and is never run through the Peer FSM.                         */
+/***************************************************************************/
+#define HM_PEER_FSM_STATE_DELEGATED               ((uint16_t) 4)
 /***************************************************************************/
 /* Group: Peer FSM Signals                                                 */
 /***************************************************************************/
@@ -189,6 +195,11 @@
 #define   HM_CONFIG_ROLE                            ((uint32_t) 15)
 #define   HM_CONFIG_SUBSCRIPTION_INSTANCE           ((uint32_t) 16)
 #define   HM_CONFIG_HA_SPECS                        ((uint32_t) 17)
+#define   HM_CONFIG_SUBS_QUEUE                      ((uint32_t) 18)
+#define   HM_CONFIG_PEER_FRAME                      ((uint32_t) 19)
+#define   HM_CONFIG_MEMBERSHIP                      ((uint32_t) 20)
+#define   HM_CONFIG_AGGREGATION                     ((uint32_t) 21)
+#define   HM_CONFIG_PEER_REPLAY                     ((uint32_t) 22)
 
 /***************************************************************************/
 /* Attribute values vocabulary                                             */
@@ -215,6 +226,20 @@
 #define HM_CONFIG_ATTR_SUBS_TYPE_IF                 ((uint32_t) 14)
 #define HM_CONFIG_ATTR_SUBS_TYPE_LOCATION           ((uint32_t) 15)
 #define HM_CONFIG_ATTR_SUBS_TYPE_NODE               ((uint32_t) 16)
+/* Subscriber queue overflow policies */
+#define HM_CONFIG_ATTR_QUEUE_DROP_OLDEST            ((uint32_t) 17)
+#define HM_CONFIG_ATTR_QUEUE_COLLAPSE               ((uint32_t) 18)
+#define HM_CONFIG_ATTR_QUEUE_DISCONNECT             ((uint32_t) 19)
+/* Membership modes */
+#define HM_CONFIG_ATTR_MEMBERSHIP_MCAST             ((uint32_t) 20)
+#define HM_CONFIG_ATTR_MEMBERSHIP_GOSSIP            ((uint32_t) 21)
+/* Liveness detection of nodes */
+#define HM_CONFIG_ATTR_LIVENESS_APPLICATION         ((uint32_t) 22)
+#define HM_CONFIG_ATTR_LIVENESS_KERNEL              ((uint32_t) 23)
+/* Roles in an aggregated cluster */
+#define HM_CONFIG_ATTR_AGGREGATION_MESH             ((uint32_t) 24)
+#define HM_CONFIG_ATTR_AGGREGATION_AGGREGATOR       ((uint32_t) 25)
+#define HM_CONFIG_ATTR_AGGREGATION_LEAF             ((uint32_t) 26)
 
 /***************************************************************************/
 /* Scope of configuration                                                  */
@@ -230,11 +255,191 @@
 #define HM_CONFIG_DEFAULT_NODE_TICK_TIME            ((uint32_t) 1000)
 #define HM_CONFIG_DEFAULT_PEER_TICK_TIME            ((uint32_t) 1000)
 
+/***************************************************************************/
+/* Phi accrual failure detection. A threshold of 0 keeps counting missed   */
+/* keepalives against the kickout value instead.                           */
+/***************************************************************************/
+#define HM_CONFIG_DEFAULT_PHI_THRESHOLD             ((uint32_t) 0)
+
+/***************************************************************************/
+/* How a node is known to be alive: by its keepalives, or by the kernel   */
+/* probing its connection with the heartbeat period and threshold.        */
+/***************************************************************************/
+#define HM_LIVENESS_APPLICATION                     ((uint32_t) 1)
+#define HM_LIVENESS_KERNEL                          ((uint32_t) 2)
+#define HM_CONFIG_DEFAULT_LIVENESS                  HM_LIVENESS_APPLICATION
+
+/***************************************************************************/
+/* Ticks of the cluster may be sent, heard and judged on a thread of their */
+/* own, optionally at a SCHED_FIFO priority (0: normal scheduling) and on a */
+/* given CPU (-1: any).                            */
+/***************************************************************************/
+#define HM_CONFIG_DEFAULT_HEARTBEAT_THREAD          FALSE
+#define HM_CONFIG_DEFAULT_HEARTBEAT_PRIORITY        ((int32_t) 0)
+#define HM_CONFIG_DEFAULT_HEARTBEAT_CPU             ((int32_t) -1)
+
+/***************************************************************************/
+/* What the heartbeat thread tells the main loop                           */
+/***************************************************************************/
+#define HM_HEARTBEAT_EVENT_TICK                     ((uint32_t) 1)
+#define HM_HEARTBEAT_EVENT_DOWN                     ((uint32_t) 2)
+
+/***************************************************************************/
+/* Inter-arrival times of keepalives remembered per entity, how many there */
+/* must be before phi is trusted, and the least deviation assumed of them, */
+/* so that a perfectly regular sender is not declared down on a hiccup.    */
+/***************************************************************************/
+#define HM_PHI_WINDOW_SIZE                          ((uint32_t) 32)
+#define HM_PHI_MIN_SAMPLES                          ((uint32_t) 4)
+#define HM_PHI_MIN_STD_DEV_MS                       ((uint32_t) 50)
+
 #define HM_DEFAULT_TCP_LISTEN_PORT                  ((uint32_t) 0x8000)
 #define HM_DEFAULT_UDP_COMM_PORT                    ((uint32_t) 0x8001)
 #define HM_DEFAULT_MCAST_COMM_PORT                  ((uint32_t) 0x8002)
 #define HM_DEFAULT_MCAST_GROUP                      ((uint32_t) 3)
 
+#define HM_CONFIG_DEFAULT_SUBS_QUEUE_POLICY         HM_SUBS_QUEUE_POLICY_COLLAPSE
+#define HM_CONFIG_DEFAULT_SUBS_QUEUE_MSGS           ((uint32_t) 64)
+#define HM_CONFIG_DEFAULT_SUBS_QUEUE_BYTES          ((uint32_t) 32768)
+#define HM_CONFIG_DEFAULT_SUBS_QUEUE_OVERFLOWS      ((uint32_t) 16)
+
+#define HM_CONFIG_DEFAULT_PEER_FRAME_SIZE           ((uint32_t) 16384)
+
+#define HM_CONFIG_DEFAULT_REPLAY_CHUNKS             ((uint32_t) 8)
+#define HM_CONFIG_DEFAULT_REPLAY_RATE               ((uint32_t) 0)
+
+#define HM_CONFIG_DEFAULT_MEMBERSHIP                HM_MEMBERSHIP_MULTICAST
+#define HM_CONFIG_DEFAULT_GOSSIP_FANOUT             ((uint32_t) 3)
+
+/***************************************************************************/
+/* Peer streams over UDP: messages a peer may have unacknowledged, and the */
+/* wait in ms after which an unacknowledged message is sent again: the     */
+/* round trip plus four deviations, but no less than the minimum, and the  */
+/* initial value till the round trip has been measured. It doubles with   */
+/* every timeout on a lane upto the maximum, till an ack makes progress.  */
+/* Over TCP, the kernel orders and paces the stream; nothing is windowed. */
+/***************************************************************************/
+#define HM_PEER_WINDOW_SIZE                         ((uint32_t) 64)
+#define HM_PEER_RTO_MIN_MSEC                        ((uint32_t) 200)
+#define HM_PEER_RTO_INITIAL_MSEC                    ((uint32_t) 1000)
+#define HM_PEER_RTO_MAX_MSEC                        ((uint32_t) 16000)
+
+/***************************************************************************/
+/* How locations find each other and tell if one is down:                  */
+/* Multicast: Every location multicasts a Keepalive each period.           */
+/* Gossip: Every location probes one other each period, asking a few more  */
+/* to probe for it if there is no answer. Membership changes ride on the   */
+/* probes.                                                                 */
+/***************************************************************************/
+#define HM_MEMBERSHIP_MULTICAST                     ((uint32_t) 1)
+#define HM_MEMBERSHIP_GOSSIP                        ((uint32_t) 2)
+
+/***************************************************************************/
+/* Role of a location in an aggregated cluster. Carried in Ticks and INIT. */
+/* Mesh: Peers with every location it discovers, as without aggregation.  */
+/* Aggregator: Peers with other aggregators and its own leaves, and passes */
+/* on to each what it learns of the other.                                 */
+/* Leaf: Peers with its aggregator only, and learns the rest through it.   */
+/***************************************************************************/
+#define HM_AGGREGATION_ROLE_MESH                    ((uint32_t) 0)
+#define HM_AGGREGATION_ROLE_AGGREGATOR              ((uint32_t) 1)
+#define HM_AGGREGATION_ROLE_LEAF                    ((uint32_t) 2)
+#define HM_CONFIG_DEFAULT_AGGREGATION_ROLE          HM_AGGREGATION_ROLE_MESH
+
+/***************************************************************************/
+/* Gossip: membership changes carried on one message, and how many times a */
+/* change is sent for each doubling of the cluster size.                   */
+/***************************************************************************/
+#define HM_GOSSIP_MAX_PIGGYBACK                     ((uint32_t) 8)
+#define HM_GOSSIP_RETRANSMIT_MULT                   ((uint32_t) 3)
+
+/***************************************************************************/
+/* Gossip: one probe round in so many goes to a member held dead, in case  */
+/* it was only partitioned away.                                           */
+/***************************************************************************/
+#define HM_GOSSIP_DEAD_PROBE_ROUNDS                 ((uint32_t) 8)
+
+/***************************************************************************/
+/* Gossip: stage of the probe of a member in the current period           */
+/***************************************************************************/
+#define HM_GOSSIP_PROBE_NONE                        ((uint32_t) 0)
+#define HM_GOSSIP_PROBE_DIRECT                      ((uint32_t) 1)
+#define HM_GOSSIP_PROBE_INDIRECT                    ((uint32_t) 2)
+#define HM_GOSSIP_PROBE_ACKED                       ((uint32_t) 3)
+
+/***************************************************************************/
+/* Anti-entropy: peers compare digests of the tables once these many ticks */
+/***************************************************************************/
+#define HM_DIGEST_INTERVAL_TICKS                    ((uint32_t) 10)
+
+/***************************************************************************/
+/* A full replay snapshot is rebuilt once our tables have moved on by more */
+/* than these many versions. Till then, joining peers get it followed by  */
+/* what changed since.                            */
+/***************************************************************************/
+#define HM_REPLAY_SNAPSHOT_MAX_LAG                  ((uint32_t) 64)
+
+/***************************************************************************/
+/* Stages of a replay under way                       */
+/***************************************************************************/
+#define HM_REPLAY_STAGE_IDLE                        ((uint32_t) 0)
+#define HM_REPLAY_STAGE_SNAPSHOT                    ((uint32_t) 1)
+#define HM_REPLAY_STAGE_NODES                       ((uint32_t) 2)
+#define HM_REPLAY_STAGE_PROCESSES                   ((uint32_t) 3)
+
+/***************************************************************************/
+/* Passes a replay makes at most to catch up with changes made while it   */
+/* was under way. Changes during the last pass go out as live updates.    */
+/***************************************************************************/
+#define HM_REPLAY_MAX_PASSES                        ((uint32_t) 3)
+
+/***************************************************************************/
+/* While replays are under way, the main loop comes back to them at least  */
+/* this often (in microseconds), even if nothing else happens.        */
+/***************************************************************************/
+#define HM_REPLAY_POLL_USEC                         ((uint32_t) 10000)
+
+/***************************************************************************/
+/* Hybrid logical clock: wall clock in ms above the low bits, which count */
+/* events within the same ms. A peer whose clock is ahead of ours by more */
+/* than the drift bound is not followed.                   */
+/***************************************************************************/
+#define HM_HLC_LOGICAL_BITS                         16
+#define HM_HLC_MAX_DRIFT_MS                         ((uint64_t) 60000)
+
+/***************************************************************************/
+/* Multicast addresses that each carry a copy of our Keepalives. A tick  */
+/* heard on one path is not acted on again when it arrives on another, so */
+/* we remember the last few ticks heard.                    */
+/***************************************************************************/
+#define HM_MAX_HEARTBEAT_PATHS                      ((uint32_t) 4)
+#define HM_RECENT_TICKS                             ((uint32_t) 64)
+
+/***************************************************************************/
+/* Message priority classes. Lower value is served first.                  */
+/* Control messages (INIT/Register responses) are always sent first. Rest  */
+/* share the socket by weight, so no class waits behind another's backlog. */
+/***************************************************************************/
+#define HM_PRIORITY_CONTROL                         ((uint32_t) 0)
+#define HM_PRIORITY_HA                              ((uint32_t) 1)
+#define HM_PRIORITY_NODE                            ((uint32_t) 2)
+#define HM_PRIORITY_PROCESS                         ((uint32_t) 3)
+#define HM_PRIORITY_INFO                            ((uint32_t) 4)
+#define HM_NUM_PRIORITIES                           ((uint32_t) 5)
+
+/* Messages sent from a class in one round while lower classes are waiting */
+#define HM_PRIORITY_WEIGHT_HA                       ((uint32_t) 8)
+#define HM_PRIORITY_WEIGHT_NODE                     ((uint32_t) 4)
+#define HM_PRIORITY_WEIGHT_PROCESS                  ((uint32_t) 2)
+#define HM_PRIORITY_WEIGHT_INFO                     ((uint32_t) 1)
+
+/***************************************************************************/
+/* Subscriber queue overflow policies                                      */
+/***************************************************************************/
+#define HM_SUBS_QUEUE_POLICY_DROP_OLDEST            ((uint32_t) 1)
+#define HM_SUBS_QUEUE_POLICY_COLLAPSE               ((uint32_t) 2)
+#define HM_SUBS_QUEUE_POLICY_DISCONNECT             ((uint32_t) 3)
+
 /***************************************************************************/
 /* Table Types                                                             */
 /***************************************************************************/
@@ -37,6 +37,8 @@ HM_SUBSCRIPTION_CB * hm_alloc_subscription_cb();
 void hm_free_subscription_cb(HM_SUBSCRIPTION_CB *);
 HM_NOTIFICATION_CB * hm_alloc_notify_cb();
 void hm_free_notify_cb(HM_NOTIFICATION_CB *);
+HM_HEARTBEAT_PATH * hm_alloc_heartbeat_path(HM_TRANSPORT_CB *, HM_TRANSPORT_CB *);
+void hm_free_heartbeat_path(HM_HEARTBEAT_PATH *);
 //HM_TRANSPORT_CB * hm_init_transport_cb(  uint32_t );
 
 /* hmlocmgmt.c */
@@ -47,16 +49,118 @@ int32_t hm_location_remove(HM_LOCATION_CB *);
 int32_t hm_peer_keepalive_callback(void *);
 
 /* hmcluster.c */
-void hm_cluster_check_location(HM_MSG *, SOCKADDR *);
+void hm_cluster_check_location(HM_MSG *, SOCKADDR *, uint32_t);
+HM_LOCATION_CB *hm_cluster_find_peer(uint32_t);
+HM_LOCATION_CB *hm_cluster_add_datagram_peer(uint32_t, SOCKADDR *);
+int32_t hm_cluster_recv_datagram(HM_TRANSPORT_CB *, SOCKADDR *);
 void hm_cluster_send_tick();
-int32_t hm_cluster_replay_info(HM_TRANSPORT_CB *);
-int32_t hm_cluster_send_end_of_replay(HM_TRANSPORT_CB *);
-int32_t hm_receive_cluster_message(HM_SOCKET_CB *);
+int32_t hm_cluster_send_ack(HM_LOCATION_CB *);
+void hm_cluster_read_keepalive_acks(HM_PEER_MSG_KEEPALIVE *, uint32_t, HM_LOCATION_CB *);
+void hm_cluster_put_ack(HM_PEER_ACK *, HM_LOCATION_CB *);
+void hm_cluster_put_echo(HM_PEER_ACK *, HM_LOCATION_CB *);
+void hm_cluster_measure_link(HM_PEER_MSG_KEEPALIVE *, HM_PEER_ACK *, HM_LOCATION_CB *);
+uint32_t hm_cluster_seen_tick(uint32_t, uint64_t);
+void hm_cluster_path_heard(HM_PATH_HEALTH *, uint32_t, uint32_t);
+void hm_cluster_path_missed(HM_PATH_HEALTH *, uint32_t);
+int32_t hm_cluster_replay_info(HM_TRANSPORT_CB *, uint32_t);
+void hm_cluster_replay_continue();
+int32_t hm_cluster_replay_step(HM_LOCATION_CB *);
+int32_t hm_cluster_replay_chunk(HM_LOCATION_CB *);
+HM_PROCESS_CB * hm_cluster_replay_next_process(HM_LOCATION_CB *);
+void hm_cluster_replay_cancel(HM_LOCATION_CB *);
+void hm_cluster_fill_node_tlv(HM_PEER_REPLAY_TLV *, HM_NODE_CB *);
+void hm_cluster_fill_process_tlv(HM_PEER_REPLAY_TLV *, HM_PROCESS_CB *);
+HM_PEER_REPLAY_TLV * hm_cluster_replay_next_tlv(HM_TRANSPORT_CB *, HM_MSG **, uint32_t);
+int32_t hm_cluster_replay_flush(HM_TRANSPORT_CB *, HM_MSG **);
+HM_MSG * hm_cluster_replay_new(uint32_t, uint32_t);
+void hm_cluster_replay_seal(HM_MSG **);
+HM_REPLAY_SNAPSHOT * hm_cluster_replay_snapshot(uint32_t);
+HM_PEER_REPLAY_TLV * hm_cluster_snapshot_next_tlv(HM_MSG **, uint32_t);
+int32_t hm_cluster_snapshot_append(HM_MSG **);
+void hm_cluster_drop_snapshot();
+int32_t hm_cluster_send_end_of_replay(HM_TRANSPORT_CB *, uint32_t);
+int32_t hm_receive_cluster_message(HM_TRANSPORT_CB *);
 int32_t hm_cluster_process_replay(HM_PEER_MSG_REPLAY *, HM_LOCATION_CB *);
 int32_t hm_cluster_send_update(void *);
 int32_t hm_cluster_send_init(HM_TRANSPORT_CB *);
+void hm_cluster_fill_init(HM_PEER_MSG_INIT *, HM_LOCATION_CB *);
+void hm_cluster_read_init(HM_PEER_MSG_INIT *, HM_LOCATION_CB *);
+void hm_cluster_forget_versions(HM_LOCATION_CB *);
+void hm_cluster_check_return(HM_LOCATION_CB *, HM_PEER_MSG_KEEPALIVE *);
+uint32_t hm_cluster_frame_size(HM_LOCATION_CB *);
+int32_t hm_cluster_send_sequenced(HM_MSG *, HM_LOCATION_CB *, uint32_t);
+int32_t hm_cluster_transmit(HM_LIST_BLOCK *, HM_LOCATION_CB *);
+void hm_cluster_read_ack(HM_LOCATION_CB *, uint32_t, uint32_t, uint32_t);
+void hm_cluster_open_window(HM_LOCATION_CB *, uint32_t);
+void hm_cluster_check_retransmit(HM_LOCATION_CB *);
+void hm_cluster_service_streams();
+uint32_t hm_cluster_stream_reliable(HM_LOCATION_CB *);
+uint64_t hm_cluster_rto_ms(HM_LOCATION_CB *);
+uint32_t hm_cluster_accept_seq(HM_LOCATION_CB *, uint32_t, uint32_t);
+void hm_cluster_reset_stream(HM_LOCATION_CB *);
+uint32_t hm_cluster_accept_version(HM_LOCATION_CB *, uint32_t *, uint32_t,
+                                   uint64_t *, uint64_t);
+void hm_cluster_apply_node_status(HM_NODE_CB *, uint32_t);
+void hm_cluster_apply_process_status(HM_PROCESS_CB *, uint32_t);
+void hm_cluster_restore_location(HM_LOCATION_CB *, uint32_t);
 void hm_cluster_exchange_binding(void *, uint32_t , void *);
 uint32_t hm_cluster_recv_binding(HM_PEER_MSG_BINDING *, HM_LOCATION_CB *);
+void hm_cluster_check_digests();
+int32_t hm_cluster_send_root_digest(HM_LOCATION_CB *);
+HM_MSG * hm_cluster_digest_new(HM_LOCATION_CB *, uint32_t, uint32_t, uint32_t);
+HM_PEER_DIGEST_ENTRY * hm_cluster_digest_next_entry(HM_LOCATION_CB *, HM_MSG **,
+                                                    uint32_t, uint32_t);
+int32_t hm_cluster_digest_flush(HM_LOCATION_CB *, HM_MSG **, uint32_t);
+int32_t hm_cluster_recv_digest(HM_PEER_MSG_DIGEST *, HM_LOCATION_CB *);
+int32_t hm_cluster_send_node_digests(HM_LOCATION_CB *);
+int32_t hm_cluster_compare_node_digests(HM_PEER_MSG_DIGEST *, HM_LOCATION_CB *);
+int32_t hm_cluster_repair_nodes(HM_PEER_MSG_DIGEST *, HM_LOCATION_CB *);
+void hm_cluster_retire_unrepaired(HM_PEER_MSG_DIGEST *, HM_LOCATION_CB *);
+uint32_t hm_cluster_peer_wants(HM_LOCATION_CB *, uint32_t);
+uint32_t hm_cluster_node_digest_for(HM_NODE_CB *, HM_LOCATION_CB *);
+uint32_t hm_cluster_location_digest_for(HM_LOCATION_CB *);
+void hm_cluster_update_interest();
+int32_t hm_cluster_send_interest(HM_LOCATION_CB *);
+void hm_cluster_recv_interest(HM_PEER_MSG_INTEREST *, HM_LOCATION_CB *);
+int32_t hm_cluster_send_process(HM_LOCATION_CB *, HM_PROCESS_CB *);
+uint32_t hm_cluster_may_peer(uint32_t, uint32_t, uint32_t);
+uint32_t hm_cluster_init_may_peer(HM_PEER_MSG_INIT *);
+uint32_t hm_cluster_is_our_leaf(HM_LOCATION_CB *);
+uint32_t hm_cluster_relays_to(HM_LOCATION_CB *, HM_LOCATION_CB *);
+HM_PEER_REPLAY_TLV * hm_cluster_relay_next_tlv(HM_LOCATION_CB *, HM_LOCATION_CB *,
+                        HM_MSG **);
+int32_t hm_cluster_relay_flush(HM_LOCATION_CB *, HM_MSG **);
+int32_t hm_cluster_relay_update(void *);
+int32_t hm_cluster_relay_tables(HM_LOCATION_CB *);
+int32_t hm_cluster_recv_relay(HM_PEER_MSG_RELAY *, HM_LOCATION_CB *);
+
+/* hmgossip.c */
+int32_t hm_gossip_init();
+int32_t hm_gossip_add_member(HM_LOCATION_CB *);
+HM_LOCATION_CB *hm_gossip_new_member(uint32_t, SOCKADDR *);
+void hm_gossip_tick();
+HM_LOCATION_CB *hm_gossip_next_member();
+void hm_gossip_ping_req(HM_LOCATION_CB *);
+int32_t hm_gossip_send(HM_TRANSPORT_CB *, uint32_t, uint32_t, uint32_t, uint32_t);
+uint32_t hm_gossip_fill(HM_PEER_MSG_GOSSIP *, uint32_t, HM_LOCATION_CB *);
+void hm_gossip_put_member(HM_PEER_MEMBER *, HM_LOCATION_CB *);
+int32_t hm_gossip_receive(HM_TRANSPORT_CB *, SOCKADDR *);
+uint32_t hm_gossip_apply(HM_LOCATION_CB *, uint32_t, uint32_t);
+void hm_gossip_refute(uint32_t, uint32_t);
+uint32_t hm_gossip_sends();
+
+/* hmhbeat.c */
+int32_t hm_heartbeat_start();
+void hm_heartbeat_stop();
+void hm_heartbeat_release();
+void *hm_heartbeat_thread(void *);
+int32_t hm_heartbeat_send_tick(uint8_t *);
+void hm_heartbeat_receive(HM_HEARTBEAT_PATH *, uint8_t *, uint32_t);
+void hm_heartbeat_judge();
+void hm_heartbeat_post(uint32_t, uint32_t, uint32_t, HM_SOCKADDR_UNION *,
+                       uint8_t *, uint32_t);
+void hm_heartbeat_set_tick(HM_MSG *);
+void hm_heartbeat_process_events();
 
 /* hmnodemgmt.c */
 int32_t hm_node_fsm(uint32_t, HM_NODE_CB *);
@@ -78,11 +182,19 @@ int32_t hm_global_node_remove(HM_NODE_CB *);
 int32_t hm_global_process_add(HM_PROCESS_CB *);
 int32_t hm_global_process_update(HM_PROCESS_CB *, uint32_t);
 int32_t hm_global_process_remove(HM_PROCESS_CB *);
+void hm_global_digest_node(HM_NODE_CB *);
+void hm_global_digest_process(HM_PROCESS_CB *);
+HM_GLOBAL_PENDING * hm_global_pending(void *);
+int32_t hm_global_queue_update(void *);
+void hm_global_flush_updates();
 HM_SUBSCRIPTION_CB * hm_create_subscription_entry(uint32_t, uint32_t, void *);
 int32_t hm_update_subscribers(HM_SUBSCRIPTION_CB *);
-int32_t hm_subscribe(uint32_t, uint32_t , void *, uint32_t);
+int32_t hm_subscribe(uint32_t, uint32_t , void *, uint32_t, HM_SUBS_FILTER *);
 int32_t hm_subscription_insert(HM_SUBSCRIPTION_CB *, HM_LIST_BLOCK *);
 int32_t hm_compare_proc_tree_keys(void *, void *);
+HM_LOCATION_CB * hm_global_owner(void *);
+uint32_t hm_global_is_remote(void *);
+int32_t hm_subscription_bind_back(void *, void *);
 
 
 /* hmha.c */
@@ -91,27 +203,45 @@ int32_t hm_recv_ha_update(HM_MSG *, HM_TRANSPORT_CB *);
 int32_t hm_cluster_send_ha_update(HM_NODE_CB *, HM_NODE_CB *, HM_NODE_CB *);
 int32_t hm_cluster_recv_ha_update(HM_PEER_MSG_HA_UPDATE *, HM_LOCATION_CB *);
 void hm_ha_resolve_active_backup(HM_NODE_CB *);
+double hm_ha_node_suspicion(HM_NODE_CB *);
 
 /* hmnotify.c */
 int32_t hm_service_notify_queue();
+uint32_t hm_notify_priority(uint32_t);
+HM_NOTIFICATION_CB * hm_next_notification();
+int32_t hm_queue_notification(HM_NOTIFICATION_CB *);
+void hm_subs_filter_compile(HM_REGISTER_TLV_CB *, HM_SUBS_FILTER *);
+int32_t hm_subs_filter_match(HM_SUBS_FILTER *, HM_NOTIFICATION_CB *);
+int32_t hm_subs_filter_any(HM_SUBSCRIPTION_CB *, HM_NOTIFICATION_CB *);
 HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *);
+int32_t hm_cache_node_addr_info(HM_GLOBAL_NODE_CB *);
+HM_ADDRESS_INFO * hm_get_node_addr_info(HM_GLOBAL_NODE_CB *);
 
 /* hmmsg.c */
 int32_t hm_recv_register(HM_MSG *, HM_TRANSPORT_CB *);
 int32_t hm_recv_proc_update(HM_MSG *, HM_TRANSPORT_CB *);
 int32_t hm_route_incoming_message(HM_SOCKET_CB *);
+int32_t hm_recv_peer_frame(HM_SOCKET_CB *, HM_MSG **, SOCKADDR **);
 
 int32_t hm_tprt_handle_improper_read(int32_t , HM_TRANSPORT_CB *);
+void hm_tprt_heard_from(HM_TRANSPORT_CB *, uint32_t);
 int32_t hm_receive_msg_hdr(char *);
 int32_t hm_node_send_init_rsp(HM_NODE_CB *);
 int32_t hm_queue_on_transport(HM_MSG *, HM_TRANSPORT_CB *, uint32_t);
 int32_t hm_tprt_process_outgoing_queue(HM_TRANSPORT_CB *);
+void hm_tprt_remove_pending(HM_TRANSPORT_CB *, HM_LIST_BLOCK *);
+HM_LIST_BLOCK * hm_tprt_next_pending(HM_TRANSPORT_CB *);
+int32_t hm_tprt_queue_notification(HM_MSG *, HM_TRANSPORT_CB *, void *, uint32_t);
 
 /* hmtprt.c */
 HM_SOCKET_CB * hm_tprt_accept_connection(int32_t);
 HM_SOCKET_CB * hm_tprt_open_connection(uint32_t, void *);
 int32_t hm_tprt_send_on_socket(struct sockaddr* ,int32_t ,
             uint32_t, uint8_t *, uint32_t );
+int32_t hm_tprt_write_on_socket(int32_t, uint8_t *, uint32_t);
+int32_t hm_tprt_send_parts(struct sockaddr *, int32_t, uint32_t, HM_MSG *,
+            uint32_t);
+int32_t hm_tprt_set_kernel_liveness(int32_t, uint32_t, uint32_t);
 int32_t hm_tprt_recv_on_socket(uint32_t , uint32_t ,
               uint8_t * , uint32_t, struct sockaddr ** );
 int32_t hm_tprt_close_connection(HM_TRANSPORT_CB *);
@@ -134,6 +264,8 @@ void avl3_verify_tree(HM_AVL3_TREE *,
 /* hmutil2.c */
 int64_t hm_hton64(int64_t);
 int64_t hm_ntoh64(int64_t);
+void hm_put_64(uint8_t *, uint64_t);
+uint64_t hm_get_64(uint8_t *);
 
 void hm_base_timer_handler(int32_t , siginfo_t *, void *);
 
@@ -147,4 +279,17 @@ HM_MSG * hm_grow_buffer(HM_MSG *, uint32_t);
 HM_MSG * hm_shrink_buffer(HM_MSG *, uint32_t);
 int32_t hm_free_buffer(HM_MSG *);
 
+uint64_t hm_time_ms();
+uint64_t hm_time_ns();
+uint64_t hm_wall_time_ns();
+void hm_phi_init(HM_PHI_DETECTOR *);
+void hm_phi_heartbeat(HM_PHI_DETECTOR *, uint32_t);
+void hm_phi_touch(HM_PHI_DETECTOR *);
+double hm_phi(HM_PHI_DETECTOR *);
+uint32_t hm_hash_mix(uint32_t, uint32_t);
+uint64_t hm_hlc_now();
+void hm_hlc_merge(uint64_t);
+void hm_hlc_put(uint8_t *, uint64_t);
+uint64_t hm_hlc_get(uint8_t *);
+
 #endif /* SRC_HMFUNC_H_ */
@@ -31,9 +31,31 @@ HM_ATTRIBUTE_MAP attribute_map[] = {
     {"interface",            HM_CONFIG_ATTR_SUBS_TYPE_IF},
     {"4",                HM_CONFIG_ATTR_IP_VERSION_4},
     {"6",                HM_CONFIG_ATTR_IP_VERSION_6},
+    {"drop_oldest",          HM_CONFIG_ATTR_QUEUE_DROP_OLDEST},
+    {"collapse",            HM_CONFIG_ATTR_QUEUE_COLLAPSE},
+    {"disconnect",          HM_CONFIG_ATTR_QUEUE_DISCONNECT},
+    {"multicast",           HM_CONFIG_ATTR_MEMBERSHIP_MCAST},
+    {"gossip",              HM_CONFIG_ATTR_MEMBERSHIP_GOSSIP},
+    {"application",         HM_CONFIG_ATTR_LIVENESS_APPLICATION},
+    {"kernel",              HM_CONFIG_ATTR_LIVENESS_KERNEL},
+    {"mesh",                HM_CONFIG_ATTR_AGGREGATION_MESH},
+    {"aggregator",          HM_CONFIG_ATTR_AGGREGATION_AGGREGATOR},
+    {"leaf",                HM_CONFIG_ATTR_AGGREGATION_LEAF},
 };
 
 uint32_t size_of_map = (sizeof(attribute_map)/sizeof(attribute_map[0]));
+
+/**
+ * @brief Share of outgoing messages of each priority class in a draining round.
+ * Control messages are not weighted; they always go first.
+ */
+uint32_t hm_priority_weight[HM_NUM_PRIORITIES] = {
+    0,                          /* HM_PRIORITY_CONTROL */
+    HM_PRIORITY_WEIGHT_HA,      /* HM_PRIORITY_HA */
+    HM_PRIORITY_WEIGHT_NODE,    /* HM_PRIORITY_NODE */
+    HM_PRIORITY_WEIGHT_PROCESS, /* HM_PRIORITY_PROCESS */
+    HM_PRIORITY_WEIGHT_INFO,    /* HM_PRIORITY_INFO */
+};
 /**
  * @brief Hardware Manager Global Data-structure
  */
@@ -44,6 +66,7 @@ HM_GLOBAL_DATA global;
 extern HM_GLOBAL_DATA global;
 extern HM_ATTRIBUTE_MAP attribute_map[];
 extern uint32_t size_of_map;
+extern uint32_t hm_priority_weight[];
 #endif
 
 #define LOCAL global
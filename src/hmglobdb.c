@@ -95,6 +95,7 @@ int32_t hm_global_location_add(HM_LOCATION_CB *loc_cb, uint32_t status)
     HM_AVL3_INIT_NODE(glob_cb->node, glob_cb);
     glob_cb->sub_cb = NULL;
     glob_cb->table_type = HM_TABLE_TYPE_LOCATION;
+    memset(&glob_cb->pending, 0, sizeof(glob_cb->pending));
   }
   glob_cb->loc_cb = loc_cb;
   glob_cb->status = status;
@@ -146,7 +147,7 @@ int32_t hm_global_location_add(HM_LOCATION_CB *loc_cb, uint32_t status)
       /***************************************************************************/
       /* Allocate Node                               */
       /***************************************************************************/
-      list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(uint32_t));
+      list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
       if(list_member == NULL)
       {
         TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -158,6 +159,7 @@ int32_t hm_global_location_add(HM_LOCATION_CB *loc_cb, uint32_t status)
       list_member->opaque = (void *)((char *)list_member + sizeof(HM_LIST_BLOCK));
       processed = (uint32_t *)list_member->opaque;
       *processed = 0;
+      ((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter = greedy->filter;
 
       if(hm_subscription_insert(sub_cb, list_member) != HM_OK)
       {
@@ -241,6 +243,7 @@ int32_t hm_global_location_update(HM_LOCATION_CB *loc_cb, uint32_t op)
       switch(glob_cb->status)
       {
       case HM_PEER_FSM_STATE_ACTIVE:
+      case HM_PEER_FSM_STATE_DELEGATED:
         TRACE_DETAIL(("Location Active."));
         notify = HM_NOTIFICATION_LOCATION_ACTIVE;
         break;
@@ -276,10 +279,8 @@ int32_t hm_global_location_update(HM_LOCATION_CB *loc_cb, uint32_t op)
   /***************************************************************************/
   /* Queue the notification CB                          */
   /***************************************************************************/
-  HM_INSERT_BEFORE(LOCAL.notification_queue ,notify_cb->node);
-
-  //FIXME: Move it to a separate thread later
-  hm_service_notify_queue();
+  /* Serviced once, at the end of this pass of the main loop. */
+  hm_queue_notification(notify_cb);
 
 
   /***************************************************************************/
@@ -401,12 +402,15 @@ int32_t hm_global_node_add(HM_NODE_CB *node_cb)
     insert_cb->index =  node_cb->index;
     insert_cb->group_index = node_cb->group;
     insert_cb->table_type = HM_TABLE_TYPE_NODES;
+    memset(&insert_cb->pending, 0, sizeof(insert_cb->pending));
   }
 
   TRACE_DETAIL(("Node DB ID: %d", insert_cb->id));
   insert_cb->node_cb = node_cb;
   insert_cb->role = node_cb->role;
   insert_cb->status = node_cb->fsm_state;
+  /* Node (and so, its transport) may be new. Cached address is stale. */
+  insert_cb->addr_info_valid = FALSE;
 
   /***************************************************************************/
   /* Try inserting it into the tree                       */
@@ -440,6 +444,15 @@ int32_t hm_global_node_add(HM_NODE_CB *node_cb)
   node_cb->id = insert_cb->id;
   node_cb->db_ptr = (void *)insert_cb;
 
+  /***************************************************************************/
+  /* An aggregator passes on what it learns of other locations.       */
+  /***************************************************************************/
+  if((LOCAL.aggregation_role == HM_AGGREGATION_ROLE_AGGREGATOR) &&
+     (hm_global_is_remote(insert_cb)))
+  {
+    hm_global_queue_update(insert_cb);
+  }
+
   /***************************************************************************/
   /* Find out if there is some greedy (wildcard) subscriber.           */
   /* If present, subscribe to this location implicitly.             */
@@ -453,9 +466,23 @@ int32_t hm_global_node_add(HM_NODE_CB *node_cb)
     {
       TRACE_DETAIL(("Found wildcard subscriber."));
       /***************************************************************************/
+      /* A subscriber at another location is notified by its own HM when our   */
+      /* update reaches it, so it is not kept here. Bind our entity to it only. */
+      /***************************************************************************/
+      if(hm_global_is_remote(greedy->subscriber.void_cb))
+      {
+        if((greedy->cross_bind) &&
+           (hm_subscription_bind_back(greedy->subscriber.void_cb, insert_cb) != HM_OK))
+        {
+          ret_val = HM_ERR;
+          goto EXIT_LABEL;
+        }
+        continue;
+      }
+      /***************************************************************************/
       /* Allocate Node                               */
       /***************************************************************************/
-      list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) +sizeof(uint32_t));
+      list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
       if(list_member == NULL)
       {
         TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -467,6 +494,7 @@ int32_t hm_global_node_add(HM_NODE_CB *node_cb)
       list_member->opaque = (void *)((char *)list_member + sizeof(HM_LIST_BLOCK));
       processed = (uint32_t *)list_member->opaque;
       *processed = 0;
+      ((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter = greedy->filter;
       if(hm_subscription_insert(sub_cb, list_member) != HM_OK)
       {
         TRACE_ERROR(("Error inserting subscription to its entity"));
@@ -481,7 +509,7 @@ int32_t hm_global_node_add(HM_NODE_CB *node_cb)
       /***************************************************************************/
       /* if the wildcard is also a bidirectional subscriber, setup cross-binds   */
       /***************************************************************************/
-      if(greedy->cross_bind)
+      if((greedy->cross_bind) && (!hm_global_is_remote(insert_cb)))
       {
         TRACE_DETAIL(("Setup cross-binding."));
         /***************************************************************************/
@@ -495,7 +523,7 @@ int32_t hm_global_node_add(HM_NODE_CB *node_cb)
         /* Allocate Node.                                                          */
         /***************************************************************************/
         cross_bind_member = NULL;
-        cross_bind_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK)+ sizeof(uint32_t));
+        cross_bind_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
         if(cross_bind_member == NULL)
         {
           TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -511,6 +539,8 @@ int32_t hm_global_node_add(HM_NODE_CB *node_cb)
 
         processed = (uint32_t *)cross_bind_member->opaque;
         *processed = 0;
+        memset(&((HM_SUBSCRIBER_STATE *)cross_bind_member->opaque)->filter, 0,
+               sizeof(HM_SUBS_FILTER));
 
         switch(subscriber_type)
         {
@@ -651,6 +681,8 @@ int32_t hm_global_node_update(HM_NODE_CB *node_cb, uint32_t op)
         TRACE_ASSERT(FALSE);
   }
 
+  hm_global_digest_node(node_cb);
+
   if(!notify)
   {
     TRACE_DETAIL(("No updates."));
@@ -699,6 +731,14 @@ int32_t hm_global_node_update(HM_NODE_CB *node_cb, uint32_t op)
     /***************************************************************************/
     glob_cb->sub_cb->live = TRUE;
   }
+
+  /***************************************************************************/
+  /* Node may have come up on a new transport. Refresh its address info.   */
+  /***************************************************************************/
+  if(notify == HM_NOTIFICATION_NODE_ACTIVE)
+  {
+    hm_cache_node_addr_info(glob_cb);
+  }
   glob_cb->status = node_cb->fsm_state;
   if(op==HM_UPDATE_NODE_ROLE)
   {
@@ -721,10 +761,8 @@ int32_t hm_global_node_update(HM_NODE_CB *node_cb, uint32_t op)
   /***************************************************************************/
   /* Queue the notification CB                          */
   /***************************************************************************/
-  HM_INSERT_BEFORE(LOCAL.notification_queue ,notify_cb->node);
-
-  //FIXME: Move it to a separate thread later
-  hm_service_notify_queue();
+  /* Serviced once, at the end of this pass of the main loop. */
+  hm_queue_notification(notify_cb);
 
   /***************************************************************************/
   /* Send Notifications on the cluster too                   */
@@ -733,7 +771,15 @@ int32_t hm_global_node_update(HM_NODE_CB *node_cb, uint32_t op)
       LOCAL.local_location_cb.index)
   {
     TRACE_DETAIL(("Update cluster."));
-    hm_cluster_send_update(glob_cb);
+    hm_global_queue_update(glob_cb);
+  }
+  else if(LOCAL.aggregation_role == HM_AGGREGATION_ROLE_AGGREGATOR)
+  {
+    /***************************************************************************/
+    /* An aggregator passes on what it learns of other locations.       */
+    /***************************************************************************/
+    TRACE_DETAIL(("Relay to cluster."));
+    hm_global_queue_update(glob_cb);
   }
 EXIT_LABEL:
   /***************************************************************************/
@@ -860,6 +906,7 @@ int32_t hm_global_process_add(HM_PROCESS_CB *proc_cb)
     HM_AVL3_INIT_NODE(insert_cb->node, insert_cb);
     HM_INIT_ROOT(insert_cb->subscriptions);
     insert_cb->table_type = HM_TABLE_TYPE_PROCESS;
+    memset(&insert_cb->pending, 0, sizeof(insert_cb->pending));
   }
   insert_cb->proc_cb = proc_cb;
   insert_cb->status = proc_cb->running;
@@ -900,6 +947,15 @@ int32_t hm_global_process_add(HM_PROCESS_CB *proc_cb)
   proc_cb->id = insert_cb->id;
   proc_cb->db_ptr = (void *)insert_cb;
 
+  /***************************************************************************/
+  /* An aggregator passes on what it learns of other locations.       */
+  /***************************************************************************/
+  if((LOCAL.aggregation_role == HM_AGGREGATION_ROLE_AGGREGATOR) &&
+     (hm_global_is_remote(insert_cb)))
+  {
+    hm_global_queue_update(insert_cb);
+  }
+
   /***************************************************************************/
   /* Try only when it is a new insertion.                                    */
   /***************************************************************************/
@@ -918,9 +974,23 @@ int32_t hm_global_process_add(HM_PROCESS_CB *proc_cb)
       {
         TRACE_DETAIL(("Found wildcard subscriber."));
         /***************************************************************************/
+        /* A subscriber at another location is notified by its own HM when our   */
+        /* update reaches it, so it is not kept here. Bind our entity to it only. */
+        /***************************************************************************/
+        if(hm_global_is_remote(greedy->subscriber.void_cb))
+        {
+          if((greedy->cross_bind) &&
+             (hm_subscription_bind_back(greedy->subscriber.void_cb, insert_cb) != HM_OK))
+          {
+            ret_val = HM_ERR;
+            goto EXIT_LABEL;
+          }
+          continue;
+        }
+        /***************************************************************************/
         /* Allocate Node                               */
         /***************************************************************************/
-        list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK)+sizeof(uint32_t));
+        list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
         if(list_member == NULL)
         {
           TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -932,6 +1002,7 @@ int32_t hm_global_process_add(HM_PROCESS_CB *proc_cb)
         list_member->opaque = (void *)((char *)list_member + sizeof(HM_LIST_BLOCK));
         processed = (uint32_t *)list_member->opaque;
         *processed = 0;
+        ((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter = greedy->filter;
 
         if(hm_subscription_insert(sub_cb, list_member) != HM_OK)
         {
@@ -947,7 +1018,7 @@ int32_t hm_global_process_add(HM_PROCESS_CB *proc_cb)
         /***************************************************************************/
         /* if the wildcard is also a bidirectional subscriber, setup cross-binds   */
         /***************************************************************************/
-        if(greedy->cross_bind)
+        if((greedy->cross_bind) && (!hm_global_is_remote(insert_cb)))
         {
           TRACE_DETAIL(("Setup cross-binding."));
           /***************************************************************************/
@@ -961,7 +1032,7 @@ int32_t hm_global_process_add(HM_PROCESS_CB *proc_cb)
           /* Allocate Node.                                                          */
           /***************************************************************************/
           cross_bind_member = NULL;
-          cross_bind_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK)+ sizeof(uint32_t));
+          cross_bind_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
           if(cross_bind_member == NULL)
           {
             TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -977,6 +1048,8 @@ int32_t hm_global_process_add(HM_PROCESS_CB *proc_cb)
 
           processed = (uint32_t *)cross_bind_member->opaque;
           *processed = 0;
+          memset(&((HM_SUBSCRIBER_STATE *)cross_bind_member->opaque)->filter, 0,
+                 sizeof(HM_SUBS_FILTER));
 
           switch(subscriber_type)
           {
@@ -1094,6 +1167,8 @@ int32_t hm_global_process_update(HM_PROCESS_CB *proc_cb, uint32_t op)
       TRACE_ASSERT(FALSE);
   }
 
+  hm_global_digest_process(proc_cb);
+
   if(!notify)
   {
     TRACE_DETAIL(("No updates."));
@@ -1180,10 +1255,8 @@ int32_t hm_global_process_update(HM_PROCESS_CB *proc_cb, uint32_t op)
   /***************************************************************************/
   /* Queue the notification CB                          */
   /***************************************************************************/
-  HM_INSERT_BEFORE(LOCAL.notification_queue ,notify_cb->node);
-
-  //FIXME: Move it to a separate thread later
-  hm_service_notify_queue();
+  /* Serviced once, at the end of this pass of the main loop. */
+  hm_queue_notification(notify_cb);
 
   /***************************************************************************/
   /* Send Notifications on the cluster too                   */
@@ -1192,7 +1265,15 @@ int32_t hm_global_process_update(HM_PROCESS_CB *proc_cb, uint32_t op)
       LOCAL.local_location_cb.index)
   {
     TRACE_DETAIL(("Update cluster."));
-    hm_cluster_send_update(glob_cb);
+    hm_global_queue_update(glob_cb);
+  }
+  else if(LOCAL.aggregation_role == HM_AGGREGATION_ROLE_AGGREGATOR)
+  {
+    /***************************************************************************/
+    /* An aggregator passes on what it learns of other locations.       */
+    /***************************************************************************/
+    TRACE_DETAIL(("Relay to cluster."));
+    hm_global_queue_update(glob_cb);
   }
 EXIT_LABEL:
   /***************************************************************************/
@@ -1232,6 +1313,102 @@ int32_t hm_global_process_remove(HM_PROCESS_CB *proc_cb)
 }/* hm_global_process_remove */
 
 
+/**
+ *  @brief Brings the anti-entropy digests up to date with the state of a node
+ *
+ *  A node counts towards the digest only while it is active, so that peers
+ *  which have it down and peers which have never heard of it agree. The
+ *  change is carried up into the digest of its location.
+ *
+ *  @param *node_cb Node CB (#HM_NODE_CB) whose state may have changed
+ *  @return @c void
+ */
+void hm_global_digest_node(HM_NODE_CB *node_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t leaf = 0;
+  uint32_t delta = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(node_cb != NULL);
+  TRACE_ASSERT(node_cb->parent_location_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if(node_cb->fsm_state == HM_NODE_FSM_STATE_ACTIVE)
+  {
+    leaf = hm_hash_mix(hm_hash_mix(HM_TABLE_TYPE_NODES, node_cb->index),
+                       node_cb->group);
+  }
+
+  /***************************************************************************/
+  /* Digests are plain sums, so the change is all that needs carrying up.  */
+  /***************************************************************************/
+  delta = leaf - node_cb->digest_leaf;
+  node_cb->digest_leaf = leaf;
+  node_cb->digest += delta;
+  node_cb->parent_location_cb->digest += delta;
+
+  TRACE_DETAIL(("Node %d digest: 0x%x, Location %d digest: 0x%x",
+      node_cb->index, node_cb->digest, node_cb->parent_location_cb->index,
+      node_cb->parent_location_cb->digest));
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_global_digest_node */
+
+
+/**
+ *  @brief Brings the anti-entropy digests up to date with the state of a process
+ *
+ *  A process counts towards the digest of its node only while it runs.
+ *
+ *  @param *proc_cb Process CB (#HM_PROCESS_CB) whose state may have changed
+ *  @return @c void
+ */
+void hm_global_digest_process(HM_PROCESS_CB *proc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t leaf = 0;
+  uint32_t delta = 0;
+  HM_NODE_CB *node_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(proc_cb != NULL);
+  TRACE_ASSERT(proc_cb->parent_node_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  node_cb = proc_cb->parent_node_cb;
+  if(proc_cb->running == TRUE)
+  {
+    leaf = hm_hash_mix(hm_hash_mix(hm_hash_mix(HM_TABLE_TYPE_PROCESS,
+                       node_cb->index), proc_cb->type), proc_cb->pid);
+  }
+
+  delta = leaf - proc_cb->digest;
+  proc_cb->digest = leaf;
+  node_cb->digest += delta;
+  node_cb->parent_location_cb->digest += delta;
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_global_digest_process */
+
+
 /**
  *  @brief Makes an entry in subscription tree if no previous entry exists
  *
@@ -1387,10 +1564,13 @@ int32_t hm_update_subscribers(HM_SUBSCRIPTION_CB *subs_cb)
  *  @param value Value of subscription index
  *  @param *cb A Control block of the subscribing entity
  *  @param bidir Whether it is a bidirectional subscription or unidirectional
+ *  @param *filter Filter (#HM_SUBS_FILTER) on notifications to the subscriber.
+ *         @c NULL if it wants all of them.
  *
  *  @return #HM_OK on success, #HM_ERR otherwise
  */
-int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidir)
+int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidir,
+                     HM_SUBS_FILTER *filter)
 {
   /***************************************************************************/
   /* Variable Declarations                           */
@@ -1402,6 +1582,7 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
   int32_t ret_val = HM_OK;
 
   int32_t exists = FALSE;
+  uint32_t remote = FALSE;
   uint32_t table_type;
   uint32_t keys[2];
 
@@ -1466,6 +1647,14 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
     subscriber->value = value;
     subscriber->subscriber.void_cb = cb;
     subscriber->cross_bind = bidir;
+    if(filter != NULL)
+    {
+      subscriber->filter = *filter;
+    }
+    else
+    {
+      memset(&subscriber->filter, 0, sizeof(HM_SUBS_FILTER));
+    }
     global_cb.void_cb= cb;
     /***************************************************************************/
     /* Determine its table type and accordingly, find its global table entry   */
@@ -1527,6 +1716,8 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
             /* Nothing needs to be done. Everything is already set up.                 */
             /***************************************************************************/
             exists = TRUE;
+            /* The latest registration decides what it wants to hear about. */
+            looper->filter = subscriber->filter;
             free(subscriber);
             subscriber = looper;
             break;
@@ -1538,8 +1729,20 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
     {
       TRACE_DETAIL(("New subscription."));
       HM_INSERT_BEFORE(LOCAL.table_root_subscribers, subscriber->node);
+      /***************************************************************************/
+      /* Peers send us only the processes we subscribe to.            */
+      /***************************************************************************/
+      if(subs_type == HM_CONFIG_ATTR_SUBS_TYPE_PROC)
+      {
+        hm_cluster_update_interest();
+      }
     }
     /***************************************************************************/
+    /* A subscriber at another location is not kept on our entities: its own  */
+    /* HM notifies it when our updates reach there.                          */
+    /***************************************************************************/
+    remote = hm_global_is_remote(subscriber->subscriber.void_cb);
+    /***************************************************************************/
     /* Insert it as a subscriber to every existing node right now.             */
     /***************************************************************************/
     for(subscription = (HM_SUBSCRIPTION_CB *)HM_AVL3_FIRST(LOCAL.active_subscriptions_tree,
@@ -1561,11 +1764,22 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
             TRACE_DETAIL(("Do not subscribe to itself!"));
             continue;
           }
+          if(remote)
+          {
+            if((subscriber->cross_bind) &&
+               (hm_subscription_bind_back(subscriber->subscriber.void_cb,
+                                          subscription->row_cb.void_cb) != HM_OK))
+            {
+              ret_val = HM_ERR;
+              goto EXIT_LABEL;
+            }
+            continue;
+          }
           /***************************************************************************/
           /* Allocate Node.                                                          */
           /***************************************************************************/
           list_member = NULL;
-          list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK)+ sizeof(uint32_t));
+          list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
           if(list_member == NULL)
           {
             TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -1577,6 +1791,7 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
           list_member->opaque = (void *)((char *)list_member + sizeof(HM_LIST_BLOCK));
           processed = (uint32_t *)list_member->opaque;
           *processed = 0;
+          ((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter = subscriber->filter;
           /***************************************************************************/
           /* Insert into List                                                        */
           /***************************************************************************/
@@ -1621,13 +1836,24 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
             TRACE_DETAIL(("Do not subscribe to itself!"));
             continue;
           }
+          if(remote)
+          {
+            if((subscriber->cross_bind) &&
+               (hm_subscription_bind_back(subscriber->subscriber.void_cb,
+                                          subscription->row_cb.void_cb) != HM_OK))
+            {
+              ret_val = HM_ERR;
+              goto EXIT_LABEL;
+            }
+            continue;
+          }
 
           TRACE_DETAIL(("Found a node. Make subscription."));
           /***************************************************************************/
           /* Allocate Node.                               */
           /***************************************************************************/
           list_member = NULL;
-          list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK)+sizeof(uint32_t));
+          list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
           if(list_member == NULL)
           {
             TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -1639,6 +1865,7 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
           list_member->opaque = (void *)((char *)list_member + sizeof(HM_LIST_BLOCK));
           processed = (uint32_t *)list_member->opaque;
           *processed = 0;
+          ((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter = subscriber->filter;
           /***************************************************************************/
           /* Insert into List                               */
           /***************************************************************************/
@@ -1678,7 +1905,7 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
     /***************************************************************************/
     /* Allocate Node                               */
     /***************************************************************************/
-    list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(uint32_t));
+    list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
     if(list_member == NULL)
     {
       TRACE_ERROR(("Error allocating resources for Subscriber list element."));
@@ -1690,6 +1917,15 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
     list_member->opaque = (void *)((char *)list_member + sizeof(HM_LIST_BLOCK));
     processed = (uint32_t *)list_member->opaque;
     *processed = 0;
+    if(filter != NULL)
+    {
+      ((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter = *filter;
+    }
+    else
+    {
+      memset(&((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter, 0,
+             sizeof(HM_SUBS_FILTER));
+    }
 
     subscription = (HM_SUBSCRIPTION_CB *)HM_AVL3_FIRST(LOCAL.active_subscriptions_tree,
                                                         subs_tree_by_db_id );
@@ -1805,7 +2041,7 @@ int32_t hm_subscribe(uint32_t subs_type, uint32_t value, void *cb, uint32_t bidi
 
     if(subscription != NULL)
     {
-      if(hm_subscribe(subs_type, value, subscription->row_cb.void_cb, FALSE) != HM_OK)
+      if(hm_subscribe(subs_type, value, subscription->row_cb.void_cb, FALSE, NULL) != HM_OK)
       {
         TRACE_ERROR(("Error creating cross-binding subscription."));
         ret_val = HM_ERR;
@@ -1866,6 +2102,11 @@ int32_t hm_subscription_insert(HM_SUBSCRIPTION_CB *subs_cb, HM_LIST_BLOCK *node)
     if(looper->target == node->target)
     {
       TRACE_WARN(("Duplicate Subscription!"));
+      /***************************************************************************/
+      /* Subscriber may have re-registered with different filters. Take them.  */
+      /***************************************************************************/
+      ((HM_SUBSCRIBER_STATE *)looper->opaque)->filter =
+                                ((HM_SUBSCRIBER_STATE *)node->opaque)->filter;
       exists = TRUE;
       ret_val = HM_DUP; /* It is not wrong to re-subscribe. Just log it somewhere*/
       break;
@@ -1931,10 +2172,8 @@ int32_t hm_subscription_insert(HM_SUBSCRIPTION_CB *subs_cb, HM_LIST_BLOCK *node)
       /***************************************************************************/
       /* Queue the notification CB                          */
       /***************************************************************************/
-      HM_INSERT_BEFORE(LOCAL.notification_queue ,notify_cb->node);
-
-      //FIXME: Move it to a separate thread later
-      hm_service_notify_queue();
+      /* Serviced once, at the end of this pass of the main loop. */
+      hm_queue_notification(notify_cb);
     }
     else
     {
@@ -2009,3 +2248,342 @@ int32_t hm_compare_proc_tree_keys(void *key1, void *key2)
   TRACE_EXIT();
   return ret_val;
 }/* hm_compare_proc_tree_keys */
+
+
+/**
+ *  @brief Returns the changes of a global row waiting for the end of this pass
+ *
+ *  @param *cb Global table row (#HM_GLOBAL_LOCATION_CB, #HM_GLOBAL_NODE_CB or
+ *         #HM_GLOBAL_PROCESS_CB)
+ *  @return Pending changes (#HM_GLOBAL_PENDING), NULL for an unknown row
+ */
+HM_GLOBAL_PENDING * hm_global_pending(void *cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_GLOBAL_PENDING *pending = NULL;
+  HM_SUBSCRIBER row;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  row.void_cb = cb;
+  switch(GET_TABLE_TYPE(cb))
+  {
+    case HM_TABLE_TYPE_LOCATION:
+      pending = &row.location_cb->pending;
+      break;
+
+    case HM_TABLE_TYPE_NODES:
+      pending = &row.node_cb->pending;
+      break;
+
+    case HM_TABLE_TYPE_PROCESS:
+      pending = &row.process_cb->pending;
+      break;
+
+    default:
+      TRACE_ERROR(("Unsupported Table Type: %d", GET_TABLE_TYPE(cb)));
+      TRACE_ASSERT(FALSE);
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return pending;
+}/* hm_global_pending */
+
+
+/**
+ *  @brief Marks a global row as changed, to be sent to the cluster at the end of this pass
+ *
+ *  A row is queued only once, however many times it changed in the pass. The
+ *  update is built when it is sent, so it carries the latest state of row.
+ *
+ *  @param *cb Global table row (#HM_GLOBAL_NODE_CB or #HM_GLOBAL_PROCESS_CB)
+ *  @return #HM_OK on success, #HM_ERR otherwise
+ */
+int32_t hm_global_queue_update(void *cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_LIST_BLOCK *block = NULL;
+  HM_GLOBAL_PENDING *pending = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  pending = hm_global_pending(cb);
+  TRACE_ASSERT(pending != NULL);
+  if(pending->update != NULL)
+  {
+    TRACE_DETAIL(("Update already pending. Merge."));
+    goto EXIT_LABEL;
+  }
+
+  block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
+  if(block == NULL)
+  {
+    TRACE_ERROR(("Error allocating resources for pending update."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  HM_INIT_LQE(block->node, block);
+  block->target = cb;
+  block->opaque = NULL;
+  HM_INSERT_BEFORE(LOCAL.pending_updates, block->node);
+  pending->update = block;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return ret_val;
+}/* hm_global_queue_update */
+
+
+/**
+ *  @brief Sends out everything that changed in the global tables in this pass
+ *
+ *  Notifications are serviced first, then updates are sent to the cluster.
+ *  Called once every pass of the main loop.
+ *
+ *  @param None
+ *  @return @c void
+ */
+void hm_global_flush_updates()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *block = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if(hm_next_notification() != NULL)
+  {
+    hm_service_notify_queue();
+  }
+
+  for(block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.pending_updates);
+      block != NULL;
+      block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.pending_updates))
+  {
+    hm_global_pending(block->target)->update = NULL;
+    hm_cluster_send_update(block->target);
+    HM_REMOVE_FROM_LIST(block->node);
+    free(block);
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_global_flush_updates */
+
+
+/**
+ *  @brief Finds the location an entity of the global tables belongs to
+ *
+ *  @param *cb A global or local table entry of a location, node or process
+ *  @return Location CB (#HM_LOCATION_CB) of its owner, NULL if not known
+ */
+HM_LOCATION_CB * hm_global_owner(void *cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_SUBSCRIBER entity;
+  HM_LOCATION_CB *owner = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if(cb == NULL)
+  {
+    goto EXIT_LABEL;
+  }
+  entity.void_cb = cb;
+
+  switch(*(int32_t *)((char *)cb + (uint32_t)(sizeof(int32_t))))
+  {
+  case HM_TABLE_TYPE_LOCATION:
+    owner = entity.location_cb->loc_cb;
+    break;
+  case HM_TABLE_TYPE_LOCATION_LOCAL:
+    owner = entity.proper_location_cb;
+    break;
+  case HM_TABLE_TYPE_NODES:
+    owner = entity.node_cb->node_cb->parent_location_cb;
+    break;
+  case HM_TABLE_TYPE_NODES_LOCAL:
+    owner = entity.proper_node_cb->parent_location_cb;
+    break;
+  case HM_TABLE_TYPE_PROCESS:
+    owner = entity.process_cb->proc_cb->parent_node_cb->parent_location_cb;
+    break;
+  case HM_TABLE_TYPE_PROCESS_LOCAL:
+    owner = entity.proper_process_cb->parent_node_cb->parent_location_cb;
+    break;
+  default:
+    TRACE_WARN(("Unknown type of entity"));
+    break;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return owner;
+}/* hm_global_owner */
+
+
+/**
+ *  @brief Tells if an entity of the global tables belongs to another location
+ *
+ *  @param *cb A global or local table entry of a location, node or process
+ *  @return TRUE if it is known to belong to a peer, FALSE otherwise
+ */
+uint32_t hm_global_is_remote(void *cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *owner = NULL;
+  uint32_t remote = FALSE;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  owner = hm_global_owner(cb);
+  if((owner != NULL) && (owner->index != LOCAL.local_location_cb.index))
+  {
+    remote = TRUE;
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return remote;
+}/* hm_global_is_remote */
+
+
+/**
+ *  @brief Subscribes one of our entities to a subscriber that bound itself to it
+ *
+ *  This is the reverse half of a bidirectional subscription. A subscriber at
+ *  another location is not kept on our entities: its own HM notifies it when
+ *  our update reaches there. Only our entities are bound to it here, and its
+ *  changes are fanned out to them when its updates reach us. Entities of
+ *  other locations are bound by their own HM.
+ *
+ *  @param *subscriber_cb Global table entry (node or process) of the subscriber
+ *  @param *entity_cb Global table entry of the entity it subscribed to
+ *  @return #HM_OK if successful, #HM_ERR otherwise
+ */
+int32_t hm_subscription_bind_back(void *subscriber_cb, void *entity_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_SUBSCRIBER subscriber;
+  HM_SUBSCRIPTION_CB *subs_cb = NULL;
+  HM_LIST_BLOCK *list_member = NULL;
+  uint32_t *processed = NULL;
+  int32_t ret_val = HM_OK;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(subscriber_cb != NULL);
+  TRACE_ASSERT(entity_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if(hm_global_is_remote(entity_cb))
+  {
+    TRACE_DETAIL(("Entity is bound by its own location."));
+    goto EXIT_LABEL;
+  }
+
+  subscriber.void_cb = subscriber_cb;
+  switch(*(int32_t *)((char *)subscriber_cb + (uint32_t)(sizeof(int32_t))))
+  {
+  case HM_TABLE_TYPE_NODES:
+    subs_cb = subscriber.node_cb->sub_cb;
+    break;
+  case HM_TABLE_TYPE_PROCESS:
+    subs_cb = subscriber.process_cb->sub_cb;
+    break;
+  default:
+    TRACE_WARN(("Unknown type of subscriber"));
+    TRACE_ASSERT(FALSE);
+    goto EXIT_LABEL;
+  }
+
+  list_member = (HM_LIST_BLOCK *) malloc(sizeof(HM_LIST_BLOCK) + sizeof(HM_SUBSCRIBER_STATE));
+  if(list_member == NULL)
+  {
+    TRACE_ERROR(("Error allocating resources for Subscriber list element."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  HM_INIT_LQE(list_member->node, list_member);
+  list_member->target = entity_cb;
+  list_member->opaque = (void *)((char *)list_member + sizeof(HM_LIST_BLOCK));
+  processed = (uint32_t *)list_member->opaque;
+  *processed = 0;
+  memset(&((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter, 0,
+         sizeof(HM_SUBS_FILTER));
+
+  if((ret_val = hm_subscription_insert(subs_cb, list_member)) != HM_OK)
+  {
+    if(ret_val == HM_DUP)
+    {
+      TRACE_DETAIL(("Bound already."));
+      ret_val = HM_OK;
+    }
+    else
+    {
+      TRACE_ERROR(("Error inserting subscription to its entity"));
+    }
+    free(list_member);
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return ret_val;
+}/* hm_subscription_bind_back */
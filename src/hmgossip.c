@@ -0,0 +1,969 @@
+/**
+ *  @file hmgossip.c
+ *  @brief Gossip Membership of Cluster Locations
+ *
+ *  Instead of every location multicasting a Keepalive to every other, each
+ *  location probes one member per period, in turn. If the member does not
+ *  answer, a few others are asked to probe it on our behalf. If that fails
+ *  too, the member is suspected, and declared dead unless it refutes the
+ *  suspicion in time. Changes in membership ride on the probes, so the load
+ *  on a location stays the same however large the cluster grows.
+ *
+ *  @author agent
+ *  @date 18-Oct-2026
+ *  @bug None
+ */
+#include <hmincl.h>
+
+/**
+ *  @brief Prepares gossip membership once the peer socket is open
+ *
+ *  The remote UDP addresses in configuration are the seeds: they are probed
+ *  while we know of no member, so that we get to know some.
+ *
+ *  @param None
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_gossip_init()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_CONFIG_ADDRESS_CB *address_cb = NULL;
+  HM_TRANSPORT_CB *tprt_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(LOCAL.local_location_cb.peer_listen_cb != NULL);
+  TRACE_ASSERT(LOCAL.local_location_cb.peer_listen_cb->sock_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  /***************************************************************************/
+  /* Members to probe are picked at random. Make sure no two locations pick  */
+  /* the same ones.                                */
+  /***************************************************************************/
+  srand((uint32_t)time(NULL) ^ LOCAL.local_location_cb.index);
+
+  for (address_cb = (HM_CONFIG_ADDRESS_CB *)
+                     HM_NEXT_IN_LIST(LOCAL.config_data->instance_info.addresses);
+       address_cb != NULL;
+       address_cb = (HM_CONFIG_ADDRESS_CB *)HM_NEXT_IN_LIST(address_cb->node))
+  {
+    if (address_cb->address.type != HM_TRANSPORT_UDP)
+    {
+      continue;
+    }
+
+    tprt_cb = hm_alloc_transport_cb(HM_TRANSPORT_UDP);
+    block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
+    if ((tprt_cb == NULL) || (block == NULL))
+    {
+      TRACE_ERROR(("Error allocating gossip seed."));
+      if (tprt_cb != NULL)
+      {
+        hm_free_transport_cb(tprt_cb);
+      }
+      if (block != NULL)
+      {
+        free(block);
+      }
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    /***************************************************************************/
+    /* Like datagram peers, seeds are reached over our own socket.       */
+    /***************************************************************************/
+    tprt_cb->location_cb = NULL;
+    tprt_cb->sock_cb = LOCAL.local_location_cb.peer_listen_cb->sock_cb;
+    memcpy(&tprt_cb->address, &address_cb->address, sizeof(HM_INET_ADDRESS));
+
+    HM_INIT_LQE(block->node, block);
+    block->target = tprt_cb;
+    block->opaque = NULL;
+    HM_INSERT_BEFORE(LOCAL.gossip_seeds, block->node);
+    TRACE_INFO(("Added gossip seed."));
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_gossip_init */
+
+
+/**
+ *  @brief Adds a location to the members we probe
+ *
+ *  It goes in at a random place in the probe order, so that members are not
+ *  probed by everyone in the same order.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the new member
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_gossip_add_member(HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_LIST_BLOCK *block = NULL;
+  HM_LIST_BLOCK *position = NULL;
+  uint32_t place;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
+  if (block == NULL)
+  {
+    TRACE_ERROR(("Error allocating gossip member."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  HM_INIT_LQE(block->node, block);
+  block->target = loc_cb;
+  block->opaque = NULL;
+
+  place = rand() % (LOCAL.num_gossip_members + 1);
+  for (position = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.gossip_members);
+       (position != NULL) && (place > 0);
+       position = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(position->node))
+  {
+    place--;
+  }
+  if (position != NULL)
+  {
+    HM_INSERT_BEFORE(position->node, block->node);
+  }
+  else
+  {
+    HM_INSERT_BEFORE(LOCAL.gossip_members, block->node);
+  }
+  LOCAL.num_gossip_members++;
+
+  /***************************************************************************/
+  /* Tell the others of it, and tell it of everyone we know.         */
+  /***************************************************************************/
+  loc_cb->member_status = HM_PEER_MEMBER_ALIVE;
+  loc_cb->member_incarnation = 0;
+  loc_cb->suspect_ticks = 0;
+  loc_cb->gossip_sends_left = hm_gossip_sends();
+  loc_cb->gossip_full_sync = TRUE;
+  TRACE_INFO(("Location %d joins gossip. %d members now.", loc_cb->index,
+              LOCAL.num_gossip_members));
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_gossip_add_member */
+
+
+/**
+ *  @brief Creates a location first heard of in gossip, and says INIT to it
+ *
+ *  @param index Hardware location index of the new member
+ *  @param *addr Address (#SOCKADDR) of its datagram socket
+ *  @return Location CB (#HM_LOCATION_CB) of the member, NULL on error
+ */
+HM_LOCATION_CB *hm_gossip_new_member(uint32_t index, SOCKADDR *addr)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(addr != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  TRACE_INFO(("New Location %d Detected", index));
+  loc_cb = hm_cluster_add_datagram_peer(index, addr);
+  if (loc_cb == NULL)
+  {
+    TRACE_ERROR(("Error creating datagram peer!"));
+    goto EXIT_LABEL;
+  }
+  hm_peer_fsm(HM_PEER_FSM_CONNECT, loc_cb);
+  hm_cluster_send_init(loc_cb->peer_listen_cb);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (loc_cb);
+}/* hm_gossip_new_member */
+
+
+/**
+ *  @brief Runs one protocol period of gossip
+ *
+ *  Acknowledges the streams from peers and retransmits on ours, times out
+ *  suspected members, and moves the probe along: a member that did not
+ *  answer last period is probed through others; one that did not answer them
+ *  either is suspected. Then the next member is probed.
+ *
+ *  @param None
+ *  @return void
+ */
+void hm_gossip_tick()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  LOCAL.peer_tick_count++;
+
+  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.gossip_members);
+       block != NULL;
+       block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+  {
+    loc_cb = (HM_LOCATION_CB *)block->target;
+    if ((loc_cb->member_status == HM_PEER_MEMBER_SUSPECT) &&
+        (++loc_cb->suspect_ticks > LOCAL.peer_kickout_value))
+    {
+      TRACE_WARN(("Location %d did not refute suspicion. Declare it dead.",
+                  loc_cb->index));
+      hm_gossip_apply(loc_cb, HM_PEER_MEMBER_DEAD, loc_cb->member_incarnation);
+    }
+  }
+
+  /***************************************************************************/
+  /* Where did the probe of the last period get?               */
+  /***************************************************************************/
+  if (LOCAL.probe_target != NULL)
+  {
+    if ((LOCAL.probe_stage == HM_GOSSIP_PROBE_DIRECT) &&
+        (LOCAL.probe_target->member_status == HM_PEER_MEMBER_DEAD))
+    {
+      /***************************************************************************/
+      /* A dead member is only checked on directly. It is still dead.          */
+      /***************************************************************************/
+      TRACE_DETAIL(("Location %d is still dead.", LOCAL.probe_target->index));
+    }
+    else if (LOCAL.probe_stage == HM_GOSSIP_PROBE_DIRECT)
+    {
+      TRACE_DETAIL(("Location %d did not answer. Probe it through others.",
+                    LOCAL.probe_target->index));
+      hm_gossip_ping_req(LOCAL.probe_target);
+      LOCAL.probe_stage = HM_GOSSIP_PROBE_INDIRECT;
+      goto EXIT_LABEL;
+    }
+    if (LOCAL.probe_stage == HM_GOSSIP_PROBE_INDIRECT)
+    {
+      TRACE_WARN(("Location %d did not answer probes. Suspect it.",
+                  LOCAL.probe_target->index));
+      hm_gossip_apply(LOCAL.probe_target, HM_PEER_MEMBER_SUSPECT,
+                      LOCAL.probe_target->member_incarnation);
+    }
+    LOCAL.probe_target = NULL;
+    LOCAL.probe_stage = HM_GOSSIP_PROBE_NONE;
+  }
+
+  loc_cb = hm_gossip_next_member();
+  if (loc_cb == NULL)
+  {
+    /***************************************************************************/
+    /* Nobody to probe. Ask the seeds; whoever answers becomes a member.     */
+    /***************************************************************************/
+    TRACE_DETAIL(("No live member. Probe seeds."));
+    for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.gossip_seeds);
+         block != NULL;
+         block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+    {
+      hm_gossip_send((HM_TRANSPORT_CB *)block->target, HM_PEER_MSG_TYPE_PING,
+                     0, 0, LOCAL.local_location_cb.index);
+    }
+    goto EXIT_LABEL;
+  }
+
+  LOCAL.probe_target = loc_cb;
+  LOCAL.probe_id++;
+  LOCAL.probe_stage = HM_GOSSIP_PROBE_DIRECT;
+  if (loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE)
+  {
+    /***************************************************************************/
+    /* Say INIT again until the peer answers it.                 */
+    /***************************************************************************/
+    hm_cluster_send_init(loc_cb->peer_listen_cb);
+  }
+  hm_gossip_send(loc_cb->peer_listen_cb, HM_PEER_MSG_TYPE_PING, LOCAL.probe_id,
+                 loc_cb->index, LOCAL.local_location_cb.index);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_gossip_tick */
+
+
+/**
+ *  @brief Picks the next member to probe, in turn
+ *
+ *  Members declared dead are skipped, except once every
+ *  HM_GOSSIP_DEAD_PROBE_ROUNDS rounds, when the next dead member is probed
+ *  instead. Should a partition have healed, it hears that it is held dead and
+ *  refutes it with a later incarnation.
+ *
+ *  @param None
+ *  @return Location CB (#HM_LOCATION_CB) of the member, NULL if there is none
+ */
+HM_LOCATION_CB *hm_gossip_next_member()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  HM_LIST_BLOCK *next = NULL;
+  uint32_t dead_round;
+  uint32_t pass, i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  dead_round = ((++LOCAL.probe_rounds % HM_GOSSIP_DEAD_PROBE_ROUNDS) == 0);
+
+  /***************************************************************************/
+  /* If no member is dead in a dead round, probe a live one as usual.      */
+  /***************************************************************************/
+  for (pass = (dead_round ? 0 : 1); (pass < 2) && (loc_cb == NULL); pass++)
+  {
+    block = LOCAL.gossip_next;
+    for (i = 0; i < LOCAL.num_gossip_members; i++)
+    {
+      if (block == NULL)
+      {
+        block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.gossip_members);
+      }
+      next = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node);
+      if ((((HM_LOCATION_CB *)block->target)->member_status ==
+                                            HM_PEER_MEMBER_DEAD) == (pass == 0))
+      {
+        loc_cb = (HM_LOCATION_CB *)block->target;
+        LOCAL.gossip_next = next;
+        break;
+      }
+      block = next;
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (loc_cb);
+}/* hm_gossip_next_member */
+
+
+/**
+ *  @brief Asks a few random members to probe a member on our behalf
+ *
+ *  As many as configured in gossip fanout are asked, fewer if there are not
+ *  as many live members besides the target.
+ *
+ *  @param *target Location CB (#HM_LOCATION_CB) of the member being probed
+ *  @return void
+ */
+void hm_gossip_ping_req(HM_LOCATION_CB *target)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  uint32_t candidates = 0;
+  uint32_t needed;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(target != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.gossip_members);
+       block != NULL;
+       block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+  {
+    loc_cb = (HM_LOCATION_CB *)block->target;
+    if ((loc_cb != target) && (loc_cb->member_status == HM_PEER_MEMBER_ALIVE))
+    {
+      candidates++;
+    }
+  }
+
+  /***************************************************************************/
+  /* Each candidate is picked with the chance of what is still needed out of */
+  /* what is still left, so all are equally likely.              */
+  /***************************************************************************/
+  needed = (LOCAL.gossip_fanout < candidates) ? LOCAL.gossip_fanout : candidates;
+  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.gossip_members);
+       (block != NULL) && (needed > 0);
+       block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+  {
+    loc_cb = (HM_LOCATION_CB *)block->target;
+    if ((loc_cb == target) || (loc_cb->member_status != HM_PEER_MEMBER_ALIVE))
+    {
+      continue;
+    }
+    if ((uint32_t)(rand() % candidates) < needed)
+    {
+      TRACE_DETAIL(("Ask Location %d to probe Location %d", loc_cb->index,
+                    target->index));
+      hm_gossip_send(loc_cb->peer_listen_cb, HM_PEER_MSG_TYPE_PING_REQ,
+                     LOCAL.probe_id, target->index,
+                     LOCAL.local_location_cb.index);
+      needed--;
+    }
+    candidates--;
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_gossip_ping_req */
+
+
+/**
+ *  @brief Sends a Gossip message, with membership changes piggybacked
+ *
+ *  @param *tprt_cb Transport (#HM_TRANSPORT_CB) of a peer or of a seed
+ *  @param msg_type One of Ping, Ping Request or Ping Ack
+ *  @param probe_id Probe of the origin the message belongs to
+ *  @param target Member being probed
+ *  @param origin Member that started the probe
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_gossip_send(HM_TRANSPORT_CB *tprt_cb, uint32_t msg_type,
+                       uint32_t probe_id, uint32_t target, uint32_t origin)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_PEER_MSG_GOSSIP *gossip_msg = NULL;
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_MSG *msg = NULL;
+  uint32_t max_members, num_members;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  /***************************************************************************/
+  /* A seed may accept no more than the smallest frame of all.        */
+  /***************************************************************************/
+  loc_cb = tprt_cb->location_cb;
+  max_members = (((loc_cb != NULL) ? hm_cluster_frame_size(loc_cb) :
+                                      HM_PEER_MIN_FRAME_SIZE) -
+                 HM_PEER_GOSSIP_MSG_SIZE(0)) / sizeof(HM_PEER_MEMBER);
+  if (((loc_cb == NULL) || !loc_cb->gossip_full_sync) &&
+      (max_members > HM_GOSSIP_MAX_PIGGYBACK))
+  {
+    max_members = HM_GOSSIP_MAX_PIGGYBACK;
+  }
+
+  msg = hm_get_buffer(HM_PEER_GOSSIP_MSG_SIZE(max_members));
+  if (msg == NULL)
+  {
+    TRACE_ERROR(("Error allocating buffer for Gossip message."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  gossip_msg = (HM_PEER_MSG_GOSSIP *)msg->msg;
+  memset(gossip_msg, 0, HM_PEER_GOSSIP_MSG_SIZE(max_members));
+
+  num_members = hm_gossip_fill(gossip_msg, max_members, loc_cb);
+  msg->msg_len = HM_PEER_GOSSIP_MSG_SIZE(num_members);
+
+  HM_PUT_LONG(gossip_msg->hdr.hw_id, LOCAL.local_location_cb.index);
+  HM_PUT_LONG(gossip_msg->hdr.msg_type, msg_type);
+  HM_PUT_LONG(gossip_msg->hdr.msg_len, msg->msg_len);
+  hm_hlc_put(gossip_msg->hdr.timestamp, hm_hlc_now());
+  HM_PUT_LONG(gossip_msg->probe_id, probe_id);
+  HM_PUT_LONG(gossip_msg->target, target);
+  HM_PUT_LONG(gossip_msg->origin, origin);
+  HM_PUT_LONG(gossip_msg->incarnation,
+              LOCAL.local_location_cb.member_incarnation);
+  HM_PUT_LONG(gossip_msg->num_members, num_members);
+
+  if (hm_queue_on_transport(msg, tprt_cb, HM_PRIORITY_HA) != HM_OK)
+  {
+    TRACE_ERROR(("Error sending Gossip message."));
+    ret_val = HM_ERR;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (msg != NULL)
+  {
+    hm_free_buffer(msg);
+  }
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_gossip_send */
+
+
+/**
+ *  @brief Fills in the members to piggyback on a Gossip message
+ *
+ *  Carries each recent change a few times. A new member gets everyone we
+ *  know of, once. A member we do not believe alive is always told so, first,
+ *  that it may refute it.
+ *
+ *  @param *gossip_msg Gossip message (#HM_PEER_MSG_GOSSIP) to fill in
+ *  @param max_members Members that fit in the message
+ *  @param *to Location CB (#HM_LOCATION_CB) it is sent to, NULL for a seed
+ *  @return Number of members filled in
+ */
+uint32_t hm_gossip_fill(HM_PEER_MSG_GOSSIP *gossip_msg, uint32_t max_members,
+                        HM_LOCATION_CB *to)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LIST_BLOCK *block = NULL;
+  uint32_t full_sync = FALSE;
+  uint32_t to_first;
+  uint32_t num_members = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(gossip_msg != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (to != NULL)
+  {
+    full_sync = to->gossip_full_sync;
+    to->gossip_full_sync = FALSE;
+  }
+
+  /***************************************************************************/
+  /* The receiver, if it is suspect or dead to us, so it is never crowded  */
+  /* out. Then we, then the members, in probe order.                       */
+  /***************************************************************************/
+  to_first = ((to != NULL) && (to->member_status != HM_PEER_MEMBER_ALIVE) &&
+              (max_members > 0));
+  if (to_first)
+  {
+    hm_gossip_put_member(&gossip_msg->members[num_members++], to);
+  }
+  loc_cb = &LOCAL.local_location_cb;
+  block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(LOCAL.gossip_members);
+  while ((loc_cb != NULL) && (num_members < max_members))
+  {
+    if (((loc_cb != to) || !to_first) &&
+        (full_sync ?
+         ((loc_cb->member_status != HM_PEER_MEMBER_DEAD) ||
+          (loc_cb->gossip_sends_left > 0)) :
+         (loc_cb->gossip_sends_left > 0)))
+    {
+      hm_gossip_put_member(&gossip_msg->members[num_members++], loc_cb);
+    }
+
+    loc_cb = NULL;
+    if (block != NULL)
+    {
+      loc_cb = (HM_LOCATION_CB *)block->target;
+      block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node);
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (num_members);
+}/* hm_gossip_fill */
+
+
+/**
+ *  @brief Writes what we know of a member into a Gossip member entry
+ *
+ *  Counts it as one more send of its latest change.
+ *
+ *  @param *member Member entry (#HM_PEER_MEMBER) to write
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the member
+ *  @return void
+ */
+void hm_gossip_put_member(HM_PEER_MEMBER *member, HM_LOCATION_CB *loc_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  SOCKADDR_IN *addr = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(member != NULL);
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  HM_PUT_LONG(member->hw_id, loc_cb->index);
+  HM_PUT_LONG(member->status, loc_cb->member_status);
+  HM_PUT_LONG(member->incarnation, loc_cb->member_incarnation);
+  addr = (SOCKADDR_IN *)&loc_cb->peer_listen_cb->address.address;
+  HM_PUT_LONG(member->addr, addr->sin_addr.s_addr);
+  HM_PUT_LONG(member->port, addr->sin_port);
+  if (loc_cb->gossip_sends_left > 0)
+  {
+    loc_cb->gossip_sends_left--;
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_gossip_put_member */
+
+
+/**
+ *  @brief Processes a Gossip message received on the peer socket
+ *
+ *  The sender is alive, whatever else we heard. The members it piggybacked
+ *  are merged into ours, and the probe it belongs to is moved along: a Ping
+ *  is answered, a Ping Request is passed on to its target, and an Ack either
+ *  completes our probe or is passed back to whoever asked us.
+ *
+ *  @param *tprt_cb Our own peer transport (#HM_TRANSPORT_CB), holding the datagram
+ *  @param *sender Address (#SOCKADDR) the datagram came from
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_gossip_receive(HM_TRANSPORT_CB *tprt_cb, SOCKADDR *sender)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_PEER_MSG_GOSSIP *gossip_msg = NULL;
+  HM_LOCATION_CB *loc_cb = NULL;
+  HM_LOCATION_CB *member_cb = NULL;
+  HM_SOCKADDR_UNION member_addr;
+
+  uint32_t hw_id, msg_type;
+  uint32_t probe_id, target, origin, incarnation;
+  uint32_t num_members, i;
+  uint32_t member_id, status, addr, port;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (tprt_cb->in_bytes < (int32_t)HM_PEER_GOSSIP_MSG_SIZE(0))
+  {
+    TRACE_WARN(("Gossip message of %d bytes is too short.", tprt_cb->in_bytes));
+    goto EXIT_LABEL;
+  }
+  gossip_msg = (HM_PEER_MSG_GOSSIP *)tprt_cb->in_buffer;
+  HM_GET_LONG(hw_id, gossip_msg->hdr.hw_id);
+  HM_GET_LONG(msg_type, gossip_msg->hdr.msg_type);
+  hm_hlc_merge(hm_hlc_get(gossip_msg->hdr.timestamp));
+  HM_GET_LONG(probe_id, gossip_msg->probe_id);
+  HM_GET_LONG(target, gossip_msg->target);
+  HM_GET_LONG(origin, gossip_msg->origin);
+  HM_GET_LONG(incarnation, gossip_msg->incarnation);
+  HM_GET_LONG(num_members, gossip_msg->num_members);
+  if (num_members > (tprt_cb->in_bytes - HM_PEER_GOSSIP_MSG_SIZE(0)) /
+                                                    sizeof(HM_PEER_MEMBER))
+  {
+    TRACE_WARN(("Gossip claims %d members, more than it carries.", num_members));
+    num_members = (tprt_cb->in_bytes - HM_PEER_GOSSIP_MSG_SIZE(0)) /
+                                                    sizeof(HM_PEER_MEMBER);
+  }
+
+  /***************************************************************************/
+  /* The sender itself                                 */
+  /***************************************************************************/
+  loc_cb = hm_cluster_find_peer(hw_id);
+  if ((loc_cb == NULL) && (sender != NULL))
+  {
+    loc_cb = hm_gossip_new_member(hw_id, sender);
+  }
+  else if (sender != NULL)
+  {
+    memcpy(&loc_cb->peer_listen_cb->address.address, sender, sizeof(SOCKADDR));
+  }
+  if (loc_cb == NULL)
+  {
+    TRACE_ERROR(("Cannot place Gossip from Location %d.", hw_id));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  hm_gossip_apply(loc_cb, HM_PEER_MEMBER_ALIVE, incarnation);
+  hm_phi_heartbeat(&loc_cb->liveness, loc_cb->keepalive_period);
+
+  /***************************************************************************/
+  /* What it knows of the others                         */
+  /***************************************************************************/
+  for (i = 0; i < num_members; i++)
+  {
+    HM_GET_LONG(member_id, gossip_msg->members[i].hw_id);
+    HM_GET_LONG(status, gossip_msg->members[i].status);
+    HM_GET_LONG(incarnation, gossip_msg->members[i].incarnation);
+    if (status > HM_PEER_MEMBER_DEAD)
+    {
+      TRACE_WARN(("Unknown status %d of Location %d", status, member_id));
+      continue;
+    }
+
+    if (member_id == LOCAL.local_location_cb.index)
+    {
+      hm_gossip_refute(status, incarnation);
+      continue;
+    }
+
+    member_cb = hm_cluster_find_peer(member_id);
+    if (member_cb == NULL)
+    {
+      HM_GET_LONG(addr, gossip_msg->members[i].addr);
+      HM_GET_LONG(port, gossip_msg->members[i].port);
+      if ((status == HM_PEER_MEMBER_DEAD) || (addr == 0) || (port == 0))
+      {
+        continue;
+      }
+      memset(&member_addr, 0, sizeof(member_addr));
+      member_addr.in_addr.sin_family = AF_INET;
+      member_addr.in_addr.sin_addr.s_addr = addr;
+      member_addr.in_addr.sin_port = port;
+      member_cb = hm_gossip_new_member(member_id, &member_addr.sock_addr);
+      if (member_cb == NULL)
+      {
+        continue;
+      }
+    }
+    hm_gossip_apply(member_cb, status, incarnation);
+  }
+
+  /***************************************************************************/
+  /* The probe                                     */
+  /***************************************************************************/
+  switch (msg_type)
+  {
+  case HM_PEER_MSG_TYPE_PING:
+    TRACE_DETAIL(("Ping from Location %d", hw_id));
+    hm_gossip_send(loc_cb->peer_listen_cb, HM_PEER_MSG_TYPE_PING_ACK, probe_id,
+                   LOCAL.local_location_cb.index, origin);
+    break;
+
+  case HM_PEER_MSG_TYPE_PING_REQ:
+    TRACE_DETAIL(("Location %d asks us to probe Location %d", hw_id, target));
+    member_cb = hm_cluster_find_peer(target);
+    if ((member_cb == NULL) || (target == LOCAL.local_location_cb.index))
+    {
+      TRACE_DETAIL(("Location %d unknown.", target));
+      break;
+    }
+    hm_gossip_send(member_cb->peer_listen_cb, HM_PEER_MSG_TYPE_PING, probe_id,
+                   target, origin);
+    break;
+
+  case HM_PEER_MSG_TYPE_PING_ACK:
+    if (origin != LOCAL.local_location_cb.index)
+    {
+      /***************************************************************************/
+      /* We probed for someone else. Tell them.                  */
+      /***************************************************************************/
+      member_cb = hm_cluster_find_peer(origin);
+      if (member_cb != NULL)
+      {
+        hm_gossip_send(member_cb->peer_listen_cb, HM_PEER_MSG_TYPE_PING_ACK,
+                       probe_id, target, origin);
+      }
+    }
+    else if ((LOCAL.probe_target != NULL) && (probe_id == LOCAL.probe_id) &&
+             (target == LOCAL.probe_target->index))
+    {
+      TRACE_DETAIL(("Location %d answered probe %d", target, probe_id));
+      LOCAL.probe_stage = HM_GOSSIP_PROBE_ACKED;
+    }
+    break;
+
+  default:
+    TRACE_WARN(("Unknown Gossip message %d", msg_type));
+    break;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_gossip_receive */
+
+
+/**
+ *  @brief Merges what was heard of a member into what we know of it
+ *
+ *  News of a later incarnation always wins. Within an incarnation, dead wins
+ *  over suspect, and suspect over alive. What is taken is spread further.
+ *
+ *  @param *loc_cb Location CB (#HM_LOCATION_CB) of the member
+ *  @param status Status heard (HM_PEER_MEMBER_*)
+ *  @param incarnation Incarnation the status holds for
+ *  @return TRUE if it changed what we know, FALSE otherwise
+ */
+uint32_t hm_gossip_apply(HM_LOCATION_CB *loc_cb, uint32_t status,
+                         uint32_t incarnation)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t changed = FALSE;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(loc_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if ((incarnation < loc_cb->member_incarnation) ||
+      ((incarnation == loc_cb->member_incarnation) &&
+       (status <= loc_cb->member_status)))
+  {
+    goto EXIT_LABEL;
+  }
+
+  TRACE_INFO(("Location %d: Status %d, Incarnation %d -> Status %d, Incarnation %d",
+              loc_cb->index, loc_cb->member_status, loc_cb->member_incarnation,
+              status, incarnation));
+  changed = TRUE;
+  loc_cb->member_status = status;
+  loc_cb->member_incarnation = incarnation;
+  loc_cb->suspect_ticks = 0;
+  loc_cb->gossip_sends_left = hm_gossip_sends();
+
+  if ((status == HM_PEER_MEMBER_DEAD) &&
+      (loc_cb->fsm_state == HM_PEER_FSM_STATE_ACTIVE))
+  {
+    TRACE_WARN(("Location %d is dead. Mark it as down now!", loc_cb->index));
+    hm_peer_fsm(HM_PEER_FSM_CLOSE, loc_cb);
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (changed);
+}/* hm_gossip_apply */
+
+
+/**
+ *  @brief Refutes what is being said of us, if it is not that we are alive
+ *
+ *  Raising our incarnation makes our being alive win over it everywhere.
+ *
+ *  @param status Status heard of us (HM_PEER_MEMBER_*)
+ *  @param incarnation Incarnation the status holds for
+ *  @return void
+ */
+void hm_gossip_refute(uint32_t status, uint32_t incarnation)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LOCATION_CB *loc_cb = &LOCAL.local_location_cb;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if ((incarnation > loc_cb->member_incarnation) ||
+      ((status != HM_PEER_MEMBER_ALIVE) &&
+       (incarnation == loc_cb->member_incarnation)))
+  {
+    TRACE_WARN(("We are said to have Status %d in Incarnation %d. Refute.",
+                status, incarnation));
+    loc_cb->member_incarnation = incarnation + 1;
+    loc_cb->gossip_sends_left = hm_gossip_sends();
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_gossip_refute */
+
+
+/**
+ *  @brief Times a change is piggybacked before it is considered spread
+ *
+ *  Grows with the logarithm of the cluster size, which is how many rounds of
+ *  gossip it takes to reach everyone.
+ *
+ *  @param None
+ *  @return Number of sends
+ */
+uint32_t hm_gossip_sends()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t sends = HM_GOSSIP_RETRANSMIT_MULT;
+  uint32_t size;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (size = LOCAL.num_gossip_members + 1; size > 1; size >>= 1)
+  {
+    sends += HM_GOSSIP_RETRANSMIT_MULT;
+  }
+
+  return (sends);
+}/* hm_gossip_sends */
@@ -273,7 +273,6 @@ int32_t hm_cluster_send_ha_update(HM_NODE_CB *master_node,
   int32_t ret_val = HM_OK;
   HM_PEER_MSG_HA_UPDATE *ha_msg = NULL;
   HM_MSG *msg = NULL;
-  time_t current_time;
 #ifdef I_WANT_TO_DEBUG
   uint32_t i = 0;
 #endif
@@ -316,10 +315,10 @@ int32_t hm_cluster_send_ha_update(HM_NODE_CB *master_node,
   }
 
 #endif
+  HM_PUT_LONG(ha_msg->hdr.msg_len, sizeof(HM_PEER_MSG_HA_UPDATE));
 
-  current_time = hm_hton64(time(NULL));
-  TRACE_DETAIL(("Time value: 0x%x", (unsigned int)current_time));
-  memcpy(ha_msg->hdr.timestamp, &current_time, sizeof(current_time));
+  hm_hlc_put(ha_msg->hdr.timestamp, hm_hlc_now());
+  TRACE_DETAIL(("Clock: 0x%llx", (unsigned long long)LOCAL.hlc));
 #ifdef I_WANT_TO_DEBUG
 
   for (i = 0; i < sizeof(ha_msg->hdr.timestamp); i++)
@@ -335,12 +334,24 @@ int32_t hm_cluster_send_ha_update(HM_NODE_CB *master_node,
 
   /***************************************************************************/
   /* Message created. Now, add it to outgoing queue and try to send          */
+  /* A remote node is reached on the stream to its location.          */
   /***************************************************************************/
-  if (hm_queue_on_transport(msg, dest_node->transport_cb, FALSE) != HM_OK)
+  if (dest_node->parent_location_cb->index != LOCAL.local_location_cb.index)
+  {
+    ret_val = hm_cluster_send_sequenced(msg, dest_node->parent_location_cb,
+                                        HM_PRIORITY_HA);
+  }
+  else
+  {
+    ret_val = hm_queue_on_transport(msg, dest_node->transport_cb, HM_PRIORITY_HA);
+  }
+
+  if (ret_val != HM_OK)
   {
     TRACE_ERROR(("Error occured while sending HA Update"));
     ret_val = HM_ERR;
   }
+  hm_free_buffer(msg);
 
 EXIT_LABEL:
   /***************************************************************************/
@@ -468,6 +479,8 @@ void hm_ha_resolve_active_backup(HM_NODE_CB *node_cb)
                     (glob_cb->role == NODE_ROLE_ACTIVE) ? "active" : "passive"));
         TRACE_INFO(("Node's Role: %s",
                     (node_cb->current_role == NODE_ROLE_ACTIVE) ? "active" : "passive"));
+        TRACE_INFO(("Candidate's Suspicion: %.2f",
+                    hm_ha_node_suspicion(glob_cb->node_cb)));
 
         /* Resolve only if roles are not NONE */
         /* Or, if both are running on same location, and desired_roles are not NONE */
@@ -554,7 +567,7 @@ void hm_ha_resolve_active_backup(HM_NODE_CB *node_cb)
               LOCAL.local_location_cb.index)
           {
             /* If the other node is a local node, setup subscriptions too.*/
-            hm_subscribe(HM_REG_SUBS_TYPE_NODE, node_cb->id, (void *)glob_cb, FALSE);
+            hm_subscribe(HM_REG_SUBS_TYPE_NODE, node_cb->id, (void *)glob_cb, FALSE, NULL);
 
             if (hm_global_node_update(glob_cb->node_cb, HM_UPDATE_NODE_ROLE) != HM_OK)
             {
@@ -575,3 +588,45 @@ void hm_ha_resolve_active_backup(HM_NODE_CB *node_cb)
   /***************************************************************************/
   TRACE_EXIT();
 } /* hm_ha_resolve_active_backup */
+
+
+/**
+ *  hm_ha_node_suspicion
+ *  @brief Suspicion that a node is down
+ *
+ *  A local node is judged by its own keepalives. A remote node is as suspect
+ *  as its location, since the location's ticks are all that reach us of it.
+ *
+ *  @param *node_cb a #HM_NODE_CB type Node Control block
+ *  @return Phi of the node, or a negative value if there is too little to say
+ */
+double hm_ha_node_suspicion(HM_NODE_CB *node_cb)
+{
+  /***************************************************************************/
+  /* Local Variables                                                         */
+  /***************************************************************************/
+  double phi = -1.0;
+  /***************************************************************************/
+  /* Sanity Checks                                                           */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(node_cb != NULL);
+  /***************************************************************************/
+  /* Main Routine                                                            */
+  /***************************************************************************/
+  if (node_cb->parent_location_cb->index == LOCAL.local_location_cb.index)
+  {
+    phi = hm_phi(&node_cb->liveness);
+  }
+  else
+  {
+    phi = hm_phi(&node_cb->parent_location_cb->liveness);
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                                                       */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return phi;
+} /* hm_ha_node_suspicion */
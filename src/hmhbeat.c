@@ -0,0 +1,878 @@
+/**
+ *  @file hmhbeat.c
+ *  @brief Heartbeat Thread
+ *
+ *  Keeps the Ticks of the cluster off the main loop. A thread of its own
+ *  sends, once every Keepalive period, the Tick the main loop last built;
+ *  hears the Ticks of peers on the heartbeat paths; and judges from them
+ *  which peers are alive. What it hears, and which peers it finds dead, are
+ *  posted to the main loop. So however long the main loop is held up by a
+ *  replay or a burst of notifications, our Ticks still go out on time, and
+ *  a slow main loop is not mistaken for a dead peer by the cluster.
+ *
+ *  The thread owns the heartbeat path sockets and its table of peers, and
+ *  with it the health of each path to each peer. Only the Tick to send, the
+ *  events posted and whether it is to keep running are shared, under the
+ *  lock.
+ *
+ *  @author agent
+ *  @date 18-Oct-2026
+ *  @bug None
+ */
+#define _GNU_SOURCE
+#include <hmincl.h>
+
+/**
+ *  @brief Starts the heartbeat thread
+ *
+ *  The sockets of the heartbeat paths are taken out of the main loop's set;
+ *  the main loop waits on the wake pipe instead. The thread runs at the
+ *  configured real-time priority, if permitted, and on the configured CPU.
+ *
+ *  @param None
+ *  @return HM_OK if successful, HM_ERR otherwise
+ */
+int32_t hm_heartbeat_start()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_HEARTBEAT_PATH *path = NULL;
+  pthread_attr_t attr;
+  struct sched_param param;
+  cpu_set_t cpus;
+  int32_t flags;
+  int32_t i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  if ((LOCAL.membership == HM_MEMBERSHIP_GOSSIP) ||
+      (HM_NEXT_IN_LIST(LOCAL.heartbeat_paths) == NULL))
+  {
+    TRACE_WARN(("Heartbeat thread needs multicast heartbeat paths."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  if (pipe(LOCAL.heartbeat.wake_fd) != 0)
+  {
+    TRACE_PERROR(("Error creating heartbeat wake pipe."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  if (pipe(LOCAL.heartbeat.stop_fd) != 0)
+  {
+    TRACE_PERROR(("Error creating heartbeat stop pipe."));
+    close(LOCAL.heartbeat.wake_fd[0]);
+    close(LOCAL.heartbeat.wake_fd[1]);
+    LOCAL.heartbeat.wake_fd[0] = -1;
+    LOCAL.heartbeat.wake_fd[1] = -1;
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  for (i = 0; i < 2; i++)
+  {
+    flags = fcntl(LOCAL.heartbeat.wake_fd[i], F_GETFL, 0);
+    fcntl(LOCAL.heartbeat.wake_fd[i], F_SETFL, flags | O_NONBLOCK);
+    flags = fcntl(LOCAL.heartbeat.stop_fd[i], F_GETFL, 0);
+    fcntl(LOCAL.heartbeat.stop_fd[i], F_SETFL, flags | O_NONBLOCK);
+  }
+  pthread_mutex_init(&LOCAL.heartbeat.lock, NULL);
+
+  /***************************************************************************/
+  /* The heartbeat sockets are the thread's now.                 */
+  /***************************************************************************/
+  for (path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+       path != NULL;
+       path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+  {
+    if (path->listen_cb->sock_cb != NULL)
+    {
+      FD_CLR(path->listen_cb->sock_cb->sock_fd, &hm_tprt_conn_set);
+    }
+  }
+  FD_SET(LOCAL.heartbeat.wake_fd[0], &hm_tprt_conn_set);
+  if (max_fd < LOCAL.heartbeat.wake_fd[0])
+  {
+    max_fd = LOCAL.heartbeat.wake_fd[0];
+  }
+
+  pthread_attr_init(&attr);
+  if (LOCAL.heartbeat.priority > 0)
+  {
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = LOCAL.heartbeat.priority;
+    pthread_attr_setschedparam(&attr, &param);
+  }
+
+  LOCAL.heartbeat.running = TRUE;
+  ret_val = pthread_create(&LOCAL.heartbeat.thread, &attr,
+                           hm_heartbeat_thread, NULL);
+  if ((ret_val == EPERM) && (LOCAL.heartbeat.priority > 0))
+  {
+    TRACE_WARN(("Not permitted to run at real-time priority %d. Using default.",
+                LOCAL.heartbeat.priority));
+    pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+    ret_val = pthread_create(&LOCAL.heartbeat.thread, &attr,
+                             hm_heartbeat_thread, NULL);
+  }
+  pthread_attr_destroy(&attr);
+
+  if (ret_val != 0)
+  {
+    TRACE_ERROR(("Error creating heartbeat thread: %d", ret_val));
+    LOCAL.heartbeat.running = FALSE;
+    hm_heartbeat_release();
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  if (LOCAL.heartbeat.cpu >= 0)
+  {
+    CPU_ZERO(&cpus);
+    CPU_SET(LOCAL.heartbeat.cpu, &cpus);
+    if (pthread_setaffinity_np(LOCAL.heartbeat.thread, sizeof(cpus), &cpus) != 0)
+    {
+      TRACE_WARN(("Could not pin heartbeat thread to CPU %d", LOCAL.heartbeat.cpu));
+    }
+  }
+  TRACE_INFO(("Heartbeat thread started. Priority %d, CPU %d",
+              LOCAL.heartbeat.priority, LOCAL.heartbeat.cpu));
+  ret_val = HM_OK;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_heartbeat_start */
+
+
+/**
+ *  @brief Stops the heartbeat thread
+ *
+ *  The thread is told to stop by a byte on the stop pipe, which wakes it
+ *  from its wait, and is waited for. It is never cancelled, so it is not
+ *  caught holding the lock.
+ *
+ *  @param None
+ *  @return None
+ */
+void hm_heartbeat_stop()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint8_t stop = 1;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  pthread_mutex_lock(&LOCAL.heartbeat.lock);
+  LOCAL.heartbeat.running = FALSE;
+  pthread_mutex_unlock(&LOCAL.heartbeat.lock);
+
+  if (write(LOCAL.heartbeat.stop_fd[1], &stop, 1) < 0)
+  {
+    TRACE_PERROR(("Error telling the heartbeat thread to stop."));
+  }
+  pthread_join(LOCAL.heartbeat.thread, NULL);
+  hm_heartbeat_release();
+  TRACE_INFO(("Heartbeat thread stopped."));
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_heartbeat_stop */
+
+
+/**
+ *  @brief Frees what the heartbeat thread held, once it is no more
+ *
+ *  The heartbeat sockets go back to the main loop. Events it did not take,
+ *  the peers the thread heard and the last Tick are freed, and the pipes
+ *  closed.
+ *
+ *  @param None
+ *  @return None
+ */
+void hm_heartbeat_release()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_HEARTBEAT_PATH *path = NULL;
+  HM_HEARTBEAT_EVENT *event = NULL;
+  HM_HEARTBEAT_PEER *peer = NULL;
+  int32_t i;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  for (path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+       path != NULL;
+       path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+  {
+    if (path->listen_cb->sock_cb != NULL)
+    {
+      FD_SET(path->listen_cb->sock_cb->sock_fd, &hm_tprt_conn_set);
+    }
+  }
+  FD_CLR(LOCAL.heartbeat.wake_fd[0], &hm_tprt_conn_set);
+
+  while ((event = (HM_HEARTBEAT_EVENT *)HM_NEXT_IN_LIST(LOCAL.heartbeat.events))
+                                                                     != NULL)
+  {
+    HM_REMOVE_FROM_LIST(event->node);
+    free(event);
+  }
+  while ((peer = (HM_HEARTBEAT_PEER *)HM_NEXT_IN_LIST(LOCAL.heartbeat.peers))
+                                                                     != NULL)
+  {
+    HM_REMOVE_FROM_LIST(peer->node);
+    free(peer);
+  }
+  if (LOCAL.heartbeat.tick != NULL)
+  {
+    free(LOCAL.heartbeat.tick);
+    LOCAL.heartbeat.tick = NULL;
+    LOCAL.heartbeat.tick_len = 0;
+  }
+
+  for (i = 0; i < 2; i++)
+  {
+    close(LOCAL.heartbeat.wake_fd[i]);
+    close(LOCAL.heartbeat.stop_fd[i]);
+    LOCAL.heartbeat.wake_fd[i] = -1;
+    LOCAL.heartbeat.stop_fd[i] = -1;
+  }
+  pthread_mutex_destroy(&LOCAL.heartbeat.lock);
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_heartbeat_release */
+
+
+/**
+ *  @brief Body of the heartbeat thread
+ *
+ *  Waits on the heartbeat sockets till the next Tick is due, sends it, and
+ *  judges the peers once every period. It returns once the main loop has
+ *  cleared running and written to the stop pipe.
+ *
+ *  @param *arg Unused
+ *  @return NULL
+ */
+void *hm_heartbeat_thread(void *arg)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint8_t *buffer = NULL;
+  uint32_t size;
+  HM_HEARTBEAT_PATH *path = NULL;
+  fd_set read_set;
+  int32_t fd_max;
+  int32_t nready;
+  struct timeval timeout;
+  uint64_t period_ns;
+  uint64_t next_tick;
+  uint64_t now;
+  uint32_t running;
+  sigset_t mask;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  UNUSED(arg);
+
+  /***************************************************************************/
+  /* Timer signals are for the main loop.                     */
+  /***************************************************************************/
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGRTMIN);
+  sigaddset(&mask, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  size = MAX(LOCAL.peer_frame_size, sizeof(HM_PEER_MSG_KEEPALIVE));
+  buffer = (uint8_t *)malloc(size);
+  if (buffer == NULL)
+  {
+    TRACE_ERROR(("Error allocating heartbeat buffer."));
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  period_ns = (uint64_t)LOCAL.peer_keepalive_period * 1000000;
+  next_tick = hm_time_ns();
+  while (TRUE)
+  {
+    pthread_mutex_lock(&LOCAL.heartbeat.lock);
+    running = LOCAL.heartbeat.running;
+    pthread_mutex_unlock(&LOCAL.heartbeat.lock);
+    if (!running)
+    {
+      break;
+    }
+
+    now = hm_time_ns();
+    if (now >= next_tick)
+    {
+      if (hm_heartbeat_send_tick(buffer) != HM_OK)
+      {
+        /***************************************************************************/
+        /* The main loop has not built a Tick yet. Look again shortly.       */
+        /***************************************************************************/
+        next_tick = now + (period_ns / 10);
+        continue;
+      }
+      hm_heartbeat_judge();
+      next_tick += period_ns;
+      if (next_tick <= now)
+      {
+        /***************************************************************************/
+        /* We fell behind. Do not send a burst of Ticks to catch up.        */
+        /***************************************************************************/
+        next_tick = now + period_ns;
+      }
+      continue;
+    }
+
+    FD_ZERO(&read_set);
+    FD_SET(LOCAL.heartbeat.stop_fd[0], &read_set);
+    fd_max = LOCAL.heartbeat.stop_fd[0];
+    for (path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+         path != NULL;
+         path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+    {
+      if (path->listen_cb->sock_cb != NULL)
+      {
+        FD_SET(path->listen_cb->sock_cb->sock_fd, &read_set);
+        fd_max = MAX(fd_max, path->listen_cb->sock_cb->sock_fd);
+      }
+    }
+
+    timeout.tv_sec = (next_tick - now) / 1000000000;
+    timeout.tv_usec = ((next_tick - now) % 1000000000) / 1000;
+    nready = select(fd_max + 1, &read_set, NULL, NULL, &timeout);
+    if (nready <= 0)
+    {
+      if ((nready == -1) && (errno != EINTR))
+      {
+        TRACE_PERROR(("Error waiting on heartbeat sockets."));
+      }
+      continue;
+    }
+
+    for (path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+         path != NULL;
+         path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+    {
+      if ((path->listen_cb->sock_cb != NULL) &&
+          (FD_ISSET(path->listen_cb->sock_cb->sock_fd, &read_set)))
+      {
+        hm_heartbeat_receive(path, buffer, size);
+      }
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  if (buffer != NULL)
+  {
+    free(buffer);
+  }
+  TRACE_EXIT();
+  return (NULL);
+}/* hm_heartbeat_thread */
+
+
+/**
+ *  @brief Sends the latest Tick on every heartbeat path
+ *
+ *  The Tick is stamped when it is sent, not when the main loop built it.
+ *  The acks in it echo stamps of peers, which have been held for as long as
+ *  the Tick waited, and that is added to their hold time.
+ *
+ *  @param *buffer Buffer to copy the Tick into
+ *  @return HM_OK if sent, HM_ERR if there is no Tick yet
+ */
+int32_t hm_heartbeat_send_tick(uint8_t *buffer)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_PEER_MSG_KEEPALIVE *tick_msg = NULL;
+  HM_HEARTBEAT_PATH *path = NULL;
+  uint32_t len = 0;
+  uint32_t num_acks;
+  uint32_t i;
+  uint64_t built_ns = 0;
+  uint64_t now;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  pthread_mutex_lock(&LOCAL.heartbeat.lock);
+  if (LOCAL.heartbeat.tick != NULL)
+  {
+    len = LOCAL.heartbeat.tick_len;
+    built_ns = LOCAL.heartbeat.tick_built_ns;
+    memcpy(buffer, LOCAL.heartbeat.tick, len);
+  }
+  pthread_mutex_unlock(&LOCAL.heartbeat.lock);
+
+  if (len == 0)
+  {
+    TRACE_DETAIL(("No Tick built yet."));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  tick_msg = (HM_PEER_MSG_KEEPALIVE *)buffer;
+  now = hm_time_ns();
+  hm_put_64(tick_msg->sent_ns, now);
+  hm_put_64(tick_msg->wall_ns, hm_wall_time_ns());
+  HM_GET_LONG(num_acks, tick_msg->num_acks);
+  for (i = 0; i < num_acks; i++)
+  {
+    if (hm_get_64(tick_msg->acks[i].echo_ns) != 0)
+    {
+      hm_put_64(tick_msg->acks[i].held_ns,
+                hm_get_64(tick_msg->acks[i].held_ns) + (now - built_ns));
+    }
+  }
+
+  for (path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+       path != NULL;
+       path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+  {
+    if (path->send_cb->sock_cb == NULL)
+    {
+      continue;
+    }
+    if (hm_tprt_send_on_socket((SOCKADDR *)&path->send_cb->address.address,
+                               path->send_cb->sock_cb->sock_fd,
+                               path->send_cb->type, buffer, len) == HM_ERR)
+    {
+      TRACE_ERROR(("Error occured while sending Tick on path %d", path->id));
+    }
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (ret_val);
+}/* hm_heartbeat_send_tick */
+
+
+/**
+ *  @brief Hears a Tick on a heartbeat path
+ *
+ *  Only Ticks of other locations are taken. A copy already heard on another
+ *  path is dropped here; the first one is posted to the main loop.
+ *
+ *  @param *path Heartbeat path (#HM_HEARTBEAT_PATH) that is readable
+ *  @param *buffer Buffer to receive into
+ *  @param size Size of the buffer
+ *  @return None
+ */
+void hm_heartbeat_receive(HM_HEARTBEAT_PATH *path, uint8_t *buffer, uint32_t size)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PEER_MSG_KEEPALIVE *tick_msg = NULL;
+  HM_HEARTBEAT_PEER *peer = NULL;
+  HM_SOCKADDR_UNION sender;
+  socklen_t addr_len = sizeof(sender);
+  int32_t bytes;
+  uint32_t msg_type;
+  uint32_t loc_id;
+  uint64_t sent_ns;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  bytes = recvfrom(path->listen_cb->sock_cb->sock_fd, buffer, size, 0,
+                   &sender.sock_addr, &addr_len);
+  if (bytes < 0)
+  {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+    {
+      TRACE_PERROR(("Error receiving on heartbeat path %d", path->id));
+    }
+    goto EXIT_LABEL;
+  }
+  if ((uint32_t)bytes < HM_PEER_KEEPALIVE_MSG_SIZE(0))
+  {
+    TRACE_WARN(("Short message of %d bytes on heartbeat path %d", bytes, path->id));
+    goto EXIT_LABEL;
+  }
+
+  tick_msg = (HM_PEER_MSG_KEEPALIVE *)buffer;
+  HM_GET_LONG(msg_type, tick_msg->hdr.msg_type);
+  if (msg_type != HM_PEER_MSG_TYPE_KEEPALIVE)
+  {
+    TRACE_WARN(("Message type %d on heartbeat path %d", msg_type, path->id));
+    goto EXIT_LABEL;
+  }
+  HM_GET_LONG(loc_id, tick_msg->hdr.hw_id);
+  if (loc_id == LOCAL.local_location_cb.index)
+  {
+    goto EXIT_LABEL;
+  }
+
+  for (peer = (HM_HEARTBEAT_PEER *)HM_NEXT_IN_LIST(LOCAL.heartbeat.peers);
+       peer != NULL;
+       peer = (HM_HEARTBEAT_PEER *)HM_NEXT_IN_LIST(peer->node))
+  {
+    if (peer->loc_id == loc_id)
+    {
+      break;
+    }
+  }
+  if (peer == NULL)
+  {
+    peer = (HM_HEARTBEAT_PEER *)malloc(sizeof(HM_HEARTBEAT_PEER));
+    if (peer == NULL)
+    {
+      TRACE_ERROR(("Error allocating heartbeat peer %d", loc_id));
+      goto EXIT_LABEL;
+    }
+    memset(peer, 0, sizeof(HM_HEARTBEAT_PEER));
+    HM_INIT_LQE(peer->node, peer);
+    peer->loc_id = loc_id;
+    hm_phi_init(&peer->liveness);
+    HM_INSERT_BEFORE(LOCAL.heartbeat.peers, peer->node);
+  }
+  hm_cluster_path_heard(&peer->paths, loc_id, path->id);
+
+  sent_ns = hm_get_64(tick_msg->sent_ns);
+  if ((sent_ns != 0) && (sent_ns == peer->last_sent_ns))
+  {
+    TRACE_DETAIL(("Tick of %d already heard on another path.", loc_id));
+    goto EXIT_LABEL;
+  }
+  peer->last_sent_ns = sent_ns;
+
+  if (peer->down)
+  {
+    TRACE_INFO(("Location %d heard again.", loc_id));
+    peer->down = FALSE;
+    peer->missed = 0;
+    hm_phi_init(&peer->liveness);
+  }
+  else if (peer->missed > 0)
+  {
+    peer->missed--;
+  }
+  hm_phi_heartbeat(&peer->liveness, LOCAL.peer_keepalive_period);
+
+  hm_heartbeat_post(HM_HEARTBEAT_EVENT_TICK, loc_id, path->id, &sender,
+                    buffer, (uint32_t)bytes);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_heartbeat_receive */
+
+
+/**
+ *  @brief Judges the liveness of peers once every period
+ *
+ *  The same rule as the main loop uses without the thread: suspicion once
+ *  enough Ticks have arrived to judge by, the count of missed Ticks till then.
+ *
+ *  @param None
+ *  @return None
+ */
+void hm_heartbeat_judge()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_HEARTBEAT_PEER *peer = NULL;
+  double phi;
+  uint32_t down;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  for (peer = (HM_HEARTBEAT_PEER *)HM_NEXT_IN_LIST(LOCAL.heartbeat.peers);
+       peer != NULL;
+       peer = (HM_HEARTBEAT_PEER *)HM_NEXT_IN_LIST(peer->node))
+  {
+    if (peer->down)
+    {
+      continue;
+    }
+    peer->missed++;
+    hm_cluster_path_missed(&peer->paths, peer->loc_id);
+    phi = hm_phi(&peer->liveness);
+    if ((LOCAL.peer_phi_threshold != 0) && (phi >= 0))
+    {
+      down = (phi >= LOCAL.peer_phi_threshold);
+    }
+    else
+    {
+      down = (peer->missed > LOCAL.peer_kickout_value);
+    }
+    if (down)
+    {
+      TRACE_WARN(("Location %d missed %d Ticks, suspicion %.2f. Mark it as down!",
+                  peer->loc_id, peer->missed, phi));
+      peer->down = TRUE;
+      hm_heartbeat_post(HM_HEARTBEAT_EVENT_DOWN, peer->loc_id, 0, NULL, NULL, 0);
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_heartbeat_judge */
+
+
+/**
+ *  @brief Posts an event to the main loop, and wakes it
+ *
+ *  @param type Type of event (HM_HEARTBEAT_EVENT_*)
+ *  @param loc_id Location the event is about
+ *  @param path_id Path a Tick came by
+ *  @param *sender Sender of the Tick, or @c NULL
+ *  @param *data The Tick, or @c NULL
+ *  @param len Length of the Tick
+ *  @return None
+ */
+void hm_heartbeat_post(uint32_t type, uint32_t loc_id, uint32_t path_id,
+                       HM_SOCKADDR_UNION *sender, uint8_t *data, uint32_t len)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_HEARTBEAT_EVENT *event = NULL;
+  uint8_t wake = 1;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  event = (HM_HEARTBEAT_EVENT *)malloc(sizeof(HM_HEARTBEAT_EVENT) + len);
+  if (event == NULL)
+  {
+    TRACE_ERROR(("Error allocating heartbeat event."));
+    goto EXIT_LABEL;
+  }
+  memset(event, 0, sizeof(HM_HEARTBEAT_EVENT));
+  HM_INIT_LQE(event->node, event);
+  event->type = type;
+  event->loc_id = loc_id;
+  event->path_id = path_id;
+  if (sender != NULL)
+  {
+    event->sender = *sender;
+  }
+  if (data != NULL)
+  {
+    memcpy(event->data, data, len);
+    event->len = len;
+  }
+
+  pthread_mutex_lock(&LOCAL.heartbeat.lock);
+  HM_INSERT_BEFORE(LOCAL.heartbeat.events, event->node);
+  pthread_mutex_unlock(&LOCAL.heartbeat.lock);
+
+  /***************************************************************************/
+  /* A full pipe already has the main loop woken.                 */
+  /***************************************************************************/
+  if ((write(LOCAL.heartbeat.wake_fd[1], &wake, 1) < 0) && (errno != EAGAIN))
+  {
+    TRACE_PERROR(("Error waking the main loop."));
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_heartbeat_post */
+
+
+/**
+ *  @brief Hands a freshly built Tick to the heartbeat thread
+ *
+ *  @param *msg The Tick (#HM_MSG)
+ *  @return None
+ */
+void hm_heartbeat_set_tick(HM_MSG *msg)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint8_t *tick = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  tick = (uint8_t *)malloc(msg->msg_len);
+  if (tick == NULL)
+  {
+    TRACE_ERROR(("Error allocating Tick for heartbeat thread."));
+    goto EXIT_LABEL;
+  }
+  memcpy(tick, msg->msg, msg->msg_len);
+
+  pthread_mutex_lock(&LOCAL.heartbeat.lock);
+  TRACE_ASSERT(msg->msg_len <= MAX(LOCAL.peer_frame_size,
+                                   sizeof(HM_PEER_MSG_KEEPALIVE)));
+  if (LOCAL.heartbeat.tick != NULL)
+  {
+    free(LOCAL.heartbeat.tick);
+  }
+  LOCAL.heartbeat.tick = tick;
+  LOCAL.heartbeat.tick_len = msg->msg_len;
+  LOCAL.heartbeat.tick_built_ns = hm_time_ns();
+  pthread_mutex_unlock(&LOCAL.heartbeat.lock);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_heartbeat_set_tick */
+
+
+/**
+ *  @brief Takes the events posted by the heartbeat thread, in the main loop
+ *
+ *  Ticks heard are processed as if read off the heartbeat path, for what
+ *  they carry besides liveness: new locations, acks and table versions.
+ *  A peer found dead is closed, unless it is a relayed or gossip member,
+ *  whose liveness is judged otherwise.
+ *
+ *  @param None
+ *  @return None
+ */
+void hm_heartbeat_process_events()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_HEARTBEAT_EVENT *event = NULL;
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
+  HM_MSG *msg = NULL;
+  uint8_t drain[64];
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                */
+  /***************************************************************************/
+  while (read(LOCAL.heartbeat.wake_fd[0], drain, sizeof(drain)) > 0)
+  {
+    /* Empty the pipe. */
+  }
+
+  while (TRUE)
+  {
+    pthread_mutex_lock(&LOCAL.heartbeat.lock);
+    event = (HM_HEARTBEAT_EVENT *)HM_NEXT_IN_LIST(LOCAL.heartbeat.events);
+    if (event != NULL)
+    {
+      HM_REMOVE_FROM_LIST(event->node);
+    }
+    pthread_mutex_unlock(&LOCAL.heartbeat.lock);
+    if (event == NULL)
+    {
+      break;
+    }
+
+    switch (event->type)
+    {
+    case HM_HEARTBEAT_EVENT_TICK:
+      msg = hm_get_buffer(event->len);
+      if (msg == NULL)
+      {
+        TRACE_ERROR(("Error allocating buffer for Tick of %d", event->loc_id));
+        break;
+      }
+      memcpy(msg->msg, event->data, event->len);
+      hm_cluster_check_location(msg, &event->sender.sock_addr, event->path_id);
+      hm_free_buffer(msg);
+      break;
+
+    case HM_HEARTBEAT_EVENT_DOWN:
+      glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIND(LOCAL.locations_tree,
+                &event->loc_id, locations_tree_by_db_id);
+      if ((glob_cb == NULL) || (glob_cb->loc_cb->via != NULL) ||
+          (glob_cb->loc_cb->fsm_state != HM_PEER_FSM_STATE_ACTIVE))
+      {
+        TRACE_DETAIL(("Location %d is not an active peer.", event->loc_id));
+        break;
+      }
+      TRACE_WARN(("Heartbeat thread found location %d down.", event->loc_id));
+      hm_peer_fsm(HM_PEER_FSM_CLOSE, glob_cb->loc_cb);
+      break;
+
+    default:
+      TRACE_WARN(("Unknown heartbeat event %d", event->type));
+      break;
+    }
+    free(event);
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_heartbeat_process_events */
@@ -48,6 +48,10 @@
 /***************************************************************************/
 #include <time.h>
 /***************************************************************************/
+/* Math functions: exp(), log10(), sqrt()                    */
+/***************************************************************************/
+#include <math.h>
+/***************************************************************************/
 /* Threading and Mutex Functions                       */
 /***************************************************************************/
 #include <pthread.h>
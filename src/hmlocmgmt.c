@@ -180,6 +180,7 @@ int32_t hm_peer_fsm(uint32_t input_signal, HM_LOCATION_CB * loc_cb)
   uint32_t next_input = input_signal;
   uint32_t action;
   int32_t ret_val = HM_OK;;
+  double phi;
 
   TRACE_ENTRY();
 
@@ -221,6 +222,9 @@ int32_t hm_peer_fsm(uint32_t input_signal, HM_LOCATION_CB * loc_cb)
       /* If N masks are set, then the Peer is declared dead.             */
       /***************************************************************************/
       loc_cb->keepalive_missed = 0;
+      hm_phi_init(&loc_cb->liveness);
+      memset(&loc_cb->link, 0, sizeof(loc_cb->link));
+      memset(&loc_cb->paths, 0, sizeof(loc_cb->paths));
       HM_TIMER_START(loc_cb->timer_cb);
 
       /***************************************************************************/
@@ -240,13 +244,34 @@ int32_t hm_peer_fsm(uint32_t input_signal, HM_LOCATION_CB * loc_cb)
       /*                                       */
       /* We're expecting the peer to do the same as soon as it receives INIT Rsp.*/
       /* Send END OF REPLAY at the end of it.                     */
+      /* Only what changed since the version the peer told us it has is sent.  */
+      /* Before it, tell the peer which processes we want, so that it sends us  */
+      /* only those from now on.                          */
       /***************************************************************************/
+      hm_cluster_send_interest(loc_cb);
       loc_cb->replay_in_progress = TRUE;
-      if(hm_cluster_replay_info(loc_cb->peer_listen_cb) != HM_OK)
+      if(hm_cluster_replay_info(loc_cb->peer_listen_cb, loc_cb->replay_since) != HM_OK)
       {
         TRACE_ERROR(("Error sending replay messages to peer."));
         TRACE_ASSERT(FALSE);
       }
+      /***************************************************************************/
+      /* An aggregator follows it with what it holds of the other locations.  */
+      /***************************************************************************/
+      hm_cluster_relay_tables(loc_cb);
+
+      /***************************************************************************/
+      /* If its Ticks showed it is back with the tables we held, they are good */
+      /* now. Its replay, if any, is only what changed in the meantime.      */
+      /***************************************************************************/
+      if(loc_cb->tables_intact)
+      {
+        TRACE_INFO(("Restore tables of Location %d without waiting on replay.",
+            loc_cb->index));
+        hm_cluster_restore_location(loc_cb, loc_cb->version);
+        loc_cb->replay_in_progress = FALSE;
+        loc_cb->tables_intact = FALSE;
+      }
 
       next_input = HM_PEER_FSM_LOOP;
 
@@ -269,6 +294,11 @@ int32_t hm_peer_fsm(uint32_t input_signal, HM_LOCATION_CB * loc_cb)
       /* Stop timers                                   */
       /***************************************************************************/
       HM_TIMER_STOP(loc_cb->timer_cb);
+      /***************************************************************************/
+      /* Unacknowledged updates are not retransmitted to a new connection; the   */
+      /* replay after INIT covers them.                       */
+      /***************************************************************************/
+      hm_cluster_reset_stream(loc_cb);
       next_input = HM_PEER_FSM_LOOP;
 
       break;
@@ -279,15 +309,47 @@ int32_t hm_peer_fsm(uint32_t input_signal, HM_LOCATION_CB * loc_cb)
       /***************************************************************************/
       /* For a Local Location CB, this is an indication to send KA Ticks.       */
       /***************************************************************************/
-      if(loc_cb->index == LOCAL.local_location_cb.index)
+      if((loc_cb->index == LOCAL.local_location_cb.index) &&
+         (LOCAL.membership == HM_MEMBERSHIP_GOSSIP))
+      {
+        TRACE_DETAIL(("Probe a member of the Cluster"));
+        hm_gossip_tick();
+        hm_cluster_check_digests();
+      }
+      else if(loc_cb->index == LOCAL.local_location_cb.index)
       {
         TRACE_DETAIL(("Send Keepalive on Cluster"));
         hm_cluster_send_tick();
+        hm_cluster_check_digests();
       }
-      else if(++loc_cb->keepalive_missed > LOCAL.peer_kickout_value)
+      /***************************************************************************/
+      /* In Gossip, peers are declared down by the probes instead, and with a  */
+      /* heartbeat thread, by the thread.                     */
+      /***************************************************************************/
+      else if((LOCAL.membership != HM_MEMBERSHIP_GOSSIP) &&
+              (!LOCAL.heartbeat.running))
       {
-        TRACE_WARN(("Peer has exceeded Kickout Threshold. Mark it as down now!"));
-        next_input = HM_PEER_FSM_CLOSE;
+        /***************************************************************************/
+        /* Once enough ticks have arrived to judge by, suspicion decides. Till   */
+        /* then, or without a phi threshold, the count of missed ticks does.   */
+        /***************************************************************************/
+        loc_cb->keepalive_missed++;
+        hm_cluster_path_missed(&loc_cb->paths, loc_cb->index);
+        phi = hm_phi(&loc_cb->liveness);
+        if((LOCAL.peer_phi_threshold != 0) && (phi >= 0))
+        {
+          if(phi >= LOCAL.peer_phi_threshold)
+          {
+            TRACE_WARN(("Peer suspicion %.2f exceeds threshold. Mark it as down now!",
+                phi));
+            next_input = HM_PEER_FSM_CLOSE;
+          }
+        }
+        else if(loc_cb->keepalive_missed > LOCAL.peer_kickout_value)
+        {
+          TRACE_WARN(("Peer has exceeded Kickout Threshold. Mark it as down now!"));
+          next_input = HM_PEER_FSM_CLOSE;
+        }
       }
       /***************************************************************************/
       /* I'm sending Keepalive Ticks on the Multicast Socket only. This is due to*/
@@ -394,6 +456,7 @@ int32_t hm_location_update(HM_LOCATION_CB *loc_cb)
   /***************************************************************************/
   int32_t ret_val = HM_OK;
   HM_NODE_CB *node_cb = NULL;
+  HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -413,8 +476,16 @@ int32_t hm_location_update(HM_LOCATION_CB *loc_cb)
     TRACE_DETAIL(("Peer moved to active state."));
     break;
 
+  case HM_PEER_FSM_STATE_DELEGATED:
+    TRACE_DETAIL(("Location is active, as its aggregator tells us."));
+    break;
+
   case HM_PEER_FSM_STATE_FAILED:
     TRACE_DETAIL(("Peer is no longer active. Mark Nodes as Down"));
+    /***************************************************************************/
+    /* Remember what its tables came to, to check them against on its return.*/
+    /***************************************************************************/
+    loc_cb->held_digest = loc_cb->digest;
     for(node_cb = (HM_NODE_CB *)HM_AVL3_FIRST(loc_cb->node_tree, nodes_tree_by_node_id);
         node_cb != NULL;
         node_cb = (HM_NODE_CB *)HM_AVL3_NEXT(node_cb->index_node, nodes_tree_by_node_id))
@@ -425,6 +496,24 @@ int32_t hm_location_update(HM_LOCATION_CB *loc_cb)
       TRACE_INFO(("Mark Node %d as down.", node_cb->index));
       hm_node_fsm(HM_NODE_FSM_TERM, node_cb);
     }
+    /***************************************************************************/
+    /* Locations we knew through it are lost along with it.         */
+    /***************************************************************************/
+    for(glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_FIRST(LOCAL.locations_tree,
+                                                  locations_tree_by_db_id);
+        glob_cb != NULL;
+        glob_cb = (HM_GLOBAL_LOCATION_CB *)HM_AVL3_NEXT(glob_cb->node,
+                                                  locations_tree_by_db_id))
+    {
+      if((glob_cb->loc_cb->via == loc_cb) &&
+         (glob_cb->loc_cb->fsm_state == HM_PEER_FSM_STATE_DELEGATED))
+      {
+        TRACE_INFO(("Location %d was known through it. Mark it as down.",
+            glob_cb->loc_cb->index));
+        glob_cb->loc_cb->fsm_state = HM_PEER_FSM_STATE_FAILED;
+        hm_location_update(glob_cb->loc_cb);
+      }
+    }
     break;
 
   default:
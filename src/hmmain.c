@@ -160,6 +160,16 @@ int32_t main(int32_t argc, char **argv)
     goto EXIT_LABEL;
   }
 
+  /***************************************************************************/
+  /* Take the Ticks off the main loop, if so configured.           */
+  /* Without the thread, they stay where they were.               */
+  /***************************************************************************/
+  if(LOCAL.heartbeat.enabled && (hm_heartbeat_start() != HM_OK))
+  {
+    TRACE_WARN(("Heartbeat thread not started. Ticks stay on the main loop."));
+    LOCAL.heartbeat.enabled = FALSE;
+  }
+
   /***************************************************************************/
   /* Start Eternal Select Loop                         */
   /***************************************************************************/
@@ -193,6 +203,11 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
   HM_CONFIG_SUBSCRIPTION_CB *subs = NULL;
 
   HM_TRANSPORT_CB *tprt_cb = NULL;
+  HM_TRANSPORT_CB *send_cb = NULL;
+  HM_CONFIG_ADDRESS_CB *address_cb = NULL;
+  HM_HEARTBEAT_PATH *path = NULL;
+  uint32_t i;
+  uint32_t lane;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -233,8 +248,12 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
   HM_AVL3_INIT_TREE(LOCAL.pending_subscriptions_tree, NULL);
   LOCAL.next_pending_tree_id = 1;
 
-  /* Notifications Queue */
-  HM_INIT_ROOT(LOCAL.notification_queue);
+  /* Notifications Queues */
+  for(i = 0; i < HM_NUM_PRIORITIES; i++)
+  {
+    HM_INIT_ROOT(LOCAL.notification_queue[i]);
+  }
+  HM_INIT_ROOT(LOCAL.pending_updates);
   LOCAL.next_notification_id = 1;
 
   /* Wildcard list */
@@ -256,6 +275,10 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
 
   LOCAL.transport_bitmask = 0;
   LOCAL.mcast_addr = NULL;
+  HM_INIT_ROOT(LOCAL.heartbeat_paths);
+  LOCAL.num_heartbeat_paths = 0;
+  memset(LOCAL.recent_ticks, 0, sizeof(LOCAL.recent_ticks));
+  LOCAL.next_recent_tick = 0;
 
   LOCAL.local_location_cb.node_listen_cb = NULL;
   LOCAL.local_location_cb.peer_broadcast_cb = NULL;
@@ -264,6 +287,55 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
 
   LOCAL.local_location_cb.timer_cb = NULL;
 
+  /***************************************************************************/
+  /* Versions of our tables are only meaningful within this run. Peers that  */
+  /* remember a version from an earlier run must get everything again.     */
+  /***************************************************************************/
+  LOCAL.local_location_cb.incarnation = (uint32_t)time(NULL);
+  LOCAL.local_location_cb.version = 0;
+  LOCAL.local_location_cb.replay_since = 0;
+  LOCAL.local_location_cb.digest = 0;
+  /***************************************************************************/
+  /* Nothing is subscribed to yet: peers need send us no processes.        */
+  /***************************************************************************/
+  LOCAL.local_location_cb.interest_all = FALSE;
+  LOCAL.local_location_cb.num_interests = 0;
+  LOCAL.local_location_cb.frame_size = 0;
+  memset(LOCAL.local_location_cb.lanes, 0, sizeof(LOCAL.local_location_cb.lanes));
+  for (lane = 0; lane < HM_PEER_NUM_LANES; lane++)
+  {
+    HM_INIT_ROOT(LOCAL.local_location_cb.lanes[lane].unacked);
+  }
+  LOCAL.local_location_cb.ack_pending = FALSE;
+  LOCAL.peer_tick_count = 0;
+  LOCAL.hlc = 0;
+  HM_INIT_ROOT(LOCAL.replay_snapshot.msgs);
+  LOCAL.replay_snapshot.num_msgs = 0;
+  LOCAL.replay_snapshot.valid = FALSE;
+  LOCAL.replay_snapshot.generation = 0;
+  HM_INIT_ROOT(LOCAL.replays);
+  memset(&LOCAL.local_location_cb.replay, 0, sizeof(LOCAL.local_location_cb.replay));
+  HM_INIT_LQE(LOCAL.local_location_cb.replay.node, &LOCAL.local_location_cb);
+  LOCAL.digest_ticks_left = HM_DIGEST_INTERVAL_TICKS;
+
+  /***************************************************************************/
+  /* Our incarnation in gossip starts where a previous run could not have   */
+  /* reached, so that what peers remember of that run is overridden.       */
+  /***************************************************************************/
+  LOCAL.local_location_cb.member_status = HM_PEER_MEMBER_ALIVE;
+  LOCAL.local_location_cb.member_incarnation = LOCAL.local_location_cb.incarnation;
+  LOCAL.local_location_cb.suspect_ticks = 0;
+  LOCAL.local_location_cb.gossip_sends_left = 0;
+  LOCAL.local_location_cb.gossip_full_sync = FALSE;
+  HM_INIT_ROOT(LOCAL.gossip_members);
+  LOCAL.num_gossip_members = 0;
+  LOCAL.gossip_next = NULL;
+  HM_INIT_ROOT(LOCAL.gossip_seeds);
+  LOCAL.probe_target = NULL;
+  LOCAL.probe_id = 0;
+  LOCAL.probe_stage = HM_GOSSIP_PROBE_NONE;
+  LOCAL.probe_rounds = 0;
+
   LOCAL.node_keepalive_period = config_cb->instance_info.node.timer_val;
   TRACE_INFO(("Node Keepalive Period: %d(ms)",LOCAL.node_keepalive_period));
   LOCAL.node_kickout_value = config_cb->instance_info.node.threshold;
@@ -371,8 +443,11 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
     }
 #endif
     TRACE_DETAIL(("Port: %d", sock_addr->sin_port));
-    LOCAL.local_location_cb.peer_broadcast_cb->address.mcast_group =
+    if(LOCAL.local_location_cb.peer_broadcast_cb->address.mcast_group == 0)
+    {
+      LOCAL.local_location_cb.peer_broadcast_cb->address.mcast_group =
                           config_cb->instance_info.mcast_group;
+    }
     TRACE_DETAIL(("Multicast Group: %d",
             LOCAL.local_location_cb.peer_broadcast_cb->address.mcast_group));
     TRACE_DETAIL(("Set Multicast in transport bitmask"));
@@ -386,6 +461,62 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
       ret_val = HM_ERR;
       goto EXIT_LABEL;
     }
+
+    /***************************************************************************/
+    /* It is the first of the heartbeat paths.                   */
+    /***************************************************************************/
+    path = hm_alloc_heartbeat_path(tprt_cb, LOCAL.mcast_addr);
+    if(path == NULL)
+    {
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    path->id = LOCAL.num_heartbeat_paths++;
+    HM_INSERT_BEFORE(LOCAL.heartbeat_paths, path->node);
+
+    /***************************************************************************/
+    /* Every other multicast address is one more path for our Ticks.       */
+    /***************************************************************************/
+    for(address_cb = (HM_CONFIG_ADDRESS_CB *)HM_NEXT_IN_LIST(
+                              config_cb->instance_info.heartbeat_paths);
+        address_cb != NULL;
+        address_cb = (HM_CONFIG_ADDRESS_CB *)HM_NEXT_IN_LIST(address_cb->node))
+    {
+      if(LOCAL.num_heartbeat_paths == HM_MAX_HEARTBEAT_PATHS)
+      {
+        TRACE_WARN(("Only %d heartbeat paths are used. Ignore the rest.",
+                    HM_MAX_HEARTBEAT_PATHS));
+        break;
+      }
+      tprt_cb = hm_alloc_transport_cb(address_cb->address.type);
+      send_cb = hm_alloc_transport_cb(address_cb->address.type);
+      if((tprt_cb == NULL) || (send_cb == NULL) ||
+         ((path = hm_alloc_heartbeat_path(tprt_cb, send_cb)) == NULL))
+      {
+        TRACE_ERROR(("Error allocating heartbeat path."));
+        if(tprt_cb != NULL)
+        {
+          hm_free_transport_cb(tprt_cb);
+        }
+        if(send_cb != NULL)
+        {
+          hm_free_transport_cb(send_cb);
+        }
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+      memcpy(&tprt_cb->address, &address_cb->address, sizeof(HM_INET_ADDRESS));
+      if(tprt_cb->address.mcast_group == 0)
+      {
+        tprt_cb->address.mcast_group = config_cb->instance_info.mcast_group;
+      }
+      tprt_cb->location_cb = &LOCAL.local_location_cb;
+      path->id = LOCAL.num_heartbeat_paths++;
+      HM_INSERT_BEFORE(LOCAL.heartbeat_paths, path->node);
+      sock_addr = (SOCKADDR_IN *)&tprt_cb->address.address;
+      TRACE_INFO(("Heartbeat path %d: port %d, group %d", path->id,
+                  ntohs(sock_addr->sin_port), tprt_cb->address.mcast_group));
+    }
   }
   tprt_cb = NULL;
 
@@ -393,6 +524,9 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
   {
     TRACE_INFO(("Relative Peer information has been provided."));
     //TODO: Allocate a Location CB and fill its transport
+    /***************************************************************************/
+    /* Remote UDP addresses are used as gossip seeds once transport is up.   */
+    /***************************************************************************/
 
   }
 
@@ -410,6 +544,121 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
   LOCAL.peer_kickout_value = config_cb->instance_info.cluster.threshold;
   TRACE_INFO(("Peer Kickout Value: %d", LOCAL.peer_kickout_value));
 
+  LOCAL.node_phi_threshold = config_cb->instance_info.node.phi_threshold;
+  LOCAL.peer_phi_threshold = config_cb->instance_info.cluster.phi_threshold;
+  TRACE_INFO(("Phi Threshold: Node %d, Peer %d", LOCAL.node_phi_threshold,
+      LOCAL.peer_phi_threshold));
+
+  LOCAL.node_liveness = config_cb->instance_info.node.liveness;
+  TRACE_INFO(("Node Liveness: %s",
+      (LOCAL.node_liveness == HM_LIVENESS_KERNEL) ? "kernel" : "application"));
+
+  LOCAL.heartbeat.enabled = config_cb->instance_info.cluster.thread;
+  LOCAL.heartbeat.priority = config_cb->instance_info.cluster.priority;
+  LOCAL.heartbeat.cpu = config_cb->instance_info.cluster.cpu;
+  LOCAL.heartbeat.running = FALSE;
+  LOCAL.heartbeat.wake_fd[0] = -1;
+  LOCAL.heartbeat.wake_fd[1] = -1;
+  LOCAL.heartbeat.stop_fd[0] = -1;
+  LOCAL.heartbeat.stop_fd[1] = -1;
+  HM_INIT_ROOT(LOCAL.heartbeat.events);
+  HM_INIT_ROOT(LOCAL.heartbeat.peers);
+  LOCAL.heartbeat.tick = NULL;
+  LOCAL.heartbeat.tick_len = 0;
+  LOCAL.heartbeat.tick_built_ns = 0;
+
+  LOCAL.subs_queue = config_cb->instance_info.subs_queue;
+  TRACE_INFO(("Subscriber Queue: Policy %d, %d messages, %d bytes, %d overflows",
+      LOCAL.subs_queue.policy, LOCAL.subs_queue.max_msgs,
+      LOCAL.subs_queue.max_bytes, LOCAL.subs_queue.max_overflows));
+
+  /***************************************************************************/
+  /* A frame must at least hold the largest fixed size message, and is never */
+  /* larger than what a peer is obliged to accept.               */
+  /***************************************************************************/
+  LOCAL.peer_frame_size = config_cb->instance_info.peer_frame_size;
+  if(LOCAL.peer_frame_size < HM_PEER_MIN_FRAME_SIZE)
+  {
+    TRACE_WARN(("Peer frame size %d too small. Using %d",
+        LOCAL.peer_frame_size, (uint32_t)HM_PEER_MIN_FRAME_SIZE));
+    LOCAL.peer_frame_size = HM_PEER_MIN_FRAME_SIZE;
+  }
+  else if(LOCAL.peer_frame_size > HM_PEER_MAX_FRAME_SIZE)
+  {
+    TRACE_WARN(("Peer frame size %d too large. Using %d",
+        LOCAL.peer_frame_size, (uint32_t)HM_PEER_MAX_FRAME_SIZE));
+    LOCAL.peer_frame_size = HM_PEER_MAX_FRAME_SIZE;
+  }
+  TRACE_INFO(("Peer Frame Size: %d bytes", LOCAL.peer_frame_size));
+
+  /***************************************************************************/
+  /* A replay must make some progress every turn of the main loop.      */
+  /***************************************************************************/
+  LOCAL.replay_chunks = config_cb->instance_info.replay_chunks;
+  if(LOCAL.replay_chunks == 0)
+  {
+    TRACE_WARN(("Replay of no messages per turn. Using 1"));
+    LOCAL.replay_chunks = 1;
+  }
+  LOCAL.replay_rate = config_cb->instance_info.replay_rate;
+  TRACE_INFO(("Replay: %d messages per turn, %d bytes per second",
+      LOCAL.replay_chunks, LOCAL.replay_rate));
+
+  /***************************************************************************/
+  /* Gossip is carried on the datagram socket shared by all peers.        */
+  /***************************************************************************/
+  LOCAL.membership = config_cb->instance_info.membership;
+  LOCAL.gossip_fanout = config_cb->instance_info.gossip_fanout;
+  if((LOCAL.membership == HM_MEMBERSHIP_GOSSIP) &&
+     ((LOCAL.local_location_cb.peer_listen_cb == NULL) ||
+      (LOCAL.local_location_cb.peer_listen_cb->type != HM_TRANSPORT_UDP)))
+  {
+    TRACE_WARN(("Gossip membership needs a UDP cluster address. Using Multicast."));
+    LOCAL.membership = HM_MEMBERSHIP_MULTICAST;
+  }
+  TRACE_INFO(("Membership: %s, Fanout: %d",
+      (LOCAL.membership == HM_MEMBERSHIP_GOSSIP) ? "Gossip" : "Multicast",
+      LOCAL.gossip_fanout));
+
+  /***************************************************************************/
+  /* Who peers with whom is decided on the roles carried in Ticks. A leaf   */
+  /* that does not name its aggregator could peer with no one.            */
+  /***************************************************************************/
+  LOCAL.aggregation_role = config_cb->instance_info.aggregation_role;
+  LOCAL.aggregator = config_cb->instance_info.aggregator;
+  if((LOCAL.aggregation_role != HM_AGGREGATION_ROLE_MESH) &&
+     (LOCAL.membership == HM_MEMBERSHIP_GOSSIP))
+  {
+    TRACE_WARN(("Aggregation needs multicast membership. Peer with all."));
+    LOCAL.aggregation_role = HM_AGGREGATION_ROLE_MESH;
+  }
+  if((LOCAL.aggregation_role == HM_AGGREGATION_ROLE_LEAF) &&
+     ((LOCAL.aggregator == 0) ||
+      (LOCAL.aggregator == LOCAL.local_location_cb.index)))
+  {
+    TRACE_WARN(("Leaf has no aggregator to peer with. Peer with all."));
+    LOCAL.aggregation_role = HM_AGGREGATION_ROLE_MESH;
+  }
+  if(LOCAL.aggregation_role != HM_AGGREGATION_ROLE_LEAF)
+  {
+    LOCAL.aggregator = 0;
+  }
+  LOCAL.local_location_cb.aggregation_role = LOCAL.aggregation_role;
+  LOCAL.local_location_cb.aggregator = LOCAL.aggregator;
+  LOCAL.local_location_cb.via = NULL;
+  /***************************************************************************/
+  /* What an aggregator wants depends on whom it passes updates on to. It    */
+  /* takes everything, and filters for each of those on the way out.      */
+  /***************************************************************************/
+  if(LOCAL.aggregation_role == HM_AGGREGATION_ROLE_AGGREGATOR)
+  {
+    LOCAL.local_location_cb.interest_all = TRUE;
+  }
+  TRACE_INFO(("Aggregation role: %s, Aggregator: %d",
+      (LOCAL.aggregation_role == HM_AGGREGATION_ROLE_AGGREGATOR) ? "Aggregator" :
+      (LOCAL.aggregation_role == HM_AGGREGATION_ROLE_LEAF) ? "Leaf" : "Mesh",
+      LOCAL.aggregator));
+
   LOCAL.config_data = config_cb;
 
   /***************************************************************************/
@@ -460,7 +709,7 @@ int32_t hm_init_local(HM_CONFIG_CB *config_cb)
         subs != NULL;
         subs = (HM_CONFIG_SUBSCRIPTION_CB *)HM_NEXT_IN_LIST(subs->node))
       {
-        if(hm_subscribe(subs->subs_type, subs->value, (void *)node_config_cb->node_cb, FALSE) != HM_OK)
+        if(hm_subscribe(subs->subs_type, subs->value, (void *)node_config_cb->node_cb, FALSE, NULL) != HM_OK)
         {
           TRACE_ERROR(("Error creating subscriptions."));
           ret_val = HM_ERR;
@@ -502,6 +751,7 @@ int32_t hm_init_transport()
   /***************************************************************************/
   int32_t ret_val = HM_OK;
   HM_TRANSPORT_CB *tprt_cb = NULL;
+  HM_HEARTBEAT_PATH *path = NULL;
 
   struct sigaction action;
 
@@ -570,6 +820,23 @@ int32_t hm_init_transport()
       goto EXIT_LABEL;
     }
     tprt_cb->sock_cb->tprt_cb = tprt_cb;
+
+    if(LOCAL.membership == HM_MEMBERSHIP_GOSSIP)
+    {
+      /***************************************************************************/
+      /* Seeds are reached on this socket. Probes go out on the Cluster Timer. */
+      /***************************************************************************/
+      if(hm_gossip_init() != HM_OK)
+      {
+        TRACE_ERROR(("Error initializing gossip membership"));
+        tprt_cb = NULL;
+        ret_val = HM_ERR;
+        goto EXIT_LABEL;
+      }
+      LOCAL.local_location_cb.timer_cb = HM_TIMER_CREATE(LOCAL.peer_keepalive_period, TRUE,
+              hm_peer_keepalive_callback, (void *)&LOCAL.local_location_cb);
+      HM_TIMER_START(LOCAL.local_location_cb.timer_cb);
+    }
   }
 
   /***************************************************************************/
@@ -591,12 +858,36 @@ int32_t hm_init_transport()
     }
     tprt_cb->sock_cb->tprt_cb = tprt_cb;
 
+    /***************************************************************************/
+    /* The other heartbeat paths. Losing one of them only loses redundancy.  */
+    /***************************************************************************/
+    for(path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+        path != NULL;
+        path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+    {
+      if(path->listen_cb == LOCAL.local_location_cb.peer_broadcast_cb)
+      {
+        continue;
+      }
+      path->listen_cb->sock_cb = hm_tprt_open_connection(path->listen_cb->type,
+                                        (void *)&path->listen_cb->address);
+      if(path->listen_cb->sock_cb == NULL)
+      {
+        TRACE_ERROR(("Error initializing socket of heartbeat path %d", path->id));
+        continue;
+      }
+      path->listen_cb->sock_cb->tprt_cb = path->listen_cb;
+    }
+
     /***************************************************************************/
     /* Start the Cluster Timer too                         */
     /***************************************************************************/
-    LOCAL.local_location_cb.timer_cb = HM_TIMER_CREATE(LOCAL.peer_keepalive_period, TRUE,
-            hm_peer_keepalive_callback, (void *)&LOCAL.local_location_cb);
-    HM_TIMER_START(LOCAL.local_location_cb.timer_cb);
+    if(LOCAL.membership != HM_MEMBERSHIP_GOSSIP)
+    {
+      LOCAL.local_location_cb.timer_cb = HM_TIMER_CREATE(LOCAL.peer_keepalive_period, TRUE,
+              hm_peer_keepalive_callback, (void *)&LOCAL.local_location_cb);
+      HM_TIMER_START(LOCAL.local_location_cb.timer_cb);
+    }
   }
 
 EXIT_LABEL:
@@ -644,6 +935,7 @@ void hm_run_main_thread()
   HM_PEER_MSG_INIT *peer_init_msg = NULL;
   HM_PEER_MSG_KEEPALIVE *peer_tick_msg = NULL;
   HM_LOCATION_CB *loc_cb = NULL;
+  HM_HEARTBEAT_PATH *path = NULL;
 
   HM_GLOBAL_LOCATION_CB *glob_cb = NULL;
   int32_t loc_id;
@@ -664,7 +956,14 @@ void hm_run_main_thread()
   /***************************************************************************/
   /* Send Announce on Cluster marking its availability             */
   /***************************************************************************/
-  hm_cluster_send_tick();
+  if(LOCAL.membership == HM_MEMBERSHIP_GOSSIP)
+  {
+    hm_gossip_tick();
+  }
+  else
+  {
+    hm_cluster_send_tick();
+  }
 
   /***************************************************************************/
   /* Start HA Role timer too                                                 */
@@ -684,6 +983,18 @@ void hm_run_main_thread()
   while(1)
   {
     /*start loop to check for incoming events till kingdom come!          */
+    /***************************************************************************/
+    /* Everything that changed in the last pass (including from timers) goes  */
+    /* out now: one notification and one cluster update per changed entity.   */
+    /***************************************************************************/
+    hm_global_flush_updates();
+
+    /***************************************************************************/
+    /* Acknowledge what came from peers in the last pass, and send again what */
+    /* they have not acknowledged in time.                     */
+    /***************************************************************************/
+    hm_cluster_service_streams();
+
     /***************************************************************************/
     /* Check if the signal has been blocked. If it has been, proceed with      */
     /* select. Else, block it and unblock at the end of while. This is done to */
@@ -694,9 +1005,25 @@ void hm_run_main_thread()
     select_timeout.tv_sec = 0;
     select_timeout.tv_usec = 250000; /* 250ms */
 
+    /***************************************************************************/
+    /* Replays under way go on a few messages at a time, between the events.  */
+    /***************************************************************************/
+    if(HM_NEXT_IN_LIST(LOCAL.replays) != NULL)
+    {
+      hm_cluster_replay_continue();
+      if(HM_NEXT_IN_LIST(LOCAL.replays) != NULL)
+      {
+        select_timeout.tv_usec = HM_REPLAY_POLL_USEC;
+      }
+    }
+
     read_set = hm_tprt_conn_set;
     write_set = hm_tprt_write_set;
-    except_set = hm_tprt_write_set;
+    /***************************************************************************/
+    /* Exceptions are watched on every connection, sockets still connecting  */
+    /* included. The write set also holds sockets only waiting to drain.     */
+    /***************************************************************************/
+    except_set = hm_tprt_conn_set;
     /***************************************************************************/
     /* Unblock the signal.                             */
     /***************************************************************************/
@@ -730,6 +1057,18 @@ void hm_run_main_thread()
     TRACE_PERROR(("Error blocking signals before querying descriptors."));
     }
     /***************************************************************************/
+    /* Take what the heartbeat thread has posted.                 */
+    /***************************************************************************/
+    if((LOCAL.heartbeat.running) &&
+       (FD_ISSET(LOCAL.heartbeat.wake_fd[0], &read_set)))
+    {
+      hm_heartbeat_process_events();
+      if(--nready <=0)
+      {
+        continue;
+      }
+    }
+    /***************************************************************************/
     /* Check for incoming connections                       */
     /***************************************************************************/
     if(FD_ISSET(LOCAL.local_location_cb.node_listen_cb->sock_cb->sock_fd, &read_set))
@@ -790,14 +1129,19 @@ void hm_run_main_thread()
       }//end select on listenfd
     }
     /***************************************************************************/
-    /* Check on Multicast socket too                       */
+    /* Check on Multicast sockets too: one for each heartbeat path       */
     /***************************************************************************/
-    TRACE_DETAIL(("Check Multicast port %d!",
-            LOCAL.local_location_cb.peer_broadcast_cb->sock_cb->sock_fd));
-    if(LOCAL.local_location_cb.peer_broadcast_cb->sock_cb->sock_fd != -1)
+    for(path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+        path != NULL;
+        path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
     {
+      if((path->listen_cb->sock_cb == NULL) ||
+         (path->listen_cb->sock_cb->sock_fd == -1))
+      {
+        continue;
+      }
       TRACE_DETAIL(("Check Multicast port!"));
-      if(FD_ISSET(LOCAL.local_location_cb.peer_broadcast_cb->sock_cb->sock_fd, &read_set))
+      if(FD_ISSET(path->listen_cb->sock_cb->sock_fd, &read_set))
       {
         /***************************************************************************/
         /* Accept the connection only if we have not exceeded top-load benchmark   */
@@ -805,9 +1149,11 @@ void hm_run_main_thread()
         TRACE_INFO(("Cluster Muticast Port has requests."));
         /***************************************************************************/
         /* We'll need to receive the message into a random buffer which must be as */
-        /* large as at least the INIT message of peers.                */
+        /* large as at least the INIT message of peers. Keepalives carry acks for */
+        /* each peer, so allow for a full frame.                   */
         /***************************************************************************/
-        buf = hm_get_buffer( sizeof(HM_PEER_MSG_KEEPALIVE));
+        buf = hm_get_buffer(MAX(LOCAL.peer_frame_size,
+                                 sizeof(HM_PEER_MSG_KEEPALIVE)));
         TRACE_ASSERT(buf != NULL);
         if(buf == NULL)
         {
@@ -823,10 +1169,10 @@ void hm_run_main_thread()
         /* discard it.                                 */
         /***************************************************************************/
         if((bytes_rcvd = hm_tprt_recv_on_socket(
-                LOCAL.local_location_cb.peer_broadcast_cb->sock_cb->sock_fd,
-                LOCAL.local_location_cb.peer_broadcast_cb->sock_cb->sock_type,
+                path->listen_cb->sock_cb->sock_fd,
+                path->listen_cb->sock_cb->sock_type,
                       buf->msg,
-                      sizeof(HM_PEER_MSG_KEEPALIVE),
+                      buf->msg_len,
                       &(udp_sender)
                       ))== HM_ERR)
         {
@@ -834,11 +1180,13 @@ void hm_run_main_thread()
           TRACE_ASSERT(FALSE);
           //It is an error, but we'll still run (in release mode)
           //FIXME
-          break;
+          hm_free_buffer(buf);
+          continue;
         }
         TRACE_ASSERT(udp_sender != NULL);
-        if(bytes_rcvd == sizeof(HM_PEER_MSG_KEEPALIVE))
+        if(bytes_rcvd >= HM_PEER_KEEPALIVE_MSG_SIZE(0))
         {
+          buf->msg_len = bytes_rcvd;
           peer_tick_msg = (HM_PEER_MSG_KEEPALIVE *)buf->msg;
           HM_GET_LONG(bytes_rcvd, peer_tick_msg->hdr.msg_type);
           if( bytes_rcvd != HM_PEER_MSG_TYPE_KEEPALIVE)
@@ -866,23 +1214,34 @@ void hm_run_main_thread()
             }
 #endif
             hm_cluster_check_location(  buf,
-                          udp_sender);
+                          udp_sender, path->id);
             hm_free_buffer(buf);
             //TODO
           }
         }
+        else
+        {
+          TRACE_WARN(("Keepalive message too short. Ignore."));
+          hm_free_buffer(buf);
+        }
 
         /***************************************************************************/
-        /* If select returned 1, and it was a listen socket, it makes sense to poll*/
-        /* again by breaking out and use select again.                 */
+        /* Done with this socket. Keep it from the loop over connections below.  */
         /***************************************************************************/
-        if(--nready <=0)
-        {
-          TRACE_DETAIL(("No more incoming requests."));
-          continue;
-        }
+        FD_CLR(path->listen_cb->sock_cb->sock_fd, &read_set);
+        nready--;
       }//end select on listenfd
     }
+
+    /***************************************************************************/
+    /* If select returned 1, and it was a listen socket, it makes sense to poll*/
+    /* again by breaking out and use select again.                 */
+    /***************************************************************************/
+    if(nready <= 0)
+    {
+      TRACE_DETAIL(("No more incoming requests."));
+      continue;
+    }
     /***************************************************************************/
     /* Check for Exception events on any socket                     */
     /***************************************************************************/
@@ -965,15 +1324,24 @@ void hm_run_main_thread()
           TRACE_DETAIL(("Connect succeeded!"));
           TRACE_ASSERT(sock_cb->tprt_cb->location_cb != NULL);
           loc_cb = sock_cb->tprt_cb->location_cb;
+          sock_cb->conn_state = HM_TPRT_CONN_ACTIVE;
+          /***************************************************************************/
+          /* Remove it from global FD write set now. Sending sets it again if the  */
+          /* socket cannot take everything at once.                  */
+          /***************************************************************************/
+          FD_CLR(sock_cb->sock_fd, &hm_tprt_write_set);
           /***************************************************************************/
           /* Send an INIT request to the Peer                      */
           /***************************************************************************/
           hm_cluster_send_init(sock_cb->tprt_cb);
+        }
+        else if(sock_cb->tprt_cb != NULL)
+        {
           /***************************************************************************/
-          /* Remove it from global FD write set now.                   */
+          /* Socket can take data again. Resume the pending messages.        */
           /***************************************************************************/
-
-          FD_CLR(sock_cb->sock_fd, &hm_tprt_write_set);
+          TRACE_DETAIL(("Resume sending on socket %d", sock_cb->sock_fd));
+          hm_tprt_process_outgoing_queue(sock_cb->tprt_cb);
         }
         if(--nready <=0)
         {
@@ -1034,9 +1402,9 @@ void hm_run_main_thread()
           /* discard it.                                 */
           /* Update:                                    */
           /* We will have to try and receive Full INIT message on the socket because */
-          /* the INIT message of Nodes is bigger, and since both are TCP sockets     */
-          /* we cannot (we can but don't want to) make a distinction between a Node  */
-          /* socket and Location Socket.                         */
+          /* both are TCP sockets and we cannot (we can but don't want to) make a    */
+          /* distinction between a Node socket and Location Socket. The INIT of     */
+          /* Peers is the bigger one; a Node INIT is whatever it sent of less.      */
           /***************************************************************************/
           if((bytes_rcvd = hm_tprt_recv_on_socket(sock_cb->sock_fd,
                         sock_cb->sock_type,
@@ -1058,9 +1426,26 @@ void hm_run_main_thread()
           /***************************************************************************/
           //FIXME: There is a chance that size of HM_MSG_HDR and that of Peer Messages is same.
           //Consider differentiating recv on basis of sock type
-          if(bytes_rcvd == sizeof(HM_NODE_INIT_MSG))
+          if((bytes_rcvd == sizeof(HM_NODE_INIT_MSG)) ||
+             (bytes_rcvd == HM_NODE_INIT_V1_SIZE))
           {
+            buf = hm_shrink_buffer(buf, sizeof(HM_NODE_INIT_MSG));
+            if(buf == NULL)
+            {
+              TRACE_ERROR(("Error shrinking buffer!"));
+              TRACE_ASSERT(FALSE);
+              break;
+            }
             init_msg = (HM_NODE_INIT_MSG *)buf->msg;
+            if(bytes_rcvd == HM_NODE_INIT_V1_SIZE)
+            {
+              /***************************************************************************/
+              /* An older stub. It has no capabilities, and expects its own INIT back.  */
+              /***************************************************************************/
+              TRACE_DETAIL(("INIT without capabilities."));
+              init_msg->capabilities = 0;
+              buf->msg_len = bytes_rcvd;
+            }
             if((init_msg->hdr.msg_type != HM_MSG_TYPE_INIT) || (init_msg->hdr.request != TRUE))
             {
               TRACE_WARN(("Message type is not INIT request. Ignore."));
@@ -1168,6 +1553,15 @@ void hm_run_main_thread()
               TRACE_WARN(("Message type %d is not INIT request. Ignore.", msg_type));
               hm_free_buffer(buf);
             }
+            else if(!hm_cluster_init_may_peer(peer_init_msg))
+            {
+              /***************************************************************************/
+              /* Not ours to peer with. Leave it unanswered; it gives up on its own.    */
+              /***************************************************************************/
+              HM_GET_LONG(loc_id, peer_init_msg->hdr.hw_id);
+              TRACE_WARN(("Location %d may not peer with us. INIT ignored.", loc_id));
+              hm_free_buffer(buf);
+            }
             else
             {
               /***************************************************************************/
@@ -1192,6 +1586,7 @@ void hm_run_main_thread()
               if(glob_cb != NULL)
               {
                 TRACE_ERROR(("Received INIT on TCP Port of a known location"));
+                hm_cluster_read_init(peer_init_msg, glob_cb->loc_cb);
                 hm_peer_fsm(HM_PEER_FSM_INIT_RCVD, glob_cb->loc_cb);
               }
               else
@@ -1219,10 +1614,12 @@ void hm_run_main_thread()
                 /***************************************************************************/
                 /* Send a response of INIT first, and then commence Replay           */
                 /***************************************************************************/
+                hm_cluster_read_init(peer_init_msg, loc_cb);
                 HM_PUT_LONG(peer_init_msg->request, FALSE );
                 HM_PUT_LONG(peer_init_msg->response_ok, TRUE);
+                hm_cluster_fill_init(peer_init_msg, loc_cb);
 
-                if(hm_queue_on_transport(buf, sock_cb->tprt_cb, TRUE)!= HM_OK)
+                if(hm_queue_on_transport(buf, sock_cb->tprt_cb, HM_PRIORITY_CONTROL)!= HM_OK)
                 {
                   TRACE_ERROR(("Error sending INIT response!"));
                   TRACE_ASSERT((FALSE));
@@ -1406,6 +1803,10 @@ void hm_terminate()
   /* Close the socket connections.                       */
   /***************************************************************************/
   //hm_tprt_terminate();
+  if(LOCAL.heartbeat.running)
+  {
+    hm_heartbeat_stop();
+  }
   /***************************************************************************/
   /* Do something about the config data also. Free all memory!               */
   /***************************************************************************/
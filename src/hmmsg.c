@@ -27,10 +27,11 @@ int32_t hm_route_incoming_message(HM_SOCKET_CB *sock_cb)
   HM_MSG_HEADER *msg_hdr = NULL;
   int32_t bytes_rcvd = 0;
   HM_MSG *msg_buf = NULL;
+  HM_MSG *peer_frame = NULL;
   int32_t ret_val = HM_OK;
   int32_t size = 0;
 
-  SOCKADDR *udp_sender;
+  SOCKADDR *udp_sender = NULL;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -78,6 +79,12 @@ int32_t hm_route_incoming_message(HM_SOCKET_CB *sock_cb)
     /***************************************************************************/
     msg_hdr = (HM_MSG_HEADER *)sock_cb->tprt_cb->in_buffer;
 
+    /***************************************************************************/
+    /* Whatever it sent, the node is alive.                     */
+    /***************************************************************************/
+    hm_tprt_heard_from(sock_cb->tprt_cb,
+                       (msg_hdr->msg_type == HM_MSG_TYPE_KEEPALIVE));
+
     /***************************************************************************/
     /* Depending on the incoming message type, allocate Buffers for receiving  */
     /* the message.                                 */
@@ -88,14 +95,9 @@ int32_t hm_route_incoming_message(HM_SOCKET_CB *sock_cb)
         TRACE_DETAIL(("Keepalive Message."));
 
         /***************************************************************************/
-        /* Received Keepalive. Validate and Decrement Keepalive Ticks          */
+        /* Received Keepalive. It has been counted already.            */
         /* KEEPALIVE is just a header.                         */
         /***************************************************************************/
-        if (sock_cb->tprt_cb->node_cb->keepalive_missed > 0)
-        {
-          sock_cb->tprt_cb->node_cb->keepalive_missed--;
-        }
-
         sock_cb->tprt_cb->in_buffer = NULL;
         break;
 
@@ -252,20 +254,24 @@ int32_t hm_route_incoming_message(HM_SOCKET_CB *sock_cb)
   {
     TRACE_DETAIL(("Received Message from a peer."));
     /***************************************************************************/
-    /* Irrespective of TCP or UDP, we'll be receiving full message chunks only */
+    /* Peer messages carry their length. Small ones are read into the header   */
+    /* space of the transport; bigger frames get a buffer of their own.      */
     /***************************************************************************/
-    sock_cb->tprt_cb->in_bytes = hm_tprt_recv_on_socket(sock_cb->sock_fd,
-                                 sock_cb->sock_type,
-                                 (BYTE *)sock_cb->tprt_cb->in_buffer,
-                                 sizeof(HM_PEER_MSG_UNION),
-                                 &udp_sender
-                                                       );
+    sock_cb->tprt_cb->in_bytes = hm_recv_peer_frame(sock_cb, &peer_frame,
+                                                     &udp_sender);
 
     if (sock_cb->tprt_cb->in_bytes < (int32_t) sizeof(HM_PEER_MSG_HEADER))
     {
       TRACE_DETAIL(("Message Length of at least %d was expected, %d was received",
-                    sizeof(HM_PEER_MSG_HEADER), bytes_rcvd));
-      hm_tprt_handle_improper_read(sock_cb->tprt_cb->in_bytes, sock_cb->tprt_cb);
+                    sizeof(HM_PEER_MSG_HEADER), sock_cb->tprt_cb->in_bytes));
+      /***************************************************************************/
+      /* A bad datagram on the socket shared by all peers says nothing about   */
+      /* any one of them.                               */
+      /***************************************************************************/
+      if (sock_cb->tprt_cb != LOCAL.local_location_cb.peer_listen_cb)
+      {
+        hm_tprt_handle_improper_read(sock_cb->tprt_cb->in_bytes, sock_cb->tprt_cb);
+      }
       /***************************************************************************/
       /* Shh.. We've handled the network error. It is OK now.             */
       /***************************************************************************/
@@ -274,9 +280,18 @@ int32_t hm_route_incoming_message(HM_SOCKET_CB *sock_cb)
     }
 
     /***************************************************************************/
-    /* Process message received from cluster                   */
+    /* Process message received from cluster. On our datagram socket, it is   */
+    /* yet to be told which peer it is from.                    */
     /***************************************************************************/
-    if (hm_receive_cluster_message(sock_cb) != HM_OK)
+    if (sock_cb->tprt_cb == LOCAL.local_location_cb.peer_listen_cb)
+    {
+      if (hm_cluster_recv_datagram(sock_cb->tprt_cb, udp_sender) != HM_OK)
+      {
+        TRACE_ERROR(("Error occurred while handling cluster datagram."));
+        ret_val = HM_ERR;
+      }
+    }
+    else if (hm_receive_cluster_message(sock_cb->tprt_cb) != HM_OK)
     {
       TRACE_ERROR(("Error occurred while handling cluster message."));
       ret_val = HM_ERR;
@@ -287,11 +302,177 @@ EXIT_LABEL:
   /***************************************************************************/
   /* Exit Level Checks                             */
   /***************************************************************************/
+  if (peer_frame != NULL)
+  {
+    /***************************************************************************/
+    /* Release the buffer of a large peer message                */
+    /***************************************************************************/
+    hm_free_buffer(peer_frame);
+  }
+  if (udp_sender != NULL)
+  {
+    free(udp_sender);
+  }
   TRACE_EXIT();
   return (ret_val);
 }/* hm_route_incoming_message */
 
 
+/**
+ *  @brief Receives one complete message from a peer
+ *
+ *  The header is read first and the length it carries decides the rest. A
+ *  message that fits the header space of the transport is read in there.
+ *  Larger ones are read into a buffer allocated for them. Over UDP, the whole
+ *  message arrives in one datagram of at most our frame size.
+ *
+ *  @param *sock_cb Socket Control Block (#HM_SOCKET_CB) to read from
+ *  @param **frame Set to the buffer (#HM_MSG) allocated for a large message,
+ *      which the caller must free. Left NULL otherwise.
+ *  @param **udp_sender Filled with sender address on a datagram socket
+ *
+ *  @return Bytes of the message received. Less than a header on error.
+ */
+int32_t hm_recv_peer_frame(HM_SOCKET_CB *sock_cb, HM_MSG **frame,
+                           SOCKADDR **udp_sender)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_TRANSPORT_CB *tprt_cb = NULL;
+  HM_PEER_MSG_HEADER *peer_hdr = NULL;
+  int32_t bytes_rcvd = 0;
+  int32_t total_bytes = 0;
+  uint32_t msg_len = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(sock_cb != NULL);
+  TRACE_ASSERT(frame != NULL);
+
+  tprt_cb = sock_cb->tprt_cb;
+  *frame = NULL;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (sock_cb->sock_type == HM_TRANSPORT_SOCK_TYPE_UDP)
+  {
+    /***************************************************************************/
+    /* A datagram must be taken whole. Anything above the header space needs a */
+    /* frame sized buffer.                             */
+    /***************************************************************************/
+    if (LOCAL.peer_frame_size > sizeof(HM_PEER_MSG_UNION))
+    {
+      *frame = hm_get_buffer(LOCAL.peer_frame_size);
+      if (*frame == NULL)
+      {
+        TRACE_ERROR(("Error allocating buffer for peer message."));
+        goto EXIT_LABEL;
+      }
+      tprt_cb->in_buffer = (*frame)->msg;
+    }
+    total_bytes = hm_tprt_recv_on_socket(sock_cb->sock_fd,
+                                         sock_cb->sock_type,
+                                         (BYTE *)tprt_cb->in_buffer,
+                                         MAX(LOCAL.peer_frame_size,
+                                             sizeof(HM_PEER_MSG_UNION)),
+                                         udp_sender);
+    if (total_bytes < (int32_t) sizeof(HM_PEER_MSG_HEADER))
+    {
+      goto EXIT_LABEL;
+    }
+
+    peer_hdr = (HM_PEER_MSG_HEADER *)tprt_cb->in_buffer;
+    HM_GET_LONG(msg_len, peer_hdr->msg_len);
+    if (msg_len != (uint32_t)total_bytes)
+    {
+      TRACE_WARN(("Datagram of %d bytes carries length %d. Dropped.",
+                  total_bytes, msg_len));
+      /***************************************************************************/
+      /* Datagrams are independent. Drop this one but don't fail the socket.    */
+      /***************************************************************************/
+      total_bytes = HM_ERR;
+    }
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Stream: Read the header first                       */
+  /***************************************************************************/
+  while (total_bytes < (int32_t) sizeof(HM_PEER_MSG_HEADER))
+  {
+    bytes_rcvd = hm_tprt_recv_on_socket(sock_cb->sock_fd,
+                                        sock_cb->sock_type,
+                                        (BYTE *)tprt_cb->in_buffer + total_bytes,
+                                        sizeof(HM_PEER_MSG_HEADER) - total_bytes,
+                                        NULL);
+    if (bytes_rcvd <= 0)
+    {
+      total_bytes = bytes_rcvd;
+      goto EXIT_LABEL;
+    }
+    total_bytes += bytes_rcvd;
+  }
+
+  peer_hdr = (HM_PEER_MSG_HEADER *)tprt_cb->in_buffer;
+  HM_GET_LONG(msg_len, peer_hdr->msg_len);
+
+  if ((msg_len < sizeof(HM_PEER_MSG_HEADER)) ||
+      (msg_len > HM_PEER_MAX_FRAME_SIZE))
+  {
+    /***************************************************************************/
+    /* We cannot find the start of the next message on this stream any more.  */
+    /* Treat it like a broken connection.                    */
+    /***************************************************************************/
+    TRACE_ERROR(("Invalid peer message length %d", msg_len));
+    total_bytes = 0;
+    goto EXIT_LABEL;
+  }
+
+  if (msg_len > sizeof(HM_PEER_MSG_UNION))
+  {
+    TRACE_DETAIL(("Allocate %d bytes for large peer message", msg_len));
+    *frame = hm_get_buffer(msg_len);
+    if (*frame == NULL)
+    {
+      TRACE_ERROR(("Error allocating buffer for peer message."));
+      total_bytes = 0;
+      goto EXIT_LABEL;
+    }
+    memcpy((*frame)->msg, tprt_cb->in_buffer, sizeof(HM_PEER_MSG_HEADER));
+    tprt_cb->in_buffer = (*frame)->msg;
+  }
+
+  /***************************************************************************/
+  /* Now the rest of the message                         */
+  /***************************************************************************/
+  while (total_bytes < (int32_t) msg_len)
+  {
+    bytes_rcvd = hm_tprt_recv_on_socket(sock_cb->sock_fd,
+                                        sock_cb->sock_type,
+                                        (BYTE *)tprt_cb->in_buffer + total_bytes,
+                                        msg_len - total_bytes,
+                                        NULL);
+    if (bytes_rcvd <= 0)
+    {
+      total_bytes = bytes_rcvd;
+      goto EXIT_LABEL;
+    }
+    total_bytes += bytes_rcvd;
+  }
+  TRACE_DETAIL(("Received peer message of %d bytes", total_bytes));
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (total_bytes);
+}/* hm_recv_peer_frame */
+
+
 /**
  *  @brief Handles the event of unsuccessful read on socket.
  *
@@ -339,6 +520,76 @@ int32_t hm_tprt_handle_improper_read(int32_t bytes_rcvd,
   return (ret_val);
 }/* hm_tprt_handle_improper_read */
 
+
+/**
+ *  @brief Notes that a message was received from the other end of a transport
+ *
+ *  Any message proves the sender alive as well as a Keepalive does. Only
+ *  Keepalives are samples of its period though, and no longer than the
+ *  period once other messages came in between.
+ *
+ *  @param *tprt_cb Transport Control Block (#HM_TRANSPORT_CB) it arrived on
+ *  @param keepalive TRUE if the message was a Keepalive
+ *  @return @c void
+ */
+void hm_tprt_heard_from(HM_TRANSPORT_CB *tprt_cb, uint32_t keepalive)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_PHI_DETECTOR *detector = NULL;
+  uint32_t *missed = NULL;
+  uint32_t period = 0;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(tprt_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  tprt_cb->last_rx = hm_time_ms();
+
+  if (tprt_cb->node_cb != NULL)
+  {
+    detector = &tprt_cb->node_cb->liveness;
+    missed = &tprt_cb->node_cb->keepalive_missed;
+    period = tprt_cb->node_cb->keepalive_period;
+  }
+  else if ((tprt_cb->location_cb != NULL) &&
+           (tprt_cb->location_cb != &LOCAL.local_location_cb))
+  {
+    detector = &tprt_cb->location_cb->liveness;
+    missed = &tprt_cb->location_cb->keepalive_missed;
+    period = tprt_cb->location_cb->keepalive_period;
+  }
+  else
+  {
+    goto EXIT_LABEL;
+  }
+
+  if (*missed > 0)
+  {
+    (*missed)--;
+  }
+
+  if (keepalive)
+  {
+    hm_phi_heartbeat(detector, period);
+  }
+  else
+  {
+    hm_phi_touch(detector);
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_tprt_heard_from */
+
 /**
  *  @brief Receives a REGISTER (#HM_REGISTER_MSG) message and routes it to Node or Process Layer
  *
@@ -364,6 +615,10 @@ int32_t hm_recv_register(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb)
   SOCKADDR *udp_sender;
 
   HM_REGISTER_TLV_CB *tlv = NULL;
+  HM_SUBS_FILTER filter;
+  uint32_t tlv_size = sizeof(HM_REGISTER_TLV_CB);
+  HM_MSG *wide_msg = NULL;
+  HM_REGISTER_MSG *wide_reg = NULL;
   int32_t num_binding = 0; /* Number of bindings to propagate to cluster. */
   /***************************************************************************/
   /* Sanity Checks                               */
@@ -430,17 +685,26 @@ int32_t hm_recv_register(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb)
     goto EXIT_LABEL;
   }
 
+  /***************************************************************************/
+  /* A stub built before registration filters sends shorter TLVs.         */
+  /***************************************************************************/
+  if (reg->hdr.msg_len ==
+              sizeof(HM_REGISTER_MSG) + (reg->num_register * HM_REGISTER_TLV_V1_SIZE))
+  {
+    TRACE_DETAIL(("Register TLVs without filters."));
+    tlv_size = HM_REGISTER_TLV_V1_SIZE;
+  }
+
   /***************************************************************************/
   /* Allocate Memory to receive the rest of Register TLVs             */
   /***************************************************************************/
   TRACE_DETAIL(("Need extra memory for %u registers.[%u/block]",
-                reg->num_register , sizeof(HM_REGISTER_TLV_CB)));
+                reg->num_register , tlv_size));
 
   /* -1 is to account for the 1 uint_32 already in the header to mark start of data */
-  if ((int32_t)(msg_size + ((reg->num_register) * sizeof(HM_REGISTER_TLV_CB))
-                - 1) > msg_size)
+  if ((int32_t)(msg_size + ((reg->num_register) * tlv_size) - 1) > msg_size)
   {
-    msg_size = msg_size + ((reg->num_register) * sizeof(HM_REGISTER_TLV_CB)) - 1;
+    msg_size = msg_size + ((reg->num_register) * tlv_size) - 1;
     msg = hm_grow_buffer(msg, msg_size);
 
     if (msg == NULL)
@@ -460,14 +724,13 @@ int32_t hm_recv_register(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb)
     bytes_rcvd = hm_tprt_recv_on_socket(tprt_cb->sock_cb->sock_fd,
                                         tprt_cb->sock_cb->sock_type,
                                         (uint8_t *)tprt_cb->in_buffer,
-                                        ((reg->num_register) * sizeof(HM_REGISTER_TLV_CB)) - 1,
+                                        ((reg->num_register) * tlv_size) - 1,
                                         &udp_sender);
 
-    if (bytes_rcvd < (int32_t)((reg->num_register * sizeof(HM_REGISTER_TLV_CB))
-                               - 1))
+    if (bytes_rcvd < (int32_t)((reg->num_register * tlv_size) - 1))
     {
       TRACE_WARN(("Bytes received (%d) less than expected %u",
-                  bytes_rcvd, (reg->num_register * sizeof(HM_REGISTER_TLV_CB)) - 1));
+                  bytes_rcvd, (reg->num_register * tlv_size) - 1));
       hm_tprt_handle_improper_read(bytes_rcvd, tprt_cb);
       goto EXIT_LABEL;
     }
@@ -480,15 +743,46 @@ int32_t hm_recv_register(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb)
   TRACE_INFO(("Acquire Transport Lock!"));
   tprt_cb->hold = TRUE;
 
+  /***************************************************************************/
+  /* Short TLVs are widened into a copy, with all filters off. The response */
+  /* goes back in the format the stub sent.                  */
+  /***************************************************************************/
+  wide_reg = reg;
+  if (tlv_size != sizeof(HM_REGISTER_TLV_CB))
+  {
+    wide_msg = hm_get_buffer(sizeof(HM_REGISTER_MSG) +
+                             (reg->num_register * sizeof(HM_REGISTER_TLV_CB)));
+    if (wide_msg == NULL)
+    {
+      TRACE_ERROR(("Error allocating buffers for Register TLVs."));
+      ret_val = HM_ERR;
+      goto EXIT_LABEL;
+    }
+    wide_reg = (HM_REGISTER_MSG *)wide_msg->msg;
+    memcpy(wide_reg, reg, HM_OFFSETOF(HM_REGISTER_MSG, data));
+    for (i = 0; i < reg->num_register; i++)
+    {
+      tlv = (HM_REGISTER_TLV_CB *)wide_reg->data + i;
+      memset(tlv, 0, sizeof(HM_REGISTER_TLV_CB));
+      memcpy(tlv, (char *)reg->data + (i * tlv_size), tlv_size);
+    }
+  }
+
   /***************************************************************************/
   /* Have TLVs. Handle Subscription.                                         */
   /***************************************************************************/
-  for (i = 0; i < reg->num_register; i++)
+  for (i = 0; i < wide_reg->num_register; i++)
   {
-    tlv = (HM_REGISTER_TLV_CB *)reg->data + i;
+    tlv = (HM_REGISTER_TLV_CB *)wide_reg->data + i;
     TRACE_INFO(("Subscribe to 0X%x", tlv->id));
 
-    if (hm_subscribe(reg->type, tlv->id, subscriber, tlv->cross_bind) != HM_OK)
+    /***************************************************************************/
+    /* Notifications the subscriber does not want are never sent to it.      */
+    /***************************************************************************/
+    hm_subs_filter_compile(tlv, &filter);
+
+    if (hm_subscribe(reg->type, tlv->id, subscriber, tlv->cross_bind,
+                     &filter) != HM_OK)
     {
       TRACE_ERROR(("Error creating subscriptions."));
       ret_val = HM_ERR;
@@ -518,7 +812,7 @@ int32_t hm_recv_register(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb)
   /***************************************************************************/
   if (num_binding > 0)
   {
-    hm_cluster_exchange_binding((void *)subscriber, num_binding, reg);
+    hm_cluster_exchange_binding((void *)subscriber, num_binding, wide_reg);
   }
 
 EXIT_LABEL:
@@ -526,10 +820,15 @@ EXIT_LABEL:
   if (ret_val == HM_OK)
   {
     TRACE_DETAIL(("Send Response"));
-    ret_val = hm_queue_on_transport(msg, tprt_cb, TRUE);
+    ret_val = hm_queue_on_transport(msg, tprt_cb, HM_PRIORITY_CONTROL);
     tprt_cb->in_buffer = NULL;
   }
 
+  if (wide_msg != NULL)
+  {
+    hm_free_buffer(wide_msg);
+  }
+
   /***************************************************************************/
   /* Exit Level Checks                             */
   /***************************************************************************/
@@ -654,7 +953,7 @@ EXIT_LABEL:
   if (ret_val == HM_OK)
   {
     TRACE_DETAIL(("Send Response"));
-    ret_val = hm_queue_on_transport(msg, tprt_cb, TRUE);
+    ret_val = hm_queue_on_transport(msg, tprt_cb, HM_PRIORITY_CONTROL);
     tprt_cb->in_buffer = NULL;
   }
 
@@ -746,10 +1045,33 @@ int32_t hm_node_send_init_rsp(HM_NODE_CB *node_cb)
 
   init_msg->keepalive_period = node_cb->keepalive_period;
 
+  /***************************************************************************/
+  /* Any message of the node counts as its keepalive. Tell it so, if it can  */
+  /* hold back keepalives while it has other things to say.          */
+  /***************************************************************************/
+  node_cb->capabilities = init_msg->capabilities & HM_NODE_CAP_IDLE_KEEPALIVE;
+
+  /***************************************************************************/
+  /* If configured so, and the node agrees, leave it to the kernel to find  */
+  /* out that the node has gone. The node then sends no keepalives at all. */
+  /***************************************************************************/
+  if ((LOCAL.node_liveness == HM_LIVENESS_KERNEL) &&
+      (init_msg->capabilities & HM_NODE_CAP_KERNEL_LIVENESS) &&
+      (hm_tprt_set_kernel_liveness(node_cb->transport_cb->sock_cb->sock_fd,
+                                   node_cb->keepalive_period,
+                                   LOCAL.node_kickout_value) == HM_OK))
+  {
+    node_cb->capabilities |= HM_NODE_CAP_KERNEL_LIVENESS;
+  }
+  init_msg->capabilities = HM_NODE_CAP_IDLE_KEEPALIVE |
+                           (node_cb->capabilities & HM_NODE_CAP_KERNEL_LIVENESS);
+  TRACE_DETAIL(("Node %d capabilities: 0x%x", node_cb->index,
+                node_cb->capabilities));
+
   /***************************************************************************/
   /* Made message, now queue on transport and send if possible               */
   /***************************************************************************/
-  ret_val = hm_queue_on_transport(msg, node_cb->transport_cb, TRUE);
+  ret_val = hm_queue_on_transport(msg, node_cb->transport_cb, HM_PRIORITY_CONTROL);
   node_cb->transport_cb->in_buffer = NULL;
 
 
@@ -768,6 +1090,8 @@ int32_t hm_node_send_init_rsp(HM_NODE_CB *node_cb)
  *
  *  @param *msg Message to be sent (of type #HM_MSG)
  *  @param *tprt_cb Transport CB (#HM_TRANSPORT_CB) to which message is to be sent
+ *  @param priority Priority class of the message (HM_PRIORITY_*).
+ *         #HM_PRIORITY_CONTROL messages also release the transport lock.
  *  @return #HM_OK on success, #HM_ERR otherwise
  */
 int32_t hm_queue_on_transport(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb,
@@ -784,6 +1108,7 @@ int32_t hm_queue_on_transport(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb,
   TRACE_ENTRY();
   TRACE_ASSERT(msg != NULL);
   TRACE_ASSERT(tprt_cb != NULL);
+  TRACE_ASSERT(priority < HM_NUM_PRIORITIES);
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
@@ -803,21 +1128,26 @@ int32_t hm_queue_on_transport(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb,
   HM_INIT_LQE(block->node, block);
 
   block->target = msg;
+  block->opaque = NULL; /* Not a notification: never dropped on overflow */
   msg->ref_count++;
 
+  HM_INSERT_BEFORE(tprt_cb->pending[priority], block->node);
+
   /***************************************************************************/
-  /* INIT Response should be the first thing that is sent on this queue. So, */
-  /* add it to the head, not the tail.                       */
+  /* INIT Response should be the first thing that is sent on this queue.    */
+  /* Control class is always drained before the rest.             */
   /***************************************************************************/
-  if (priority)
+  if (priority == HM_PRIORITY_CONTROL)
   {
-    HM_INSERT_AFTER(tprt_cb->pending, block->node);
     TRACE_INFO(("Release Transport Lock!"));
     tprt_cb->hold = FALSE;
   }
-  else
+
+  tprt_cb->stats.num_pending++;
+  tprt_cb->stats.pending_bytes += HM_MSG_WIRE_LEN(msg);
+  if (tprt_cb->stats.num_pending > tprt_cb->stats.high_watermark)
   {
-    HM_INSERT_BEFORE(tprt_cb->pending, block->node);
+    tprt_cb->stats.high_watermark = tprt_cb->stats.num_pending;
   }
 
   tprt_cb->in_buffer = NULL;
@@ -836,6 +1166,78 @@ EXIT_LABEL:
 }/* hm_queue_on_transport */
 
 
+/**
+ *  @brief Picks the next message to be sent on the transport
+ *
+ *  A partly written message is always finished first. Then, control messages
+ *  go out in order. The remaining classes are drained by weight: in every round
+ *  each class sends up to its weight (#hm_priority_weight) of messages, higher
+ *  classes first. A backlog of lower class messages can therefore never delay
+ *  a higher class message by more than one round, and no class starves.
+ *
+ *  @param *tprt_cb Transport CB (#HM_TRANSPORT_CB) whose queues are to be served
+ *  @return The list block (#HM_LIST_BLOCK) of next message, @c NULL if none.
+ */
+HM_LIST_BLOCK * hm_tprt_next_pending(HM_TRANSPORT_CB *tprt_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *block = NULL;
+  uint32_t priority, round;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (tprt_cb->out_block != NULL)
+  {
+    block = tprt_cb->out_block;
+    goto EXIT_LABEL;
+  }
+
+  block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[HM_PRIORITY_CONTROL]);
+  if (block != NULL)
+  {
+    goto EXIT_LABEL;
+  }
+
+  for (round = 0; round < 2; round++)
+  {
+    for (priority = HM_PRIORITY_HA; priority < HM_NUM_PRIORITIES; priority++)
+    {
+      block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[priority]);
+      if ((block != NULL) && (tprt_cb->credits[priority] > 0))
+      {
+        tprt_cb->credits[priority]--;
+        goto EXIT_LABEL;
+      }
+    }
+    /***************************************************************************/
+    /* Every class that has something to send has used its share. New round. */
+    /***************************************************************************/
+    TRACE_DETAIL(("Start a new draining round."));
+    for (priority = HM_PRIORITY_HA; priority < HM_NUM_PRIORITIES; priority++)
+    {
+      tprt_cb->credits[priority] = hm_priority_weight[priority];
+    }
+  }
+  block = NULL;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return block;
+}/* hm_tprt_next_pending */
+
+
 /**
  *  @brief Tries to send all pending messages on the outgoing queue
  *
@@ -850,8 +1252,9 @@ int32_t hm_tprt_process_outgoing_queue(HM_TRANSPORT_CB *tprt_cb)
   HM_MSG *msg = NULL;
 
   int32_t ret_val = HM_OK;
+  int32_t bytes_sent = 0;
 
-  HM_LIST_BLOCK *block = NULL, *temp = NULL;
+  HM_LIST_BLOCK *block = NULL;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -872,12 +1275,20 @@ int32_t hm_tprt_process_outgoing_queue(HM_TRANSPORT_CB *tprt_cb)
   if (tprt_cb->hold == TRUE)
   {
     TRACE_DETAIL(("Message sending locked on transport. Keep in pending buffers."));
+    /***************************************************************************/
+    /* Do not wake up on writability until the lock is released.         */
+    /***************************************************************************/
+    if (tprt_cb->sock_cb->conn_state != HM_TPRT_CONN_INIT)
+    {
+      FD_CLR(tprt_cb->sock_cb->sock_fd, &hm_tprt_write_set);
+    }
     ret_val = HM_OK;
     goto EXIT_LABEL;
   }
 
-  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending);
-       block != NULL;)
+  for (block = hm_tprt_next_pending(tprt_cb);
+       block != NULL;
+       block = hm_tprt_next_pending(tprt_cb))
   {
     msg = (HM_MSG *)block->target;
 
@@ -895,21 +1306,73 @@ int32_t hm_tprt_process_outgoing_queue(HM_TRANSPORT_CB *tprt_cb)
     /* wrong should someone try to use it in case of UDP, since it would point */
     /* to the Transport of Local Location. But forward path stays correct.     */
     /***************************************************************************/
-    if (hm_tprt_send_on_socket((SOCKADDR *)&tprt_cb->address.address,
+    if ((tprt_cb->type == HM_TRANSPORT_TCP_IN) ||
+        (tprt_cb->type == HM_TRANSPORT_TCP_OUT))
+    {
+      /***************************************************************************/
+      /* Never wait on a stream consumer that is not reading. Whatever the socket*/
+      /* does not take stays on the transport and is resumed when select reports */
+      /* the socket writable again.                         */
+      /***************************************************************************/
+      if (msg->body != NULL)
+      {
+        bytes_sent = hm_tprt_send_parts(NULL, tprt_cb->sock_cb->sock_fd,
+                                        tprt_cb->type, msg,
+                                        tprt_cb->out_offset);
+      }
+      else
+      {
+        bytes_sent = hm_tprt_write_on_socket(tprt_cb->sock_cb->sock_fd,
+                                             msg->msg + tprt_cb->out_offset,
+                                             msg->msg_len - tprt_cb->out_offset);
+      }
+      if (bytes_sent == HM_ERR)
+      {
+        TRACE_ERROR(("Could not send on socket."));
+      }
+      else if ((tprt_cb->out_offset + bytes_sent) < HM_MSG_WIRE_LEN(msg))
+      {
+        tprt_cb->out_block = block;
+        tprt_cb->out_offset += bytes_sent;
+        TRACE_DETAIL(("Socket %d full. %d messages (%d bytes) pending.",
+                      tprt_cb->sock_cb->sock_fd, tprt_cb->stats.num_pending,
+                      tprt_cb->stats.pending_bytes));
+        FD_SET(tprt_cb->sock_cb->sock_fd, &hm_tprt_write_set);
+        goto EXIT_LABEL;
+      }
+      else
+      {
+        tprt_cb->last_tx = hm_time_ms();
+      }
+    }
+    else if ((msg->body != NULL) ?
+             (hm_tprt_send_parts((SOCKADDR *)&tprt_cb->address.address,
+                                 tprt_cb->sock_cb->sock_fd, tprt_cb->type,
+                                 msg, 0) == HM_ERR) :
+             (hm_tprt_send_on_socket((SOCKADDR *)&tprt_cb->address.address,
                                tprt_cb->sock_cb->sock_fd, tprt_cb->type,
-                               msg->msg, msg->msg_len) == HM_ERR)
+                               msg->msg, msg->msg_len) == HM_ERR))
     {
       TRACE_ERROR(("Could not send on socket."));
     }
+    else
+    {
+      tprt_cb->last_tx = hm_time_ms();
+    }
 
     /***************************************************************************/
     /* Remove from list.                             */
     /***************************************************************************/
-    temp = block;
-    block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node);
-    HM_REMOVE_FROM_LIST(temp->node);
-    hm_free_buffer(msg);
-    free(temp);
+    hm_tprt_remove_pending(tprt_cb, block);
+  }
+
+  /***************************************************************************/
+  /* Queue drained. The subscriber has caught up.                 */
+  /***************************************************************************/
+  tprt_cb->stats.consecutive_overflows = 0;
+  if (tprt_cb->sock_cb->conn_state != HM_TPRT_CONN_INIT)
+  {
+    FD_CLR(tprt_cb->sock_cb->sock_fd, &hm_tprt_write_set);
   }
 
 EXIT_LABEL:
@@ -919,3 +1382,261 @@ EXIT_LABEL:
   TRACE_EXIT();
   return ret_val;
 }/* hm_tprt_process_outgoing_queue */
+
+
+/**
+ *  @brief Removes a message from the pending queue of transport and releases it
+ *
+ *  @param *tprt_cb Transport CB (#HM_TRANSPORT_CB) on whose queue the message is
+ *  @param *block List block (#HM_LIST_BLOCK) holding the message
+ *  @return @c void
+ */
+void hm_tprt_remove_pending(HM_TRANSPORT_CB *tprt_cb, HM_LIST_BLOCK *block)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_MSG *msg = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(tprt_cb != NULL);
+  TRACE_ASSERT(block != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  msg = (HM_MSG *)block->target;
+
+  /***************************************************************************/
+  /* Whatever was written of this message is no longer relevant.        */
+  /***************************************************************************/
+  if (block == tprt_cb->out_block)
+  {
+    tprt_cb->out_block = NULL;
+    tprt_cb->out_offset = 0;
+  }
+
+  HM_REMOVE_FROM_LIST(block->node);
+
+  TRACE_ASSERT(tprt_cb->stats.num_pending > 0);
+  tprt_cb->stats.num_pending--;
+  tprt_cb->stats.pending_bytes -= HM_MSG_WIRE_LEN(msg);
+
+  hm_free_buffer(msg);
+  free(block);
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_tprt_remove_pending */
+
+
+/**
+ *  @brief Queues a notification for a subscriber within the bounds of its queue
+ *
+ *  A subscriber that does not read must not be able to grow its pending queue
+ *  without limit. When the queue is over its configured message or byte bound
+ *  the configured policy decides what gives way:
+ *  - #HM_SUBS_QUEUE_POLICY_DROP_OLDEST: the oldest queued notification is dropped.
+ *  - #HM_SUBS_QUEUE_POLICY_COLLAPSE: if the last notification queued about
+ *    the same entity is of the same class and for the same subscriber, it is
+ *    replaced by the new one, so only the latest state is delivered. Otherwise,
+ *    the oldest is dropped.
+ *  - #HM_SUBS_QUEUE_POLICY_DISCONNECT: as drop-oldest, but a subscriber which
+ *    overflows too many times without catching up is disconnected.
+ *
+ *  Notifications about an entity go out in the order they were raised: one is
+ *  never queued ahead of an earlier one about the same entity, which may hold
+ *  it back in a lower class.
+ *
+ *  Drops start from the lowest priority class. Messages which are not
+ *  notifications (responses, keepalives etc.) and a message partly written to
+ *  the socket are never dropped.
+ *
+ *  @param *msg Notification message (#HM_MSG) to be sent
+ *  @param *tprt_cb Transport CB (#HM_TRANSPORT_CB) of the subscriber
+ *  @param *key Identifies the entity and subscriber for which notification is
+ *              meant. Notifications with a @c NULL key are never dropped.
+ *  @param priority Priority class of the notification (HM_PRIORITY_*)
+ *  @return #HM_OK on success (even if the notification was dropped), #HM_ERR otherwise
+ */
+int32_t hm_tprt_queue_notification(HM_MSG *msg, HM_TRANSPORT_CB *tprt_cb,
+                                   void *key, uint32_t priority)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_LIST_BLOCK *block = NULL, *temp = NULL, *last = NULL;
+  HM_MSG *old_msg = NULL;
+  uint32_t overflow = FALSE;
+  uint32_t drop_class, lower_class;
+  uint32_t queue_class = priority;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(tprt_cb != NULL);
+  TRACE_ASSERT(priority < HM_NUM_PRIORITIES);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  /***************************************************************************/
+  /* Find the last notification still queued about the same entity in this  */
+  /* or a lower class. The new one must not overtake it, so it is queued    */
+  /* behind it, in its class.                         */
+  /***************************************************************************/
+  if (msg->entity != NULL)
+  {
+    for (lower_class = priority; lower_class < HM_NUM_PRIORITIES; lower_class++)
+    {
+      for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[lower_class]);
+           block != NULL;
+           block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node))
+      {
+        if (((HM_MSG *)block->target)->entity == msg->entity)
+        {
+          last = block;
+          queue_class = lower_class;
+        }
+      }
+    }
+  }
+
+  /***************************************************************************/
+  /* If that is an older state of the same kind for the same subscriber, it */
+  /* has not been seen yet. Replace it in place.                 */
+  /***************************************************************************/
+  if ((LOCAL.subs_queue.policy == HM_SUBS_QUEUE_POLICY_COLLAPSE) &&
+      (key != NULL) && (last != NULL) && (last->opaque == key) &&
+      (last != tprt_cb->out_block) &&
+      (((HM_MSG *)last->target)->priority == priority))
+  {
+    TRACE_DETAIL(("Collapse notification into one already queued."));
+    old_msg = (HM_MSG *)last->target;
+    tprt_cb->stats.pending_bytes -= old_msg->msg_len;
+    tprt_cb->stats.pending_bytes += msg->msg_len;
+    hm_free_buffer(old_msg);
+
+    last->target = msg;
+    msg->ref_count++;
+    tprt_cb->stats.collapsed++;
+    goto SEND;
+  }
+
+  block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
+  if (block == NULL)
+  {
+    TRACE_ASSERT(FALSE);
+    TRACE_ERROR(("Error allocating memory for notification queuing!"));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+  HM_INIT_LQE(block->node, block);
+
+  block->target = msg;
+  block->opaque = key;
+  msg->ref_count++;
+
+  if (queue_class != priority)
+  {
+    TRACE_DETAIL(("Queue notification of class %d behind one of class %d.",
+                  priority, queue_class));
+  }
+  HM_INSERT_BEFORE(tprt_cb->pending[queue_class], block->node);
+
+  tprt_cb->stats.num_pending++;
+  tprt_cb->stats.pending_bytes += msg->msg_len;
+  if (tprt_cb->stats.num_pending > tprt_cb->stats.high_watermark)
+  {
+    tprt_cb->stats.high_watermark = tprt_cb->stats.num_pending;
+  }
+
+  /***************************************************************************/
+  /* Bring the queue back within bounds: lowest class first, and oldest    */
+  /* notification first within a class.                     */
+  /***************************************************************************/
+  if ((tprt_cb->stats.num_pending > LOCAL.subs_queue.max_msgs) ||
+      (tprt_cb->stats.pending_bytes > LOCAL.subs_queue.max_bytes))
+  {
+    overflow = TRUE;
+    tprt_cb->stats.overflows++;
+    tprt_cb->stats.consecutive_overflows++;
+  }
+  for (drop_class = HM_NUM_PRIORITIES - 1;
+       overflow && (drop_class > HM_PRIORITY_CONTROL);
+       drop_class--)
+  {
+    block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[drop_class]);
+    while ((block != NULL) &&
+           ((tprt_cb->stats.num_pending > LOCAL.subs_queue.max_msgs) ||
+            (tprt_cb->stats.pending_bytes > LOCAL.subs_queue.max_bytes)))
+    {
+      temp = block;
+      block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(block->node);
+      if ((temp->opaque == NULL) || (temp == tprt_cb->out_block))
+      {
+        continue;
+      }
+      TRACE_DETAIL(("Drop oldest notification of class %d.", drop_class));
+      hm_tprt_remove_pending(tprt_cb, temp);
+      tprt_cb->stats.dropped++;
+    }
+  }
+
+  if (overflow)
+  {
+    TRACE_WARN(("Slow subscriber on socket %d: %d messages (%d bytes) pending. "
+                "Overflows %d (%d consecutive), Dropped %d, Collapsed %d, Peak %d",
+                tprt_cb->sock_cb != NULL ? tprt_cb->sock_cb->sock_fd : -1,
+                tprt_cb->stats.num_pending, tprt_cb->stats.pending_bytes,
+                tprt_cb->stats.overflows, tprt_cb->stats.consecutive_overflows,
+                tprt_cb->stats.dropped, tprt_cb->stats.collapsed,
+                tprt_cb->stats.high_watermark));
+
+    if ((LOCAL.subs_queue.policy == HM_SUBS_QUEUE_POLICY_DISCONNECT) &&
+        (tprt_cb->stats.consecutive_overflows >= LOCAL.subs_queue.max_overflows) &&
+        (tprt_cb->sock_cb != NULL))
+    {
+      /***************************************************************************/
+      /* Subscriber has not caught up for too long. Drop everything it owes and */
+      /* shut its connection down. The main loop sees it as a closed connection */
+      /* and the node goes down through its FSM as usual.            */
+      /***************************************************************************/
+      TRACE_WARN(("Disconnecting slow subscriber on socket %d",
+                  tprt_cb->sock_cb->sock_fd));
+      for (drop_class = 0; drop_class < HM_NUM_PRIORITIES; drop_class++)
+      {
+        for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[drop_class]);
+             block != NULL;
+             block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[drop_class]))
+        {
+          tprt_cb->stats.dropped++;
+          hm_tprt_remove_pending(tprt_cb, block);
+        }
+      }
+      shutdown(tprt_cb->sock_cb->sock_fd, SHUT_RDWR);
+      goto EXIT_LABEL;
+    }
+  }
+
+SEND:
+  /***************************************************************************/
+  /* Try to send                                 */
+  /***************************************************************************/
+  ret_val = hm_tprt_process_outgoing_queue(tprt_cb);
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return ret_val;
+}/* hm_tprt_queue_notification */
@@ -31,6 +31,20 @@
 #define HM_REG_SUBS_TYPE_LOCATION         ((uint32_t) 15)
 #define HM_REG_SUBS_TYPE_NODE             ((uint32_t) 16)
 
+/***************************************************************************/
+/* Registration Filters (used in HM_REGISTER_TLV_CB)                       */
+/***************************************************************************/
+#define HM_REGISTER_FILTER_BIT(n)   (((n) < 32) ? ((uint32_t) 1 << (n)) : 0)
+/* Only entities of nodes which hold an HA role (Active or Passive) */
+#define HM_REGISTER_FILTER_ROLE_ONLY        ((uint32_t) 0x01)
+
+/***************************************************************************/
+/* Stubs built before registration filters send TLVs of only id and       */
+/* cross_bind. HM tells them apart by the Register message length, and     */
+/* applies no filters to them.                                             */
+/***************************************************************************/
+#define HM_REGISTER_TLV_V1_SIZE             (2 * sizeof(uint32_t))
+
 /***************************************************************************/
 /* Notification Types                                                      */
 /***************************************************************************/
@@ -57,6 +71,20 @@
 #define HM_NOTIFY_ADDR_TYPE_TCP_v6          ((uint32_t) AF_INET6)
 
 
+/***************************************************************************/
+/* Capabilities advertised in INIT. The response carries those both share. */
+/***************************************************************************/
+/* Keepalives are sent only on an idle connection. Every message counts.   */
+#define HM_NODE_CAP_IDLE_KEEPALIVE          ((uint32_t) 0x01)
+/* The kernel watches the connection. No keepalives are to be sent at all. */
+#define HM_NODE_CAP_KERNEL_LIVENESS         ((uint32_t) 0x02)
+
+/***************************************************************************/
+/* Stubs built before capabilities send an INIT without them. HM tells it  */
+/* apart by its length, takes it as advertising none, and answers in kind. */
+/***************************************************************************/
+#define HM_NODE_INIT_V1_SIZE                (sizeof(HM_NODE_INIT_MSG) - sizeof(uint32_t))
+
 /***************************************************************************/
 /* Node status codes.                                                      */
 /***************************************************************************/
@@ -136,6 +164,12 @@ typedef struct hm_node_init_msg
   /***************************************************************************/
   uint32_t location_status;
 
+  /***************************************************************************/
+  /* Capabilities of the sender (HM_NODE_CAP_*). HM answers with those it    */
+  /* supports too.                                                           */
+  /***************************************************************************/
+  uint32_t capabilities;
+
 } HM_NODE_INIT_MSG ;
 /**STRUCT-********************************************************************/
 
@@ -218,6 +252,33 @@ typedef struct hm_register_tlv_cb
   /***************************************************************************/
   uint32_t cross_bind;
 
+  /***************************************************************************/
+  /* Filters on notifications for this registration. A notification is sent  */
+  /* only if it passes all of them. A value of 0 disables that filter.       */
+  /*                                                                         */
+  /* Event Mask: Notification types (HM_NOTIFY_TYPE_*) of interest. Use     */
+  /* HM_REGISTER_FILTER_BIT(type) for each.                                  */
+  /***************************************************************************/
+  uint32_t event_mask;
+
+  /***************************************************************************/
+  /* Location Mask: Locations of interest. HM_REGISTER_FILTER_BIT(index) for */
+  /* each location index. Locations beyond the mask are always notified.     */
+  /***************************************************************************/
+  uint32_t location_mask;
+
+  /***************************************************************************/
+  /* Process Type Mask: Process types of interest (process notifications     */
+  /* only). HM_REGISTER_FILTER_BIT(type) for each. Types beyond the mask are */
+  /* always notified.                                                        */
+  /***************************************************************************/
+  uint32_t proc_type_mask;
+
+  /***************************************************************************/
+  /* Filter Flags (HM_REGISTER_FILTER_*)                                     */
+  /***************************************************************************/
+  uint32_t filter_flags;
+
 } HM_REGISTER_TLV_CB ;
 /**STRUCT-********************************************************************/
 
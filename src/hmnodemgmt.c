@@ -270,6 +270,7 @@ int32_t hm_node_fsm(uint32_t input_signal, HM_NODE_CB * node_cb)
   int32_t ret_val = HM_OK;;
 
   HM_PROCESS_CB *proc_cb = NULL;
+  double phi;
 
   TRACE_ENTRY();
 
@@ -328,9 +329,21 @@ int32_t hm_node_fsm(uint32_t input_signal, HM_NODE_CB * node_cb)
       /***************************************************************************/
       /* Start the Keepalive timer again. The value MIGHT need modification.     */
       /***************************************************************************/
-      TRACE_DETAIL(("Arm the keepalive timer."));
-      node_cb->keepalive_missed++;
-      HM_TIMER_START(node_cb->timer_cb);
+      hm_phi_init(&node_cb->liveness);
+      if (node_cb->capabilities & HM_NODE_CAP_KERNEL_LIVENESS)
+      {
+        /***************************************************************************/
+        /* The kernel watches the connection. A dead node shows up as an error  */
+        /* on the socket, and nothing is to be timed here.            */
+        /***************************************************************************/
+        TRACE_DETAIL(("Liveness left to the kernel. No keepalive timer."));
+      }
+      else
+      {
+        TRACE_DETAIL(("Arm the keepalive timer."));
+        node_cb->keepalive_missed++;
+        HM_TIMER_START(node_cb->timer_cb);
+      }
 
       /***************************************************************************/
       /* Increment Parent Location's active node count                           */
@@ -386,6 +399,16 @@ int32_t hm_node_fsm(uint32_t input_signal, HM_NODE_CB * node_cb)
     case ACT_F:
       TRACE_DETAIL(("Act F"));
       TRACE_DETAIL(("Keepalive Timer Popped. Transmit next or Mark node as dead."));
+      /***************************************************************************/
+      /* Only a node that has been sending keepalives can be judged by them.  */
+      /***************************************************************************/
+      phi = hm_phi(&node_cb->liveness);
+      if((LOCAL.node_phi_threshold != 0) && (phi >= LOCAL.node_phi_threshold))
+      {
+        TRACE_WARN(("Node %d suspicion %.2f exceeds threshold. Mark it as down now!",
+            node_cb->index, phi));
+        next_input = HM_NODE_FSM_TERM;
+      }
       break;
 
     case ACT_G:
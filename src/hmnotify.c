@@ -30,7 +30,7 @@ int32_t hm_service_notify_queue()
   HM_MSG *msg = NULL;
   int32_t ret_val = HM_OK;
   uint32_t *processed = NULL;
-  HM_LIST_BLOCK *list_member = NULL, *block = NULL;
+  HM_LIST_BLOCK *list_member = NULL;
   int32_t target_type, subscriber_type;
   /***************************************************************************/
   /* Sanity Checks                               */
@@ -40,7 +40,7 @@ int32_t hm_service_notify_queue()
   /***************************************************************************/
   /* Main Routine                                 */
   /***************************************************************************/
-  for(notify_cb = (HM_NOTIFICATION_CB *)HM_NEXT_IN_LIST(LOCAL.notification_queue);
+  for(notify_cb = hm_next_notification();
       notify_cb != NULL;
       )
   {
@@ -63,6 +63,11 @@ int32_t hm_service_notify_queue()
         TRACE_DETAIL(("Number of subscribers: %d",
             affected_node.node_cb->sub_cb->num_subscribers));
       }
+      if(!hm_subs_filter_any(affected_node.node_cb->sub_cb, notify_cb))
+      {
+        TRACE_DETAIL(("No subscriber is interested!"));
+        break;
+      }
       msg = hm_build_notify_message(notify_cb);
       if(msg == NULL)
       {
@@ -89,6 +94,13 @@ int32_t hm_service_notify_queue()
           TRACE_DETAIL(("Subscriber has been serviced!"));
           continue;
         }
+        if(!hm_subs_filter_match(&((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter,
+                                 notify_cb))
+        {
+          TRACE_DETAIL(("Subscriber not interested."));
+          *processed = notify_cb->id;
+          continue;
+        }
         subscriber.void_cb = (void *)list_member->target;
         switch(*(int32_t *)((char *)subscriber.void_cb+ (uint32_t)(sizeof(int32_t))))
         {
@@ -132,21 +144,13 @@ int32_t hm_service_notify_queue()
         {
           if(tprt_cb->location_cb->index == LOCAL.local_location_cb.index)
           {
-            block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
-            if(block == NULL)
+            if(hm_tprt_queue_notification(msg, tprt_cb, list_member,
+                hm_notify_priority(notify_cb->notification_type)) != HM_OK)
             {
-              TRACE_ASSERT(FALSE);
-              TRACE_ERROR(("Error allocating memory for Process creation notificaton queuing!"));
+              TRACE_ERROR(("Error queuing notification on subscriber transport!"));
               ret_val = HM_ERR;
               goto EXIT_LABEL;
             }
-            HM_INIT_LQE(block->node, block);
-
-            block->target = msg;
-
-            HM_INSERT_BEFORE(tprt_cb->pending, block->node);
-            msg->ref_count++; /* This is more important */
-            hm_tprt_process_outgoing_queue(tprt_cb);
           }
           else
           {
@@ -159,6 +163,12 @@ int32_t hm_service_notify_queue()
           TRACE_INFO(("Subscribers are inactive. No notifications!"));
         }
       }
+      /***************************************************************************/
+      /* Queued copies hold their own references. Release the one taken when the */
+      /* message was built.                                                      */
+      /***************************************************************************/
+      hm_free_buffer(msg);
+      msg = NULL;
       break;
 
     case HM_NOTIFICATION_NODE_INACTIVE:
@@ -175,6 +185,11 @@ int32_t hm_service_notify_queue()
         TRACE_DETAIL(("Number of subscribers: %d",
             affected_node.node_cb->sub_cb->num_subscribers));
       }
+      if(!hm_subs_filter_any(affected_node.node_cb->sub_cb, notify_cb))
+      {
+        TRACE_DETAIL(("No subscriber is interested!"));
+        break;
+      }
       msg = hm_build_notify_message(notify_cb);
       if(msg == NULL)
       {
@@ -201,6 +216,13 @@ int32_t hm_service_notify_queue()
           TRACE_DETAIL(("Subscriber has been serviced!"));
           continue;
         }
+        if(!hm_subs_filter_match(&((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter,
+                                 notify_cb))
+        {
+          TRACE_DETAIL(("Subscriber not interested."));
+          *processed = notify_cb->id;
+          continue;
+        }
 
         subscriber.void_cb = (void *)list_member->target;
         target_type = *(int32_t *)((char *)subscriber.void_cb +
@@ -247,21 +269,13 @@ int32_t hm_service_notify_queue()
         {
           if(tprt_cb->location_cb->index == LOCAL.local_location_cb.index)
           {
-            block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
-            if(block == NULL)
+            if(hm_tprt_queue_notification(msg, tprt_cb, list_member,
+                hm_notify_priority(notify_cb->notification_type)) != HM_OK)
             {
-              TRACE_ASSERT(FALSE);
-              TRACE_ERROR(("Error allocating memory for Process creation notificaton queuing!"));
+              TRACE_ERROR(("Error queuing notification on subscriber transport!"));
               ret_val = HM_ERR;
               goto EXIT_LABEL;
             }
-            HM_INIT_LQE(block->node, block);
-
-            block->target = msg;
-
-            HM_INSERT_BEFORE(tprt_cb->pending, block->node);
-            msg->ref_count++; /* This is more important */
-            hm_tprt_process_outgoing_queue(tprt_cb);
           }
           else
           {
@@ -270,6 +284,12 @@ int32_t hm_service_notify_queue()
           *processed = notify_cb->id;
         }
       }
+      /***************************************************************************/
+      /* Queued copies hold their own references. Release the one taken when the */
+      /* message was built.                                                      */
+      /***************************************************************************/
+      hm_free_buffer(msg);
+      msg = NULL;
       break;
 
     case HM_NOTIFICATION_PROCESS_CREATED:
@@ -288,6 +308,11 @@ int32_t hm_service_notify_queue()
         TRACE_DETAIL(("Number of subscribers: %d",
             affected_node.process_cb->sub_cb->num_subscribers));
       }
+      if(!hm_subs_filter_any(affected_node.process_cb->sub_cb, notify_cb))
+      {
+        TRACE_DETAIL(("No subscriber is interested!"));
+        break;
+      }
       msg = hm_build_notify_message(notify_cb);
       if(msg == NULL)
       {
@@ -314,6 +339,13 @@ int32_t hm_service_notify_queue()
           TRACE_DETAIL(("Subscriber has been serviced!"));
           continue;
         }
+        if(!hm_subs_filter_match(&((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter,
+                                 notify_cb))
+        {
+          TRACE_DETAIL(("Subscriber not interested."));
+          *processed = notify_cb->id;
+          continue;
+        }
         subscriber.void_cb = (void *)list_member->target;
         subscriber_type = *(int32_t *)((char *)subscriber.void_cb +
                                                (uint32_t)(sizeof(int32_t)));
@@ -360,21 +392,13 @@ int32_t hm_service_notify_queue()
         {
           if(tprt_cb->location_cb->index == LOCAL.local_location_cb.index)
           {
-            block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
-            if(block == NULL)
+            if(hm_tprt_queue_notification(msg, tprt_cb, list_member,
+                hm_notify_priority(notify_cb->notification_type)) != HM_OK)
             {
-              TRACE_ASSERT(FALSE);
-              TRACE_ERROR(("Error allocating memory for Process creation notificaton queuing!"));
+              TRACE_ERROR(("Error queuing notification on subscriber transport!"));
               ret_val = HM_ERR;
               goto EXIT_LABEL;
             }
-            HM_INIT_LQE(block->node, block);
-
-            block->target = msg;
-
-            HM_INSERT_BEFORE(tprt_cb->pending, block->node);
-            msg->ref_count++; /* This is more important */
-            hm_tprt_process_outgoing_queue(tprt_cb);
           }
           else
           {
@@ -383,6 +407,12 @@ int32_t hm_service_notify_queue()
           *processed = notify_cb->id;
         }
       }
+      /***************************************************************************/
+      /* Queued copies hold their own references. Release the one taken when the */
+      /* message was built.                                                      */
+      /***************************************************************************/
+      hm_free_buffer(msg);
+      msg = NULL;
       break;
     case HM_NOTIFICATION_PROCESS_DESTROYED:
       TRACE_INFO(("Process Destroyed"));
@@ -401,6 +431,11 @@ int32_t hm_service_notify_queue()
         TRACE_DETAIL(("Number of subscribers: %d",
             affected_node.process_cb->sub_cb->num_subscribers));
       }
+      if(!hm_subs_filter_any(affected_node.process_cb->sub_cb, notify_cb))
+      {
+        TRACE_DETAIL(("No subscriber is interested!"));
+        break;
+      }
       msg = hm_build_notify_message(notify_cb);
       if(msg == NULL)
       {
@@ -428,6 +463,13 @@ int32_t hm_service_notify_queue()
           TRACE_DETAIL(("Subscriber has been serviced!"));
           continue;
         }
+        if(!hm_subs_filter_match(&((HM_SUBSCRIBER_STATE *)list_member->opaque)->filter,
+                                 notify_cb))
+        {
+          TRACE_DETAIL(("Subscriber not interested."));
+          *processed = notify_cb->id;
+          continue;
+        }
 
         subscriber.void_cb = (void *)list_member->target;
         switch(*(int32_t *)((char *)subscriber.void_cb+ (uint32_t)(sizeof(int32_t))))
@@ -472,21 +514,13 @@ int32_t hm_service_notify_queue()
         {
           if(tprt_cb->location_cb->index == LOCAL.local_location_cb.index)
           {
-            block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
-            if(block == NULL)
+            if(hm_tprt_queue_notification(msg, tprt_cb, list_member,
+                hm_notify_priority(notify_cb->notification_type)) != HM_OK)
             {
-              TRACE_ASSERT(FALSE);
-              TRACE_ERROR(("Error allocating memory for Process creation notificaton queuing!"));
+              TRACE_ERROR(("Error queuing notification on subscriber transport!"));
               ret_val = HM_ERR;
               goto EXIT_LABEL;
             }
-            HM_INIT_LQE(block->node, block);
-
-            block->target = msg;
-
-            HM_INSERT_BEFORE(tprt_cb->pending, block->node);
-            msg->ref_count++; /* This is more important */
-            hm_tprt_process_outgoing_queue(tprt_cb);
           }
           else
           {
@@ -495,6 +529,12 @@ int32_t hm_service_notify_queue()
           *processed = notify_cb->id;
         }
       }
+      /***************************************************************************/
+      /* Queued copies hold their own references. Release the one taken when the */
+      /* message was built.                                                      */
+      /***************************************************************************/
+      hm_free_buffer(msg);
+      msg = NULL;
       break;
 
     case HM_NOTIFICATION_INTERFACE_ADDED:
@@ -571,27 +611,25 @@ int32_t hm_service_notify_queue()
       {
         if(tprt_cb->location_cb->index == LOCAL.local_location_cb.index)
         {
-          block = (HM_LIST_BLOCK *)malloc(sizeof(HM_LIST_BLOCK));
-          if(block == NULL)
+          if(hm_tprt_queue_notification(msg, tprt_cb, NULL,
+              hm_notify_priority(notify_cb->notification_type)) != HM_OK)
           {
-            TRACE_ASSERT(FALSE);
-            TRACE_ERROR(("Error allocating memory for Process creation notificaton queuing!"));
+            TRACE_ERROR(("Error queuing notification on subscriber transport!"));
             ret_val = HM_ERR;
             goto EXIT_LABEL;
           }
-          HM_INIT_LQE(block->node, block);
-
-          block->target = msg;
-
-          HM_INSERT_BEFORE(tprt_cb->pending, block->node);
-          msg->ref_count++; /* This is more important */
-          hm_tprt_process_outgoing_queue(tprt_cb);
         }
         else
         {
           TRACE_DETAIL(("Remote peer binding. Discard!"));
         }
       }
+      /***************************************************************************/
+      /* Queued copies hold their own references. Release the one taken when the */
+      /* message was built.                                                      */
+      /***************************************************************************/
+      hm_free_buffer(msg);
+      msg = NULL;
       break;
 
     default:
@@ -605,10 +643,13 @@ int32_t hm_service_notify_queue()
     /***************************************************************************/
     TRACE_DETAIL(("Freeing Notification CB"));
     temp = notify_cb;
-    notify_cb = (HM_NOTIFICATION_CB *)HM_NEXT_IN_LIST(notify_cb->node);
     HM_REMOVE_FROM_LIST(temp->node);
     hm_free_notify_cb(temp);
     temp = NULL;
+    /***************************************************************************/
+    /* Notifications raised while servicing this one may be of a higher class */
+    /***************************************************************************/
+    notify_cb = hm_next_notification();
   }
 EXIT_LABEL:
 
@@ -620,6 +661,434 @@ EXIT_LABEL:
 }/* hm_service_notify_queue */
 
 
+/**
+ *  @brief Returns the priority class of a notification type
+ *
+ *  HA role changes come first, since subscribers act on them to take over
+ *  service. Node liveness comes next, then process lifecycle. Everything else
+ *  is informational.
+ *
+ *  @param notification_type Type of notification (HM_NOTIFICATION_*)
+ *  @return Priority class (HM_PRIORITY_*) of the notification
+ */
+uint32_t hm_notify_priority(uint32_t notification_type)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint32_t priority = HM_PRIORITY_INFO;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  switch (notification_type)
+  {
+  case HM_NOTIFICATION_NODE_ROLE_ACTIVE:
+  case HM_NOTIFICATION_NODE_ROLE_PASSIVE:
+    priority = HM_PRIORITY_HA;
+    break;
+
+  case HM_NOTIFICATION_NODE_ACTIVE:
+  case HM_NOTIFICATION_NODE_INACTIVE:
+    priority = HM_PRIORITY_NODE;
+    break;
+
+  case HM_NOTIFICATION_PROCESS_CREATED:
+  case HM_NOTIFICATION_PROCESS_DESTROYED:
+    priority = HM_PRIORITY_PROCESS;
+    break;
+
+  default:
+    priority = HM_PRIORITY_INFO;
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return priority;
+}/* hm_notify_priority */
+
+
+/**
+ *  @brief Returns the next notification to be serviced
+ *
+ *  Notifications are serviced in strict class order; within a class, in the
+ *  order in which they were queued. Those about the same entity are kept in the
+ *  order they were raised by #hm_queue_notification.
+ *
+ *  @param None
+ *  @return Notification CB (#HM_NOTIFICATION_CB) to service, @c NULL if none.
+ */
+HM_NOTIFICATION_CB * hm_next_notification()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  HM_NOTIFICATION_CB *notify_cb = NULL;
+  uint32_t priority;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (priority = 0; priority < HM_NUM_PRIORITIES; priority++)
+  {
+    notify_cb = (HM_NOTIFICATION_CB *)HM_NEXT_IN_LIST(
+                                        LOCAL.notification_queue[priority]);
+    if (notify_cb != NULL)
+    {
+      break;
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return notify_cb;
+}/* hm_next_notification */
+
+
+/**
+ *  @brief Queues a notification to be serviced at the end of this pass of the main loop
+ *
+ *  If a notification about the same entity and of the same class (e.g. Node
+ *  Active and Node Inactive) is still waiting, it is not worth sending both;
+ *  the one waiting is turned into the new one and keeps its place in queue.
+ *  Subscribers thus hear once about the state an entity ends up in.
+ *
+ *  A notification never overtakes an earlier one about the same entity; if
+ *  one is waiting in a lower class, the new one is queued behind it there.
+ *
+ *  @param *notify_cb Notification CB (#HM_NOTIFICATION_CB) to be queued. It may
+ *         be freed if it was merged into one already queued.
+ *  @return #HM_OK on success, #HM_ERR otherwise
+ */
+int32_t hm_queue_notification(HM_NOTIFICATION_CB *notify_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_NOTIFICATION_CB *queued = NULL, *last = NULL;
+  HM_GLOBAL_PENDING *pending = NULL;
+  uint32_t priority, lower_class;
+  uint32_t queue_class;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(notify_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  priority = hm_notify_priority(notify_cb->notification_type);
+  queue_class = priority;
+
+  /***************************************************************************/
+  /* Informational notifications are of mixed kinds. Never merge them.     */
+  /***************************************************************************/
+  if((priority != HM_PRIORITY_INFO) && (notify_cb->custom_data == NULL))
+  {
+    pending = hm_global_pending(notify_cb->node_cb.void_cb);
+  }
+
+  /***************************************************************************/
+  /* Find the last notification still queued about the same entity in this  */
+  /* or a lower class. The new one must not overtake it, so it is queued    */
+  /* behind it, in its class.                         */
+  /***************************************************************************/
+  if(notify_cb->node_cb.void_cb != NULL)
+  {
+    for(lower_class = priority; lower_class < HM_NUM_PRIORITIES; lower_class++)
+    {
+      for(queued = (HM_NOTIFICATION_CB *)HM_NEXT_IN_LIST(
+                                      LOCAL.notification_queue[lower_class]);
+          queued != NULL;
+          queued = (HM_NOTIFICATION_CB *)HM_NEXT_IN_LIST(queued->node))
+      {
+        if(queued->node_cb.void_cb == notify_cb->node_cb.void_cb)
+        {
+          last = queued;
+          queue_class = lower_class;
+        }
+      }
+    }
+  }
+
+  /***************************************************************************/
+  /* Merge only into the last one, else the entity would seem to go back to */
+  /* an older state.                               */
+  /***************************************************************************/
+  if((pending != NULL) && ((queued = pending->notify[priority]) != NULL) &&
+     (queued == last))
+  {
+    TRACE_DETAIL(("Merge notification %d into queued notification of type %d",
+                  notify_cb->notification_type, queued->notification_type));
+    queued->notification_type = notify_cb->notification_type;
+    queued->id = notify_cb->id;
+    hm_free_notify_cb(notify_cb);
+    goto EXIT_LABEL;
+  }
+
+  if(queue_class != priority)
+  {
+    TRACE_DETAIL(("Queue notification %d behind one of class %d",
+                  notify_cb->notification_type, queue_class));
+  }
+  HM_INSERT_BEFORE(LOCAL.notification_queue[queue_class], notify_cb->node);
+  if(pending != NULL)
+  {
+    pending->notify[priority] = notify_cb;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return ret_val;
+}/* hm_queue_notification */
+
+
+/**
+ *  @brief Compiles the filters of a registration TLV into a subscription filter
+ *
+ *  Notification types on the interface (HM_NOTIFY_TYPE_*) are translated to the
+ *  internal notification types (HM_NOTIFICATION_*) so that matching does not
+ *  need any translation when notifications are serviced.
+ *
+ *  @param *tlv Registration TLV (#HM_REGISTER_TLV_CB) received from subscriber
+ *  @param *filter Subscription Filter (#HM_SUBS_FILTER) to be filled in
+ *  @return @c void
+ */
+void hm_subs_filter_compile(HM_REGISTER_TLV_CB *tlv, HM_SUBS_FILTER *filter)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(tlv != NULL);
+  TRACE_ASSERT(filter != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  memset(filter, 0, sizeof(HM_SUBS_FILTER));
+
+  if(tlv->event_mask & HM_REGISTER_FILTER_BIT(HM_NOTIFY_TYPE_NODE_UP))
+  {
+    filter->event_mask |= HM_REGISTER_FILTER_BIT(HM_NOTIFICATION_NODE_ACTIVE);
+  }
+  if(tlv->event_mask & HM_REGISTER_FILTER_BIT(HM_NOTIFY_TYPE_NODE_DOWN))
+  {
+    filter->event_mask |= HM_REGISTER_FILTER_BIT(HM_NOTIFICATION_NODE_INACTIVE);
+  }
+  if(tlv->event_mask & HM_REGISTER_FILTER_BIT(HM_NOTIFY_TYPE_PROC_AVAILABLE))
+  {
+    filter->event_mask |= HM_REGISTER_FILTER_BIT(HM_NOTIFICATION_PROCESS_CREATED);
+  }
+  if(tlv->event_mask & HM_REGISTER_FILTER_BIT(HM_NOTIFY_TYPE_PROC_GONE))
+  {
+    filter->event_mask |= HM_REGISTER_FILTER_BIT(HM_NOTIFICATION_PROCESS_DESTROYED);
+  }
+  if(tlv->event_mask & HM_REGISTER_FILTER_BIT(HM_NOTIFY_TYPE_IF_PARTNER_AVAILABLE))
+  {
+    filter->event_mask |= HM_REGISTER_FILTER_BIT(HM_NOTIFICATION_INTERFACE_ADDED);
+  }
+  if(tlv->event_mask & HM_REGISTER_FILTER_BIT(HM_NOTIFY_TYPE_IF_PARTNER_GONE))
+  {
+    filter->event_mask |= HM_REGISTER_FILTER_BIT(HM_NOTIFICATION_INTERFACE_DELETE);
+  }
+  if((tlv->event_mask != 0) && (filter->event_mask == 0))
+  {
+    /***************************************************************************/
+    /* Nothing we know of was asked for. Do not silently turn it into "all".   */
+    /***************************************************************************/
+    TRACE_WARN(("Unknown notification types in event mask 0x%x", tlv->event_mask));
+    filter->event_mask = HM_REGISTER_FILTER_BIT(0);
+  }
+
+  filter->location_mask = tlv->location_mask;
+  filter->proc_type_mask = tlv->proc_type_mask;
+  filter->role_only = ((tlv->filter_flags & HM_REGISTER_FILTER_ROLE_ONLY) != 0);
+
+  TRACE_DETAIL(("Filter: Events 0x%x Locations 0x%x Process Types 0x%x Role Only %d",
+                filter->event_mask, filter->location_mask,
+                filter->proc_type_mask, filter->role_only));
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_subs_filter_compile */
+
+
+/**
+ *  @brief Checks whether a notification passes the filter of a subscriber
+ *
+ *  Values which cannot be represented in a mask (beyond 31) always pass, so
+ *  that a filter can only ever save a notification, never lose one.
+ *
+ *  @param *filter Subscription Filter (#HM_SUBS_FILTER) of the subscriber
+ *  @param *notify_cb Notification CB (#HM_NOTIFICATION_CB) to be sent
+ *  @return @c TRUE if the notification must be sent, @c FALSE otherwise
+ */
+int32_t hm_subs_filter_match(HM_SUBS_FILTER *filter, HM_NOTIFICATION_CB *notify_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t match = TRUE;
+  HM_SUBSCRIBER affected_node;
+  HM_NODE_CB *node_cb = NULL;
+  HM_GLOBAL_NODE_CB *glob_node_cb = NULL;
+  uint32_t bit;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(filter != NULL);
+  TRACE_ASSERT(notify_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if(filter->event_mask != 0)
+  {
+    bit = HM_REGISTER_FILTER_BIT(notify_cb->notification_type);
+    if((bit != 0) && ((filter->event_mask & bit) == 0))
+    {
+      match = FALSE;
+      goto EXIT_LABEL;
+    }
+  }
+
+  if((filter->location_mask == 0) && (filter->proc_type_mask == 0) &&
+     (!filter->role_only))
+  {
+    goto EXIT_LABEL;
+  }
+
+  /***************************************************************************/
+  /* Find the node on which affected entity is.                 */
+  /***************************************************************************/
+  affected_node.void_cb = notify_cb->node_cb.void_cb;
+  switch (notify_cb->notification_type)
+  {
+  case HM_NOTIFICATION_NODE_ACTIVE:
+  case HM_NOTIFICATION_NODE_INACTIVE:
+    glob_node_cb = affected_node.node_cb;
+    node_cb = glob_node_cb->node_cb;
+    break;
+
+  case HM_NOTIFICATION_PROCESS_CREATED:
+  case HM_NOTIFICATION_PROCESS_DESTROYED:
+    node_cb = affected_node.process_cb->proc_cb->parent_node_cb;
+    glob_node_cb = (HM_GLOBAL_NODE_CB *)node_cb->db_ptr;
+
+    if(filter->proc_type_mask != 0)
+    {
+      bit = HM_REGISTER_FILTER_BIT(affected_node.process_cb->type);
+      if((bit != 0) && ((filter->proc_type_mask & bit) == 0))
+      {
+        match = FALSE;
+        goto EXIT_LABEL;
+      }
+    }
+    break;
+
+  default:
+    TRACE_DETAIL(("No entity filters for notification type %d",
+                  notify_cb->notification_type));
+    goto EXIT_LABEL;
+  }
+
+  if((filter->location_mask != 0) && (node_cb != NULL))
+  {
+    bit = HM_REGISTER_FILTER_BIT(node_cb->parent_location_cb->index);
+    if((bit != 0) && ((filter->location_mask & bit) == 0))
+    {
+      match = FALSE;
+      goto EXIT_LABEL;
+    }
+  }
+
+  if((filter->role_only) && (glob_node_cb != NULL) &&
+     (glob_node_cb->role == NODE_ROLE_NONE))
+  {
+    match = FALSE;
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return match;
+}/* hm_subs_filter_match */
+
+
+/**
+ *  @brief Checks whether any subscriber of a subscription wants a notification
+ *
+ *  Lets the notification be dropped before its message is built when every
+ *  subscriber has filtered it out.
+ *
+ *  @param *sub_cb Subscription CB (#HM_SUBSCRIPTION_CB) of the affected entity
+ *  @param *notify_cb Notification CB (#HM_NOTIFICATION_CB) to be sent
+ *  @return @c TRUE if at least one subscriber wants it, @c FALSE otherwise
+ */
+int32_t hm_subs_filter_any(HM_SUBSCRIPTION_CB *sub_cb, HM_NOTIFICATION_CB *notify_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t match = FALSE;
+  HM_LIST_BLOCK *list_member = NULL;
+  HM_SUBSCRIBER_STATE *state = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(sub_cb != NULL);
+  TRACE_ASSERT(notify_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for(list_member = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(sub_cb->subscribers_list);
+      list_member != NULL;
+      list_member = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(list_member->node))
+  {
+    state = (HM_SUBSCRIBER_STATE *)list_member->opaque;
+    TRACE_ASSERT(state != NULL);
+    if((state->processed < notify_cb->id) &&
+       hm_subs_filter_match(&state->filter, notify_cb))
+    {
+      match = TRUE;
+      break;
+    }
+  }
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return match;
+}/* hm_subs_filter_any */
+
+
 /**
  *  @brief Builds a notification Message
  *
@@ -639,7 +1108,7 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
   HM_MSG *msg = NULL;
   HM_NOTIFICATION_MSG *notify_msg = NULL;
   HM_SUBSCRIBER affected_node;
-  HM_SOCKADDR_UNION *addr=NULL;
+  HM_NODE_CB *node_cb = NULL, *partner = NULL;
 
   /***************************************************************************/
   /* Sanity Checks                                                           */
@@ -657,6 +1126,8 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
     goto EXIT_LABEL;
   }
   notify_msg = msg->msg;
+  msg->entity = notify_cb->node_cb.void_cb;
+  msg->priority = hm_notify_priority(notify_cb->notification_type);
 
   notify_msg->hdr.msg_id = 0;
   notify_msg->hdr.msg_len = sizeof(HM_NOTIFICATION_MSG);
@@ -667,7 +1138,7 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
   affected_node.node_cb = notify_cb->node_cb.node_cb;
 
   /***************************************************************************/
-  /* WICKED CODE. Please refrain from using so many levels of pointer.     */
+  /* Address information of a node is cached on its global row. Copy it.    */
   /***************************************************************************/
   switch(notify_cb->notification_type)
   {
@@ -680,52 +1151,10 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
     notify_msg->proc_type = 0;
 
     TRACE_ASSERT(affected_node.node_cb->node_cb->transport_cb != NULL);
-    TRACE_ASSERT(affected_node.node_cb->node_cb->transport_cb->location_cb != NULL);
-
     TRACE_ASSERT(affected_node.node_cb->node_cb->transport_cb->sock_cb != NULL);
 
-    addr = (HM_SOCKADDR_UNION *)&(affected_node.node_cb->node_cb->transport_cb->sock_cb->addr);
-
-    if(affected_node.node_cb->node_cb->transport_cb->type == HM_TRANSPORT_TCP_IN
-      ||
-      affected_node.node_cb->node_cb->transport_cb->type == HM_TRANSPORT_TCP_OUT)
-    {
-      TRACE_DETAIL(("Node has IPv4 type of connection."));
-      notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v4;
-
-      memcpy(    notify_msg->addr_info.addr,
-            &addr->in_addr.sin_addr.s_addr,
-            sizeof(struct in_addr)
-          );
-
-      notify_msg->addr_info.port = (uint32_t)addr->in_addr.sin_port;
-#ifdef I_WANT_TO_DEBUG
-    {
-    char address_value[128];
-    inet_ntop(addr->in_addr.sin_family,
-          notify_msg->addr_info.addr,
-          address_value, sizeof(address_value));
-    TRACE_INFO(("IP Address filled: %s:%d",address_value, notify_msg->addr_info.port));
-    }
-#endif
-    }
-    else if(affected_node.node_cb->node_cb->transport_cb->type == HM_TRANSPORT_TCP_IPv6_IN)
-    {
-      TRACE_DETAIL(("Node has IPv6 type of connection"));
-      notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v6;
-      memcpy(notify_msg->addr_info.addr,
-        &addr->in6_addr.sin6_addr,
-        sizeof(struct in6_addr));
-      notify_msg->addr_info.port = (uint32_t)addr->in6_addr.sin6_port;
-    }
-    else
-    {
-      TRACE_WARN(("Unknown Transport Type %d", affected_node.node_cb->node_cb->transport_cb->type));
-    }
-    notify_msg->addr_info.group = affected_node.node_cb->group_index;
-    notify_msg->addr_info.hw_index = affected_node.node_cb->node_cb->parent_location_cb->index;
-    notify_msg->addr_info.node_id = affected_node.node_cb->index;
-
+    memcpy(&notify_msg->addr_info, hm_get_node_addr_info(affected_node.node_cb),
+           sizeof(HM_ADDRESS_INFO));
     break;
 
   case HM_NOTIFICATION_NODE_INACTIVE:
@@ -738,125 +1167,34 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
 
     TRACE_ASSERT(affected_node.node_cb->node_cb->transport_cb != NULL);
 
-    if(affected_node.node_cb->node_cb->transport_cb->sock_cb != NULL)
-    {
-      addr = (HM_SOCKADDR_UNION *)&(affected_node.node_cb->node_cb->transport_cb->sock_cb->addr);
-      if((affected_node.node_cb->node_cb->transport_cb->type == HM_TRANSPORT_TCP_IN) ||
-        (affected_node.node_cb->node_cb->transport_cb->type == HM_TRANSPORT_TCP_OUT))
-      {
-        TRACE_DETAIL(("Node has IPv4 type of connection."));
-        notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v4;
-        memcpy(notify_msg->addr_info.addr,
-            &addr->in_addr.sin_addr.s_addr,
-          sizeof(struct in_addr));
-        notify_msg->addr_info.port = (uint32_t)addr->in_addr.sin_port;
-      }
-      else if((affected_node.node_cb->node_cb->transport_cb->type == HM_TRANSPORT_TCP_IPv6_IN)||
-          (affected_node.node_cb->node_cb->transport_cb->type == HM_TRANSPORT_TCP_IPv6_OUT))
-      {
-        TRACE_DETAIL(("Node has IPv6 type of connection"));
-        notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v6;
-        memcpy(notify_msg->addr_info.addr,
-          &addr->in6_addr.sin6_addr,
-          sizeof(struct in6_addr));
-        notify_msg->addr_info.port = (uint32_t)addr->in6_addr.sin6_port;
-      }
-      else
-      {
-        TRACE_WARN(("Unknown Transport Type"));
-      }
-    }
-    else
-    {
-      TRACE_WARN(("Node never connected. Nothing to put in its transport profile notification."));
-    }
-
-    notify_msg->addr_info.group = affected_node.node_cb->group_index;
-    notify_msg->addr_info.hw_index = affected_node.node_cb->node_cb->parent_location_cb->index;
-    notify_msg->addr_info.node_id = affected_node.node_cb->index;
-
+    memcpy(&notify_msg->addr_info, hm_get_node_addr_info(affected_node.node_cb),
+           sizeof(HM_ADDRESS_INFO));
     break;
 
   case HM_NOTIFICATION_PROCESS_CREATED:
-
-    notify_msg->type = HM_NOTIFY_TYPE_PROC_AVAILABLE;
-    notify_msg->id = affected_node.process_cb->pid;
-    notify_msg->if_id = 0;
-    notify_msg->proc_type = affected_node.process_cb->type;
-    TRACE_INFO(("Process  %x Created", notify_msg->id ));
-    TRACE_ASSERT(affected_node.process_cb->proc_cb->parent_node_cb->transport_cb != NULL);
-
-    addr = (HM_SOCKADDR_UNION *)&(
-        affected_node.process_cb->proc_cb->parent_node_cb->transport_cb->sock_cb->addr);
-    if(affected_node.process_cb->proc_cb->parent_node_cb->transport_cb->type
-              == HM_TRANSPORT_TCP_IN)
-    {
-      TRACE_DETAIL(("Node has IPv4 type of connection."));
-      notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v4;
-      memcpy(notify_msg->addr_info.addr,
-          &addr->in_addr.sin_addr.s_addr,
-        sizeof(struct in_addr));
-      notify_msg->addr_info.port = (uint32_t)addr->in_addr.sin_port;
-    }
-    else if(affected_node.process_cb->proc_cb->parent_node_cb->transport_cb->type
-              == HM_TRANSPORT_TCP_IPv6_IN)
+  case HM_NOTIFICATION_PROCESS_DESTROYED:
+    if(notify_cb->notification_type == HM_NOTIFICATION_PROCESS_CREATED)
     {
-      TRACE_DETAIL(("Node has IPv6 type of connection"));
-      notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v6;
-      memcpy(notify_msg->addr_info.addr,
-        &addr->in6_addr.sin6_addr,
-        sizeof(struct in6_addr));
-      notify_msg->addr_info.port = (uint32_t)addr->in6_addr.sin6_port;
+      notify_msg->type = HM_NOTIFY_TYPE_PROC_AVAILABLE;
+      TRACE_INFO(("Process  %x Created", affected_node.process_cb->pid));
     }
     else
     {
-      TRACE_WARN(("Unknown Transport Type"));
+      notify_msg->type = HM_NOTIFY_TYPE_PROC_GONE;
+      TRACE_INFO(("Process Destroyed"));
     }
-    notify_msg->addr_info.group = affected_node.process_cb->proc_cb->parent_node_cb->group;
-    notify_msg->addr_info.hw_index =
-          affected_node.process_cb->proc_cb->parent_node_cb->parent_location_cb->index;
-    notify_msg->addr_info.node_id = affected_node.process_cb->proc_cb->parent_node_cb->index;
-    notify_msg->addr_info.role = affected_node.process_cb->proc_cb->parent_node_cb->role;
-
-    break;
-  case HM_NOTIFICATION_PROCESS_DESTROYED:
-    TRACE_INFO(("Process Destroyed"));
-    notify_msg->type = HM_NOTIFY_TYPE_PROC_GONE;
     notify_msg->id = affected_node.process_cb->pid;
     notify_msg->if_id = 0;
     notify_msg->proc_type = affected_node.process_cb->type;
-    TRACE_ASSERT(affected_node.process_cb->proc_cb->parent_node_cb->transport_cb != NULL);
-    addr = (HM_SOCKADDR_UNION *)&(
-        affected_node.process_cb->proc_cb->parent_node_cb->transport_cb->sock_cb->addr);
-    if(affected_node.process_cb->proc_cb->parent_node_cb->transport_cb->type
-              == HM_TRANSPORT_TCP_IN)
-    {
-      TRACE_DETAIL(("Node has IPv4 type of connection."));
-      notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v4;
-      memcpy(notify_msg->addr_info.addr,
-          &addr->in_addr.sin_addr.s_addr,
-        sizeof(struct in_addr));
-      notify_msg->addr_info.port = (uint32_t)addr->in_addr.sin_port;
-    }
-    else if(affected_node.process_cb->proc_cb->parent_node_cb->transport_cb->type
-              == HM_TRANSPORT_TCP_IPv6_IN)
-    {
-      TRACE_DETAIL(("Node has IPv6 type of connection"));
-      notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v6;
-      memcpy(notify_msg->addr_info.addr,
-        &addr->in6_addr.sin6_addr,
-        sizeof(struct in6_addr));
-      notify_msg->addr_info.port = (uint32_t)addr->in6_addr.sin6_port;
-    }
-    else
-    {
-      TRACE_WARN(("Unknown Transport Type"));
-    }
-    notify_msg->addr_info.group = affected_node.process_cb->proc_cb->parent_node_cb->group;
-    notify_msg->addr_info.hw_index =
-          affected_node.process_cb->proc_cb->parent_node_cb->parent_location_cb->index;
-    notify_msg->addr_info.node_id = affected_node.process_cb->proc_cb->parent_node_cb->index;
-    notify_msg->addr_info.role = affected_node.process_cb->proc_cb->parent_node_cb->role;
+
+    node_cb = affected_node.process_cb->proc_cb->parent_node_cb;
+    TRACE_ASSERT(node_cb->transport_cb != NULL);
+
+    memcpy(&notify_msg->addr_info,
+           hm_get_node_addr_info((HM_GLOBAL_NODE_CB *)node_cb->db_ptr),
+           sizeof(HM_ADDRESS_INFO));
+    /* Role may change without the address changing. Never cached. */
+    notify_msg->addr_info.role = node_cb->role;
     break;
 
   case HM_NOTIFICATION_INTERFACE_ADDED:
@@ -867,7 +1205,7 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
     break;
 
   case HM_NOTIFICATION_NODE_ROLE_ACTIVE:
-    TRACE_INFO(("Node Role Active"));
+  case HM_NOTIFICATION_NODE_ROLE_PASSIVE:
     TRACE_INFO(("Node %d role change to %s", affected_node.node_cb->index,
         (affected_node.node_cb->role==NODE_ROLE_PASSIVE)?"Passive":"Active/None"));
     notify_msg->hdr.msg_type = HM_MSG_TYPE_HA_UPDATE;
@@ -882,50 +1220,29 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
       notify_msg->type = HM_HA_NODE_ROLE_NONE;
     }
     notify_msg->id = 0;
+    notify_msg->if_id = 0;
     notify_msg->proc_type = 0;
 
     TRACE_ASSERT(affected_node.node_cb->node_cb->transport_cb != NULL);
-    /* For active node, there may or may not be a passive node on cluster */
-    if(affected_node.node_cb->node_cb->partner != NULL)
+    partner = affected_node.node_cb->node_cb->partner;
+    /***************************************************************************/
+    /* For active node, there may or may not be a passive node on cluster.    */
+    /* For a passive node, there must always be an active node on the cluster */
+    /***************************************************************************/
+    TRACE_ASSERT((partner != NULL) ||
+            (notify_cb->notification_type == HM_NOTIFICATION_NODE_ROLE_ACTIVE));
+    if(partner != NULL)
     {
       TRACE_DETAIL(("Node partner present."));
-      if(affected_node.node_cb->node_cb->partner->transport_cb->sock_cb != NULL)
-      {
-        addr = (HM_SOCKADDR_UNION *)&(affected_node.node_cb->node_cb->partner->transport_cb->sock_cb->addr);
-        if((affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_IN) ||
-          (affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_OUT))
-        {
-          TRACE_DETAIL(("Node has IPv4 type of connection."));
-          notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v4;
-          memcpy(notify_msg->addr_info.addr,
-              &addr->in_addr.sin_addr.s_addr,
-            sizeof(struct in_addr));
-          notify_msg->addr_info.port = (uint32_t)addr->in_addr.sin_port;
-        }
-        else if((affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_IPv6_IN)||
-            (affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_IPv6_OUT))
-        {
-          TRACE_DETAIL(("Node has IPv6 type of connection"));
-          notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v6;
-          memcpy(notify_msg->addr_info.addr,
-            &addr->in6_addr.sin6_addr,
-            sizeof(struct in6_addr));
-          notify_msg->addr_info.port = (uint32_t)addr->in6_addr.sin6_port;
-        }
-        else
-        {
-          TRACE_WARN(("Unknown Transport Type"));
-        }
-      }
-      else
+      if(partner->transport_cb->sock_cb == NULL)
       {
         /* Possible point of bug. */
         TRACE_WARN(("Node Partner present without transport connection."));
         TRACE_ASSERT(FALSE);
       }
-      notify_msg->addr_info.group = affected_node.node_cb->node_cb->partner->group;
-      notify_msg->addr_info.hw_index = affected_node.node_cb->node_cb->partner->parent_location_cb->index;
-      notify_msg->addr_info.node_id = affected_node.node_cb->node_cb->partner->index;
+      memcpy(&notify_msg->addr_info,
+             hm_get_node_addr_info((HM_GLOBAL_NODE_CB *)partner->db_ptr),
+             sizeof(HM_ADDRESS_INFO));
       notify_msg->if_id = TRUE;
     }
     else
@@ -933,83 +1250,152 @@ HM_MSG * hm_build_notify_message(HM_NOTIFICATION_CB *notify_cb)
       TRACE_DETAIL(("Node partner not present"));
       notify_msg->if_id = FALSE;
     }
-
     break;
 
-  case HM_NOTIFICATION_NODE_ROLE_PASSIVE:
-    TRACE_INFO(("Node Role Passive or None"));
-    TRACE_INFO(("Node %d role change to %s", affected_node.node_cb->index,
-        (affected_node.node_cb->role==NODE_ROLE_PASSIVE)?"Passive":"Active/None"));
-    notify_msg->hdr.msg_type = HM_MSG_TYPE_HA_UPDATE;
+  default:
+    TRACE_ERROR(("Unknown notification type"));
+    TRACE_ASSERT(FALSE);
+  }
 
-    if(affected_node.node_cb->role != HM_HA_NODE_ROLE_NONE)
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (msg);
+}/* hm_build_notify_message */
+
+
+/**
+ *  @brief Computes the address information of a node and caches it on its global row
+ *
+ *  Called when the node becomes active, which is also the only point at which
+ *  a node can come up on a new transport. Notifications about the node and its
+ *  processes then only copy the cached block. A node with no transport of ours
+ *  (on another location, or not connected yet) is cached without an address.
+ *
+ *  @param *glob_cb Global Node CB (#HM_GLOBAL_NODE_CB) of the node
+ *  @return #HM_OK if address could be determined or is not ours to know,
+ *          #HM_ERR otherwise
+ */
+int32_t hm_cache_node_addr_info(HM_GLOBAL_NODE_CB *glob_cb)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  HM_ADDRESS_INFO *addr_info = NULL;
+  HM_TRANSPORT_CB *tprt_cb = NULL;
+  HM_SOCKADDR_UNION *addr = NULL;
+  /***************************************************************************/
+  /* Sanity Checks                                                           */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(glob_cb != NULL);
+  TRACE_ASSERT(glob_cb->node_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                                            */
+  /***************************************************************************/
+  addr_info = &glob_cb->addr_info;
+  memset(addr_info, 0, sizeof(HM_ADDRESS_INFO));
+  glob_cb->addr_info_valid = FALSE;
+
+  addr_info->group = glob_cb->node_cb->group;
+  addr_info->hw_index = glob_cb->node_cb->parent_location_cb->index;
+  addr_info->node_id = glob_cb->node_cb->index;
+
+  /***************************************************************************/
+  /* A node on another location is not connected to us; peers do not tell  */
+  /* its address. One of ours may not have connected yet. Either way, the  */
+  /* notifications go without an address (type 0) till it becomes active,  */
+  /* so there is nothing to look up again before that.              */
+  /***************************************************************************/
+  tprt_cb = glob_cb->node_cb->transport_cb;
+  if((tprt_cb == NULL) || (tprt_cb->sock_cb == NULL))
+  {
+    if(glob_cb->node_cb->parent_location_cb->index == LOCAL.local_location_cb.index)
     {
-      notify_msg->type = (affected_node.node_cb->role==NODE_ROLE_ACTIVE)?
-                            HM_HA_NODE_ROLE_ACTIVE:HM_HA_NODE_ROLE_PASSIVE;
+      TRACE_WARN(("Node %d never connected. Nothing to put in its transport "
+                  "profile notification.", glob_cb->index));
+      ret_val = HM_ERR;
     }
     else
     {
-      notify_msg->type = HM_HA_NODE_ROLE_NONE;
+      TRACE_DETAIL(("Node %d is on Location %d. Its address is not known here.",
+                    glob_cb->index, addr_info->hw_index));
     }
-    notify_msg->id = 0;
-    notify_msg->if_id = 0;
-    notify_msg->proc_type = 0;
+    glob_cb->addr_info_valid = TRUE;
+    goto EXIT_LABEL;
+  }
 
-    TRACE_ASSERT(affected_node.node_cb->node_cb->transport_cb != NULL);
-    /* For a passive node, there must always be an active node on the cluster */
-    TRACE_ASSERT(affected_node.node_cb->node_cb->partner != NULL);
-    TRACE_DETAIL(("Node partner present."));
-    if(affected_node.node_cb->node_cb->partner->transport_cb->sock_cb != NULL)
-    {
-      addr = (HM_SOCKADDR_UNION *)&(affected_node.node_cb->node_cb->partner->transport_cb->sock_cb->addr);
-      if((affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_IN) ||
-        (affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_OUT))
-      {
-        TRACE_DETAIL(("Node has IPv4 type of connection."));
-        notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v4;
-        memcpy(notify_msg->addr_info.addr,
-            &addr->in_addr.sin_addr.s_addr,
-          sizeof(struct in_addr));
-        notify_msg->addr_info.port = (uint32_t)addr->in_addr.sin_port;
-      }
-      else if((affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_IPv6_IN)||
-          (affected_node.node_cb->node_cb->partner->transport_cb->type == HM_TRANSPORT_TCP_IPv6_OUT))
-      {
-        TRACE_DETAIL(("Node has IPv6 type of connection"));
-        notify_msg->addr_info.addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v6;
-        memcpy(notify_msg->addr_info.addr,
-          &addr->in6_addr.sin6_addr,
-          sizeof(struct in6_addr));
-        notify_msg->addr_info.port = (uint32_t)addr->in6_addr.sin6_port;
-      }
-      else
-      {
-        TRACE_WARN(("Unknown Transport Type"));
-      }
-    }
-    else
+  addr = (HM_SOCKADDR_UNION *)&(tprt_cb->sock_cb->addr);
+  if((tprt_cb->type == HM_TRANSPORT_TCP_IN) || (tprt_cb->type == HM_TRANSPORT_TCP_OUT))
+  {
+    TRACE_DETAIL(("Node has IPv4 type of connection."));
+    addr_info->addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v4;
+    memcpy(addr_info->addr, &addr->in_addr.sin_addr.s_addr, sizeof(struct in_addr));
+    addr_info->port = (uint32_t)addr->in_addr.sin_port;
+#ifdef I_WANT_TO_DEBUG
     {
-      /* Possible point of bug. */
-      TRACE_WARN(("Node Partner present without transport connection."));
-      TRACE_ASSERT(FALSE);
+    char address_value[128];
+    inet_ntop(addr->in_addr.sin_family,
+          addr_info->addr,
+          address_value, sizeof(address_value));
+    TRACE_INFO(("IP Address filled: %s:%d",address_value, addr_info->port));
     }
+#endif
+  }
+  else if((tprt_cb->type == HM_TRANSPORT_TCP_IPv6_IN) ||
+          (tprt_cb->type == HM_TRANSPORT_TCP_IPv6_OUT))
+  {
+    TRACE_DETAIL(("Node has IPv6 type of connection"));
+    addr_info->addr_type = HM_NOTIFY_ADDR_TYPE_TCP_v6;
+    memcpy(addr_info->addr, &addr->in6_addr.sin6_addr, sizeof(struct in6_addr));
+    addr_info->port = (uint32_t)addr->in6_addr.sin6_port;
+  }
+  else
+  {
+    TRACE_WARN(("Unknown Transport Type %d", tprt_cb->type));
+  }
 
-    notify_msg->addr_info.group = affected_node.node_cb->node_cb->partner->group;
-    notify_msg->addr_info.hw_index = affected_node.node_cb->node_cb->partner->parent_location_cb->index;
-    notify_msg->addr_info.node_id = affected_node.node_cb->node_cb->partner->index;
+  glob_cb->addr_info_valid = TRUE;
 
-    notify_msg->if_id = TRUE;
-    break;
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return ret_val;
+}/* hm_cache_node_addr_info */
 
-  default:
-    TRACE_ERROR(("Unknown notification type"));
-    TRACE_ASSERT(FALSE);
+
+/**
+ *  @brief Returns the cached address information of a node
+ *
+ *  @param *glob_cb Global Node CB (#HM_GLOBAL_NODE_CB) of the node
+ *  @return Address information (#HM_ADDRESS_INFO) to be copied into notifications
+ */
+HM_ADDRESS_INFO * hm_get_node_addr_info(HM_GLOBAL_NODE_CB *glob_cb)
+{
+  /***************************************************************************/
+  /* Sanity Checks                                                           */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(glob_cb != NULL);
+
+  /***************************************************************************/
+  /* Main Routine                                                            */
+  /***************************************************************************/
+  if(!glob_cb->addr_info_valid)
+  {
+    TRACE_DETAIL(("Address information of Node %d not cached.", glob_cb->index));
+    hm_cache_node_addr_info(glob_cb);
   }
 
-EXIT_LABEL:
   /***************************************************************************/
   /* Exit Level Checks                             */
   /***************************************************************************/
   TRACE_EXIT();
-  return (msg);
-}/* hm_build_notify_message */
+  return &glob_cb->addr_info;
+}/* hm_get_node_addr_info */
@@ -10,10 +10,21 @@
 #define SRC_HMPEERIF_H_
 
 /*******************************NOTE****************************************/
-/* Since we cannot be sure if the Cluster Communication will be TCP or UDP */
-/* the PDU size of each message is non-variable.                           */
+/* Every Peer message carries its own length in the header. Replay and     */
+/* Binding messages are variable: they carry as many entries as fit in the */
+/* frame size negotiated in INIT (the smaller of both ends). A frame is    */
+/* never larger than HM_PEER_MAX_FRAME_SIZE, so that a UDP peer can always */
+/* take it in a single datagram.                                           */
 /***************************************************************************/
-#define HM_PEER_NUM_TLVS_PER_UPDATE                              ((uint32_t)5)
+#define HM_PEER_MAX_FRAME_SIZE                               ((uint32_t)65507)
+
+/*******************************NOTE****************************************/
+/* Updates, Replay, HA and Binding messages to a peer are numbered in one  */
+/* sequence per peer, which restarts with every INIT. Each peer tells what */
+/* it has received in the Acks carried on its Keepalive: all messages upto */
+/* ack, and those of the next HM_PEER_SACK_BITS set in the sack bitmap.     */
+/***************************************************************************/
+#define HM_PEER_SACK_BITS                                         ((uint32_t)32)
 
 /***************************************************************************/
 /* Message Types to be used in msg_type field of HM_MSG_HEADER             */
@@ -25,6 +36,12 @@
 #define HM_PEER_MSG_TYPE_HA_UPDATE        ((uint32_t) 5) /* Updates on HA roles */
 #define HM_PEER_MSG_TYPE_REPLAY           ((uint32_t) 6) /* Replay messages */
 #define HM_PEER_MSG_TYPE_BINDING          ((uint32_t) 7) /* Subscription binding */
+#define HM_PEER_MSG_TYPE_PING             ((uint32_t) 8) /* Gossip: Probe */
+#define HM_PEER_MSG_TYPE_PING_REQ         ((uint32_t) 9) /* Gossip: Probe on my behalf */
+#define HM_PEER_MSG_TYPE_PING_ACK         ((uint32_t) 10) /* Gossip: Probe answered */
+#define HM_PEER_MSG_TYPE_DIGEST           ((uint32_t) 11) /* Anti-entropy digests */
+#define HM_PEER_MSG_TYPE_INTEREST         ((uint32_t) 12) /* Process types subscribed to */
+#define HM_PEER_MSG_TYPE_RELAY            ((uint32_t) 13) /* State of a location passed on by an aggregator */
 /***************************************************************************/
 
 /***************************************************************************/
@@ -39,6 +56,53 @@
 #define HM_PEER_ENTITY_STATUS_INACTIVE                         ((uint32_t) 0)
 #define HM_PEER_ENTITY_STATUS_ACTIVE                           ((uint32_t) 1)
 
+/***************************************************************************/
+/* Group: Status of a member in Gossip                                     */
+/***************************************************************************/
+#define HM_PEER_MEMBER_ALIVE                                   ((uint32_t) 0)
+#define HM_PEER_MEMBER_SUSPECT                                 ((uint32_t) 1)
+#define HM_PEER_MEMBER_DEAD                                    ((uint32_t) 2)
+
+/***************************************************************************/
+/* Group: Kinds of Digest message                                          */
+/***************************************************************************/
+/* Our digest of the receiver's tables                                     */
+#define HM_PEER_DIGEST_ROOT                                    ((uint32_t) 1)
+/* Digests of the sender's own nodes between first and last                */
+#define HM_PEER_DIGEST_NODES                                   ((uint32_t) 2)
+/* Nodes of the receiver we disagree on. Send them again.                  */
+#define HM_PEER_DIGEST_REPAIR                                  ((uint32_t) 3)
+/* Nodes asked for in a Repair have all been sent                          */
+#define HM_PEER_DIGEST_REPAIRED                                ((uint32_t) 4)
+
+/* Last of a range that runs to the end of the Node IDs                    */
+#define HM_PEER_DIGEST_LAST_NODE                      ((uint32_t) 0xFFFFFFFF)
+
+/***************************************************************************/
+/* Group: Version of the peer protocol                                     */
+/* Carried in INIT. Raised whenever a peer message changes on the wire;   */
+/* peers on different versions do not talk to each other.                 */
+/***************************************************************************/
+#define HM_PEER_PROTOCOL_VERSION                            ((uint32_t) 2)
+
+/***************************************************************************/
+/* Group: Capabilities advertised in INIT                                  */
+/***************************************************************************/
+/* Every message counts as a Keepalive. The Tick is still sent each period.*/
+#define HM_PEER_CAP_IDLE_KEEPALIVE                          ((uint32_t) 0x01)
+
+/***************************************************************************/
+/* Group: Lanes of the stream between peers                                */
+/* Each lane is numbered, windowed and acknowledged on its own, so that    */
+/* what is on one never waits behind the other.                            */
+/***************************************************************************/
+/* Interest and HA updates: few, small, and wanted right away              */
+#define HM_PEER_LANE_CONTROL                                ((uint32_t) 0)
+/* Replays, Node/Process updates, Bindings, Digests and Relays             */
+#define HM_PEER_LANE_BULK                                   ((uint32_t) 1)
+
+#define HM_PEER_NUM_LANES                                   ((uint32_t) 2)
+
 
 /**
  * @brief Hardware Manager Peer Message Header
@@ -58,12 +122,27 @@ typedef struct hm_peer_msg_hdr
   uint8_t hw_id[4];
 
   /*
-   * Timestamp of sending
-   * A time_t variable is a long int, so 8 bytes should suffice for most
-   * purposes.
+   * Hybrid logical clock of the sender when it was sent. For a Node or
+   * Process update, that of the change it carries.
    */
   uint8_t timestamp[8];
 
+  /*
+   * Length of the whole message, this header included.
+   */
+  uint8_t msg_len[4];
+
+  /*
+   * Sequence number on the stream to the receiving peer. 0 for messages
+   * outside of it (INIT and Keepalive).
+   */
+  uint8_t seq[4];
+
+  /*
+   * Lane of the stream (HM_PEER_LANE_*) the sequence number is on.
+   */
+  uint8_t lane[4];
+
 } HM_PEER_MSG_HEADER ;
 /**STRUCT-********************************************************************/
 
@@ -80,6 +159,12 @@ typedef struct hm_peer_msg_init
    */
   HM_PEER_MSG_HEADER hdr;
 
+  /*
+   * Version of the peer protocol the sender speaks (HM_PEER_PROTOCOL_VERSION).
+   * Checked before anything else in the message.
+   */
+  uint8_t version[4];
+
   /*
    * Request/Response
    */
@@ -91,14 +176,97 @@ typedef struct hm_peer_msg_init
    */
   uint8_t response_ok[4];
 
+  /*
+   * Run of the sender. Versions are only comparable within the same run.
+   */
+  uint8_t incarnation[4];
+
+  /*
+   * Run of the receiver that seen_version refers to.
+   */
+  uint8_t peer_incarnation[4];
+
+  /*
+   * Highest version of the receiver's tables that the sender has applied.
+   * The receiver replays only what changed after it.
+   */
+  uint8_t seen_version[4];
+
+  /*
+   * Largest message the sender accepts. Replay and Binding messages sent to
+   * it are packed up to this size.
+   */
+  uint8_t frame_size[4];
+
+  /*
+   * Capabilities of the sender (HM_PEER_CAP_*)
+   */
+  uint8_t capabilities[4];
+
+  /*
+   * Role of the sender in an aggregated cluster (HM_AGGREGATION_ROLE_*), and
+   * the index of its aggregator if it is a leaf.
+   */
+  uint8_t aggregation_role[4];
+  uint8_t aggregator[4];
+
 } HM_PEER_MSG_INIT ;
 /**STRUCT-********************************************************************/
 
 
+/**
+ * @brief HM Peer Acknowledgement of a lane
+ */
+typedef struct hm_peer_lane_ack
+{
+  /*
+   * All messages upto and including this sequence number have been received
+   */
+  uint8_t ack[4];
+
+  /*
+   * Bit i set: message ack + 2 + i has been received as well.
+   */
+  uint8_t sack[4];
+
+} HM_PEER_LANE_ACK ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief HM Peer Acknowledgement
+ *
+ * What the sender of a Keepalive has received from one of its peers.
+ */
+typedef struct hm_peer_ack
+{
+  /*
+   * Index of the peer being acknowledged
+   */
+  uint8_t hw_id[4];
+
+  /*
+   * What has been received on each lane of the stream from the peer
+   */
+  HM_PEER_LANE_ACK lanes[HM_PEER_NUM_LANES];
+
+  /*
+   * Send stamp of the last Keepalive received from the peer, echoed back, and
+   * the nanoseconds it was held here before this one went out. Lets the peer
+   * measure its round trip to us. Zero if nothing was received yet.
+   */
+  uint8_t echo_ns[8];
+  uint8_t held_ns[8];
+
+} HM_PEER_ACK ;
+/**STRUCT-********************************************************************/
+
+
 /**
  * @brief HM Peer Keepalive Update Message
  *
- * Keepalive Tick sending a summary of own status and timestamps
+ * Keepalive Tick sending a summary of own status and timestamps, and what has
+ * been received from each peer.
  */
 typedef struct hm_peer_msg_keepalive
 {
@@ -122,9 +290,48 @@ typedef struct hm_peer_msg_keepalive
    */
   uint8_t num_proc[4];
 
+  /*
+   * Incarnation, version and digest of the sender's own tables. A peer
+   * holding the same version and digest needs nothing replayed.
+   */
+  uint8_t incarnation[4];
+  uint8_t version[4];
+  uint8_t digest[4];
+
+  /*
+   * Role of the sender in an aggregated cluster (HM_AGGREGATION_ROLE_*), and
+   * the index of its aggregator if it is a leaf. Locations that may not peer
+   * do not connect on each other's Ticks.
+   */
+  uint8_t aggregation_role[4];
+  uint8_t aggregator[4];
+
+  /*
+   * Sender's monotonic and wall clocks when it sent this, in ns. The first
+   * is echoed back in Acks; the second estimates the offset between clocks.
+   */
+  uint8_t sent_ns[8];
+  uint8_t wall_ns[8];
+
+  /*
+   * Number of Acks that follow
+   */
+  uint8_t num_acks[4];
+
+  /*
+   * Acks to the peers we have a stream from
+   */
+  HM_PEER_ACK acks[1];
+
 } HM_PEER_MSG_KEEPALIVE ;
 /**STRUCT-********************************************************************/
 
+/***************************************************************************/
+/* Length of a Keepalive message carrying NUM Acks                         */
+/***************************************************************************/
+#define HM_PEER_KEEPALIVE_MSG_SIZE(NUM)                                        \
+      (HM_OFFSETOF(HM_PEER_MSG_KEEPALIVE, acks) + ((NUM) * sizeof(HM_PEER_ACK)))
+
 
 /**
  * @brief HM Peer Replay TVL Chunk
@@ -162,6 +369,16 @@ typedef struct hm_peer_replay_tlv
    * Status: Running or not?
    */
   uint8_t running[4];
+
+  /*
+   * Version of sender's tables when this entry last changed
+   */
+  uint8_t version[4];
+
+  /*
+   * Hybrid logical clock of the sender when this entry last changed
+   */
+  uint8_t hlc[8];
 } HM_PEER_REPLAY_TLV ;
 /**STRUCT-********************************************************************/
 
@@ -187,15 +404,64 @@ typedef struct hm_peer_msg_replay
    */
   uint8_t num_tlvs[4];
 
+  /*
+   * Replay carries changes after this version only. 0 for a full replay.
+   */
+  uint8_t since[4];
+
+  /*
+   * Version of sender's tables at the time of replay.
+   */
+  uint8_t version[4];
 
   /*
-   * Array of TLVs [Maximum Number controlled by #HM_PEER_NUM_TLVS_PER_UPDATE]
+   * Array of TLVs. num_tlvs of them follow, as many as fit in the frame.
    */
-  HM_PEER_REPLAY_TLV tlv[HM_PEER_NUM_TLVS_PER_UPDATE];
+  HM_PEER_REPLAY_TLV tlv[1];
 
 } HM_PEER_MSG_REPLAY ;
 /**STRUCT-********************************************************************/
 
+/***************************************************************************/
+/* Length of a Replay message carrying NUM TLVs                            */
+/***************************************************************************/
+#define HM_PEER_REPLAY_MSG_SIZE(NUM)                                           \
+      (HM_OFFSETOF(HM_PEER_MSG_REPLAY, tlv) + ((NUM) * sizeof(HM_PEER_REPLAY_TLV)))
+
+
+/**
+ * @brief HM Peer Relay Message
+ *
+ * An aggregator passes on what it holds of a location that the receiver does
+ * not peer with. The entries are those of a Replay, as the aggregator has
+ * them now, and are not versioned: the aggregator has put them in order.
+ */
+typedef struct hm_peer_msg_relay
+{
+  /*
+   * HM Header
+   */
+  HM_PEER_MSG_HEADER hdr;
+
+  /*
+   * Index of the location the entries belong to
+   */
+  uint8_t origin[4];
+
+  /*
+   * Entries of the location
+   */
+  HM_PEER_MSG_REPLAY replay;
+
+} HM_PEER_MSG_RELAY ;
+/**STRUCT-********************************************************************/
+
+/***************************************************************************/
+/* Length of a Relay message carrying NUM TLVs                             */
+/***************************************************************************/
+#define HM_PEER_RELAY_MSG_SIZE(NUM)                                            \
+      (HM_OFFSETOF(HM_PEER_MSG_RELAY, replay) + HM_PEER_REPLAY_MSG_SIZE(NUM))
+
 /**
  * @brief HM Peer Node Update Message
  *
@@ -227,6 +493,11 @@ typedef struct hm_peer_msg_node_update
    */
   uint8_t node_role[4];
 
+  /*
+   * Version of sender's tables at this change
+   */
+  uint8_t version[4];
+
 } HM_PEER_MSG_NODE_UPDATE ;
 /**STRUCT-********************************************************************/
 
@@ -260,6 +531,11 @@ typedef struct hm_peer_msg_proc_update
    *  Node ID
    */
   uint8_t node_id[4];
+
+  /*
+   * Version of sender's tables at this change
+   */
+  uint8_t version[4];
 } HM_PEER_MSG_PROCESS_UPDATE ;
 /**STRUCT-********************************************************************/
 
@@ -355,13 +631,225 @@ typedef struct hm_peer_msg_binding
   uint8_t num_bindings[4];
 
   /*
-   * Bindings to be filled in.
+   * Bindings to be filled in. num_bindings of them follow.
    */
-  HM_PEER_BINDING_CB bindings[HM_PEER_NUM_TLVS_PER_UPDATE];
+  HM_PEER_BINDING_CB bindings[1];
 
 } HM_PEER_MSG_BINDING ;
 /**STRUCT-********************************************************************/
 
+/***************************************************************************/
+/* Length of a Binding message carrying NUM bindings                       */
+/***************************************************************************/
+#define HM_PEER_BINDING_MSG_SIZE(NUM)                                          \
+      (HM_OFFSETOF(HM_PEER_MSG_BINDING, bindings) +                            \
+                                        ((NUM) * sizeof(HM_PEER_BINDING_CB)))
+
+
+/**
+ * @brief HM Peer Gossip Member
+ *
+ * What the sender knows of one member of the cluster. Carried on each Gossip
+ * message, so that membership changes spread without messages of their own.
+ */
+typedef struct hm_peer_member
+{
+  /*
+   * Hardware Index of the member
+   */
+  uint8_t hw_id[4];
+
+  /*
+   * One of HM_PEER_MEMBER_*
+   */
+  uint8_t status[4];
+
+  /*
+   * Incarnation of the member the status holds for. Only the member raises
+   * it, to refute being suspected.
+   */
+  uint8_t incarnation[4];
+
+  /*
+   * IPv4 address and port of the datagram socket of the member, in network
+   * order. 0 if the sender does not know it.
+   */
+  uint8_t addr[4];
+  uint8_t port[4];
+
+} HM_PEER_MEMBER ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief HM Peer Gossip message
+ *
+ * Ping, Ping Request and Ping Ack of the gossip membership. A Ping Request
+ * asks the receiver to Ping the target for the origin; the Ack goes back the
+ * same way.
+ */
+typedef struct hm_peer_msg_gossip
+{
+  /*
+   * HM Header
+   */
+  HM_PEER_MSG_HEADER hdr;
+
+  /*
+   * Probe of the origin this message belongs to
+   */
+  uint8_t probe_id[4];
+
+  /*
+   * Member being probed. 0 if the sender does not know its index yet.
+   */
+  uint8_t target[4];
+
+  /*
+   * Member that started the probe
+   */
+  uint8_t origin[4];
+
+  /*
+   * Incarnation of the sender
+   */
+  uint8_t incarnation[4];
+
+  /*
+   * Number of members in this message
+   */
+  uint8_t num_members[4];
+
+  /*
+   * Membership changes to spread. num_members of them follow.
+   */
+  HM_PEER_MEMBER members[1];
+
+} HM_PEER_MSG_GOSSIP ;
+/**STRUCT-********************************************************************/
+
+/***************************************************************************/
+/* Length of a Gossip message carrying NUM members                         */
+/***************************************************************************/
+#define HM_PEER_GOSSIP_MSG_SIZE(NUM)                                                 (HM_OFFSETOF(HM_PEER_MSG_GOSSIP, members) + ((NUM) * sizeof(HM_PEER_MEMBER)))
+
+
+/**
+ * @brief HM Peer Digest Entry
+ *
+ * Digest of one node: its own state and that of every process on it.
+ */
+typedef struct hm_peer_digest_entry
+{
+  /*
+   * Node ID
+   */
+  uint8_t node_id[4];
+
+  /*
+   * Digest of the node and its processes
+   */
+  uint8_t digest[4];
+
+} HM_PEER_DIGEST_ENTRY ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief HM Peer Digest message
+ *
+ * Anti-entropy between peers. The digest of a location is the sum of the
+ * digests of its nodes, and that of a node the sum of its own and of its
+ * processes', so peers that agree on the root need exchange nothing more;
+ * otherwise only the nodes whose digests differ are sent again.
+ */
+typedef struct hm_peer_msg_digest
+{
+  /*
+   * HM Header
+   */
+  HM_PEER_MSG_HEADER hdr;
+
+  /*
+   * One of HM_PEER_DIGEST_*
+   */
+  uint8_t kind[4];
+
+  /*
+   * Digest of the location the message is about
+   */
+  uint8_t digest[4];
+
+  /*
+   * Range of Node IDs the entries cover. The sender has no other nodes with
+   * a non-zero digest in it.
+   */
+  uint8_t first[4];
+  uint8_t last[4];
+
+  /*
+   * Number of entries in this message
+   */
+  uint8_t num_entries[4];
+
+  /*
+   * Nodes, in order of ID. num_entries of them follow.
+   */
+  HM_PEER_DIGEST_ENTRY entries[1];
+
+} HM_PEER_MSG_DIGEST ;
+/**STRUCT-********************************************************************/
+
+/***************************************************************************/
+/* Length of a Digest message carrying NUM entries                         */
+/***************************************************************************/
+#define HM_PEER_DIGEST_MSG_SIZE(NUM)                                           \
+      (HM_OFFSETOF(HM_PEER_MSG_DIGEST, entries) + ((NUM) * sizeof(HM_PEER_DIGEST_ENTRY)))
+
+
+/***************************************************************************/
+/* Most process types an Interest message names. A location subscribed to */
+/* more than these asks for every process instead.                         */
+/***************************************************************************/
+#define HM_PEER_MAX_INTERESTS                                  ((uint32_t) 32)
+
+/**
+ * @brief HM Peer Interest message
+ *
+ * Process types the sender has subscribers for. Peers send it updates of
+ * those processes only. Nodes are sent to all, whatever their interest.
+ */
+typedef struct hm_peer_msg_interest
+{
+  /*
+   * HM Header
+   */
+  HM_PEER_MSG_HEADER hdr;
+
+  /*
+   * TRUE if the sender wants every process, whatever the types below
+   */
+  uint8_t all[4];
+
+  /*
+   * Number of process types in this message
+   */
+  uint8_t num_types[4];
+
+  /*
+   * Process types. num_types of them follow.
+   */
+  uint8_t proc_types[HM_PEER_MAX_INTERESTS][4];
+
+} HM_PEER_MSG_INTEREST ;
+/**STRUCT-********************************************************************/
+
+/***************************************************************************/
+/* Length of an Interest message carrying NUM process types                */
+/***************************************************************************/
+#define HM_PEER_INTEREST_MSG_SIZE(NUM)                                         \
+      (HM_OFFSETOF(HM_PEER_MSG_INTEREST, proc_types) + ((NUM) * 4))
+
 
 /**
  * @brief HM Peer Message Union
@@ -380,7 +868,17 @@ typedef struct hm_peer_msg_union
   HM_PEER_MSG_PROCESS_UPDATE peer_proc_update;
   HM_PEER_MSG_HA_UPDATE peer_ha_update;
   HM_PEER_MSG_BINDING peer_binding;
+  HM_PEER_MSG_GOSSIP peer_gossip;
+  HM_PEER_MSG_DIGEST peer_digest;
+  HM_PEER_MSG_INTEREST peer_interest;
+  HM_PEER_MSG_RELAY peer_relay;
 } HM_PEER_MSG_UNION ;
 /**STRUCT-********************************************************************/
 
+/***************************************************************************/
+/* Smallest frame size allowed: every fixed message, and a variable one    */
+/* with at least one entry, must fit.                                      */
+/***************************************************************************/
+#define HM_PEER_MIN_FRAME_SIZE             ((uint32_t)sizeof(HM_PEER_MSG_UNION))
+
 #endif /* SRC_HMPEERIF_H_ */
@@ -303,6 +303,20 @@ typedef struct hm_msg
   /***************************************************************************/
   void *msg;
 
+  /***************************************************************************/
+  /* Message shared with others, whose bytes past the first msg_len follow   */
+  /* ours on the wire. It is never written through us. NULL if none.        */
+  /***************************************************************************/
+  struct hm_msg *body;
+
+  /***************************************************************************/
+  /* Notifications only: the entity the message is about, and the priority  */
+  /* class (HM_PRIORITY_*) it belongs to. It may be queued in a lower class  */
+  /* to stay behind an earlier message about the same entity.               */
+  /***************************************************************************/
+  void *entity;
+  uint32_t priority;
+
 } HM_MSG ;
 /**STRUCT-********************************************************************/
 
@@ -392,6 +406,45 @@ typedef struct hm_socket_cb {
 } HM_SOCKET_CB ;
 /**STRUCT-********************************************************************/
 
+/**
+ * @brief Outgoing queue accounting of a Transport
+ *
+ * Counters kept on every transport so that a subscriber which stops reading
+ * can be identified (and bounded) without walking its pending queue.
+ */
+typedef struct hm_queue_stats {
+  /***************************************************************************/
+  /* Messages and bytes currently waiting on the pending queue               */
+  /***************************************************************************/
+  uint32_t num_pending;
+  uint32_t pending_bytes;
+
+  /***************************************************************************/
+  /* Largest number of messages ever held on the pending queue               */
+  /***************************************************************************/
+  uint32_t high_watermark;
+
+  /***************************************************************************/
+  /* Notifications discarded because the queue was over its bounds           */
+  /***************************************************************************/
+  uint32_t dropped;
+
+  /***************************************************************************/
+  /* Notifications superseded in place by a newer state of the same entity   */
+  /***************************************************************************/
+  uint32_t collapsed;
+
+  /***************************************************************************/
+  /* Times the queue went over its bounds: in total, and since it was last   */
+  /* drained completely.                                                     */
+  /***************************************************************************/
+  uint32_t overflows;
+  uint32_t consecutive_overflows;
+
+} HM_QUEUE_STATS ;
+/**STRUCT-********************************************************************/
+
+
 /**
  * @brief Transport Connection Control Block
  *
@@ -445,9 +498,15 @@ typedef struct hm_transport_cb {
   char *out_buffer;
 
   /***************************************************************************/
-  /* Outgoing buffers (Pending). HM_MSG structures must be appended on top.  */
+  /* Outgoing buffers (Pending), one queue per priority class.        */
+  /* HM_MSG structures must be appended on top.                 */
   /***************************************************************************/
-  HM_LQE pending;
+  HM_LQE pending[HM_NUM_PRIORITIES];
+
+  /***************************************************************************/
+  /* Messages each class may still send in the current draining round     */
+  /***************************************************************************/
+  uint32_t credits[HM_NUM_PRIORITIES];
 
   /***************************************************************************/
   /* A single MSG_HEADER structure pre-allocated so that we always have some */
@@ -470,10 +529,249 @@ typedef struct hm_transport_cb {
   /***************************************************************************/
   uint32_t hold;
 
+  /***************************************************************************/
+  /* Message partly written to the socket, and the bytes of it already     */
+  /* written. It is finished before anything else is sent, and it is never */
+  /* dropped or collapsed.                                                   */
+  /***************************************************************************/
+  HM_LIST_BLOCK *out_block;
+  uint32_t out_offset;
+
+  /***************************************************************************/
+  /* Outgoing queue accounting                                               */
+  /***************************************************************************/
+  HM_QUEUE_STATS stats;
+
+  /***************************************************************************/
+  /* When a message was last received on, and last sent out of, this       */
+  /* transport (ms, monotonic). Traffic either way makes a keepalive moot.  */
+  /***************************************************************************/
+  uint64_t last_rx;
+  uint64_t last_tx;
+
 } HM_TRANSPORT_CB ;
 /**STRUCT-********************************************************************/
 
 
+/**
+ * @brief Peer Window Entry
+ *
+ * State kept alongside each message sent to a peer that it has not yet
+ * acknowledged.
+ */
+typedef struct hm_peer_window_entry
+{
+  /***************************************************************************/
+  /* Sequence number of the message                      */
+  /***************************************************************************/
+  uint32_t seq;
+
+  /***************************************************************************/
+  /* Priority class to queue it in on the transport              */
+  /***************************************************************************/
+  uint32_t priority;
+
+  /***************************************************************************/
+  /* Handed to the transport (TRUE), or held till the window opens (FALSE)   */
+  /***************************************************************************/
+  uint32_t in_flight;
+
+  /***************************************************************************/
+  /* When it was last handed to the transport (ms, monotonic)        */
+  /***************************************************************************/
+  uint64_t sent_ms;
+
+  /***************************************************************************/
+  /* Lane of the stream it is on (HM_PEER_LANE_*), and when it was put there */
+  /***************************************************************************/
+  uint32_t lane;
+  uint64_t queued_ns;
+
+} HM_PEER_WINDOW_ENTRY ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief One lane of the stream to and from a peer
+ *
+ * Numbered, windowed and acknowledged apart from the other lanes.
+ */
+typedef struct hm_peer_lane
+{
+  /***************************************************************************/
+  /* To the peer: last sequence number used, and everything sent but not yet */
+  /* acknowledged in order of sequence. Only the first window of these are   */
+  /* with the transport; the rest wait for acks to open it.          */
+  /***************************************************************************/
+  uint32_t send_seq;
+  HM_LQE unacked;
+  uint32_t num_unacked;
+  uint32_t num_in_flight;
+
+  /***************************************************************************/
+  /* From the peer: everything upto recv_seq has arrived, and so have those  */
+  /* marked in recv_sack after it (bit i is recv_seq + 2 + i).        */
+  /***************************************************************************/
+  uint32_t recv_seq;
+  uint32_t recv_sack;
+
+  /***************************************************************************/
+  /* Times the retransmission timeout has doubled since an ack last made   */
+  /* progress.                                   */
+  /***************************************************************************/
+  uint32_t backoff;
+
+  /***************************************************************************/
+  /* Statistics. Queue time is from being put on the lane till first handed  */
+  /* to the transport, in ns.                         */
+  /***************************************************************************/
+  uint32_t retransmits;
+  uint32_t duplicates;
+  uint32_t num_queued;
+  uint64_t total_queue_ns;
+  uint64_t max_queue_ns;
+
+} HM_PEER_LANE ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Replay of our tables to a peer, under way
+ *
+ * The replay is sent a few messages at a time from the main loop, as the
+ * peer's window, its socket and the rate cap allow. Between turns, only the
+ * keys of the Node and Process last replayed are kept, since either may be
+ * gone by the next turn. Changes made while a pass was under way are sent in
+ * another pass, till one finds none; then the End of Replay goes.
+ */
+typedef struct hm_replay_cursor
+{
+  HM_LQE node;              /* In LOCAL.replays while under way. Self is Location CB */
+  uint32_t stage;           /* HM_REPLAY_STAGE_* */
+  uint32_t since;           /* Version the peer said it had. 0 for full replay */
+
+  /***************************************************************************/
+  /* This pass sends what changed after version from. It began at upto.  */
+  /***************************************************************************/
+  uint32_t from;
+  uint32_t upto;
+
+  /***************************************************************************/
+  /* Next message of the shared snapshot, valid while it is of this generation*/
+  /***************************************************************************/
+  HM_LIST_BLOCK *snap_block;
+  uint32_t snap_generation;
+
+  /***************************************************************************/
+  /* Where the pass stands: Node index, and Process type and pid after which */
+  /* it resumes, unless it has just begun the stage.              */
+  /***************************************************************************/
+  uint32_t resume;
+  uint32_t node_key;
+  uint32_t proc_key[2];
+
+  HM_MSG *msg;              /* Replay message being filled */
+
+  /***************************************************************************/
+  /* Bytes it may send now under the rate cap, and when that was reckoned  */
+  /***************************************************************************/
+  int64_t tokens;
+  uint64_t refilled_ns;
+
+  /***************************************************************************/
+  /* Statistics                                 */
+  /***************************************************************************/
+  uint64_t started_ns;
+  uint32_t num_msgs;
+  uint32_t num_bytes;
+  uint32_t num_passes;
+
+} HM_REPLAY_CURSOR ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Phi Accrual Failure Detector
+ *
+ * Remembers the last few inter-arrival times of keepalives from an entity.
+ * Suspicion (phi) of the entity grows with the time since the last one, the
+ * faster the more regular they have been.
+ */
+typedef struct hm_phi_detector
+{
+  /***************************************************************************/
+  /* When the last keepalive arrived, in ms. 0 if none has. Intervals are  */
+  /* sampled from it alone.                                                */
+  /***************************************************************************/
+  uint64_t last_keepalive;
+
+  /***************************************************************************/
+  /* When the entity was last heard from at all, in ms. Phi is reckoned    */
+  /* from it.                                                              */
+  /***************************************************************************/
+  uint64_t last_heard;
+
+  /***************************************************************************/
+  /* Ring of inter-arrival times in ms, and their running sums        */
+  /***************************************************************************/
+  uint32_t intervals[HM_PHI_WINDOW_SIZE];
+  uint32_t num_intervals;
+  uint32_t next_interval;
+  uint64_t sum;
+  uint64_t sum_squares;
+} HM_PHI_DETECTOR ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Heartbeat Path Health of a peer
+ *
+ * Keepalive periods since the peer was last heard on each heartbeat path,
+ * and a bit set for each path given up on.
+ */
+typedef struct hm_path_health
+{
+  uint32_t missed[HM_MAX_HEARTBEAT_PATHS];
+  uint32_t down;
+} HM_PATH_HEALTH ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Link Statistics
+ *
+ * Round trip, its jitter and the clock offset to a peer, measured from the
+ * send stamps its Keepalives carry and that ours echo back to it.
+ */
+typedef struct hm_link_stats
+{
+  /***************************************************************************/
+  /* Send stamp of the peer's last Keepalive, and when we received it, in ns */
+  /***************************************************************************/
+  uint64_t echo_sent_ns;
+  uint64_t echo_rcvd_ns;
+
+  /***************************************************************************/
+  /* Smoothed round trip, its mean deviation and the least one seen, in ns   */
+  /***************************************************************************/
+  uint64_t rtt_ns;
+  uint64_t jitter_ns;
+  uint64_t min_rtt_ns;
+
+  /***************************************************************************/
+  /* Smoothed offset of the peer's wall clock from ours, in ns        */
+  /***************************************************************************/
+  int64_t clock_offset_ns;
+
+  /***************************************************************************/
+  /* Round trips measured, and whether the link is too slow for its period   */
+  /***************************************************************************/
+  uint32_t num_samples;
+  uint32_t degraded;
+} HM_LINK_STATS ;
+/**STRUCT-********************************************************************/
+
+
 /**
  * @brief Hardware Manager Location Control Block
  *
@@ -561,6 +859,27 @@ typedef struct hm_location_cb {
   /***************************************************************************/
   uint32_t keepalive_missed;
 
+  /***************************************************************************/
+  /* Arrivals of its keepalives, to tell how suspect it is           */
+  /***************************************************************************/
+  HM_PHI_DETECTOR liveness;
+
+  /***************************************************************************/
+  /* Round trip and clock offset to it, from Keepalives           */
+  /***************************************************************************/
+  HM_LINK_STATS link;
+
+  /***************************************************************************/
+  /* How it is heard on each heartbeat path. With a heartbeat thread, that */
+  /* thread keeps it instead (#HM_HEARTBEAT_PEER), and this is unused.     */
+  /***************************************************************************/
+  HM_PATH_HEALTH paths;
+
+  /***************************************************************************/
+  /* Capabilities the peer advertised in its INIT (HM_PEER_CAP_*)      */
+  /***************************************************************************/
+  uint32_t capabilities;
+
   /***************************************************************************/
   /* Number of active nodes                           */
   /***************************************************************************/
@@ -582,6 +901,11 @@ typedef struct hm_location_cb {
   /***************************************************************************/
   uint32_t replay_in_progress;
 
+  /***************************************************************************/
+  /* Our replay to the peer, if under way                   */
+  /***************************************************************************/
+  HM_REPLAY_CURSOR replay;
+
   /***************************************************************************/
   /* Timer to wait for HA Role updates (For local only)                      */
   /***************************************************************************/
@@ -591,6 +915,94 @@ typedef struct hm_location_cb {
   /* Wait period for HA Timer                                                */
   /***************************************************************************/
   uint32_t ha_timer_wait_interval;
+
+  /***************************************************************************/
+  /* Run of the HM the version below belongs to. For the local location, it  */
+  /* is stamped at startup; for a peer, it is the one it last told us of.    */
+  /***************************************************************************/
+  uint32_t incarnation;
+
+  /***************************************************************************/
+  /* Version of the tables of this location. For the local location, it is  */
+  /* the last version stamped on a change; for a peer, it is the highest one */
+  /* we have applied.                           */
+  /***************************************************************************/
+  uint32_t version;
+
+  /***************************************************************************/
+  /* Version of our tables the peer already has. Replay sends only newer.   */
+  /* 0 means the peer must get everything.                   */
+  /***************************************************************************/
+  uint32_t replay_since;
+
+  /***************************************************************************/
+  /* Anti-entropy digest: sum of the digests of the nodes of this location.  */
+  /* Kept up as the tables change; peers compare theirs to find divergence.  */
+  /***************************************************************************/
+  uint32_t digest;
+
+  /***************************************************************************/
+  /* Digest of the peer's tables when we lost it, and whether its Ticks show */
+  /* it has come back with those same tables, so that nothing need be replayed.*/
+  /***************************************************************************/
+  uint32_t held_digest;
+  uint32_t tables_intact;
+
+  /***************************************************************************/
+  /* Process types the peer wants updates of, as told in its Interest. All  */
+  /* of them if interest_all is set, as it is till the peer tells us. For   */
+  /* the local location, what we last told peers.                          */
+  /***************************************************************************/
+  uint32_t interest_all;
+  uint32_t num_interests;
+  uint32_t interests[HM_PEER_MAX_INTERESTS];
+
+  /***************************************************************************/
+  /* Role of the location in an aggregated cluster (HM_AGGREGATION_ROLE_*), */
+  /* and for a leaf, the index of its aggregator, as told in its Ticks and  */
+  /* INIT. A location we only hear of through an aggregator has no         */
+  /* connection of its own: via is the peer it is reached through.         */
+  /* NULL for a peer.                                                      */
+  /***************************************************************************/
+  uint32_t aggregation_role;
+  uint32_t aggregator;
+  struct hm_location_cb *via;
+
+  /***************************************************************************/
+  /* Largest message the peer accepts, as told in its INIT. 0 till then.     */
+  /***************************************************************************/
+  uint32_t frame_size;
+
+  /***************************************************************************/
+  /* Stream to and from the peer, by lane (HM_PEER_LANE_*)           */
+  /***************************************************************************/
+  HM_PEER_LANE lanes[HM_PEER_NUM_LANES];
+
+  /***************************************************************************/
+  /* Something arrived on the stream from the peer since it was last       */
+  /* acknowledged                                */
+  /***************************************************************************/
+  uint32_t ack_pending;
+
+  /***************************************************************************/
+  /* Gossip membership: what we believe of the location (HM_PEER_MEMBER_*)  */
+  /* and the incarnation it holds for. Only the location itself raises the   */
+  /* incarnation, to refute a suspicion.                    */
+  /***************************************************************************/
+  uint32_t member_status;
+  uint32_t member_incarnation;
+
+  /***************************************************************************/
+  /* Periods the location has been suspected for                             */
+  /***************************************************************************/
+  uint32_t suspect_ticks;
+
+  /***************************************************************************/
+  /* Times the last change to the location is still to be piggybacked, and */
+  /* whether the next message to it must carry all members we know of.   */
+  /***************************************************************************/
+  uint32_t gossip_sends_left;
+  uint32_t gossip_full_sync;
 } HM_LOCATION_CB ;
 /**STRUCT-********************************************************************/
 
@@ -700,6 +1112,38 @@ typedef struct hm_node_cb {
   /***************************************************************************/
   uint32_t keepalive_missed;
 
+  /***************************************************************************/
+  /* Arrivals of its keepalives, to tell how suspect it is           */
+  /***************************************************************************/
+  HM_PHI_DETECTOR liveness;
+
+  /***************************************************************************/
+  /* Capabilities agreed with the node in INIT (HM_NODE_CAP_*)        */
+  /***************************************************************************/
+  uint32_t capabilities;
+
+  /***************************************************************************/
+  /* Version of the parent location's tables at the last change of this node */
+  /***************************************************************************/
+  uint32_t version;
+
+  /***************************************************************************/
+  /* Hybrid logical clock of the parent location at the last change     */
+  /***************************************************************************/
+  uint64_t hlc;
+
+  /***************************************************************************/
+  /* Status last reported by the owning peer (#HM_PEER_ENTITY_STATUS_ACTIVE  */
+  /* or #HM_PEER_ENTITY_STATUS_INACTIVE). Only for remote nodes.       */
+  /***************************************************************************/
+  uint32_t reported_status;
+
+  /***************************************************************************/
+  /* Anti-entropy digest of the node alone, and of it and its processes      */
+  /***************************************************************************/
+  uint32_t digest_leaf;
+  uint32_t digest;
+
 } HM_NODE_CB ;
 /**STRUCT-********************************************************************/
 
@@ -772,6 +1216,27 @@ typedef struct hm_process_cb
   /***************************************************************************/
   uint32_t running;
 
+  /***************************************************************************/
+  /* Version of the parent location's tables at the last change of process.  */
+  /* A process that stopped keeps its entry, which serves as its tombstone. */
+  /***************************************************************************/
+  uint32_t version;
+
+  /***************************************************************************/
+  /* Hybrid logical clock of the parent location at the last change     */
+  /***************************************************************************/
+  uint64_t hlc;
+
+  /***************************************************************************/
+  /* Status last reported by the owning peer. Only for remote processes.   */
+  /***************************************************************************/
+  uint32_t reported_status;
+
+  /***************************************************************************/
+  /* Share of the process in the digest of its node               */
+  /***************************************************************************/
+  uint32_t digest;
+
 } HM_PROCESS_CB ;
 /**STRUCT-********************************************************************/
 
@@ -815,6 +1280,29 @@ typedef struct hm_interface_cb
 } HM_INTERFACE_CB ;
 /**STRUCT-********************************************************************/
 
+/**
+ * @brief Changes to a Global Table row waiting for the end of the pass
+ *
+ * Kept on the row, so that a change queued again in the same pass is merged
+ * without searching the queues.
+ */
+typedef struct hm_global_pending
+{
+  /***************************************************************************/
+  /* Block of the row on LOCAL.pending_updates, if queued           */
+  /***************************************************************************/
+  HM_LIST_BLOCK *update;
+
+  /***************************************************************************/
+  /* Notification about the row waiting in each class, if any. Only ones  */
+  /* that may be merged are kept here.                       */
+  /***************************************************************************/
+  struct hm_notification_cb *notify[HM_NUM_PRIORITIES];
+
+} HM_GLOBAL_PENDING ;
+/**STRUCT-********************************************************************/
+
+
 /**
  * @brief Global Location Control Block
  *
@@ -862,6 +1350,11 @@ typedef struct hm_global_location_cb
   /***************************************************************************/
   struct hm_subscription_cb *sub_cb;
 
+  /***************************************************************************/
+  /* Changes waiting for the end of this pass                  */
+  /***************************************************************************/
+  HM_GLOBAL_PENDING pending;
+
 } HM_GLOBAL_LOCATION_CB ;
 /**STRUCT-********************************************************************/
 
@@ -921,6 +1414,18 @@ typedef struct hm_global_node_cb
   /***************************************************************************/
   struct hm_subscription_cb *sub_cb;
 
+  /***************************************************************************/
+  /* Address information sent in notifications about this node. Computed   */
+  /* when the node becomes active (i.e. on a new transport).          */
+  /***************************************************************************/
+  HM_ADDRESS_INFO addr_info;
+  uint32_t addr_info_valid;
+
+  /***************************************************************************/
+  /* Changes waiting for the end of this pass                  */
+  /***************************************************************************/
+  HM_GLOBAL_PENDING pending;
+
 } HM_GLOBAL_NODE_CB ;
 /**STRUCT-********************************************************************/
 
@@ -981,6 +1486,11 @@ typedef struct hm_global_process_cb
   /***************************************************************************/
   struct hm_subscription_cb *sub_cb;
 
+  /***************************************************************************/
+  /* Changes waiting for the end of this pass                  */
+  /***************************************************************************/
+  HM_GLOBAL_PENDING pending;
+
 } HM_GLOBAL_PROCESS_CB ;
 /**STRUCT-********************************************************************/
 
@@ -1097,6 +1607,59 @@ typedef struct hm_subscription_cb
 /**STRUCT-********************************************************************/
 
 
+/**
+ * @brief Subscription Filter
+ *
+ * Compiled form of the filters a subscriber registered with. Every mask is a
+ * bitmap with one bit per value; an empty mask matches everything.
+ */
+typedef struct hm_subs_filter
+{
+  /***************************************************************************/
+  /* Notification types (HM_NOTIFICATION_*) of interest             */
+  /***************************************************************************/
+  uint32_t event_mask;
+
+  /***************************************************************************/
+  /* Location indices of interest                         */
+  /***************************************************************************/
+  uint32_t location_mask;
+
+  /***************************************************************************/
+  /* Process types of interest                           */
+  /***************************************************************************/
+  uint32_t proc_type_mask;
+
+  /***************************************************************************/
+  /* Only entities on nodes with an HA role                     */
+  /***************************************************************************/
+  uint32_t role_only;
+
+} HM_SUBS_FILTER ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Subscriber State
+ *
+ * Per subscriber state kept alongside each member of a subscribers list.
+ */
+typedef struct hm_subscriber_state
+{
+  /***************************************************************************/
+  /* ID of the last notification serviced for this subscriber. Must be first.*/
+  /***************************************************************************/
+  uint32_t processed;
+
+  /***************************************************************************/
+  /* Notifications this subscriber is interested in               */
+  /***************************************************************************/
+  HM_SUBS_FILTER filter;
+
+} HM_SUBSCRIBER_STATE ;
+/**STRUCT-********************************************************************/
+
+
 /**
  * @brief Wild Card Subscriber
  *
@@ -1129,6 +1692,11 @@ typedef struct hm_subscriber_wildcard
   /***************************************************************************/
   HM_SUBSCRIBER subscriber;
 
+  /***************************************************************************/
+  /* Filter applied to each subscription made through this wildcard      */
+  /***************************************************************************/
+  HM_SUBS_FILTER filter;
+
 } HM_SUBSCRIBER_WILDCARD ;
 /**STRUCT-********************************************************************/
 
@@ -1263,9 +1831,43 @@ typedef struct hm_heartbeat_config {
   uint32_t resolution;
   uint32_t timer_val;
   uint32_t threshold;
+  uint32_t phi_threshold;
+  uint32_t liveness;
+  uint32_t thread;   /* Cluster Ticks on a thread of their own */
+  int32_t priority;  /* SCHED_FIFO priority of that thread. 0 if none */
+  int32_t cpu;       /* CPU it is pinned to. -1 if none */
 } HM_HEARTBEAT_CONFIG ;
 /**STRUCT-********************************************************************/
 
+/**
+ * @brief Subscriber Queue Configuration Structure
+ *
+ */
+typedef struct hm_subs_queue_config {
+  uint32_t policy;
+  uint32_t max_msgs;
+  uint32_t max_bytes;
+  uint32_t max_overflows;
+} HM_SUBS_QUEUE_CONFIG ;
+/**STRUCT-********************************************************************/
+
+/**
+ * @brief Full replay of our tables, serialized once and sent to every peer
+ * that needs one till it goes stale.
+ *
+ * Messages are reference counted buffers, so a snapshot replaced while peers
+ * still hold its messages in their windows does not pull them away.
+ */
+typedef struct hm_replay_snapshot {
+  HM_LQE msgs; /* Blocks of the Replay messages (#HM_MSG), in order */
+  uint32_t num_msgs;
+  uint32_t version; /* Version of our tables it was taken at */
+  uint32_t frame_size; /* Frame size its messages were packed for */
+  uint32_t valid;
+  uint32_t generation; /* Bumped every time it is dropped */
+} HM_REPLAY_SNAPSHOT ;
+/**STRUCT-********************************************************************/
+
 /**
  * @brief HM Configuration Control Block
  *
@@ -1284,6 +1886,36 @@ typedef struct hm_config_cb
     /***************************************************************************/
     HM_HEARTBEAT_CONFIG node, cluster, ha_role;
 
+    /***************************************************************************/
+    /* Bounds and overflow policy of per-subscriber outgoing queues            */
+    /***************************************************************************/
+    HM_SUBS_QUEUE_CONFIG subs_queue;
+
+    /***************************************************************************/
+    /* Largest message packed for a peer HM, in bytes                          */
+    /***************************************************************************/
+    uint32_t peer_frame_size;
+
+    /***************************************************************************/
+    /* Replay messages sent to a peer per turn of the main loop, and bytes per */
+    /* second a replay may send (0: no cap)                   */
+    /***************************************************************************/
+    uint32_t replay_chunks;
+    uint32_t replay_rate;
+
+    /***************************************************************************/
+    /* Membership mode (HM_MEMBERSHIP_*) and members probed on our behalf     */
+    /***************************************************************************/
+    uint32_t membership;
+    uint32_t gossip_fanout;
+
+    /***************************************************************************/
+    /* Role in an aggregated cluster (HM_AGGREGATION_ROLE_*), and the index of */
+    /* the aggregator of a leaf                                              */
+    /***************************************************************************/
+    uint32_t aggregation_role;
+    uint32_t aggregator;
+
     /***************************************************************************/
     /* Information on local TCP/UDP/Multicast Transports             */
     /***************************************************************************/
@@ -1293,6 +1925,10 @@ typedef struct hm_config_cb
 
     uint32_t mcast_group;
     /***************************************************************************/
+    /* Multicast addresses after the first: further heartbeat paths       */
+    /***************************************************************************/
+    HM_LQE heartbeat_paths;
+    /***************************************************************************/
     /* List of address CBs                              */
     /***************************************************************************/
     HM_LQE addresses;
@@ -1322,6 +1958,128 @@ typedef struct attribute_map {
 } HM_ATTRIBUTE_MAP;
 
 
+/**
+ * @brief Heartbeat Path
+ *
+ * One multicast address our Keepalives are sent to and heard on. With more
+ * than one, each is pinned to the interface of its address, so that a peer
+ * is lost only when it is silent on all of them.
+ */
+typedef struct hm_heartbeat_path
+{
+  /***************************************************************************/
+  /* Node in list of paths                             */
+  /***************************************************************************/
+  HM_LQE node;
+
+  /***************************************************************************/
+  /* Position among paths. Path 0 is the multicast address of old.      */
+  /***************************************************************************/
+  uint32_t id;
+
+  /***************************************************************************/
+  /* Socket that joins the group, and the group address Ticks are sent to  */
+  /***************************************************************************/
+  HM_TRANSPORT_CB *listen_cb;
+  HM_TRANSPORT_CB *send_cb;
+} HM_HEARTBEAT_PATH ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Liveness of a peer, as judged by the heartbeat thread
+ */
+typedef struct hm_heartbeat_peer
+{
+  HM_LQE node;
+  uint32_t loc_id;
+  HM_PHI_DETECTOR liveness;
+  uint32_t missed;          /* Periods without a Tick, less Ticks since */
+  HM_PATH_HEALTH paths;     /* The only record of paths while the thread runs */
+  uint64_t last_sent_ns;    /* Send stamp of the last Tick, to drop copies */
+  uint32_t down;            /* Reported down, and not heard since */
+} HM_HEARTBEAT_PEER ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Event posted by the heartbeat thread to the main loop
+ */
+typedef struct hm_heartbeat_event
+{
+  HM_LQE node;
+  uint32_t type;            /* HM_HEARTBEAT_EVENT_* */
+  uint32_t loc_id;
+  uint32_t path_id;         /* Path a Tick came by */
+  HM_SOCKADDR_UNION sender; /* Who sent the Tick */
+  uint32_t len;             /* Bytes of the Tick that follow */
+  uint8_t data[1];
+} HM_HEARTBEAT_EVENT ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Heartbeat Thread
+ *
+ * Sends the Ticks the main loop last built, hears those of peers on the
+ * heartbeat paths and judges their liveness, so that none of it waits on
+ * the main loop. Ticks heard, and peers found dead, are posted to the main
+ * loop, woken by a byte on a pipe. The main loop stops it by a byte on
+ * another.
+ */
+typedef struct hm_heartbeat_thread
+{
+  /***************************************************************************/
+  /* Configuration                               */
+  /***************************************************************************/
+  uint32_t enabled;
+  int32_t priority;
+  int32_t cpu;
+
+  /***************************************************************************/
+  /* The thread, the pipe it wakes the main loop by, and the pipe it is   */
+  /* told to stop by                                                      */
+  /***************************************************************************/
+  pthread_t thread;
+  int32_t wake_fd[2];
+  int32_t stop_fd[2];
+
+  /***************************************************************************/
+  /* Guards running, the events and the Tick below. Only the main loop     */
+  /* sets running, so it may read it without the lock.                     */
+  /***************************************************************************/
+  pthread_mutex_t lock;
+  uint32_t running;
+  HM_LQE events;
+
+  /***************************************************************************/
+  /* Tick last built by the main loop, and when (monotonic, in ns)     */
+  /***************************************************************************/
+  uint8_t *tick;
+  uint32_t tick_len;
+  uint64_t tick_built_ns;
+
+  /***************************************************************************/
+  /* Owned by the thread: peers heard (#HM_HEARTBEAT_PEER)          */
+  /***************************************************************************/
+  HM_LQE peers;
+} HM_HEARTBEAT_THREAD ;
+/**STRUCT-********************************************************************/
+
+
+/**
+ * @brief Recently heard Keepalive
+ *
+ * Identifies a Tick by its sender and the send stamp it carries.
+ */
+typedef struct hm_recent_tick
+{
+  uint32_t loc_id;
+  uint64_t sent_ns;
+} HM_RECENT_TICK ;
+/**STRUCT-********************************************************************/
+
+
 /**
  * @brief Hardware Manager Global Data
  *
@@ -1382,9 +2140,15 @@ typedef struct hm_global_data
   HM_LQE table_root_subscribers;
 
   /***************************************************************************/
-  /* Queue of Notifications that need to be sent                 */
+  /* Queue of Notifications that need to be sent, one per priority class  */
   /***************************************************************************/
-  HM_LQE notification_queue;
+  HM_LQE notification_queue[HM_NUM_PRIORITIES];
+
+  /***************************************************************************/
+  /* Global rows changed in this pass of the main loop, whose update is yet */
+  /* to be sent to the cluster. One entry per row.               */
+  /***************************************************************************/
+  HM_LQE pending_updates;
 
   /***************************************************************************/
   /* Local Location is represented as a static structure.             */
@@ -1400,6 +2164,45 @@ typedef struct hm_global_data
   uint32_t peer_keepalive_period; /* Configured/Default Keepalive period in ms */
   uint32_t peer_kickout_value;  /* After how many ticks to declare node down */
 
+  uint32_t node_phi_threshold; /* Suspicion at which a node is down. 0: Use kickout */
+  uint32_t peer_phi_threshold; /* Suspicion at which a peer is down. 0: Use kickout */
+  uint32_t node_liveness;      /* Node liveness by keepalives or kernel (HM_LIVENESS_*) */
+
+  HM_SUBS_QUEUE_CONFIG subs_queue; /* Bounds on a subscriber's pending queue */
+
+  uint32_t peer_frame_size; /* Largest message packed for a peer, in bytes */
+
+  uint32_t peer_tick_count; /* Keepalive ticks sent on cluster so far */
+  uint64_t hlc; /* Hybrid logical clock of this HM. See hm_hlc_now() */
+  HM_REPLAY_SNAPSHOT replay_snapshot; /* Full replay shared by joining peers */
+  HM_LQE replays; /* Replays under way (#HM_REPLAY_CURSOR) */
+  uint32_t replay_chunks; /* Replay messages per peer per turn of the main loop */
+  uint32_t replay_rate; /* Bytes per second a replay may send. 0: no cap */
+  uint32_t digest_ticks_left; /* Ticks till we compare digests with peers */
+
+  /***************************************************************************/
+  /* Membership (HM_MEMBERSHIP_*) and its gossip state                       */
+  /***************************************************************************/
+  uint32_t membership;
+  uint32_t gossip_fanout; /* Members asked to probe when a probe goes unanswered */
+
+  HM_LQE gossip_members; /* Blocks of Location CBs of the other members */
+  uint32_t num_gossip_members;
+  HM_LIST_BLOCK *gossip_next; /* Member to probe next. NULL: Start of list */
+
+  HM_LQE gossip_seeds; /* Blocks of transports to configured remote addresses */
+
+  HM_LOCATION_CB *probe_target; /* Member being probed. NULL if none */
+  uint32_t probe_id;
+  uint32_t probe_stage; /* HM_GOSSIP_PROBE_* */
+  uint32_t probe_rounds; /* Rounds so far, to pick out dead member rounds */
+
+  /***************************************************************************/
+  /* Role in an aggregated cluster (HM_AGGREGATION_ROLE_*)                   */
+  /***************************************************************************/
+  uint32_t aggregation_role;
+  uint32_t aggregator; /* Index of the aggregator of a leaf. 0 otherwise */
+
   /***************************************************************************/
   /* User Configuration Data                           */
   /***************************************************************************/
@@ -1420,6 +2223,24 @@ typedef struct hm_global_data
   /***************************************************************************/
   HM_TRANSPORT_CB *mcast_addr;
 
+  /***************************************************************************/
+  /* Heartbeat paths (#HM_HEARTBEAT_PATH), the first of which is mcast_addr */
+  /* and the peer broadcast transport of the local location          */
+  /***************************************************************************/
+  HM_LQE heartbeat_paths;
+  uint32_t num_heartbeat_paths;
+
+  /***************************************************************************/
+  /* Ring of Ticks heard lately, to ignore copies from the other paths     */
+  /***************************************************************************/
+  HM_RECENT_TICK recent_ticks[HM_RECENT_TICKS];
+  uint32_t next_recent_tick;
+
+  /***************************************************************************/
+  /* Thread that sends, hears and judges Ticks, if configured        */
+  /***************************************************************************/
+  HM_HEARTBEAT_THREAD heartbeat;
+
   /***************************************************************************/
   /* Next Notification ID                                                    */
   /* TODO: Wrap-around condition is not taken care of for now.               */
@@ -259,6 +259,8 @@ HM_SOCKET_CB *hm_tprt_open_connection(uint32_t conn_type, void *params)
 
   struct addrinfo hints, *res, *ressave;
   HM_SOCKADDR_UNION *mcast_cast = NULL, *addr = NULL;
+  HM_HEARTBEAT_PATH *path = NULL;
+  HM_TRANSPORT_CB *send_cb = NULL;
 
   TRACE_ENTRY();
 
@@ -617,6 +619,20 @@ HM_SOCKET_CB *hm_tprt_open_connection(uint32_t conn_type, void *params)
       inet_pton(res->ai_family, mcast_addr, &mreq.imr_multiaddr.s_addr);
       mreq.imr_interface.s_addr = htonl(INADDR_ANY);
 
+      /***************************************************************************/
+      /* With several heartbeat paths, each must stay on its own interface:     */
+      /* that of its address.                            */
+      /***************************************************************************/
+      if (LOCAL.num_heartbeat_paths > 1)
+      {
+        mreq.imr_interface = ((SOCKADDR_IN *)&address->address)->sin_addr;
+        if (setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_IF, &mreq.imr_interface,
+                       sizeof(mreq.imr_interface)) == -1)
+        {
+          TRACE_PERROR(("Error setting interface of Multicast socket"));
+        }
+      }
+
       if (setsockopt(sock_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
                      sizeof(mreq)) == -1)
       {
@@ -630,14 +646,26 @@ HM_SOCKET_CB *hm_tprt_open_connection(uint32_t conn_type, void *params)
       TRACE_INFO(("Joined Multicast Group %d.", address->mcast_group));
       TRACE_INFO(("Update Global Multicast Address Destination"));
       /***************************************************************************/
-      /* Also update the Multicast sending address in LOCAL             */
+      /* Also update the Multicast sending address of the heartbeat path this   */
+      /* socket is for.                                 */
       /* This is a quickfix.                             */
       /* FIXME                                      */
       /***************************************************************************/
-      TRACE_ASSERT(LOCAL.mcast_addr != NULL);
-      LOCAL.mcast_addr->address.mcast_group = address->mcast_group;
+      send_cb = LOCAL.mcast_addr;
+      for (path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(LOCAL.heartbeat_paths);
+           path != NULL;
+           path = (HM_HEARTBEAT_PATH *)HM_NEXT_IN_LIST(path->node))
+      {
+        if (&path->listen_cb->address == address)
+        {
+          send_cb = path->send_cb;
+          break;
+        }
+      }
+      TRACE_ASSERT(send_cb != NULL);
+      send_cb->address.mcast_group = address->mcast_group;
       //IPv4 Specific
-      mcast_cast = (HM_SOCKADDR_UNION *)&LOCAL.mcast_addr->address.address;
+      mcast_cast = (HM_SOCKADDR_UNION *)&send_cb->address.address;
       inet_pton(res->ai_family, mcast_addr,
                 ((SOCKADDR_IN *)&mcast_cast->in_addr.sin_addr));
       mcast_cast->in_addr.sin_port = ((SOCKADDR_IN *)res->ai_addr)->sin_port;
@@ -669,8 +697,8 @@ HM_SOCKET_CB *hm_tprt_open_connection(uint32_t conn_type, void *params)
           TRACE_PERROR(("Error setting loopback option on Multicast socket"));
         }
       }
-      LOCAL.mcast_addr->sock_cb = sock_cb;
-      LOCAL.mcast_addr->location_cb = &LOCAL.local_location_cb;
+      send_cb->sock_cb = sock_cb;
+      send_cb->location_cb = &LOCAL.local_location_cb;
 
       break;
 
@@ -871,6 +899,239 @@ int32_t hm_tprt_send_on_socket(struct sockaddr *ip, int32_t sock_fd,
 } /* hm_tprt_send_on_socket */
 
 
+/**
+ *  @brief Writes as much of a buffer as a stream socket takes without blocking
+ *
+ *  Unlike hm_tprt_send_on_socket(), this does not loop on a full socket buffer.
+ *  The caller keeps the unsent remainder and retries once the socket is writable.
+ *
+ *  @param sock_fd  Socket descriptor to write on
+ *  @param *msg_buffer A byte buffer to be sent
+ *  @param length   Length of data to be sent from @p msg_buffer
+ *
+ *  @return Number of bytes written (may be 0), or #HM_ERR if the socket failed
+ */
+int32_t hm_tprt_write_on_socket(int32_t sock_fd, BYTE *msg_buffer, uint32_t length)
+{
+  /***************************************************************************/
+  /* Local variables                               */
+  /***************************************************************************/
+  int32_t bytes_sent = 0;
+  int32_t os_error;
+
+  TRACE_ENTRY();
+
+  TRACE_DETAIL(("Attempt to write %d bytes of data on socket %d",
+                length, sock_fd));
+
+  do
+  {
+    bytes_sent = send(sock_fd, msg_buffer, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    os_error = (bytes_sent == -1) ? errno : 0;
+  }
+  while (os_error == EINTR);
+
+  if (bytes_sent == -1)
+  {
+    if ((os_error == EWOULDBLOCK) ||
+        (os_error == EAGAIN) ||
+        (os_error == ENOMEM) ||
+        (os_error == ENOSR))
+    {
+      /*********************************************************************/
+      /* Flow control condition. Nothing was written this time.         */
+      /*********************************************************************/
+      TRACE_DETAIL(("Socket %d is full - try later", sock_fd));
+      bytes_sent = 0;
+    }
+    else
+    {
+      TRACE_PERROR(("Send failed on socket %d.", sock_fd));
+      bytes_sent = HM_ERR;
+    }
+  }
+
+  TRACE_EXIT();
+  return (bytes_sent);
+} /* hm_tprt_write_on_socket */
+
+
+/**
+ *  @brief Sends a message with a shared body in one go, from an offset
+ *
+ *  The message's own bytes and the rest of its body (#HM_MSG) are gathered
+ *  into one datagram, or one write on a stream, without copying them
+ *  together. On a stream, it never waits: what the socket does not take is
+ *  left for the caller to resume from.
+ *
+ *  @param *ip Destination of a datagram. Unused on a stream.
+ *  @param sock_fd Socket Descriptor on which to send data
+ *  @param sock_type Type of socket to determine sending mechanism
+ *  @param *msg Message (#HM_MSG) with a body
+ *  @param offset Bytes of it already written
+ *
+ *  @return Bytes written, 0 if the socket is full, #HM_ERR on error
+ */
+int32_t hm_tprt_send_parts(struct sockaddr *ip, int32_t sock_fd,
+                           uint32_t sock_type, HM_MSG *msg, uint32_t offset)
+{
+  /***************************************************************************/
+  /* Local variables                               */
+  /***************************************************************************/
+  struct msghdr hdr;
+  struct iovec iov[2];
+  int32_t bytes_sent = 0;
+  int32_t os_error;
+
+  TRACE_ENTRY();
+
+  TRACE_ASSERT(msg != NULL);
+  TRACE_ASSERT(msg->body != NULL);
+  TRACE_ASSERT(msg->msg_len <= msg->body->msg_len);
+
+  TRACE_DETAIL(("Attempt to send %d bytes of data on socket %d",
+                HM_MSG_WIRE_LEN(msg) - offset, sock_fd));
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.msg_iov = iov;
+  if (offset < msg->msg_len)
+  {
+    iov[hdr.msg_iovlen].iov_base = (char *)msg->msg + offset;
+    iov[hdr.msg_iovlen].iov_len = msg->msg_len - offset;
+    hdr.msg_iovlen++;
+    offset = msg->msg_len;
+  }
+  iov[hdr.msg_iovlen].iov_base = (char *)msg->body->msg + offset;
+  iov[hdr.msg_iovlen].iov_len = msg->body->msg_len - offset;
+  hdr.msg_iovlen++;
+
+  if ((sock_type != HM_TRANSPORT_TCP_IN) && (sock_type != HM_TRANSPORT_TCP_OUT))
+  {
+    hdr.msg_name = ip;
+    hdr.msg_namelen = sizeof(struct sockaddr);
+  }
+
+  do
+  {
+    bytes_sent = sendmsg(sock_fd, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL);
+    os_error = (bytes_sent == -1) ? errno : 0;
+  }
+  while (os_error == EINTR);
+
+  if (bytes_sent == -1)
+  {
+    if (((sock_type == HM_TRANSPORT_TCP_IN) ||
+         (sock_type == HM_TRANSPORT_TCP_OUT)) &&
+        ((os_error == EWOULDBLOCK) || (os_error == EAGAIN) ||
+         (os_error == ENOMEM) || (os_error == ENOSR)))
+    {
+      TRACE_DETAIL(("Socket %d is full - try later", sock_fd));
+      bytes_sent = 0;
+    }
+    else
+    {
+      TRACE_PERROR(("Send failed on socket %d.", sock_fd));
+      bytes_sent = HM_ERR;
+    }
+  }
+
+  TRACE_EXIT();
+  return (bytes_sent);
+} /* hm_tprt_send_parts */
+
+
+/**
+ *  @brief Lets the kernel find out when the other end of a connection is gone
+ *
+ *  An idle connection is probed every @p period, and given up after
+ *  @p count probes go unanswered. Data that stays unacknowledged as long
+ *  also fails the connection. Either way, the socket reports an error and the
+ *  connection is handled as closed.
+ *
+ *  @param sock_fd Socket descriptor of a TCP connection
+ *  @param period Probe period (ms). The kernel takes it in whole seconds.
+ *  @param count Unanswered probes after which the other end is gone
+ *
+ *  @return #HM_OK if the kernel will watch the connection, #HM_ERR otherwise
+ */
+int32_t hm_tprt_set_kernel_liveness(int32_t sock_fd, uint32_t period,
+                                    uint32_t count)
+{
+  /***************************************************************************/
+  /* Local variables                               */
+  /***************************************************************************/
+  int32_t ret_val = HM_OK;
+  int32_t option_val = 1;
+  int32_t seconds;
+#ifdef TCP_USER_TIMEOUT
+  uint32_t timeout;
+#endif
+
+  TRACE_ENTRY();
+
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  seconds = (period + 999) / 1000;
+  if (seconds == 0)
+  {
+    seconds = 1;
+  }
+  if (count == 0)
+  {
+    count = 1;
+  }
+
+  if (setsockopt(sock_fd, SOL_SOCKET, SO_KEEPALIVE,
+                 &option_val, sizeof(option_val)) == -1)
+  {
+    TRACE_PERROR(("Error Setting SO_KEEPALIVE"));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+  option_val = (int32_t)count;
+  if ((setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPIDLE,
+                  &seconds, sizeof(seconds)) == -1) ||
+      (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPINTVL,
+                  &seconds, sizeof(seconds)) == -1) ||
+      (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPCNT,
+                  &option_val, sizeof(option_val)) == -1))
+  {
+    TRACE_PERROR(("Error Setting TCP Keepalive timing"));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+
+#ifdef TCP_USER_TIMEOUT
+  timeout = seconds * 1000 * (count + 1);
+  if (setsockopt(sock_fd, IPPROTO_TCP, TCP_USER_TIMEOUT,
+                 &timeout, sizeof(timeout)) == -1)
+  {
+    TRACE_PERROR(("Error Setting TCP_USER_TIMEOUT"));
+    ret_val = HM_ERR;
+    goto EXIT_LABEL;
+  }
+#endif
+
+  TRACE_DETAIL(("Socket %d probed every %d s, down after %d probes",
+                sock_fd, seconds, count));
+
+EXIT_LABEL:
+  if (ret_val != HM_OK)
+  {
+    /***************************************************************************/
+    /* Keepalives from the node are needed after all.            */
+    /***************************************************************************/
+    option_val = 0;
+    setsockopt(sock_fd, SOL_SOCKET, SO_KEEPALIVE, &option_val,
+               sizeof(option_val));
+  }
+  TRACE_EXIT();
+  return (ret_val);
+} /* hm_tprt_set_kernel_liveness */
+
+
 /**
  *  @brief Receives data from socket
  *
@@ -1091,9 +1352,9 @@ int32_t hm_tprt_close_connection(HM_TRANSPORT_CB *tprt_cb)
   /* Variable Declarations                           */
   /***************************************************************************/
   int32_t ret_val = HM_OK;
-  HM_MSG *msg = NULL;
 
   HM_LIST_BLOCK *block = NULL;
+  uint32_t priority;
   /***************************************************************************/
   /* Sanity Checks                               */
   /***************************************************************************/
@@ -1109,21 +1370,26 @@ int32_t hm_tprt_close_connection(HM_TRANSPORT_CB *tprt_cb)
   /* Empty the outgoing buffers queue. Don't try to send them, just drop.     */
   /***************************************************************************/
   TRACE_DETAIL(("Emptying pending queue."));
+  TRACE_INFO(("Outgoing queue: %d messages pending. Peak %d, Overflows %d, "
+              "Dropped %d, Collapsed %d", tprt_cb->stats.num_pending,
+              tprt_cb->stats.high_watermark, tprt_cb->stats.overflows,
+              tprt_cb->stats.dropped, tprt_cb->stats.collapsed));
 
-  for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending);
-       block != NULL;
-       block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending))
+  for (priority = 0; priority < HM_NUM_PRIORITIES; priority++)
   {
-    msg = (HM_MSG *)block->target;
-    /***************************************************************************/
-    /* Remove from list.                             */
-    /***************************************************************************/
-    HM_REMOVE_FROM_LIST(block->node);
-    TRACE_DETAIL(("Freeing Message!"));
-    hm_free_buffer(msg);
-    free(block);
-    block = NULL;
+    for (block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[priority]);
+         block != NULL;
+         block = (HM_LIST_BLOCK *)HM_NEXT_IN_LIST(tprt_cb->pending[priority]))
+    {
+      /***************************************************************************/
+      /* Remove from list.                             */
+      /***************************************************************************/
+      TRACE_DETAIL(("Freeing Message!"));
+      hm_tprt_remove_pending(tprt_cb, block);
+      block = NULL;
+    }
   }
+  tprt_cb->stats.consecutive_overflows = 0;
 
   if (tprt_cb->in_buffer != NULL)
   {
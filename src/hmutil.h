@@ -27,6 +27,12 @@
 
 #define GET_TABLE_TYPE(row_cb)  (*(uint32_t *)((char *)row_cb + sizeof(uint32_t)))
 
+/***************************************************************************/
+/* Bytes a message (#HM_MSG) puts on the wire, its shared body included    */
+/***************************************************************************/
+#define HM_MSG_WIRE_LEN(msg)  (((msg)->body != NULL) ? (msg)->body->msg_len :  \
+                                                       (msg)->msg_len)
+
 /***************************************************************************/
 /* To address to Memory Addresses                       */
 /***************************************************************************/
@@ -110,6 +110,55 @@ int64_t hm_ntoh64(int64_t num)
 }/* hm_hton64 */
 
 
+/**
+ *  @brief Writes a 64 bit number into a message in network byte order
+ *
+ *  @param *into 8 bytes of the message to write into
+ *  @param num Number to write
+ *  @return @c void
+ */
+void hm_put_64(uint8_t *into, uint64_t num)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  int32_t i;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (i = 7; i >= 0; i--)
+  {
+    into[i] = (uint8_t)(num & 0xFF);
+    num >>= 8;
+  }
+}/* hm_put_64 */
+
+
+/**
+ *  @brief Reads a 64 bit number out of a message in network byte order
+ *
+ *  @param *from 8 bytes of the message holding it
+ *  @return Number in host order
+ */
+uint64_t hm_get_64(uint8_t *from)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint64_t num = 0;
+  int32_t i;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  for (i = 0; i < 8; i++)
+  {
+    num = (num << 8) | from[i];
+  }
+
+  return (num);
+}/* hm_get_64 */
+
+
 /***************************************************************************/
 /* Timer Related Functions                           */
 /***************************************************************************/
@@ -1096,6 +1145,10 @@ int32_t hm_free_buffer(HM_MSG *msg)
   if (--msg->ref_count == 0)
   {
     TRACE_DETAIL(("Freeing Buffer"));
+    if (msg->body != NULL)
+    {
+      hm_free_buffer(msg->body);
+    }
     free(msg);
   }
 
@@ -1105,3 +1158,392 @@ int32_t hm_free_buffer(HM_MSG *msg)
   TRACE_EXIT();
   return ret_val;
 }/* hm_free_buffer */
+
+
+/***************************************************************************/
+/* Phi Accrual Failure Detection                        */
+/***************************************************************************/
+/**
+ *  @brief Current time on a clock that never steps back, in ms
+ *
+ *  @param None
+ *  @return Milliseconds since an arbitrary point
+ */
+uint64_t hm_time_ms()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  struct timespec now;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000);
+}/* hm_time_ms */
+
+
+/**
+ *  @brief Current time on a clock that never steps back, in ns
+ *
+ *  @param None
+ *  @return Nanoseconds since an arbitrary point
+ */
+uint64_t hm_time_ns()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  struct timespec now;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000) + (uint64_t)now.tv_nsec;
+}/* hm_time_ns */
+
+
+/**
+ *  @brief Current wall clock time, in ns
+ *
+ *  @param None
+ *  @return Nanoseconds since the Epoch
+ */
+uint64_t hm_wall_time_ns()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  struct timespec now;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  clock_gettime(CLOCK_REALTIME, &now);
+  return ((uint64_t)now.tv_sec * 1000000000) + (uint64_t)now.tv_nsec;
+}/* hm_wall_time_ns */
+
+
+/**
+ *  @brief Forgets all arrivals seen by a detector
+ *
+ *  @param *detector Detector (#HM_PHI_DETECTOR) to reset
+ *  @return void
+ */
+void hm_phi_init(HM_PHI_DETECTOR *detector)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ASSERT(detector != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  memset(detector, 0, sizeof(HM_PHI_DETECTOR));
+}/* hm_phi_init */
+
+
+/**
+ *  @brief Records the arrival of a keepalive
+ *
+ *  A sender that takes its other messages for keepalives holds them back
+ *  while it is busy. If it was heard from since its last keepalive, the
+ *  interval is not a gap between keepalives, and is taken as no longer than
+ *  the keepalive period.
+ *
+ *  @param *detector Detector (#HM_PHI_DETECTOR) of the sender
+ *  @param period Keepalive period of the sender in ms
+ *  @return void
+ */
+void hm_phi_heartbeat(HM_PHI_DETECTOR *detector, uint32_t period)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint64_t now = hm_time_ms();
+  uint64_t old;
+  uint32_t interval;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(detector != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (detector->last_keepalive != 0)
+  {
+    interval = (uint32_t)(now - detector->last_keepalive);
+    if ((detector->last_heard > detector->last_keepalive) && (interval > period))
+    {
+      interval = period;
+    }
+    if (detector->num_intervals == HM_PHI_WINDOW_SIZE)
+    {
+      /***************************************************************************/
+      /* Window is full. The oldest interval makes way.             */
+      /***************************************************************************/
+      old = detector->intervals[detector->next_interval];
+      detector->sum -= old;
+      detector->sum_squares -= old * old;
+    }
+    else
+    {
+      detector->num_intervals++;
+    }
+    detector->intervals[detector->next_interval] = interval;
+    detector->next_interval = (detector->next_interval + 1) % HM_PHI_WINDOW_SIZE;
+    detector->sum += interval;
+    detector->sum_squares += (uint64_t)interval * interval;
+  }
+  detector->last_keepalive = now;
+  detector->last_heard = now;
+
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+}/* hm_phi_heartbeat */
+
+
+/**
+ *  @brief Records that the sender was heard from, other than by a keepalive
+ *
+ *  It restarts the wait phi is reckoned over, but leaves alone the last
+ *  keepalive, from which the next interval is sampled.
+ *
+ *  @param *detector Detector (#HM_PHI_DETECTOR) of the sender
+ *  @return void
+ */
+void hm_phi_touch(HM_PHI_DETECTOR *detector)
+{
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ASSERT(detector != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  detector->last_heard = hm_time_ms();
+}/* hm_phi_touch */
+
+
+/**
+ *  @brief Suspicion that the sender is down, given how long it has been quiet
+ *
+ *  Phi is -log10 of the chance that a keepalive arrives this late, the
+ *  intervals being taken as normally distributed. A phi of 1 means about a
+ *  10% chance of being wrong in calling the sender down; 3 means 0.1%.
+ *
+ *  @param *detector Detector (#HM_PHI_DETECTOR) of the sender
+ *  @return Phi, or a negative value if too few keepalives have arrived to say
+ */
+double hm_phi(HM_PHI_DETECTOR *detector)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  double phi = -1.0;
+  double mean, variance, std_dev;
+  double elapsed, y, e;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  TRACE_ASSERT(detector != NULL);
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (detector->num_intervals < HM_PHI_MIN_SAMPLES)
+  {
+    goto EXIT_LABEL;
+  }
+
+  mean = (double)detector->sum / detector->num_intervals;
+  variance = ((double)detector->sum_squares / detector->num_intervals) -
+             (mean * mean);
+  std_dev = (variance > 0) ? sqrt(variance) : 0;
+  if (std_dev < HM_PHI_MIN_STD_DEV_MS)
+  {
+    std_dev = HM_PHI_MIN_STD_DEV_MS;
+  }
+
+  /***************************************************************************/
+  /* Logistic approximation of the tail of the normal distribution      */
+  /***************************************************************************/
+  elapsed = (double)(hm_time_ms() - detector->last_heard);
+  y = (elapsed - mean) / std_dev;
+  e = exp(-y * (1.5976 + 0.070566 * y * y));
+  if (elapsed > mean)
+  {
+    phi = -log10(e / (1.0 + e));
+  }
+  else
+  {
+    phi = -log10(1.0 - 1.0 / (1.0 + e));
+  }
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return (phi);
+}/* hm_phi */
+
+
+/**
+ *  @brief Mixes a value into a hash
+ *
+ *  Every bit of the result depends on every bit of both inputs, so hashes of
+ *  entries may be summed into a digest without like entries cancelling out.
+ *
+ *  @param hash Hash so far
+ *  @param value Value to mix into it
+ *  @return New hash
+ */
+uint32_t hm_hash_mix(uint32_t hash, uint32_t value)
+{
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+
+  return (hash);
+}/* hm_hash_mix */
+
+
+/***************************************************************************/
+/* Hybrid Logical Clock                            */
+/***************************************************************************/
+/**
+ *  @brief Wall clock in ms, shifted into place of a hybrid logical clock
+ *
+ *  @param None
+ *  @return Physical part of a hybrid logical clock now, with no events counted
+ */
+static uint64_t hm_hlc_physical()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  struct timespec now;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  clock_gettime(CLOCK_REALTIME, &now);
+  return ((((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000))
+                                                      << HM_HLC_LOGICAL_BITS);
+}/* hm_hlc_physical */
+
+
+/**
+ *  @brief Advances our hybrid logical clock for an event of ours
+ *
+ *  The clock follows the wall clock, but never stands still or steps back:
+ *  events within the same ms, or while the wall clock is behind, are counted
+ *  in its low bits.
+ *
+ *  @param None
+ *  @return Hybrid logical clock of the event
+ */
+uint64_t hm_hlc_now()
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint64_t physical;
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  physical = hm_hlc_physical();
+  LOCAL.hlc = (physical > LOCAL.hlc) ? physical : LOCAL.hlc + 1;
+
+  return (LOCAL.hlc);
+}/* hm_hlc_now */
+
+
+/**
+ *  @brief Brings our hybrid logical clock past that of a message received
+ *
+ *  Everything we stamp afterwards is then ordered after what the sender had
+ *  stamped before it sent the message.
+ *
+ *  @param hlc Hybrid logical clock of the sender. 0 if it did not stamp it.
+ *  @return @c void
+ */
+void hm_hlc_merge(uint64_t hlc)
+{
+  /***************************************************************************/
+  /* Variable Declarations                           */
+  /***************************************************************************/
+  uint64_t physical;
+  /***************************************************************************/
+  /* Sanity Checks                               */
+  /***************************************************************************/
+  TRACE_ENTRY();
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  if (hlc == 0)
+  {
+    goto EXIT_LABEL;
+  }
+
+  physical = hm_hlc_physical();
+  if ((hlc >> HM_HLC_LOGICAL_BITS) >
+      (physical >> HM_HLC_LOGICAL_BITS) + HM_HLC_MAX_DRIFT_MS)
+  {
+    TRACE_WARN(("Peer clock is ahead of ours by more than %d ms. Not followed.",
+                (int32_t)HM_HLC_MAX_DRIFT_MS));
+    goto EXIT_LABEL;
+  }
+
+  if (hlc >= LOCAL.hlc)
+  {
+    LOCAL.hlc = hlc;
+  }
+  LOCAL.hlc = (physical > LOCAL.hlc) ? physical : LOCAL.hlc + 1;
+
+EXIT_LABEL:
+  /***************************************************************************/
+  /* Exit Level Checks                             */
+  /***************************************************************************/
+  TRACE_EXIT();
+  return;
+}/* hm_hlc_merge */
+
+
+/**
+ *  @brief Writes a hybrid logical clock into a message in network order
+ *
+ *  @param *into 8 bytes of the message to write into
+ *  @param hlc Hybrid logical clock
+ *  @return @c void
+ */
+void hm_hlc_put(uint8_t *into, uint64_t hlc)
+{
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  hm_put_64(into, hlc);
+}/* hm_hlc_put */
+
+
+/**
+ *  @brief Reads a hybrid logical clock out of a message
+ *
+ *  @param *from 8 bytes of the message holding it in network order
+ *  @return Hybrid logical clock
+ */
+uint64_t hm_hlc_get(uint8_t *from)
+{
+  /***************************************************************************/
+  /* Main Routine                                 */
+  /***************************************************************************/
+  return (hm_get_64(from));
+}/* hm_hlc_get */
@@ -195,6 +195,10 @@ int32_t main(int32_t argc, char **argv)
 
   tlv = (HM_REGISTER_TLV_CB *)((char *)reg_msg + sizeof(HM_REGISTER_MSG));
   tlv->id = pct_type;
+  tlv->event_mask = 0;
+  tlv->location_mask = 0;
+  tlv->proc_type_mask = 0;
+  tlv->filter_flags = 0;
 
   TRACE_INFO(("Sending PROCESS_REGISTER message!"));
   ret_val = send(sock_fd, (char *)reg_msg, reg_msg->hdr.msg_len, 0);